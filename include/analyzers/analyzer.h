@@ -9,6 +9,7 @@
 #include <TH1.h>
 
 namespace Storage { class Event; }
+namespace Storage { struct EventView; }
 namespace Mechanics { class Device; }
 
 namespace Analyzers {
@@ -36,6 +37,8 @@ protected:
   const size_t m_ndevices;
   /** The events for each device, updated at each execute */
   std::vector<const Storage::Event*> m_events;
+  /** The event views for each device, updated at each view execute */
+  std::vector<const Storage::EventView*> m_views;
   /** Remember if this analyzer has already been finalized. */
   bool m_finalized;
 
@@ -45,6 +48,9 @@ protected:
   
   /** Event processing must be specified in derived class */
   virtual void process() = 0;
+  /** Event view processing, for analyzers which can work from the columns of
+    * `m_views` alone. Throws unless overridden. */
+  virtual void processView();
 
 public:
   /** Constructor for an analyzer which needs device information */
@@ -65,6 +71,12 @@ public:
   void execute(const std::vector<const Storage::Event*>& events);
   /** Single device event execution */
   void execute(const Storage::Event& event);
+  /** Multi device execution on event views */
+  void execute(const std::vector<const Storage::EventView*>& views);
+  /** Single device execution on an event view */
+  void execute(const Storage::EventView& view);
+  /** If the analyzer can be executed on event views */
+  virtual bool hasViews() const { return false; }
 
   /** Post processing */
   virtual void finalize();
@@ -39,6 +39,8 @@ private:
 
   /** Base virtual method defined, gives code to run at each loop */
   void process();
+  /** Same as `process`, reading the cluster columns of the views */
+  void processView();
 
 public:
   /** Automatically calls the correct base constuctor */
@@ -46,6 +48,8 @@ public:
   ClusterResiduals(const T& t) : Analyzer(t) { initialize(); }
   ~ClusterResiduals() {}
 
+  bool hasViews() const { return true; }
+
   void setOutput(TDirectory* dir, const std::string& name="ClusterResiduals") {
     // Just adds the default name
     Analyzer::setOutput(dir, name);
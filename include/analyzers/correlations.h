@@ -43,6 +43,8 @@ private:
 
   /** Base virtual method defined, gives code to run at each loop */
   void process();
+  /** Same as `process`, reading the cluster columns of the views */
+  void processView();
 
 public:
   /** Automatically calls the correct base constuctor */
@@ -51,6 +53,8 @@ public:
   /** Memory managed by base class */
   ~Correlations() {}
 
+  bool hasViews() const { return true; }
+
   void setOutput(TDirectory* dir, const std::string& name="Correlations") {
     // Just adds the default name
     Analyzer::setOutput(dir, name);
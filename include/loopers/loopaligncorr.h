@@ -6,7 +6,7 @@
 #include "analyzers/clusterresiduals.h"
 #include "loopers/looper.h"
 
-namespace Storage { class StorageI; }
+namespace Storage { class EventInput; }
 namespace Mechanics { class Device; }
 
 namespace Loopers {
@@ -25,10 +25,10 @@ private:
 
 public:
   LoopAlignCorr(
-      const std::vector<Storage::StorageI*>& inputs,
+      const std::vector<Storage::EventInput*>& inputs,
       const std::vector<Mechanics::Device*>& devices);
   LoopAlignCorr(
-      Storage::StorageI& input,
+      Storage::EventInput& input,
       Mechanics::Device& device);
   ~LoopAlignCorr() {}
 
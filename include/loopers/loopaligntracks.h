@@ -10,7 +10,7 @@
 #include "analyzers/trackchi2.h"
 #include "loopers/looper.h"
 
-namespace Storage { class StorageI; }
+namespace Storage { class EventInput; }
 namespace Mechanics { class Device; }
 
 namespace Loopers {
@@ -58,15 +58,17 @@ public:
   Processors::Tracking m_tracking;
 
   LoopAlignTracks(
-      const std::vector<Storage::StorageI*>& inputs,
+      const std::vector<Storage::EventInput*>& inputs,
       const std::vector<Mechanics::Device*>& devices);
   LoopAlignTracks(
-      Storage::StorageI& input,
+      Storage::EventInput& input,
       Mechanics::Device& device);
   ~LoopAlignTracks() {}
 
   /** Override default execute behaviour */
   void execute();
+  /** Execute needs the events */
+  bool readsViews() const { return false; }
 
   /** Compute and apply alignment as post-processing step */
   void finalize();
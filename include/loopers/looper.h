@@ -6,8 +6,9 @@
 #include <Rtypes.h>
 #include <TStopwatch.h>
 
-namespace Storage { class StorageI; }
+namespace Storage { class EventInput; }
 namespace Storage { class Event; }
+namespace Storage { struct EventView; }
 namespace Mechanics { class Device; }
 namespace Processors { class Processor; }
 namespace Analyzers { class Analyzer; }
@@ -32,9 +33,11 @@ private:
 
 protected:
   /** List of inputs from which to read events */
-  const std::vector<Storage::StorageI*> m_inputs;
+  const std::vector<Storage::EventInput*> m_inputs;
   /** List of events (in the same order as the inputs) read an iteration */
   std::vector<Storage::Event*> m_events;
+  /** Event views read instead of the events, see `readsViews` */
+  std::vector<const Storage::EventView*> m_views;
   /** Optional vector of device information. Note: it is up to the derived 
     * looper to check if device information is provided. */
   const std::vector<Mechanics::Device*> m_devices;
@@ -57,6 +60,12 @@ protected:
 
   /** Print a progress bar and bandwidth */
   void printProgress();
+  /** If the loop can read event views rather than events: there are no
+    * processors, and all the analyzers take views. Loopers whose `execute`
+    * needs the events must return false. */
+  virtual bool readsViews() const;
+  /** Execute the analyzers on the event views */
+  void executeViews();
 
 public:
   /** First event index to process */
@@ -69,17 +78,20 @@ public:
   unsigned m_printInterval;
   /** Draw outputs or not (not always applicable) */
   bool m_draw;
+  /** Decode this many events ahead of the loop on a background thread for
+    * each input (0 is off) */
+  size_t m_prefetch;
 
   /** Constructor for multi device looper without device information */
-  Looper(const std::vector<Storage::StorageI*>& inputs);
+  Looper(const std::vector<Storage::EventInput*>& inputs);
   /** Constructor for multi device looper with device information */
   Looper(
-      const std::vector<Storage::StorageI*>& inputs,
+      const std::vector<Storage::EventInput*>& inputs,
       const std::vector<Mechanics::Device*>& devices);
   /** Constructor for single device looper without device information */
-  Looper(Storage::StorageI& input);
+  Looper(Storage::EventInput& input);
   /** Constructor for single device looper with device information */
-  Looper(Storage::StorageI& input, Mechanics::Device& device);
+  Looper(Storage::EventInput& input, Mechanics::Device& device);
   virtual ~Looper() {}
   
   /** Loop over the largest common set of events in the inputs */
@@ -3,7 +3,7 @@
 
 #include "loopers/looper.h"
 
-namespace Storage { class StorageI; }
+namespace Storage { class EventInput; }
 namespace Storage { class StorageO; }
 namespace Processors { class Clustering; }
 namespace Processors { class Aligning; }
@@ -24,11 +24,13 @@ private:
   Storage::StorageO& m_output;
 
 public:
-  LoopProcess(Storage::StorageI& input, Storage::StorageO& output);
+  LoopProcess(Storage::EventInput& input, Storage::StorageO& output);
   ~LoopProcess() {}
 
   /** Execute writes to the output */
   void execute();
+  /** Execute needs the events */
+  bool readsViews() const { return false; }
 };
 
 }
@@ -6,7 +6,7 @@
 #include "analyzers/clusterresiduals.h"
 #include "loopers/looper.h"
 
-namespace Storage { class StorageI; }
+namespace Storage { class EventInput; }
 namespace Mechanics { class Device; }
 namespace Processors { class Tracking; }
 
@@ -31,10 +31,10 @@ private:
 
 public:
   LoopTransfers(
-      const std::vector<Storage::StorageI*>& inputs,
+      const std::vector<Storage::EventInput*>& inputs,
       const std::vector<Mechanics::Device*>& devices);
   LoopTransfers(
-      Storage::StorageI& input,
+      Storage::EventInput& input,
       Mechanics::Device& device);
   ~LoopTransfers() {}
 
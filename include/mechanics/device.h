@@ -44,6 +44,8 @@ public:
   std::string m_timeUnit;
   /** Path of file where this device can store alignment information */
   std::string m_alignmentFile;
+  /** Path of file listing the noisy pixels of the sensors */
+  std::string m_noiseMaskFile;
 
   /** Clock tick of first event in read out */
   ULong64_t m_timeStart;
@@ -72,6 +74,9 @@ public:
   void maskSensor(size_t n, bool mask=true);
   /** Get the mask applied to the full list of sensors */
   const std::vector<bool>& getSensorMask() const { return m_sensorMask; }
+  /** Noise masks of the active sensors, as the storage takes them. Empty
+    * if the device has no noise mask file. */
+  std::vector<Storage::PixelMask> getNoiseMasks() const;
   /** Get the number of sensors in the device */
   inline size_t getNumSensors() const { return m_sensors.size(); } 
   /** Get a reference to the sensor `n` */
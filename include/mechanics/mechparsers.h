@@ -14,6 +14,12 @@ Device* parseDevice(const std::string& filePath);
 /** Set a device's alignment based on its alignment file. */
 void parseAlignment(Device& device);
 
+/** Set a device's sensor noise masks based on its noise mask file, which
+  * lists one pixel per line as `sensor, column, row` (as written by the
+  * noise scan). Sensors are numbered in the active list, so parse it before
+  * masking any. */
+void parseNoiseMask(Device& device);
+
 /** Write out a device's alignment */
 void writeAlignment(const Device& device);
 
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "storage/pixelmask.h"
 #include "mechanics/alignment.h"
 
 namespace Mechanics {
@@ -41,9 +42,9 @@ public:
   /** Vector of noisy hit rate for each pixel. Pixel order is given by 
     * `getPixelIndex` */
   std::vector<double> m_noiseProfile;
-  /** Vector indicating which pixels are masked (true if masked). Pixel order
-    * is given by `getPixelIndex`. */
-  std::vector<bool> m_noiseMask;
+  /** Bitset indicating which pixels are masked. Pixel order is given by
+    * `getPixelIndex`, so that it can be handed to the storage as is. */
+  Storage::PixelMask m_noiseMask;
   
   Sensor();
   Sensor(const Sensor& copy);
@@ -2,12 +2,19 @@
 #define PROC_CLUSTERING_H
 
 #include <list>
+#include <vector>
+#include <memory>
+#include <cstdint>
 
 #include "processors/processor.h"
+#include "processors/pixelbitmap.h"
+#include "processors/threadpool.h"
 
 namespace Storage { class Hit; }
 namespace Storage { class Cluster; }
+namespace Storage { class Plane; }
 namespace Storage { class Event; }
+namespace Mechanics { class Device; }
 
 namespace Processors {
 
@@ -19,10 +26,80 @@ namespace Processors {
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Clustering : public Processor {
+public:
+  /** Algorithms to find the hits of each cluster */
+  enum Algorithm {
+    // Compare each clustered hit with all unclustered hits, using
+    // `clusterSeed`
+    SCAN,
+    // Sort the plane's hits by column then row once, and compare each
+    // clustered hit only with those in its window. Gives the same clusters.
+    SWEEP
+  };
+
+private:
+  /** Hit in the sweep order, with its index in the plane */
+  struct SweepHit {
+    int x;
+    int y;
+    std::uint32_t index;
+  };
+
+  /** Hits of a plane grouped into clusters: cluster `n` is made of `hits`
+    * from `starts[n]` to `starts[n+1]`, or the end for the last one */
+  struct PlaneClusters {
+    std::vector<Storage::Hit*> hits;
+    std::vector<std::uint32_t> starts;
+  };
+
+  /** Work space of one thread, kept from one plane to the next */
+  struct WorkSpace {
+    std::vector<SweepHit> sweep;
+    std::vector<char> isClustered;
+    std::vector<std::uint32_t> search;
+    std::vector<std::uint32_t> neighbours;
+    std::vector<PixelBitmap::Pixel> pixels;
+    std::vector<std::uint32_t> labelClusters;
+  };
+
+  /** Clusters of each plane of the event being processed */
+  std::vector<PlaneClusters> m_planeClusters;
+  std::vector<WorkSpace> m_workSpaces;
+  /** Hits of the cluster being built */
+  std::vector<Storage::Hit*> m_clusterHits;
+  /** Occupancy bitmap of each device's sensors, made when first needed */
+  std::vector<std::vector<PixelBitmap> > m_bitmaps;
+  /** Threads clustering the planes, made when first needed */
+  std::unique_ptr<ThreadPool> m_pool;
+
+  /** Group a plane's hits with the `SCAN` algorithm */
+  void scanPlane(const Storage::Plane& plane, PlaneClusters& clusters);
+  /** Group a plane's hits with the `SWEEP` algorithm */
+  void sweepPlane(
+      const Storage::Plane& plane,
+      PlaneClusters& clusters,
+      WorkSpace& work) const;
+  /** Group a plane's hits with the bitmap of its sensor. Returns false if a
+    * hit is outside the sensor. */
+  bool bitmapPlane(
+      const Storage::Plane& plane,
+      PlaneClusters& clusters,
+      WorkSpace& work,
+      PixelBitmap& bitmap) const;
+  /** Group a plane's hits with the algorithm suited to it. Planes can be
+    * grouped at the same time, each with its own work space. */
+  void groupPlane(
+      const Storage::Plane& plane,
+      const Mechanics::Device* device,
+      size_t ndevice,
+      PlaneClusters& clusters,
+      WorkSpace& work);
+
 protected:
   /** Algorithm builds a list of hits belonging to the same cluster as the
     * provided seed. It is called from `process` and can be extended to
-    * implement a different clustering algorithm */
+    * implement a different clustering algorithm. With `m_threads` above 1, it
+    * is called for several planes at once. */
   virtual void clusterSeed(
       Storage::Hit& seed,
       std::list<Storage::Hit*>& hits,
@@ -32,10 +109,11 @@ protected:
     * mean and uncertainties for the clusters. */
   virtual void buildCluster(
       Storage::Cluster& cluster,
-      std::list<Storage::Hit*>& clustered);
+      const std::vector<Storage::Hit*>& clustered);
 
-  /** Processing is done device-by-device, so make single device method */
-  virtual void processEvent(Storage::Event& event);
+  /** Processing is done device-by-device, so make single device method.
+    * `ndevice` indexes the devices, if they were given. */
+  virtual void processEvent(Storage::Event& event, size_t ndevice);
 
   /** Base virtual method called at each loop iteration */
   virtual void process();
@@ -47,6 +125,18 @@ public:
   unsigned m_maxCols;
   /** Weight the cluster center and RMS by its hit values */
   bool m_weighted;
+  /** Algorithm finding the hits of each cluster */
+  Algorithm m_algorithm;
+  /** Fraction of a sensor's pixels which must be hit for its plane to be
+    * clustered with an occupancy bitmap, instead of `m_algorithm`. Needs the
+    * devices, and is 0 (off) by default: the bitmap doesn't go through
+    * `clusterSeed`, and it lists each cluster's hits in another order than
+    * the search does, which can change the rounding of the cluster values. */
+  double m_denseOccupancy;
+  /** Number of threads finding the clusters of an event's planes at once.
+    * The clusters are then made in plane order, so the event is the same as
+    * with a single thread. */
+  unsigned m_threads;
 
   /** Clustering doesn't require device information, so construct only with
     * the expected number of devices (events) */
@@ -54,13 +144,36 @@ public:
       Processor(ndevices),
       m_maxRows(1),
       m_maxCols(1),
-      m_weighted(false) {}
+      m_weighted(false),
+      m_algorithm(SCAN),
+      m_denseOccupancy(0),
+      m_threads(1) {}
+  /** With the devices, whose sensor sizes allow the bitmap clustering */
+  Clustering(const std::vector<Mechanics::Device*>& devices) :
+      Processor(devices),
+      m_maxRows(1),
+      m_maxCols(1),
+      m_weighted(false),
+      m_algorithm(SCAN),
+      m_denseOccupancy(0),
+      m_threads(1) {}
+  Clustering(Mechanics::Device& device) :
+      Processor(device),
+      m_maxRows(1),
+      m_maxCols(1),
+      m_weighted(false),
+      m_algorithm(SCAN),
+      m_denseOccupancy(0),
+      m_threads(1) {}
   /** Keep the default constructor around, to make single device clustering */
   Clustering()  :
       Processor(1),
       m_maxRows(1),
       m_maxCols(1),
-      m_weighted(false) {}
+      m_weighted(false),
+      m_algorithm(SCAN),
+      m_denseOccupancy(0),
+      m_threads(1) {}
   virtual ~Clustering() {}
 };
 
@@ -0,0 +1,220 @@
+#ifndef PIXELBITMAP_H
+#define PIXELBITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace Processors {
+
+/**
+  * Occupancy bitmap of a sensor, which labels the groups of hit pixels
+  * connected within a maximal separation in columns and rows. It replaces the
+  * hit list when a plane is so occupied that its hits are better found by
+  * position than by comparing them.
+  *
+  * The labelling takes two passes over the rows with hits. The first splits
+  * each row into runs of pixels closer than the separation, a 64 bit word at
+  * a time, and joins each run to the runs it reaches in the rows before it.
+  * The second resolves the joins into one label per group.
+  *
+  * The bitmap is kept between planes of the same sensor. Only the words the
+  * hits were painted in are cleared, so a plane costs in proportion to its
+  * hits and the rows they are in, not to the size of the sensor.
+  */
+class PixelBitmap {
+public:
+  /** Pixel of a hit, which must be inside the sensor */
+  struct Pixel {
+    unsigned col;
+    unsigned row;
+  };
+
+private:
+  /** Pixels `begin` to `end` (included) of a row, closer than the separation */
+  struct Run {
+    unsigned begin;
+    unsigned end;
+  };
+
+  unsigned m_ncols;
+  unsigned m_nrows;
+  /** Number of words in a row of the bitmap */
+  unsigned m_nwords;
+  std::vector<std::uint64_t> m_bits;
+  /** Flags the rows with hits, and is cleared with the bitmap */
+  std::vector<char> m_rowHit;
+  /** Position of each row with hits in `m_rows`. Only set for those rows */
+  std::vector<std::uint32_t> m_rowIndex;
+  /** Rows with hits, in order, and their first run */
+  std::vector<std::uint32_t> m_rows;
+  std::vector<std::uint32_t> m_rowRuns;
+  std::vector<Run> m_runs;
+  /** Run with which each run is joined, before it in the list or itself */
+  std::vector<std::uint32_t> m_parent;
+  std::vector<std::uint32_t> m_runLabels;
+  std::vector<std::uint32_t> m_labels;
+
+  inline std::uint32_t findRoot(std::uint32_t run) {
+    while (m_parent[run] != run) {
+      m_parent[run] = m_parent[m_parent[run]];
+      run = m_parent[run];
+    }
+    return run;
+  }
+
+  /** Join the runs of two rows with hits which are within `sepCols` */
+  void joinRows(std::uint32_t row1, std::uint32_t row2, unsigned sepCols) {
+    std::uint32_t i1 = m_rowRuns[row1];
+    std::uint32_t i2 = m_rowRuns[row2];
+    const std::uint32_t end1 = m_rowRuns[row1+1];
+    const std::uint32_t end2 = m_rowRuns[row2+1];
+    // Runs extended by the separation past their end don't overlap others of
+    // their row, so each row is a sorted list of intervals
+    while (i1 < end1 && i2 < end2) {
+      const Run& run1 = m_runs[i1];
+      const Run& run2 = m_runs[i2];
+      if (run2.begin <= (std::uint64_t)run1.end+sepCols &&
+          run1.begin <= (std::uint64_t)run2.end+sepCols) {
+        const std::uint32_t root1 = findRoot(i1);
+        const std::uint32_t root2 = findRoot(i2);
+        // The earlier run becomes the root, so it is labelled first
+        if (root1 < root2) m_parent[root2] = root1;
+        else m_parent[root1] = root2;
+      }
+      // The run ending first overlaps nothing past the other
+      if (run1.end < run2.end) i1++;
+      else i2++;
+    }
+  }
+
+  /** Split a row into runs, merging those separated by at most `sepCols` */
+  void addRuns(unsigned row, unsigned sepCols) {
+    const std::uint64_t* words = &m_bits[(size_t)row*m_nwords];
+    const std::uint32_t first = m_runs.size();
+    for (unsigned iword = 0; iword < m_nwords; iword++) {
+      std::uint64_t word = words[iword];
+      while (word) {
+        const unsigned start = __builtin_ctzll(word);
+        // Length of the set bits from `start`
+        const std::uint64_t rest = ~(word >> start);
+        const unsigned length = rest ? __builtin_ctzll(rest) : 64;
+        const unsigned begin = 64*iword + start;
+        const unsigned end = begin + length - 1;
+        if (sepCols == 0) {
+          // Only the same column is in reach, each pixel is a run
+          for (unsigned col = begin; col <= end; col++) {
+            const Run run = { col, col };
+            m_runs.push_back(run);
+          }
+        } else if (m_runs.size() > first &&
+            begin - m_runs.back().end <= sepCols) {
+          m_runs.back().end = end;
+        } else {
+          const Run run = { begin, end };
+          m_runs.push_back(run);
+        }
+        word = start+length < 64 ? word & (~0ULL << (start+length)) : 0;
+      }
+    }
+  }
+
+public:
+  PixelBitmap() : m_ncols(0), m_nrows(0), m_nwords(0) {}
+
+  /** Size the bitmap for a sensor of `ncols` by `nrows` pixels */
+  void resize(unsigned ncols, unsigned nrows) {
+    if (ncols == m_ncols && nrows == m_nrows) return;
+    m_ncols = ncols;
+    m_nrows = nrows;
+    m_nwords = (ncols+63) / 64;
+    m_bits.assign((size_t)m_nwords*nrows, 0);
+    m_rowHit.assign(nrows, 0);
+    m_rowIndex.assign(nrows, 0);
+  }
+
+  inline bool contains(long long col, long long row) const {
+    return col >= 0 && col < m_ncols && row >= 0 && row < m_nrows;
+  }
+
+  /** Label the groups of pixels within `sepCols` columns and `sepRows` rows
+    * of one another. Returns the number of groups, labelled from 0 in the
+    * order of their first row then column. */
+  std::uint32_t label(
+      const std::vector<Pixel>& pixels,
+      unsigned sepCols,
+      unsigned sepRows) {
+    const size_t npixels = pixels.size();
+
+    // Paint the hits, noting the rows they are in
+    m_rows.clear();
+    for (size_t i = 0; i < npixels; i++) {
+      const Pixel& pixel = pixels[i];
+      m_bits[(size_t)pixel.row*m_nwords + pixel.col/64] |=
+          1ULL << (pixel.col%64);
+      if (m_rowHit[pixel.row]) continue;
+      m_rowHit[pixel.row] = 1;
+      m_rows.push_back(pixel.row);
+    }
+    std::sort(m_rows.begin(), m_rows.end());
+
+    // First pass: runs of each row, joined to those of the rows in reach
+    m_runs.clear();
+    m_rowRuns.clear();
+    const std::uint32_t nrows = m_rows.size();
+    for (std::uint32_t i = 0; i < nrows; i++) {
+      m_rowIndex[m_rows[i]] = i;
+      m_rowRuns.push_back(m_runs.size());
+      addRuns(m_rows[i], sepCols);
+    }
+    m_rowRuns.push_back(m_runs.size());
+
+    const std::uint32_t nruns = m_runs.size();
+    m_parent.resize(nruns);
+    for (std::uint32_t i = 0; i < nruns; i++) m_parent[i] = i;
+    for (std::uint32_t i = 1; i < nrows; i++) {
+      for (std::uint32_t j = i; j-- > 0; ) {
+        if (m_rows[i] - m_rows[j] > sepRows) break;
+        joinRows(j, i, sepCols);
+      }
+    }
+
+    // Second pass: roots come before the runs joined to them
+    std::uint32_t nlabels = 0;
+    m_runLabels.resize(nruns);
+    for (std::uint32_t i = 0; i < nruns; i++) {
+      const std::uint32_t root = findRoot(i);
+      m_runLabels[i] = root == i ? nlabels++ : m_runLabels[root];
+    }
+
+    // Label each pixel by its run, then clear the words it was painted in
+    m_labels.resize(npixels);
+    for (size_t i = 0; i < npixels; i++) {
+      const Pixel& pixel = pixels[i];
+      const std::uint32_t row = m_rowIndex[pixel.row];
+      // Last run of the row starting at or before the pixel
+      std::uint32_t low = m_rowRuns[row];
+      std::uint32_t high = m_rowRuns[row+1];
+      while (high - low > 1) {
+        const std::uint32_t mid = (low + high) / 2;
+        if (m_runs[mid].begin <= pixel.col) low = mid;
+        else high = mid;
+      }
+      m_labels[i] = m_runLabels[low];
+      m_bits[(size_t)pixel.row*m_nwords + pixel.col/64] = 0;
+      m_rowHit[pixel.row] = 0;
+    }
+
+    return nlabels;
+  }
+
+  /** Label of each pixel given to the last `label` call */
+  const std::vector<std::uint32_t>& getLabels() const { return m_labels; }
+
+  inline unsigned getNumCols() const { return m_ncols; }
+  inline unsigned getNumRows() const { return m_nrows; }
+};
+
+}
+
+#endif  // PIXELBITMAP_H
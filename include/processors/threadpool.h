@@ -0,0 +1,128 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Processors {
+
+/**
+  * Small pool of threads which runs a batch of jobs, such as one per plane of
+  * an event, and waits for all of them. The calling thread takes jobs too, so
+  * a pool of `n` threads starts `n-1` of its own. They are kept between
+  * batches, so that a batch costs a wake up rather than a thread start.
+  *
+  * Jobs are taken in order but finish in any order: results must be stored
+  * per job, and combined in order by the caller once `run` returns.
+  */
+class ThreadPool {
+public:
+  /** Job `n` of a batch, run by thread `ithread` (0 is the caller) */
+  typedef std::function<void(size_t n, unsigned ithread)> Job;
+
+private:
+  // Disable copy and assignment operators
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_start;
+  std::condition_variable m_done;
+  /** Current batch, and how far it got */
+  const Job* m_job;
+  size_t m_njobs;
+  size_t m_next;
+  size_t m_finished;
+  unsigned long m_batch;
+  bool m_stop;
+  /** First exception thrown by a job of the batch */
+  std::exception_ptr m_error;
+
+  /** Run jobs of the batch until none are left. Called with the lock held */
+  void takeJobs(std::unique_lock<std::mutex>& lock, unsigned ithread) {
+    while (m_next < m_njobs) {
+      const size_t n = m_next++;
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        (*m_job)(n, ithread);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      if (error && !m_error) {
+        // Skip the jobs not yet taken
+        m_error = error;
+        m_finished += m_njobs - m_next;
+        m_next = m_njobs;
+      }
+      if (++m_finished == m_njobs) m_done.notify_all();
+    }
+  }
+
+  void work(unsigned ithread) {
+    unsigned long batch = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_start.wait(lock, [&]() { return m_stop || m_batch != batch; });
+      if (m_stop) return;
+      batch = m_batch;
+      takeJobs(lock, ithread);
+    }
+  }
+
+public:
+  ThreadPool(unsigned nthreads) :
+      m_job(0),
+      m_njobs(0),
+      m_next(0),
+      m_finished(0),
+      m_batch(0),
+      m_stop(false) {
+    for (unsigned ithread = 1; ithread < nthreads; ithread++)
+      m_threads.push_back(std::thread(&ThreadPool::work, this, ithread));
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_start.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++) m_threads[i].join();
+  }
+
+  /** Run jobs 0 to `njobs` (excluded) and wait for them. Rethrows the first
+    * exception of a job, once the jobs already started are done. */
+  void run(size_t njobs, const Job& job) {
+    if (njobs == 0) return;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_job = &job;
+    m_njobs = njobs;
+    m_next = 0;
+    m_finished = 0;
+    m_error = std::exception_ptr();
+    m_batch++;
+    m_start.notify_all();
+
+    takeJobs(lock, 0);
+    m_done.wait(lock, [&]() { return m_finished == m_njobs; });
+
+    if (m_error) {
+      std::exception_ptr error = m_error;
+      m_error = std::exception_ptr();
+      std::rethrow_exception(error);
+    }
+  }
+
+  inline unsigned getNumThreads() const { return m_threads.size() + 1; }
+};
+
+}
+
+#endif  // THREADPOOL_H
@@ -2,12 +2,16 @@
 #define CLUSTER_H
 
 #include <vector>
+#include <cstdint>
+
+#include "storage/membership.h"
 
 namespace Storage {
 
 class Hit;
 class Track;
 class Plane;
+class Event;
 
 /**
   * Collection of hits which are considered to belong to the same particle-
@@ -15,16 +19,28 @@ class Plane;
   * be matched to a track which doesn't include the cluster. See hit for
   * information on naming conventions and friend class access.
   *
+  * The hits of a cluster made by an `Event` are listed by index in the
+  * event's flat membership array, rather than in a vector of their own, and
+  * its track and plane are also referred to by index.
+  *
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Cluster {
 protected:
-  /** List of hits comprising this cluster */
-  std::vector<Hit*> m_hits;
-  /** If this cluster is part of a track, points to that track */
-  Track* m_track;  
-  /** Points to nearest track to this cluster */
-  Track* m_matchedTrack;  
+  /** Event owning this cluster, 0 for a cluster made outside an event */
+  Event* m_event;
+  /** Hits comprising this cluster, in the event's membership array */
+  MemberRange m_hits;
+  /** Index+1 of the nearest track to this cluster in the event, 0 if none */
+  std::uint32_t m_matchedTrack;
+  /** Track of which this cluster is part: its index+1 in the event (0 if
+    * none), or a pointer for a cluster outside an event */
+  union {
+    std::uint32_t m_track;
+    Track* m_ownTrack;
+  };
+  /** Hits of a cluster outside an event */
+  std::vector<Hit*> m_ownHits;
   /** Distance to the nearest track to this cluster */
   double m_matchDistance;
   /** Cluster's center of gravity in the pixel space x direction */
@@ -49,8 +65,8 @@ protected:
   /** Index of this cluster in the list of all clusters. Needed to build hit-
     * cluster associations when reading from disk. */
   int m_index;
-  /** Plane to which this cluster belongs set by friend Plane class */
-  Plane* m_plane;
+  /** Number of the plane to which this cluster belongs, set by friend Event */
+  std::uint32_t m_plane;
   /** Clear values so the object can be re-used */
   void clear();
 
@@ -64,12 +80,14 @@ public:
   /** Add a hit to this cluster. Does bi-directional linking. */
   void addHit(Hit& hit);
   /** Reserve some space for adding hits to make the process faster */
-  void reserveHits(size_t n) { m_hits.reserve(n); }
+  void reserveHits(size_t n);
   /** Compute the properties of the cluster from the provided hits */
   void compute();
 
   Hit& getHit(size_t n) const;
-  inline size_t getNumHits() const { return m_hits.size(); }
+  inline size_t getNumHits() const {
+    return m_event ? m_hits.size() : m_ownHits.size();
+  }
   inline double getMatchDistance() const { return m_matchDistance; }
   inline double getPixX() const { return m_pixX; }
   inline double getPixY() const { return m_pixY; }
@@ -83,9 +101,9 @@ public:
   inline double getPosErrZ() const { return m_posErrZ; }
   inline double getTiming() const { return m_timing; }
   inline double getValue() const { return m_value; }
-  inline Track* fetchTrack() const { return m_track; }
-  inline Track* fetchMatchedTrack() const { return m_matchedTrack; }
-  inline Plane* fetchPlane() const { return m_plane; }
+  Track* fetchTrack() const;
+  Track* fetchMatchedTrack() const;
+  Plane* fetchPlane() const;
 
   inline int getIndex() const { return m_index; }
 
@@ -100,6 +118,8 @@ public:
 
   friend class StorageIO;  // Sets values
   friend class Event;  // Access index
+  friend class Hit;  // Links by index
+  friend class Track;
 };
 
 }
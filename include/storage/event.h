@@ -5,11 +5,14 @@
 
 #include <Rtypes.h>
 
+#include "storage/hit.h"
+#include "storage/cluster.h"
+#include "storage/track.h"
+#include "storage/slab.h"
+#include "storage/eventview.h"
+
 namespace Storage {
 
-class Hit;
-class Cluster;
-class Track;
 class Plane;
 class StorageIO;
 
@@ -22,6 +25,14 @@ class StorageIO;
   * access is provided through getters and setters so that a constant interface
   * can be maintained even if the underlying data structure changes.
   *
+  * The hits, clusters and tracks live in one slab per type (see `Slab`), and
+  * are re-used when the event is cleared. They refer to each other by their
+  * 32 bit index in the slabs, and each plane keeps the range of its hits and
+  * clusters, so that a plane whose objects were made one after the other
+  * can be scanned as an array. The hits of each cluster and the clusters of
+  * each track are listed in flat membership arrays (see `Membership`), so
+  * that filling an event makes no allocations once the arrays have grown.
+  *
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Event {
@@ -31,18 +42,21 @@ private:
   Event& operator=(const Event&);
 
 protected:
-  /** The event can be owned by a storage object which cahces it and its
-    * constituents */
+  /** The event can be owned by a storage object which re-uses it */
   StorageIO* m_storage;
   
-  /** Pointers to all the `Hit` objects */
-  std::vector<Hit*> m_hits;
-  /** Pointers to all the `Cluster` objects */
-  std::vector<Cluster*> m_clusters;
+  /** The `Hit`, `Cluster` and `Track` objects owned by this event. A const
+    * event still hands out its objects, as their getters always have */
+  mutable Slab<Hit> m_hitSlab;
+  mutable Slab<Cluster> m_clusterSlab;
+  mutable Slab<Track> m_trackSlab;
+  /** Hits of each cluster, and clusters (and matched clusters) of each track */
+  Membership m_clusterHits;
+  Membership m_trackClusters;
+  Membership m_matchedClusters;
+
   /** Pointers the `Plane` objects */
   std::vector<Plane*> m_planes;
-  /** Pointers to the `Track` objects */
-  std::vector<Track*> m_tracks;
 
   /** Timestamp at which this event was triggered */
   ULong64_t m_timeStamp;
@@ -57,8 +71,8 @@ protected:
 
   /** Constructor managed by friend StorageIO class */
   Event(StorageIO& storage);
-  /** Clear the values so the object can be re-used. Loose owernship over
-    * hits, clusters and tracks */
+  /** Clear the values so the object can be re-used. The hits, clusters and
+    * tracks are kept for the next fill */
   void clear();
 
 public:
@@ -82,10 +96,12 @@ public:
   Plane& getPlane(size_t n) const;
   Track& getTrack(size_t n) const;
 
-  const std::vector<Hit*>& getHits() const { return m_hits; }
-  const std::vector<Cluster*>& getClusters() const { return m_clusters; }
   const std::vector<Plane*>& getPlanes() const { return m_planes; }
-  const std::vector<Track*>& getTracks() const { return m_tracks; }
+
+  /** Hits of plane `nplane` as one array, for a linear scan. False if they
+    * aren't contiguous, in which case `Plane::getHit` must be used. */
+  bool getPlaneHits(size_t nplane, Span<Hit>& hits) const;
+  bool getPlaneClusters(size_t nplane, Span<Cluster>& clusters) const;
 
   inline void setInvalid(bool value) { m_invalid = value; }
   inline void setTimeStamp(ULong64_t timeStamp) { m_timeStamp = timeStamp; }
@@ -93,10 +109,10 @@ public:
   inline void setTriggerOffset(int triggerOffset) { m_triggerOffset = triggerOffset; }
   inline void setTriggerInfo(int triggerInfo) { m_triggerInfo = triggerInfo; }
 
-  inline size_t getNumHits() const { return m_hits.size(); }
-  inline size_t getNumClusters() const { return m_clusters.size(); }
+  inline size_t getNumHits() const { return m_hitSlab.size(); }
+  inline size_t getNumClusters() const { return m_clusterSlab.size(); }
   inline size_t getNumPlanes() const { return m_planes.size(); }
-  inline size_t getNumTracks() const { return m_tracks.size(); }
+  inline size_t getNumTracks() const { return m_trackSlab.size(); }
   inline ULong64_t getTimeStamp() const { return m_timeStamp; }
   inline ULong64_t getFrameNumber() const { return m_frameNumber; }
   inline int getTriggerOffset() const { return m_triggerOffset; }
@@ -104,6 +120,10 @@ public:
   inline bool getInvalid() const { return m_invalid; }
 
   friend StorageIO;  // Manages cache
+  friend class Plane;  // Objects are linked by their index in the slabs
+  friend class Hit;
+  friend class Cluster;
+  friend class Track;
 };
 
 }
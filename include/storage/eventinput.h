@@ -0,0 +1,42 @@
+#ifndef EVENTINPUT_H
+#define EVENTINPUT_H
+
+#include <Rtypes.h>
+
+namespace Storage {
+
+class Event;
+struct EventView;
+
+/**
+  * Interface of the storages from which events are read back, so that a
+  * looper can read from any of them (`StorageI`, `StorageMapped`).
+  */
+class EventInput {
+public:
+  virtual ~EventInput() {}
+
+  virtual Long64_t getNumEvents() const = 0;
+  virtual size_t getNumPlanes() const = 0;
+
+  /** Generate the `Event` object filled from entry `n`. The event is valid
+    * until the next call. */
+  virtual Event& readEvent(Long64_t n) = 0;
+  /** Columnar view of entry `n`, valid until the next read */
+  virtual const EventView& readView(Long64_t n) = 0;
+
+  /** Decode up to `depth` events ahead of the reader for the entries
+    * `start`, `start+step`, ... below `end`. Does nothing for inputs which
+    * are cheap to read in place. */
+  virtual void startPrefetch(
+      size_t /*depth*/,
+      Long64_t /*start*/,
+      Long64_t /*end*/,
+      Long64_t /*step*/=1) {}
+  /** Stop reading ahead */
+  virtual void stopPrefetch() {}
+};
+
+}
+
+#endif // EVENTINPUT_H
@@ -0,0 +1,112 @@
+#ifndef EVENTVIEW_H
+#define EVENTVIEW_H
+
+#include <vector>
+
+#include <Rtypes.h>
+
+namespace Storage {
+
+/**
+  * Read-only window onto `size` contiguous values owned by someone else.
+  */
+template <class T>
+class Span {
+private:
+  const T* m_data;
+  size_t m_size;
+
+public:
+  Span() : m_data(0), m_size(0) {}
+  Span(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+  inline const T& operator[](size_t n) const { return m_data[n]; }
+  inline const T* begin() const { return m_data; }
+  inline const T* end() const { return m_data+m_size; }
+  inline const T* data() const { return m_data; }
+  inline size_t size() const { return m_size; }
+  inline bool empty() const { return m_size == 0; }
+};
+
+/**
+  * Structure-of-arrays view of one event, pointing directly at the arrays
+  * into which `StorageI` reads the file's branches. No hit, cluster or track
+  * objects are built, so analysis which only needs a few columns of the
+  * event can loop over contiguous memory.
+  *
+  * The spans are only valid until the storage reads its next event or view.
+  * Columns whose branches are off or missing are filled with zeros.
+  * Associations are stored as in the file: the index of the parent cluster
+  * or track plus one, 0 if there is none.
+  */
+struct EventView {
+  /** Columns of the hits and clusters in one plane */
+  struct PlaneView {
+    size_t numHits;
+    Span<Int_t> hitPixX;
+    Span<Int_t> hitPixY;
+    Span<Double_t> hitPosX;
+    Span<Double_t> hitPosY;
+    Span<Double_t> hitPosZ;
+    Span<Int_t> hitValue;
+    Span<Int_t> hitTiming;
+    Span<Int_t> hitInCluster;
+    /** Non-zero for hits in noisy pixels. Empty without noise masks. Note
+      * that masked hits are flagged here, even in the `REMOVE` mask mode. */
+    Span<char> hitMasked;
+
+    size_t numClusters;
+    Span<Double_t> clusterPixX;
+    Span<Double_t> clusterPixY;
+    Span<Double_t> clusterPixErrX;
+    Span<Double_t> clusterPixErrY;
+    Span<Double_t> clusterPosX;
+    Span<Double_t> clusterPosY;
+    Span<Double_t> clusterPosZ;
+    Span<Double_t> clusterPosErrX;
+    Span<Double_t> clusterPosErrY;
+    Span<Double_t> clusterPosErrZ;
+    Span<Double_t> clusterValue;
+    Span<Double_t> clusterTiming;
+    Span<Int_t> clusterInTrack;
+
+    PlaneView() : numHits(0), numClusters(0) {}
+  };
+
+  ULong64_t timeStamp;
+  ULong64_t frameNumber;
+  Int_t triggerOffset;
+  Int_t triggerInfo;
+  bool invalid;
+
+  size_t numTracks;
+  Span<Double_t> trackSlopeX;
+  Span<Double_t> trackSlopeY;
+  Span<Double_t> trackSlopeErrX;
+  Span<Double_t> trackSlopeErrY;
+  Span<Double_t> trackOriginX;
+  Span<Double_t> trackOriginY;
+  Span<Double_t> trackOriginErrX;
+  Span<Double_t> trackOriginErrY;
+  Span<Double_t> trackCovarianceX;
+  Span<Double_t> trackCovarianceY;
+  Span<Double_t> trackChi2;
+
+  /** One entry per plane read from the storage */
+  std::vector<PlaneView> planes;
+
+  EventView() :
+      timeStamp(0),
+      frameNumber(0),
+      triggerOffset(0),
+      triggerInfo(0),
+      invalid(false),
+      numTracks(0) {}
+
+  inline size_t getNumPlanes() const { return planes.size(); }
+  inline const PlaneView& getPlane(size_t n) const { return planes.at(n); }
+};
+
+}
+
+#endif // EVENTVIEW_H
@@ -1,10 +1,13 @@
 #ifndef HIT_H
 #define HIT_H
 
+#include <cstdint>
+
 namespace Storage {
 
 class Cluster;
 class Plane;
+class Event;
 
 /**
   * Information about a digitzed hit. The hit is the basic unit of the cluster.
@@ -14,12 +17,21 @@ class Plane;
   * Note that value and timing are typically integer type variables but can
   * be calibrated to a higher precision so are stored as doubles.
   *
+  * A hit made by an `Event` refers to its cluster and plane by their index
+  * in the event, rather than by pointer.
+  *
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Hit {
 protected:
-  /** Cluster containing this hit */
-  Cluster* m_cluster;
+  /** Event owning this hit, 0 for a hit made outside an event */
+  Event* m_event;
+  /** Cluster containing this hit: its index+1 in the event (0 if none), or a
+    * pointer for a hit outside an event */
+  union {
+    std::uint32_t m_cluster;
+    Cluster* m_ownCluster;
+  };
   /** X index of hit pixel (pixel space coordinate) */
   int m_pixX;
   int m_pixY;
@@ -33,8 +45,8 @@ protected:
   double m_timing;
   /** Flag to determine if this hit is masked */
   bool m_masked;
-  /** Plane in which hit belongs set by friend Plane class */
-  Plane* m_plane;
+  /** Number of the plane in which the hit belongs, set by friend Event */
+  std::uint32_t m_plane;
 
   /** Clear values so the object can be re-used */
   void clear();
@@ -54,8 +66,8 @@ public:
   inline double getValue() const { return m_value; }
   inline double getTiming() const { return m_timing; }
   inline bool getMasked() const { return m_masked; }
-  inline Cluster* fetchCluster() const { return m_cluster; }
-  inline Plane* fetchPlane() const { return m_plane; }
+  Cluster* fetchCluster() const;
+  Plane* fetchPlane() const;
 
   void setCluster(Cluster& cluster);
   inline void setPix(int x, int y) { m_pixX = x; m_pixY = y; }
@@ -66,6 +78,7 @@ public:
 
   friend class StorageIO;  // Sets values
   friend class Event;  // Sets values
+  friend class Cluster;  // Reads the event
 };
 
 }
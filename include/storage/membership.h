@@ -0,0 +1,83 @@
+#ifndef MEMBERSHIP_H
+#define MEMBERSHIP_H
+
+#include <vector>
+#include <cstdint>
+
+namespace Storage {
+
+/**
+  * Where the members of one owner are in a `Membership`: `begin` to `end`
+  * (excluded) hold the members, and the slots up to `last` are reserved for
+  * more of them.
+  */
+struct MemberRange {
+  std::uint32_t begin;
+  std::uint32_t end;
+  std::uint32_t last;
+
+  MemberRange() : begin(0), end(0), last(0) {}
+  inline std::uint32_t size() const { return end-begin; }
+};
+
+/**
+  * Members of many owners, e.g. the hits of each cluster in an event, in
+  * compressed sparse row form: one flat array of the members' indices in
+  * the event's slab, in which each owner's members are contiguous. Owners
+  * built one after the other (or which reserve their size up front) fill the
+  * array in order. An owner which outgrows its slots is moved to the end of
+  * the array, doubling its room, and leaves a gap until the array is cleared.
+  *
+  * The array keeps its memory when cleared, so that a steady stream of
+  * events makes no allocations.
+  */
+class Membership {
+private:
+  std::vector<std::uint32_t> m_members;
+
+  /** Move `range` to the end of the array, with room for `n` members */
+  void relocate(MemberRange& range, std::uint32_t n) {
+    const std::uint32_t begin = m_members.size();
+    m_members.resize(begin + n, 0);
+    for (std::uint32_t i = 0; i < range.size(); i++)
+      m_members[begin+i] = m_members[range.begin+i];
+    range.end = begin + range.size();
+    range.begin = begin;
+    range.last = begin + n;
+  }
+
+public:
+  /** Make room for `n` members in `range` */
+  void reserve(MemberRange& range, std::uint32_t n) {
+    if (range.last - range.begin >= n) return;
+    relocate(range, n);
+  }
+
+  /** Append the member at index `member` to `range` */
+  void add(MemberRange& range, std::uint32_t member) {
+    if (range.end == range.last) {
+      if (range.last == m_members.size() && range.begin != range.last) {
+        // Last owner in the array, it can grow in place. An empty range
+        // might share its position, so it is always moved.
+        m_members.push_back(member);
+        range.end++;
+        range.last++;
+        return;
+      }
+      relocate(range, range.size() ? 2*range.size() : 1);
+    }
+    m_members[range.end++] = member;
+  }
+
+  /** Index of the `n`-th member in `range` */
+  inline std::uint32_t get(const MemberRange& range, std::uint32_t n) const {
+    return m_members[range.begin+n];
+  }
+
+  /** Forget all members, keeping the memory. Owners must reset their ranges */
+  void clear() { m_members.clear(); }
+};
+
+}
+
+#endif  // MEMBERSHIP_H
@@ -0,0 +1,98 @@
+#ifndef PIXELMASK_H
+#define PIXELMASK_H
+
+#include <vector>
+#include <cstdint>
+
+#include <Rtypes.h>
+
+namespace Storage {
+
+/**
+  * Flag for each pixel of a sensor, packed one bit per pixel in a single
+  * contiguous array. Pixels are ordered by row, then by column within the
+  * row (as `Mechanics::Sensor::getPixelIndex`), so that a Mimosa sized mask
+  * takes 81 kB, in one block, rather than a pointer per column.
+  *
+  * Pixels outside the sensor read as unflagged.
+  */
+class PixelMask {
+private:
+  unsigned m_ncols;
+  unsigned m_nrows;
+  /** Always holds at least one word, so that filtering can read it without
+    * checking the size */
+  std::vector<std::uint32_t> m_words;
+
+public:
+  PixelMask() : m_ncols(0), m_nrows(0), m_words(1, 0) {}
+  PixelMask(unsigned ncols, unsigned nrows) :
+      m_ncols(0), m_nrows(0), m_words(1, 0) { resize(ncols, nrows); }
+
+  /** Set the sensor size, unflagging all pixels */
+  void resize(unsigned ncols, unsigned nrows) {
+    m_ncols = ncols;
+    m_nrows = nrows;
+    const size_t size = (size_t)ncols*nrows;
+    m_words.assign(size/32 + 1, 0);
+  }
+
+  /** Unflag all pixels */
+  void clear() { m_words.assign(m_words.size(), 0); }
+
+  inline unsigned getNumCols() const { return m_ncols; }
+  inline unsigned getNumRows() const { return m_nrows; }
+
+  inline bool get(unsigned col, unsigned row) const {
+    if (col >= m_ncols || row >= m_nrows) return false;
+    const size_t index = (size_t)row*m_ncols + col;
+    return (m_words[index >> 5] >> (index & 31)) & 1;
+  }
+
+  inline void set(unsigned col, unsigned row, bool value=true) {
+    if (col >= m_ncols || row >= m_nrows) return;
+    const size_t index = (size_t)row*m_ncols + col;
+    const std::uint32_t bit = (std::uint32_t)1 << (index & 31);
+    if (value) m_words[index >> 5] |= bit;
+    else m_words[index >> 5] &= ~bit;
+  }
+
+  /** Number of flagged pixels */
+  size_t count() const {
+    size_t num = 0;
+    for (size_t i = 0; i < m_words.size(); i++)
+      num += __builtin_popcount(m_words[i]);
+    return num;
+  }
+
+  /** Look up the `num` pixels at `pixX`, `pixY` and write their flags to
+    * `masked`. The loop has no branches and 32 bit lanes throughout, so that
+    * the compiler can vectorize it with gathers (e.g. with AVX2). Returns the
+    * number of flagged pixels. */
+  size_t filter(
+      const Int_t* pixX,
+      const Int_t* pixY,
+      size_t num,
+      char* __restrict masked) const {
+    const std::uint32_t* __restrict words = &m_words[0];
+    const unsigned ncols = m_ncols;
+    const unsigned nrows = m_nrows;
+    unsigned flagged = 0;
+    for (size_t i = 0; i < num; i++) {
+      // Negative coordinates wrap around and fall outside too
+      const unsigned col = pixX[i];
+      const unsigned row = pixY[i];
+      const unsigned inside = (col < ncols) & (row < nrows);
+      // Pixels outside look up the first word, and are then cleared
+      const unsigned index = (row*ncols + col) & -inside;
+      const unsigned bit = (words[index >> 5] >> (index & 31)) & inside;
+      masked[i] = bit;
+      flagged += bit;
+    }
+    return flagged;
+  }
+};
+
+}
+
+#endif  // PIXELMASK_H
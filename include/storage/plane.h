@@ -2,30 +2,35 @@
 #define PLANE_H
 
 #include <vector>
+#include <cstdint>
+
+#include "storage/slab.h"
 
 namespace Storage {
 
 class Hit;
 class Cluster;
+class Event;
 
 /**
   * Collection of hits and clusters from the same sensor plane. Note that the
   * hits and clusters are actually managed by the `Event` and provided here
-  * only for navigation.
+  * only for navigation: the plane keeps where they are in the event's slabs.
   *
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Plane {
 protected:
+  /** Event owning the plane's hits and clusters */
+  Event& m_event;
   /** Index of this plane within the list of sensor planes in the storage */
   const size_t m_planeNum;
-  /** List of hits in this plane for an event */
-  std::vector<Hit*> m_hits;
-  /** List of clusters in this plane for an event */
-  std::vector<Cluster*> m_clusters;
+  /** Hits and clusters of this plane for an event, in the event's slabs */
+  SlabRange m_hits;
+  SlabRange m_clusters;
 
   /** Only constructed by an `Event` object */
-  Plane(size_t nplane);
+  Plane(Event& event, size_t nplane);
   /** Only destructed by an `Event` object */
   ~Plane() {}
 
@@ -39,12 +44,11 @@ public:
   Hit& getHit(size_t n) const;
   Cluster& getCluster(size_t n) const;
 
-  const std::vector<Hit*>& getHits() const { return m_hits; }
-  const std::vector<Cluster*>& getClusters() const { return m_clusters; }
-
   inline size_t getPlaneNum() const { return m_planeNum; }
   inline size_t getNumHits() const { return m_hits.size(); }
   inline size_t getNumClusters() const { return m_clusters.size(); }
+  inline const SlabRange& getHitRange() const { return m_hits; }
+  inline const SlabRange& getClusterRange() const { return m_clusters; }
 
   friend class Event;
 };
@@ -0,0 +1,153 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace Storage {
+
+/**
+  * Contiguous store for the objects of one type in an event, addressed by
+  * 32 bit indices. Objects never move while the event is being filled, so
+  * references handed out stay valid: an event which outgrows the store
+  * continues in a new block. Clearing merges the blocks into one, so once the
+  * store has seen the largest event, every event is a single array.
+  *
+  * Objects are kept when the store is cleared, and handed out again in index
+  * order. The caller is responsible for clearing their prior values.
+  */
+template <class T>
+class Slab {
+private:
+  /** Each block is reserved up front and never grows past its capacity */
+  std::vector<std::vector<T> > m_blocks;
+  /** Index of the first object in each block */
+  std::vector<std::uint32_t> m_starts;
+  std::uint32_t m_size;
+  std::uint32_t m_capacity;
+
+  void addBlock(std::uint32_t capacity) {
+    m_blocks.push_back(std::vector<T>());
+    m_blocks.back().reserve(capacity);
+    m_starts.push_back(m_capacity);
+    m_capacity += capacity;
+  }
+
+public:
+  Slab() : m_size(0), m_capacity(0) {}
+
+  /** Next object of the store, either a new one or a kept one */
+  T& add() {
+    if (m_size == m_capacity)
+      addBlock(m_capacity < 16 ? 16 : m_capacity);  // Doubles the capacity
+    std::vector<T>& block = m_blocks.back();
+    const std::uint32_t offset = m_size - m_starts.back();
+    if (offset == block.size()) block.push_back(T());
+    m_size++;
+    return block[offset];
+  }
+
+  inline T& operator[](std::uint32_t n) {
+    // Usually a single block
+    size_t nblock = m_blocks.size()-1;
+    while (m_starts[nblock] > n) nblock--;
+    return m_blocks[nblock][n-m_starts[nblock]];
+  }
+
+  inline const T& operator[](std::uint32_t n) const {
+    return const_cast<Slab&>(*this)[n];
+  }
+
+  /** Index of `object`, which must be in the store */
+  std::uint32_t indexOf(const T& object) const {
+    for (size_t nblock = m_blocks.size(); nblock-- > 0; ) {
+      const std::vector<T>& block = m_blocks[nblock];
+      if (block.empty() || &object < &block[0]) continue;
+      if (&object < &block[0] + block.size())
+        return m_starts[nblock] + (&object - &block[0]);
+    }
+    throw std::out_of_range("Slab::indexOf: object not in the store");
+  }
+
+  T& at(std::uint32_t n) {
+    if (n >= m_size)
+      throw std::out_of_range("Slab::at: requested object out of range");
+    return (*this)[n];
+  }
+
+  inline std::uint32_t size() const { return m_size; }
+  inline bool empty() const { return m_size == 0; }
+
+  /** True if objects `begin` to `end` (excluded) are in one array */
+  inline bool isContiguous(std::uint32_t begin, std::uint32_t end) const {
+    if (begin >= end) return true;
+    size_t nblock = m_blocks.size()-1;
+    while (m_starts[nblock] > begin) nblock--;
+    return end <= m_starts[nblock] + m_blocks[nblock].size();
+  }
+
+  /** Forget the objects, keeping their memory for the next event */
+  void clear() {
+    m_size = 0;
+    if (m_blocks.size() <= 1) return;
+    // Replace the blocks by one large enough for everything they held
+    const std::uint32_t capacity = m_capacity;
+    m_blocks.clear();
+    m_starts.clear();
+    m_capacity = 0;
+    addBlock(capacity);
+  }
+};
+
+/**
+  * Selection of objects in a slab, e.g. the hits of one plane. Objects made
+  * one after the other are kept as the range `begin` to `end` (excluded),
+  * which can be scanned as an array if the slab holds it in one block. Once
+  * an object breaks the range, the selection falls back to listing indices.
+  */
+struct SlabRange {
+  std::uint32_t begin;
+  std::uint32_t end;
+  /** Indices of the selected objects, only used if they aren't a range */
+  std::vector<std::uint32_t> scattered;
+
+  SlabRange() : begin(0), end(0) {}
+
+  inline bool isRange() const { return scattered.empty(); }
+  inline std::uint32_t size() const {
+    return isRange() ? end-begin : scattered.size();
+  }
+  /** Index in the slab of the `n`-th selected object */
+  inline std::uint32_t operator[](std::uint32_t n) const {
+    return isRange() ? begin+n : scattered[n];
+  }
+
+  /** Select the object at `index`, made after those already selected */
+  void extend(std::uint32_t index) {
+    if (isRange()) {
+      if (begin == end) {
+        begin = index;
+        end = index+1;
+        return;
+      }
+      if (index == end) {
+        end++;
+        return;
+      }
+      for (std::uint32_t i = begin; i < end; i++) scattered.push_back(i);
+    }
+    scattered.push_back(index);
+  }
+
+  /** Forget the selection, keeping the list's memory */
+  void clear() {
+    begin = 0;
+    end = 0;
+    scattered.clear();
+  }
+};
+
+}
+
+#endif  // SLAB_H
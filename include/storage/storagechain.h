@@ -0,0 +1,128 @@
+#ifndef STORAGECHAIN_H
+#define STORAGECHAIN_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+
+#include <Rtypes.h>
+
+#include "storage/eventinput.h"
+#include "storage/storageio.h"
+#include "storage/pixelmask.h"
+
+namespace Storage {
+
+class StorageI;
+
+/**
+  * Several files of one run, read back as a single input. Events are
+  * numbered across the whole run, so that looper ranges and steps span all
+  * the files.
+  *
+  * Only the file being read is kept open. Each file is opened briefly on
+  * construction to count its events. When a file is reached, the next one
+  * starts opening on a background thread, so that crossing into it doesn't
+  * stall the loop.
+  */
+class StorageChain : public EventInput {
+private:
+  // Disable copy and assignment operators
+  StorageChain(const StorageChain&);
+  StorageChain& operator=(const StorageChain&);
+
+  /** Arguments with which each file's `StorageI` is built */
+  const std::vector<std::string> m_paths;
+  const int m_treeMask;
+  std::vector<bool> m_planeMask;
+  bool m_usePlaneMask;
+  std::set<std::string> m_branchesOff[4];
+  std::vector<PixelMask> m_noiseMasks;
+  StorageIO::MaskMode m_maskMode;
+
+  /** Global index of the first event of each file, and one past the last */
+  std::vector<Long64_t> m_offsets;
+  size_t m_numPlanes;
+
+  /** Open file and its position in the chain */
+  StorageI* m_current;
+  size_t m_ncurrent;
+  /** File being opened in the background, and its position */
+  StorageI* m_next;
+  size_t m_nnext;
+  std::thread m_opener;
+  std::string m_openerError;
+
+  /** Read-ahead range requested by the looper, passed on to each file in
+    * its own numbering (0 depth when off) */
+  size_t m_prefetchDepth;
+  Long64_t m_prefetchStart;
+  Long64_t m_prefetchEnd;
+  Long64_t m_prefetchStep;
+
+  /** Largest arrays needed by files already closed */
+  Int_t m_maxHits;
+  Int_t m_maxClusters;
+  Int_t m_maxTracks;
+
+  StorageI* openSegment(size_t nsegment) const;
+  /** Wait for the background opening, if any */
+  void joinOpener();
+  /** Make `nsegment` the open file, and start opening the following one */
+  void selectSegment(size_t nsegment);
+  /** Start opening the file after the open one in the background */
+  void openFollowing();
+  /** Select the file holding global event `n`, and return its local index */
+  Long64_t seek(Long64_t n);
+  /** Pass the read-ahead range on to the open file */
+  void prefetchSegment();
+
+public:
+  /** Chain the files in `paths`, in order. The masks and branch lists are
+    * those of `StorageI`. */
+  StorageChain(
+      const std::vector<std::string>& paths,
+      int treeMask=0,
+      const std::vector<bool>* planeMask=0,
+      const std::set<std::string>* hitsBranchesOff=0,
+      const std::set<std::string>* clustersBranchesOff=0,
+      const std::set<std::string>* tracksBranchesOff=0,
+      const std::set<std::string>* eventInfoBranchesOff=0);
+  ~StorageChain();
+
+  /** Noise masks of the planes read, applied to every file as by
+    * `StorageIO::setNoiseMasks` */
+  void setNoiseMasks(
+      const std::vector<PixelMask>& masks,
+      StorageIO::MaskMode mode=StorageIO::REMOVE);
+
+  /** Expand a comma separated list of paths and shell wildcard patterns into
+    * the list of files. The files matching a pattern are sorted by name. */
+  static std::vector<std::string> expandPaths(const std::string& spec);
+
+  Long64_t getNumEvents() const { return m_offsets.back(); }
+  size_t getNumPlanes() const { return m_numPlanes; }
+  size_t getNumSegments() const { return m_paths.size(); }
+  /** Global index of the first event of file `n` */
+  Long64_t getSegmentOffset(size_t n) const { return m_offsets.at(n); }
+
+  /** File currently open, e.g. to query which of its branches are off */
+  const StorageI& getSegment() const { return *m_current; }
+
+  Event& readEvent(Long64_t n);
+  const EventView& readView(Long64_t n);
+
+  /** The range is in global numbering, each file reads ahead over its own
+    * part of it */
+  void startPrefetch(size_t depth, Long64_t start, Long64_t end, Long64_t step=1);
+  void stopPrefetch();
+
+  Int_t getMaxHits() const;
+  Int_t getMaxClusters() const;
+  Int_t getMaxTracks() const;
+};
+
+}
+
+#endif // STORAGECHAIN_H
@@ -4,17 +4,99 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 
 #include "storage/storageio.h"
+#include "storage/eventview.h"
+#include "storage/eventinput.h"
 
 namespace Storage {
 
-class StorageI : public StorageIO {
+/**
+  * Input of events from a ROOT file. A file written as the friend of
+  * another (see `StorageO`) is read along with that file, as though it held
+  * all the trees.
+  */
+class StorageI : public StorageIO, public EventInput {
 private:
   // Disable copy and assignment operators
   StorageI(const StorageI&);
   StorageI& operator=(const StorageI&);
 
+  /** File with the hits and event information, when this file only holds
+    * the trees derived from it (see `StorageO`) */
+  std::unique_ptr<TFile> m_baseFile;
+
+  /** Read only the multiplicity branch `name` of entry `n`, into its bound
+    * `num` member, so that the arrays can be grown before reading the rest */
+  void readCount(TTree* tree, const char* name, Long64_t n);
+  /** Fill the cleared `event` from entry `n` */
+  void fillEvent(Long64_t n, Event& event);
+  /** Body of the read-ahead thread: decode entries into the ring */
+  void prefetchLoop();
+
+  /** Read-ahead state. Entry `k` of the range goes in slot `k % size`, and
+    * the ring has one more slot than the depth so that the event last
+    * returned by `readEvent` is never overwritten while it is in use. */
+  std::vector<Event*> m_ring;
+  std::thread m_prefetchThread;
+  std::mutex m_prefetchMutex;
+  std::condition_variable m_prefetchCond;
+  Long64_t m_prefetchStart;
+  Long64_t m_prefetchEnd;
+  Long64_t m_prefetchStep;
+  size_t m_prefetchDepth;
+  size_t m_filled;  // Number of range entries decoded by the thread
+  size_t m_taken;  // Number of range entries returned by `readEvent`
+  bool m_prefetchStop;
+  std::string m_prefetchError;
+
+  /** Arrays of one plane into which its trees are read for views. Unlike the
+    * event arrays, every plane needs its own so that all planes stay valid
+    * in the view at once. */
+  struct PlaneColumns {
+    std::vector<Int_t>    hitPixX;
+    std::vector<Int_t>    hitPixY;
+    std::vector<Double_t> hitPosX;
+    std::vector<Double_t> hitPosY;
+    std::vector<Double_t> hitPosZ;
+    std::vector<Int_t>    hitValue;
+    std::vector<Int_t>    hitTiming;
+    std::vector<Int_t>    hitInCluster;
+    std::vector<char>     hitMasked;
+    std::vector<Double_t> clusterPixX;
+    std::vector<Double_t> clusterPixY;
+    std::vector<Double_t> clusterPixErrX;
+    std::vector<Double_t> clusterPixErrY;
+    std::vector<Double_t> clusterPosX;
+    std::vector<Double_t> clusterPosY;
+    std::vector<Double_t> clusterPosZ;
+    std::vector<Double_t> clusterPosErrX;
+    std::vector<Double_t> clusterPosErrY;
+    std::vector<Double_t> clusterPosErrZ;
+    std::vector<Double_t> clusterValue;
+    std::vector<Double_t> clusterTiming;
+    std::vector<Int_t>    clusterInTrack;
+  };
+  std::vector<PlaneColumns> m_columns;
+  EventView m_view;
+  /** The plane trees are bound to `m_columns` rather than the event arrays */
+  bool m_viewBound;
+
+  /** Grow the columns of plane `nplane` to hold `num` hits, re-binding the
+    * plane's branches if they move */
+  void reserveViewHits(size_t nplane, Int_t num);
+  /** Likewise for the cluster columns */
+  void reserveViewClusters(size_t nplane, Int_t num);
+  /** Point the plane's trees at its view columns */
+  void bindViewHits(size_t nplane);
+  void bindViewClusters(size_t nplane);
+  /** Point the plane trees at the view columns or back at the event arrays */
+  void bindView(bool view);
+
 public:
   StorageI(
       const std::string& filePath,
@@ -25,10 +107,26 @@ public:
       const std::set<std::string>* clustersBranchesOff=0,
       const std::set<std::string>* tracksBranchesOff=0,
       const std::set<std::string>* eventInfoBranchesOff=0);
-  virtual ~StorageI() {}
+  virtual ~StorageI();
+
+  Long64_t getNumEvents() const { return m_numEvents; }
+  size_t getNumPlanes() const { return m_numPlanes; }
 
-  /** Generate the `Event` object filled from entry `n` */
+  /** Generate the `Event` object filled from entry `n`. The event is valid
+    * until the next call. */
   Event& readEvent(Long64_t n);
+
+  /** Read entry `n` into the columnar view, without building any objects.
+    * The view is valid until the next read. */
+  const EventView& readView(Long64_t n);
+
+  /** Decode up to `depth` events ahead on a background thread, for the
+    * entries `start`, `start+step`, ... below `end`. Reading the entries in
+    * that order returns the decoded events, any other read stops the
+    * read-ahead and falls back to reading in place. */
+  void startPrefetch(size_t depth, Long64_t start, Long64_t end, Long64_t step=1);
+  /** Stop the read-ahead thread and release its events */
+  void stopPrefetch();
 };
 
 }
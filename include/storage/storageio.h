@@ -3,7 +3,6 @@
 
 #include <string>
 #include <vector>
-#include <stack>
 #include <set>
 
 #include <Rtypes.h>
@@ -11,13 +10,16 @@
 #include <TTree.h>
 #include <TBranch.h>
 
-// NOTE: these sizes are used to initialize arrays of track, cluster and
-// hit information. BUT these arrays are generated ONLY ONCE and re-used
-// to load events. Vectors could have been used in the ROOT file format, but
-// they would need to be constructed at each event reading step. 
-#define MAX_TRACKS 1000
-#define MAX_CLUSTERS 10000
-#define MAX_HITS 10000
+#include "storage/pixelmask.h"
+
+// NOTE: these are the initial sizes of the arrays of track, cluster and hit
+// information. The arrays are generated ONLY ONCE and re-used to load events,
+// growing to the largest multiplicity seen (at which point the branches are
+// re-bound to the new memory). Vectors could have been used in the ROOT file
+// format, but they would need to be constructed at each event reading step.
+#define INIT_TRACKS 16
+#define INIT_CLUSTERS 64
+#define INIT_HITS 256
 
 namespace Storage {
 
@@ -35,7 +37,7 @@ class Event;
   * Local memory is filled either by an `Event` object, and then read into the
   * output `TFile`, or is filled by a `TFile` and then used to populate an
   * `Event` object. Given the amount of memory allocated to an `Event` object
-  * (including all hits, clusters, tracks), all such objects are cached.
+  * (including all hits, clusters, tracks), the event is re-used with them.
   *
   * Includes the ability to mask parts of the file (i.e. do not read/write
   * some variables, or entire sets of variables). Also provids the ability to
@@ -73,16 +75,6 @@ public:
     REMOVE
   };
 
-  /** Struct allows user to pass a noise mask for each plane as a 1D vector
-    * specifying how it is partitionned */
-  struct NoiseMask {
-    std::vector<bool> mask;
-    size_t nrows;
-    size_t ncols;
-    NoiseMask() : nrows(0), ncols(0) {}
-    inline bool at(size_t nrow, size_t ncol) { return mask[nrow*ncols+ncol]; }
-  };
-
 protected:
   /** File to read or write */
   TFile m_file;
@@ -96,15 +88,11 @@ protected:
   MaskMode m_maskMode;
   /** Number of events */
   Long64_t m_numEvents;
-  /** Vector of NoiseMask objects for each plane. The objects are realtively
-    * small and the vector won't be copied. */
-  std::vector<NoiseMask> m_noiseMasks;
+  /** Noise mask of each plane, empty if no masking */
+  std::vector<PixelMask> m_noiseMasks;
 
-  // Cache objects so they aren't re-allocated at each iteration
-  Event* m_event;  // Only one event exists ever in this object
-  std::stack<Track*> m_cacheTracks;
-  std::stack<Cluster*> m_cacheClusters;
-  std::stack<Hit*> m_cacheHits;
+  /** Re-used at each iteration, along with the objects it holds */
+  Event* m_event;
 
   // NOTE: trees can easily be added and removed from a file. So each type
   // of information that might or might not be included in a file should be
@@ -113,6 +101,9 @@ protected:
   // Trees containing event-by-event data for each plane
   std::vector<TTree*> m_hitsTrees;
   std::vector<TTree*> m_clustersTrees;
+  /** Trees with only the hit to cluster associations of each plane, for
+    * files which are friends of the file holding the hits */
+  std::vector<TTree*> m_linksTrees;
   // Trees global to the entire event
   TTree* m_tracksTree;
   TTree* m_eventInfoTree;
@@ -125,33 +116,32 @@ protected:
 
   // Variables in which the storage is output on an event-by-event basis
 
-  // NOTE: don't change the order of these declarations since they are used to
-  // do one big memset to zero everything
-
-  Int_t    numHits;
-  Int_t    hitPixX[MAX_HITS];
-  Int_t    hitPixY[MAX_HITS];
-  Double_t hitPosX[MAX_HITS];
-  Double_t hitPosY[MAX_HITS];
-  Double_t hitPosZ[MAX_HITS];
-  Int_t    hitValue[MAX_HITS];
-  Int_t    hitTiming[MAX_HITS];
-  Int_t    hitInCluster[MAX_HITS];
-
-  Int_t    numClusters;
-  Double_t clusterPixX[MAX_CLUSTERS];
-  Double_t clusterPixY[MAX_CLUSTERS];
-  Double_t clusterPixErrX[MAX_CLUSTERS];
-  Double_t clusterPixErrY[MAX_CLUSTERS];
-  Double_t clusterPosX[MAX_CLUSTERS];
-  Double_t clusterPosY[MAX_CLUSTERS];
-  Double_t clusterPosZ[MAX_CLUSTERS];
-  Double_t clusterPosErrX[MAX_CLUSTERS];
-  Double_t clusterPosErrY[MAX_CLUSTERS];
-  Double_t clusterPosErrZ[MAX_CLUSTERS];
-  Double_t clusterValue[MAX_CLUSTERS];
-  Double_t clusterTiming[MAX_CLUSTERS];
-  Int_t    clusterInTrack[MAX_CLUSTERS];
+  Int_t                 numHits;
+  std::vector<Int_t>    hitPixX;
+  std::vector<Int_t>    hitPixY;
+  std::vector<Double_t> hitPosX;
+  std::vector<Double_t> hitPosY;
+  std::vector<Double_t> hitPosZ;
+  std::vector<Int_t>    hitValue;
+  std::vector<Int_t>    hitTiming;
+  std::vector<Int_t>    hitInCluster;
+  /** Noise mask flag of each hit, looked up for the whole plane at once */
+  std::vector<char>     hitMasked;
+
+  Int_t                 numClusters;
+  std::vector<Double_t> clusterPixX;
+  std::vector<Double_t> clusterPixY;
+  std::vector<Double_t> clusterPixErrX;
+  std::vector<Double_t> clusterPixErrY;
+  std::vector<Double_t> clusterPosX;
+  std::vector<Double_t> clusterPosY;
+  std::vector<Double_t> clusterPosZ;
+  std::vector<Double_t> clusterPosErrX;
+  std::vector<Double_t> clusterPosErrY;
+  std::vector<Double_t> clusterPosErrZ;
+  std::vector<Double_t> clusterValue;
+  std::vector<Double_t> clusterTiming;
+  std::vector<Int_t>    clusterInTrack;
 
   ULong64_t timeStamp;
   ULong64_t frameNumber;
@@ -159,25 +149,48 @@ protected:
   Int_t     triggerInfo;
   Bool_t    invalid;
 
-  Int_t    numTracks;
-  Double_t trackSlopeX[MAX_TRACKS];
-  Double_t trackSlopeY[MAX_TRACKS];
-  Double_t trackSlopeErrX[MAX_TRACKS];
-  Double_t trackSlopeErrY[MAX_TRACKS];
-  Double_t trackOriginX[MAX_TRACKS];
-  Double_t trackOriginY[MAX_TRACKS];
-  Double_t trackOriginErrX[MAX_TRACKS];
-  Double_t trackOriginErrY[MAX_TRACKS];
-  Double_t trackCovarianceX[MAX_TRACKS];
-  Double_t trackCovarianceY[MAX_TRACKS];
-  Double_t trackChi2[MAX_TRACKS];
-
-  /** Cached make new track only for friend Event class */
-  Track& newTrack();
-  /** Cached make new cluster only for friend Event class */
-  Cluster& newCluster();
-  /** Cached make new hit only for friend Event class */
-  Hit& newHit();
+  Int_t                 numTracks;
+  std::vector<Double_t> trackSlopeX;
+  std::vector<Double_t> trackSlopeY;
+  std::vector<Double_t> trackSlopeErrX;
+  std::vector<Double_t> trackSlopeErrY;
+  std::vector<Double_t> trackOriginX;
+  std::vector<Double_t> trackOriginY;
+  std::vector<Double_t> trackOriginErrX;
+  std::vector<Double_t> trackOriginErrY;
+  std::vector<Double_t> trackCovarianceX;
+  std::vector<Double_t> trackCovarianceY;
+  std::vector<Double_t> trackChi2;
+
+  /** Largest number of hits and clusters in a plane, and of tracks in an
+    * event, seen by this storage (high-water marks of the arrays) */
+  Int_t m_maxHits;
+  Int_t m_maxClusters;
+  Int_t m_maxTracks;
+
+  /** Constructors call this to initialize the values and arrays */
+  void initialize(size_t numPlanes);
+  /** Grow the hit arrays to hold at least `num` entries, re-binding the hits
+    * trees' branches if they move */
+  void reserveHits(Int_t num);
+  /** Grow the cluster arrays, likewise re-binding the clusters trees */
+  void reserveClusters(Int_t num);
+  /** Grow the track arrays, likewise re-binding the tracks tree */
+  void reserveTracks(Int_t num);
+  /** Point the active array branches of a tree at the current arrays */
+  void bindHitsBranches(TTree* tree);
+  void bindClustersBranches(TTree* tree);
+  void bindTracksBranches(TTree* tree);
+  void bindLinksBranches(TTree* tree);
+  /** Point `name` at `address` if the tree has it and it is on. Output trees
+    * only have the branches they were made with, so `off` is ignored. */
+  void bindBranch(TTree* tree, const char* name, void* address, bool off);
+
+  /** Make an event with the planes of this storage. The caller owns the
+    * event. */
+  Event* makeEvent();
+  /** Clear `event` so it can be re-filled, keeping its objects */
+  void recycleEvent(Event& event);
 
   /** Construction needs to be called by a derived class */
   StorageIO(
@@ -185,6 +198,9 @@ protected:
       FileMode fileMode,
       size_t numPlanes,
       int treeMask);
+  /** Storage without a ROOT file, for readers of other formats which only
+    * need the re-used event */
+  StorageIO(size_t numPlanes, int treeMask);
 
 public:
   virtual ~StorageIO();
@@ -193,6 +209,10 @@ public:
     * overwritten whenever this method is called. */
   Event& newEvent();
 
+  /** Mask the hits in noisy pixels, with one mask for each plane read or
+    * written. An empty vector turns masking off. */
+  void setNoiseMasks(const std::vector<PixelMask>& masks, MaskMode mode=REMOVE);
+
   bool isHitsBranchOff(const std::string& name) const;
   bool isClustersBranchOff(const std::string& name) const;
   bool isTracksBranchOff(const std::string& name) const;
@@ -207,8 +227,11 @@ public:
   size_t getNumPlanes() const { return m_numPlanes; }
   FileMode getFileMode() const { return m_fileMode; }
   MaskMode getMaskMode() const { return m_maskMode; }
+  Int_t getMaxHits() const { return m_maxHits; }
+  Int_t getMaxClusters() const { return m_maxClusters; }
+  Int_t getMaxTracks() const { return m_maxTracks; }
 
-  friend class Event;  // Access to cache
+  friend class Event;  // Access to the number of planes
 };
 
 }
@@ -0,0 +1,109 @@
+#ifndef STORAGEMAPPED_H
+#define STORAGEMAPPED_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <Rtypes.h>
+
+#include "storage/storageio.h"
+#include "storage/eventview.h"
+#include "storage/eventinput.h"
+
+namespace Storage {
+
+/**
+  * Reader of the native event format written by `StorageMappedO`. The file
+  * is memory mapped and its per-event offset index gives random access to
+  * any event without decompression or tree bookkeeping, so repeated passes
+  * over the same run are limited by memory bandwidth.
+  *
+  * The file is laid out in the host byte order, each block padded to 8
+  * bytes:
+  *   - header: magic, version, byte order mark, number of planes and events,
+  *     offset of the index
+  *   - one block per event: event information, hit and cluster counts of
+  *     each plane, the track columns, and for each plane its hit columns
+  *     then its cluster columns
+  *   - index: offset of each event block from the start of the file
+  *
+  * The columns are the same as the branches of the ROOT layout, and views
+  * point directly into the mapping.
+  */
+class StorageMapped : public StorageIO, public EventInput {
+private:
+  // Disable copy and assignment operators
+  StorageMapped(const StorageMapped&);
+  StorageMapped& operator=(const StorageMapped&);
+
+  /** Descriptor and extent of the mapped file */
+  int m_fd;
+  const char* m_data;
+  size_t m_size;
+  /** Offset of each event block */
+  const ULong64_t* m_index;
+  /** Number of planes in the file, some of which might be masked */
+  size_t m_filePlanes;
+  /** Mask of the planes in the file to load */
+  std::vector<bool> m_planeMask;
+  /** View of the last event read */
+  EventView m_view;
+  /** Event-wide index in the file of the first cluster of each loaded plane */
+  std::vector<size_t> m_firstClusters;
+
+  /** Point the view's spans at the block of event `n` */
+  void fillView(Long64_t n);
+
+public:
+  StorageMapped(
+      const std::string& filePath,
+      int treeMask=NONE,
+      const std::vector<bool>* planeMask=0);
+  ~StorageMapped();
+
+  Long64_t getNumEvents() const { return m_numEvents; }
+  size_t getNumPlanes() const { return m_numPlanes; }
+
+  /** Generate the `Event` object filled from entry `n` */
+  Event& readEvent(Long64_t n);
+  /** View of entry `n` directly over the mapped file */
+  const EventView& readView(Long64_t n);
+};
+
+/**
+  * Writer of the native event format read by `StorageMapped`. Events are
+  * appended as they are written, and the index is written when closing.
+  */
+class StorageMappedO {
+private:
+  // Disable copy and assignment operators
+  StorageMappedO(const StorageMappedO&);
+  StorageMappedO& operator=(const StorageMappedO&);
+
+  std::ofstream m_file;
+  const size_t m_numPlanes;
+  /** Offset of each event block written so far */
+  std::vector<ULong64_t> m_index;
+  /** Offset at which the next block goes */
+  ULong64_t m_offset;
+  /** Re-used memory in which a block is prepared */
+  std::vector<char> m_block;
+
+public:
+  StorageMappedO(const std::string& filePath, size_t numPlanes);
+  /** Closes the file if it wasn't already */
+  ~StorageMappedO();
+
+  /** Append the `Event` object to the file */
+  void writeEvent(Event& event);
+  /** Write the index and header, after which no more events can be written */
+  void close();
+
+  Long64_t getNumEvents() const { return m_index.size(); }
+  size_t getNumPlanes() const { return m_numPlanes; }
+};
+
+}
+
+#endif // STORAGEMAPPED_H
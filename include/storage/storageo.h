@@ -4,17 +4,152 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "storage/storageio.h"
 
 namespace Storage {
 
+/**
+  * Output of events to a ROOT file. Given the path of the file from which
+  * the events were read (`friendOf`), only the derived trees are written:
+  * clusters, tracks and, in place of the hits trees, the hit to cluster
+  * associations. The entries line up with those of the original file,
+  * which `StorageI` then reads the hits and event information from.
+  *
+  * Events can also be written behind the event loop: `writeEvent` then only
+  * copies the event into a queue, from which a writer thread fills the
+  * trees (compressing the baskets of all trees in parallel if ROOT has
+  * implicit multi-threading).
+  */
 class StorageO : public StorageIO {
+public:
+  /** Compression and buffering of the trees written. The defaults keep
+    * those of ROOT. */
+  struct Settings {
+    /** ROOT compression algorithm (1 zlib, 2 lzma, 4 lz4, 5 zstd), or -1 */
+    int compressionAlgorithm;
+    /** Compression level from 0 (none) to 9, or -1 */
+    int compressionLevel;
+    /** Buffer size of each branch in bytes, or 0 */
+    Int_t basketSize;
+    /** Entries between flushes of the baskets to the file, or bytes if
+      * negative (as `TTree::SetAutoFlush`), or 0 */
+    Long64_t autoFlush;
+    Settings() :
+        compressionAlgorithm(-1),
+        compressionLevel(-1),
+        basketSize(0),
+        autoFlush(0) {}
+  };
+
+  /** Set the compression of `settings` from `spec`, given as an algorithm
+    * name (none, zlib, lzma, lz4, zstd) optionally followed by `:level` */
+  static void parseCompression(const std::string& spec, Settings& settings);
+
 private:
   // Disable copy and assignment operators
   StorageO(const StorageIO&);
   StorageO& operator=(const StorageIO&);
 
+  /** Columns of one plane of an event, as they go in the trees */
+  struct PlaneRecord {
+    std::vector<Int_t>    hitPixX;
+    std::vector<Int_t>    hitPixY;
+    std::vector<Double_t> hitPosX;
+    std::vector<Double_t> hitPosY;
+    std::vector<Double_t> hitPosZ;
+    std::vector<Int_t>    hitValue;
+    std::vector<Int_t>    hitTiming;
+    std::vector<Int_t>    hitInCluster;
+    std::vector<Double_t> clusterPixX;
+    std::vector<Double_t> clusterPixY;
+    std::vector<Double_t> clusterPixErrX;
+    std::vector<Double_t> clusterPixErrY;
+    std::vector<Double_t> clusterPosX;
+    std::vector<Double_t> clusterPosY;
+    std::vector<Double_t> clusterPosZ;
+    std::vector<Double_t> clusterPosErrX;
+    std::vector<Double_t> clusterPosErrY;
+    std::vector<Double_t> clusterPosErrZ;
+    std::vector<Double_t> clusterValue;
+    std::vector<Double_t> clusterTiming;
+    std::vector<Int_t>    clusterInTrack;
+  };
+
+  /** Copy of an event independent of its objects, so that it can be written
+    * after the objects are re-used. The vectors keep their capacity from one
+    * event to the next. */
+  struct EventRecord {
+    ULong64_t timeStamp;
+    ULong64_t frameNumber;
+    Int_t     triggerOffset;
+    Int_t     triggerInfo;
+    Bool_t    invalid;
+    std::vector<Double_t> trackSlopeX;
+    std::vector<Double_t> trackSlopeY;
+    std::vector<Double_t> trackSlopeErrX;
+    std::vector<Double_t> trackSlopeErrY;
+    std::vector<Double_t> trackOriginX;
+    std::vector<Double_t> trackOriginY;
+    std::vector<Double_t> trackOriginErrX;
+    std::vector<Double_t> trackOriginErrY;
+    std::vector<Double_t> trackCovarianceX;
+    std::vector<Double_t> trackCovarianceY;
+    std::vector<Double_t> trackChi2;
+    std::vector<PlaneRecord> planes;
+  };
+
+  /** Apply the basket size and auto-flush of the settings to `tree` */
+  void configureTree(TTree* tree);
+
+  /** Copy the event information, or the values of the tracks, clusters or
+    * hits, into the columns of `cols`. The record structs and the branch
+    * arrays share the column names, so that either can be the destination.
+    * The columns must already have room for the objects. */
+  template <class Columns>
+  static void copyEventInfo(Event& event, Columns& cols);
+  template <class Columns>
+  static void copyTracks(Event& event, Columns& cols);
+  template <class Columns>
+  static void copyClusters(Plane& plane, Columns& cols);
+  template <class Columns>
+  static void copyHits(Plane& plane, Columns& cols);
+  /** Throw if the storage has no trees for plane `nplane` */
+  void checkPlane(size_t nplane) const;
+  /** Fill the hits, clusters and links trees of `nplane` from the arrays */
+  void fillPlaneTrees(size_t nplane);
+  /** Fill the tracks and event info trees from the arrays */
+  void fillEventTrees();
+
+  /** Copy `event` into `record` */
+  void recordEvent(Event& event, EventRecord& record) const;
+  /** Fill one entry of the trees from `record` */
+  void fillTrees(const EventRecord& record);
+  /** Fill one entry of the trees directly from `event`, without a writer */
+  void fillTrees(Event& event);
+  /** Body of the writer thread: fill the trees from the queued records */
+  void writeLoop();
+  /** Stop the writer thread once the queue is written, and return the first
+    * error it met (empty if none) */
+  std::string joinWriter();
+
+  const Settings m_settings;
+
+  /** Write-behind state. Records go from `m_free` to `m_queue` and back
+    * once written, there are `depth` records in all. */
+  std::vector<EventRecord*> m_records;
+  std::vector<EventRecord*> m_free;
+  std::deque<EventRecord*> m_queue;
+  std::thread m_writeThread;
+  std::mutex m_writeMutex;
+  std::condition_variable m_writeCond;
+  bool m_writeStop;
+  std::string m_writeError;
+
 public:
   StorageO(
       const std::string& filePath,
@@ -24,12 +159,24 @@ public:
       const std::set<std::string>* hitsBranchesOff=0,
       const std::set<std::string>* clustersBranchesOff=0,
       const std::set<std::string>* tracksBranchesOff=0,
-      const std::set<std::string>* eventInfoBranchesOff=0);
+      const std::set<std::string>* eventInfoBranchesOff=0,
+      // Path of the file with the hits, to write only the derived trees
+      const std::string& friendOf="",
+      const Settings& settings=Settings());
   // Write to the file
   virtual ~StorageO();
 
   /** Write the `Event` object to the file */
   void writeEvent(Event& event);
+
+  /** Write events on a background thread, queueing up to `depth` of them.
+    * `writeEvent` blocks only while the queue is full. With `threads` above
+    * zero, ROOT's implicit multi-threading is turned on with that many
+    * threads, so that the baskets of all trees are compressed in parallel. */
+  void startWriter(size_t depth, unsigned int threads=0);
+  /** Write out the queued events and stop the writer thread. Must be called
+    * before reading the high-water marks of a threaded output. */
+  void stopWriter();
 };
 
 }
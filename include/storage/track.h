@@ -3,23 +3,34 @@
 
 #include <vector>
 
+#include "storage/membership.h"
+
 namespace Storage {
 
 class Cluster;
+class Event;
 
 /**
   * Collection of clusters on different planes which are considered to have 
   * been created by the same particle. Also stores the parameters describing
   * a straight line passing through those clusters.
   *
+  * As for the hits of a `Cluster`, the clusters of a track made by an `Event`
+  * are listed by index in the event's flat membership arrays.
+  *
   * @author Garrin McGoldrick (garrin.mcgoldrick@cern.ch)
   */
 class Track {
 protected:
-  /** List of clusters comprising the track */
-  std::vector<Cluster*> m_clusters;
-  /** List of clusters matched to this track but not part of the track */
-  std::vector<Cluster*> m_matchedClusters;
+  /** Clusters comprising the track, in the event's membership array */
+  MemberRange m_clusters;
+  /** Clusters matched to this track but not part of the track */
+  MemberRange m_matchedClusters;
+  /** Event owning this track, 0 for a track made outside an event */
+  Event* m_event;
+  /** Clusters of a track outside an event */
+  std::vector<Cluster*> m_ownClusters;
+  std::vector<Cluster*> m_ownMatched;
   /** Origin of track's linear fit in global space x coordinate */
   double m_originX;
   double m_originY;
@@ -50,6 +61,8 @@ public:
 
   /** Add a cluster to the track. Does bi-directional linking. */
   void addCluster(Cluster& cluster);
+  /** Reserve some space for adding clusters to make the process faster */
+  void reserveClusters(size_t n);
   /** Set all cluster in the track. */
   void setClusters(const std::vector<Cluster*>& clusters);
   /** Match a cluster to this track */
@@ -59,8 +72,12 @@ public:
 
   Cluster& getCluster(size_t n) const;
   Cluster& getMatchedCluster(size_t n) const;
-  inline size_t getNumClusters() const { return m_clusters.size(); }
-  inline size_t getNumMatchedClusters() const { return m_matchedClusters.size(); }
+  inline size_t getNumClusters() const {
+    return m_event ? m_clusters.size() : m_ownClusters.size();
+  }
+  inline size_t getNumMatchedClusters() const {
+    return m_event ? m_matchedClusters.size() : m_ownMatched.size();
+  }
   inline double getOriginX() const { return m_originX; }
   inline double getOriginY() const { return m_originY; }
   inline double getOriginErrX() const { return m_originErrX; }
@@ -84,6 +101,7 @@ public:
 
   friend class StorageIO;  // Sets values
   friend class Event;  // Access index
+  friend class Cluster;  // Links by index
 };
 
 }
@@ -6,6 +6,7 @@
 #include <TDirectory.h>
 #include <TH1.h>
 
+#include "storage/eventview.h"
 #include "analyzers/analyzer.h"
 
 namespace Analyzers {
@@ -15,6 +16,7 @@ Analyzer::Analyzer(const std::vector<Mechanics::Device*>& devices) :
     m_devices(devices.begin(), devices.end()),
     m_ndevices(m_devices.size()),
     m_events(m_ndevices, 0),
+    m_views(m_ndevices, 0),
     m_finalized(false) {
   if (m_ndevices == 0)
     throw std::runtime_error("Analyzer::Analyzer: empty device vector");
@@ -25,6 +27,7 @@ Analyzer::Analyzer(const std::vector<const Mechanics::Device*>& devices) :
     m_devices(devices),
     m_ndevices(m_devices.size()),
     m_events(m_ndevices, 0),
+    m_views(m_ndevices, 0),
     m_finalized(false) {
   if (m_ndevices == 0)
     throw std::runtime_error("Analyzer::Analyzer: empty device vector");
@@ -35,6 +38,7 @@ Analyzer::Analyzer(const Mechanics::Device& device) :
     m_devices(1, &device),
     m_ndevices(1),
     m_events(m_ndevices, 0),
+    m_views(m_ndevices, 0),
     m_finalized(false) {}
 
 Analyzer::~Analyzer() {
@@ -91,6 +95,25 @@ void Analyzer::execute(const Storage::Event& event) {
   process();
 }
 
+void Analyzer::execute(const std::vector<const Storage::EventView*>& views) {
+  if (views.size() != m_ndevices)
+    throw std::runtime_error("Analyzer::execute: incorrect number of views passed");
+  for (size_t i = 0; i < m_ndevices; i++)
+    m_views[i] = views[i];
+  processView();
+}
+
+void Analyzer::execute(const Storage::EventView& view) {
+  if (m_ndevices != 1)
+    throw std::runtime_error("Analyzer::execute: incorrect number of views passed");
+  m_views[0] = &view;
+  processView();
+}
+
+void Analyzer::processView() {
+  throw std::runtime_error("Analyzer::processView: event views not supported");
+}
+
 void Analyzer::finalize() {
   if (m_finalized)
     throw std::runtime_error("Analyzer::finalize: analyzer already finalized");
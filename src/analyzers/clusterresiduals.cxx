@@ -12,6 +12,7 @@
 #include "storage/event.h"
 #include "storage/plane.h"
 #include "storage/cluster.h"
+#include "storage/eventview.h"
 #include "mechanics/device.h"
 #include "mechanics/sensor.h"
 #include "analyzers/clusterresiduals.h"
@@ -148,6 +149,52 @@ void ClusterResiduals::process() {
   }
 }
 
+void ClusterResiduals::processView() {
+  assert(m_ndevices > 0 && "ensures > 0 events");
+  const Storage::EventView& refView = *m_views[0];
+
+  size_t iglobal = 0;
+
+  for (size_t iview = 0; iview < m_views.size(); iview++) {
+    const Storage::EventView& view = *m_views[iview];
+
+    for (size_t iplane = 0; iplane < view.getNumPlanes(); iplane++) {
+      const Storage::EventView::PlaneView& plane = view.planes[iplane];
+
+      for (size_t iref = 0; iref < refView.getNumPlanes(); iref++) {
+        const Storage::EventView::PlaneView& ref = refView.planes[iref];
+
+        for (size_t icluster = 0; icluster < plane.numClusters; icluster++) {
+          const double posX = plane.clusterPosX[icluster];
+          const double posY = plane.clusterPosY[icluster];
+
+          // Nearest by squared distance, same ordering as the distance
+          double bestDistance = 0;
+          size_t nearest = ref.numClusters;
+
+          for (size_t ircluster = 0; ircluster < ref.numClusters; ircluster++) {
+            const double dx = posX - ref.clusterPosX[ircluster];
+            const double dy = posY - ref.clusterPosY[ircluster];
+            const double distance = dx*dx + dy*dy;
+
+            if (distance < bestDistance || ircluster == 0) {
+              bestDistance = distance;
+              nearest = ircluster;
+            }
+          }
+
+          if (nearest == ref.numClusters) continue;
+
+          m_hResidualsX[iglobal]->Fill(posX - ref.clusterPosX[nearest]);
+          m_hResidualsY[iglobal]->Fill(posY - ref.clusterPosY[nearest]);
+        }
+
+        iglobal += 1;
+      }
+    }
+  }
+}
+
 size_t ClusterResiduals::toGlobal(
     size_t idevice, 
     size_t isensor, 
@@ -24,6 +24,7 @@
 #include "eventinfo.h"
 #include "../mechanics/device.h"
 #include "../loopers/looper.h"
+#include "../loopers/skim.h"
 #include "../configparser.h"
 
 namespace Analyzers {
@@ -204,6 +205,54 @@ void applyCuts(DualAnalyzer* analyzer,
     analyzer->addCut(hitCuts.at(i));
 }
 
+void configSkim(const ConfigParser& config,
+                Loopers::Skim& skim)
+{
+  bool active = false;
+  std::string refOutput = "";
+  std::string dutOutput = "";
+  std::vector<EventCut*> eventCuts;
+  std::vector<TrackCut*> trackCuts;
+  std::vector<ClusterCut*> clusterCuts;
+  std::vector<HitCut*> hitCuts;
+
+  for (unsigned int i = 0; i < config.getNumRows(); i++)
+  {
+    const ConfigParser::Row* row = config.getRow(i);
+
+    if (row->isHeader) continue;
+    if (row->header.compare("Skim")) continue;
+
+    if (!row->key.compare("active"))
+      active = ConfigParser::valueToLogical(row->value);
+    else if (!row->key.compare("ref output"))
+      refOutput = row->value;
+    else if (!row->key.compare("dut output"))
+      dutOutput = row->value;
+    else if (!row->key.compare("min good tracks"))
+      skim.setMinGoodTracks(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("max good tracks"))
+      skim.setMaxGoodTracks(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.substr(0, 4).compare("cut "))
+      parseCut(row, eventCuts, trackCuts, clusterCuts, hitCuts);
+    else
+      throw "Analyzers: skim can't parse row";
+  }
+
+  if (clusterCuts.size() || hitCuts.size())
+    throw "Analyzers: skim only takes event and track cuts";
+
+  for (unsigned int i = 0; i < eventCuts.size(); i++)
+    skim.addCut(eventCuts.at(i)); // Cuts will be deleted by the skim
+  for (unsigned int i = 0; i < trackCuts.size(); i++)
+    skim.addCut(trackCuts.at(i));
+
+  if (!active) return;
+  if (refOutput.empty()) throw "Analyzers: active skim needs a ref output";
+  skim.setRefOutput(refOutput.c_str());
+  if (!dutOutput.empty()) skim.setDutOutput(dutOutput.c_str());
+}
+
 void configDUTDepictor(const ConfigParser& config,
                        Loopers::Looper* looper,
                        Mechanics::Device* refDevice,
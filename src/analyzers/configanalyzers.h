@@ -6,6 +6,7 @@
 class ConfigParser;
 namespace Mechanics { class Device; }
 namespace Loopers { class Looper; }
+namespace Loopers { class Skim; }
 
 namespace Analyzers {
 
@@ -84,6 +85,10 @@ void configTrackInfo(const ConfigParser& config,
                      Mechanics::Device* refDevice,
                      TFile* results);
 
+// Reads the [Skim] section, the skim stays inactive if it isn't
+void configSkim(const ConfigParser& config,
+                Loopers::Skim& skim);
+
 void configLooper(const ConfigParser& config,
                   Loopers::Looper* looper,
                   Mechanics::Device* refDevice,
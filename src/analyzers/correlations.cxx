@@ -10,6 +10,7 @@
 #include "storage/event.h"
 #include "storage/plane.h"
 #include "storage/cluster.h"
+#include "storage/eventview.h"
 #include "mechanics/device.h"
 #include "mechanics/sensor.h"
 #include "analyzers/correlations.h"
@@ -140,6 +141,35 @@ void Correlations::process() {
   }  // devices
 }
 
+void Correlations::processView() {
+  assert(m_ndevices > 0 && "ensures > 0 events");
+  const Storage::EventView& refView = *m_views[0];
+
+  size_t iglobal = 0;
+  for (size_t idevice = 0; idevice < m_devices.size(); idevice++) {
+    const Storage::EventView& view = *m_views[idevice];
+    for (size_t iplane = 0; iplane < view.getNumPlanes(); iplane++) {
+      const Storage::EventView::PlaneView& plane = view.planes[iplane];
+      assert(m_irelative[iglobal] < refView.getNumPlanes());
+      const Storage::EventView::PlaneView& refPlane =
+          refView.planes[m_irelative[iglobal]];
+
+      TH2D& histX = *m_hCorrelationsX[iglobal];
+      TH2D& histY = *m_hCorrelationsY[iglobal];
+      for (size_t icluster = 0; icluster < plane.numClusters; icluster++) {
+        const double pixX = plane.clusterPixX[icluster];
+        const double pixY = plane.clusterPixY[icluster];
+        for (size_t iref = 0; iref < refPlane.numClusters; iref++) {
+          histX.Fill(pixX, refPlane.clusterPixX[iref]);
+          histY.Fill(pixY, refPlane.clusterPixY[iref]);
+        }  // ref clusters
+      }  // plane clusters
+
+      iglobal += 1;  // next global plane
+    }  // planes
+  }  // devices
+}
+
 size_t Correlations::toGlobal(size_t idevice, size_t isensor) const {
   // Simple counting of sensor up to the correct device. Infrequently called,
   // so no need to cache or map indices.
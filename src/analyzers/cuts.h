@@ -6,6 +6,7 @@
 #include "../storage/plane.h"
 #include "../storage/cluster.h"
 #include "../storage/hit.h"
+#include "../storage/eventindex.h"
 #include "../mechanics/sensor.h"
 #include "../processors/processors.h"
 
@@ -34,6 +35,10 @@ public:
   EventCut(Type type = EQ) : Cut(type) { }
   virtual ~EventCut() { }
   virtual bool check(const Storage::Event* event) const = 0;
+  /* Same decision from the event's index summary, so that loopers can skip
+   * the event without reading it. Cuts which need more than the summary
+   * must accept. */
+  virtual bool check(const Storage::EventSummary* summary) const { return true; }
 };
 
 class TrackCut : public Cut
@@ -87,6 +92,15 @@ public:
     if (_type == GT && event->getNumHits() < _value) return false;
     return true;
   }
+  inline bool check(const Storage::EventSummary* summary) const
+  {
+    // Hits dropped when reading aren't reflected in the summary
+    if (!summary->getHitsExact()) return true;
+    if (_type == EQ && summary->getNumHits() != _value) return false;
+    if (_type == LT && summary->getNumHits() > _value) return false;
+    if (_type == GT && summary->getNumHits() < _value) return false;
+    return true;
+  }
 };
 
 class EventClusters : public EventCut
@@ -102,6 +116,13 @@ public:
     if (_type == GT && event->getNumClusters() < _value) return false;
     return true;
   }
+  inline bool check(const Storage::EventSummary* summary) const
+  {
+    if (_type == EQ && summary->getNumClusters() != _value) return false;
+    if (_type == LT && summary->getNumClusters() > _value) return false;
+    if (_type == GT && summary->getNumClusters() < _value) return false;
+    return true;
+  }
 };
 
 class EventTrigOffset : public EventCut
@@ -117,6 +138,13 @@ public:
     if (_type == GT && event->getTriggerOffset() < _value) return false;
     return true;
   }
+  inline bool check(const Storage::EventSummary* summary) const
+  {
+    if (_type == EQ && summary->getTriggerOffset() != _value) return false;
+    if (_type == LT && summary->getTriggerOffset() > _value) return false;
+    if (_type == GT && summary->getTriggerOffset() < _value) return false;
+    return true;
+  }
 };
 
 class EventTracks : public EventCut
@@ -132,6 +160,13 @@ public:
     if (_type == GT && event->getNumTracks() < _value) return false;
     return true;
   }
+  inline bool check(const Storage::EventSummary* summary) const
+  {
+    if (_type == EQ && summary->getNumTracks() != _value) return false;
+    if (_type == LT && summary->getNumTracks() > _value) return false;
+    if (_type == GT && summary->getNumTracks() < _value) return false;
+    return true;
+  }
 };
 
 /*******************************************************************************
@@ -47,6 +47,13 @@ void DualAnalyzer::addCut(const EventCut* cut)
   _numEventCuts++;
 }
 
+bool DualAnalyzer::checkEventCuts(const Storage::EventSummary* summary) const
+{
+  for (unsigned int ncut = 0; ncut < _numEventCuts; ncut++)
+    if (!_eventCuts.at(ncut)->check(summary)) return false;
+  return true;
+}
+
 void DualAnalyzer::addCut(const TrackCut* cut)
 {
   _trackCuts.push_back(cut);
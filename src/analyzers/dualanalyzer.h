@@ -6,6 +6,7 @@
 #include <TDirectory.h>
 
 namespace Storage { class Event; }
+namespace Storage { class EventSummary; }
 namespace Mechanics { class Device; }
 
 namespace Analyzers {
@@ -61,6 +62,9 @@ public:
   void addCut(const TrackCut* cut);
   void addCut(const ClusterCut* cut);
   void addCut(const HitCut* cut);
+
+  // False if one of the event cuts rejects the event from its summary alone
+  bool checkEventCuts(const Storage::EventSummary* summary) const;
 };
 
 }
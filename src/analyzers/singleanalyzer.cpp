@@ -39,6 +39,13 @@ void SingleAnalyzer::addCut(const EventCut* cut)
   _numEventCuts++;
 }
 
+bool SingleAnalyzer::checkEventCuts(const Storage::EventSummary* summary) const
+{
+  for (unsigned int ncut = 0; ncut < _numEventCuts; ncut++)
+    if (!_eventCuts.at(ncut)->check(summary)) return false;
+  return true;
+}
+
 void SingleAnalyzer::addCut(const TrackCut* cut)
 {
   _trackCuts.push_back(cut);
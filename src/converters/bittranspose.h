@@ -0,0 +1,82 @@
+#ifndef BITTRANSPOSE_H
+#define BITTRANSPOSE_H
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Converters {
+
+/* Transpose a 16x16 matrix of bits, held as 16 words: bit n of out[b] is bit
+ * b of in[n]. This turns a line of the Kartel stream (16 words, each holding
+ * one bit of every variable) into the 16 variables.
+ *
+ * The matrix is split into 2x2 blocks, and the two off-diagonal blocks are
+ * swapped, down from 8x8 blocks to single bits. */
+inline void transposeBitsScalar(const uint16_t* in, uint16_t* out)
+{
+  for (unsigned int n = 0; n < 16; n++) out[n] = in[n];
+
+  const uint16_t masks[4] = { 0x00FF, 0x0F0F, 0x3333, 0x5555 };
+  unsigned int nmask = 0;
+  for (unsigned int size = 8; size > 0; size >>= 1, nmask++)
+  {
+    const uint16_t mask = masks[nmask];
+    for (unsigned int n = 0; n < 16; n = (n + size + 1) & ~size)
+    {
+      const uint16_t swap = ((out[n] >> size) ^ out[n + size]) & mask;
+      out[n + size] ^= swap;
+      out[n] ^= swap << size;
+    }
+  }
+}
+
+/* As transposeBitsScalar, using the instruction set the file is compiled
+ * for. The bits of a byte lane are gathered across lanes by movemask, which
+ * reads the top bit of each, and the lanes are then doubled to move the next
+ * bit to the top. */
+inline void transposeBits(const uint16_t* in, uint16_t* out)
+{
+#if defined(__AVX2__)
+  __m256i words = _mm256_loadu_si256((const __m256i*)in);
+  // Within each lane, move the low bytes of its words before the high bytes
+  const __m256i split = _mm256_setr_epi8(
+      0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+      0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+  words = _mm256_shuffle_epi8(words, split);
+  // Low bytes of the 16 words in the low lane, high bytes in the high lane
+  words = _mm256_permute4x64_epi64(words, _MM_SHUFFLE(3, 1, 2, 0));
+  for (int bit = 7; bit >= 0; bit--)
+  {
+    const uint32_t bits = _mm256_movemask_epi8(words);
+    out[bit] = bits & 0xFFFF;
+    out[bit + 8] = bits >> 16;
+    words = _mm256_add_epi8(words, words);
+  }
+#elif defined(__SSE2__)
+  const __m128i first = _mm_loadu_si128((const __m128i*)in);
+  const __m128i second = _mm_loadu_si128((const __m128i*)(in + 8));
+  const __m128i lowByte = _mm_set1_epi16(0x00FF);
+  __m128i low = _mm_packus_epi16(_mm_and_si128(first, lowByte),
+                                 _mm_and_si128(second, lowByte));
+  __m128i high = _mm_packus_epi16(_mm_srli_epi16(first, 8),
+                                  _mm_srli_epi16(second, 8));
+  for (int bit = 7; bit >= 0; bit--)
+  {
+    out[bit] = _mm_movemask_epi8(low);
+    out[bit + 8] = _mm_movemask_epi8(high);
+    low = _mm_add_epi8(low, low);
+    high = _mm_add_epi8(high, high);
+  }
+#else
+  transposeBitsScalar(in, out);
+#endif
+}
+
+}
+
+#endif // BITTRANSPOSE_H
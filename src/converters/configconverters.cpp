@@ -0,0 +1,45 @@
+#include "configconverters.h"
+
+#include "../configparser.h"
+#include "kartelgenerator.h"
+
+namespace Converters {
+
+void configGenerator(const ConfigParser& config, KartelGenerator& generator)
+{
+  for (unsigned int i = 0; i < config.getNumRows(); i++)
+  {
+    const ConfigParser::Row* row = config.getRow(i);
+
+    if (row->isHeader) continue;
+    if (row->header.compare("Kartel Generator")) continue;
+
+    if (!row->key.compare("seed"))
+      generator.setSeed(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("planes"))
+      generator.setActivePlanes(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("occupancy"))
+      generator.setOccupancy(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("trigger rate"))
+      generator.setTriggerRate(ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("header errors"))
+      generator.setErrorRate(KartelGenerator::ERR_HEADER,
+                             ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("sync errors"))
+      generator.setErrorRate(KartelGenerator::ERR_SYNC,
+                             ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("offset errors"))
+      generator.setErrorRate(KartelGenerator::ERR_OFFSET,
+                             ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("hit errors"))
+      generator.setErrorRate(KartelGenerator::ERR_HITS,
+                             ConfigParser::valueToNumerical(row->value));
+    else if (!row->key.compare("sum errors"))
+      generator.setErrorRate(KartelGenerator::ERR_SUM,
+                             ConfigParser::valueToNumerical(row->value));
+    else
+      throw "Converters: can't parse kartel generator row";
+  }
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef CONFIGCONVERTERS_H
+#define CONFIGCONVERTERS_H
+
+class ConfigParser;
+
+namespace Converters {
+
+class KartelGenerator;
+
+// Set the generator from the optional [Kartel Generator] rows
+void configGenerator(const ConfigParser& config, KartelGenerator& generator);
+
+}
+
+#endif // CONFIGCONVERTERS_H
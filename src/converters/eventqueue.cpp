@@ -0,0 +1,92 @@
+#include "eventqueue.h"
+
+#include <cassert>
+
+#include "../storage/event.h"
+
+namespace Converters {
+
+bool EventQueue::push(Storage::Event* event, ULong64_t position)
+{
+  assert(event && "EventQueue: tried to push a null event");
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _notFull.wait(lock, [this]() { return _closed || _entries.size() < _capacity; });
+
+  if (_closed)
+  {
+    delete event;
+    return false;
+  }
+
+  Entry entry;
+  entry.event = event;
+  entry.pushed = Clock::now();
+  entry.position = position;
+  _entries.push_back(entry);
+  _notEmpty.notify_one();
+  return true;
+}
+
+/* Take the front entry, the lock must be held */
+Storage::Event* EventQueue::take(double* queued, ULong64_t* position)
+{
+  if (_entries.empty()) return 0;
+
+  const Entry entry = _entries.front();
+  _entries.pop_front();
+  _notFull.notify_one();
+
+  if (queued)
+    *queued = std::chrono::duration<double>(Clock::now() - entry.pushed).count();
+  if (position) *position = entry.position;
+  return entry.event;
+}
+
+Storage::Event* EventQueue::pop()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _notEmpty.wait(lock, [this]() { return _closed || !_entries.empty(); });
+  return take(0, 0);
+}
+
+Storage::Event* EventQueue::pop(double timeout, double* queued, ULong64_t* position)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _notEmpty.wait_for(lock, std::chrono::duration<double>(timeout > 0 ? timeout : 0),
+                     [this]() { return _closed || !_entries.empty(); });
+  return take(queued, position);
+}
+
+void EventQueue::close()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = true;
+  _notFull.notify_all();
+  _notEmpty.notify_all();
+}
+
+bool EventQueue::isClosed()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _closed;
+}
+
+bool EventQueue::isDone()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _closed && _entries.empty();
+}
+
+EventQueue::EventQueue(size_t capacity) :
+  _capacity(capacity ? capacity : 1),
+  _closed(false)
+{ }
+
+EventQueue::~EventQueue()
+{
+  for (size_t nentry = 0; nentry < _entries.size(); nentry++)
+    delete _entries[nentry].event;
+}
+
+}
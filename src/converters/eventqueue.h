@@ -0,0 +1,68 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include <Rtypes.h>
+
+namespace Storage { class Event; }
+
+namespace Converters {
+
+/* Hands events from a converter to a consumer on another thread (e.g. to
+ * cluster and track them as they are converted, see KartelConvert::setQueue).
+ * The queue holds a bounded number of events, the converter waits when it is
+ * full, and the consumer when it is empty.
+ *
+ * The queue owns the events it holds. Closing it wakes both sides: the
+ * consumer drains what is left, and events pushed afterwards are deleted. */
+class EventQueue
+{
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Entry {
+    Storage::Event* event;
+    Clock::time_point pushed;
+    ULong64_t position;
+  };
+
+  std::deque<Entry> _entries;
+  const size_t _capacity;
+  bool _closed;
+  std::mutex _mutex;
+  std::condition_variable _notFull;
+  std::condition_variable _notEmpty;
+
+  Storage::Event* take(double* queued, ULong64_t* position);
+
+public:
+  EventQueue(size_t capacity = 256);
+  ~EventQueue(); // Deletes the events left in the queue
+
+  // Add an event, taking its ownership, with its position in the source (e.g.
+  // a byte offset). Returns false if the queue is closed
+  bool push(Storage::Event* event, ULong64_t position = 0);
+  // The next event, the caller takes its ownership. Returns 0 once the queue
+  // is closed and empty
+  Storage::Event* pop();
+  // As above, but returns 0 if no event came within `timeout` seconds. Gives
+  // the seconds the event spent in the queue, and its position
+  Storage::Event* pop(double timeout, double* queued, ULong64_t* position = 0);
+  // No more events will be accepted
+  void close();
+  bool isClosed();
+  // Closed and empty: no more events will come out
+  bool isDone();
+
+private:
+  EventQueue(const EventQueue&); // Disable the copy constructor
+  EventQueue& operator=(const EventQueue&); // Disable the assignment operator
+};
+
+}
+
+#endif // EVENTQUEUE_H
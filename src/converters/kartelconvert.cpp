@@ -3,6 +3,16 @@
 #include <cassert>
 #include <iostream>
 #include <stdio.h>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../storage/hit.h"
 #include "../storage/cluster.h"
@@ -11,6 +21,9 @@
 #include "../mechanics/device.h"
 #include "../mechanics/sensor.h"
 #include "../storage/storageio.h"
+#include "bittranspose.h"
+#include "kartelformat.h"
+#include "eventqueue.h"
 
 #ifndef VERBOSE
 #define VERBOSE 1
@@ -22,6 +35,11 @@ using std::fstream;
 
 namespace Converters {
 
+using namespace KartelFormat;
+
+// Defined here since sleep_for takes the poll period by reference
+const unsigned int KartelConvert::_followPoll;
+
 /* Check if a specific bit is non-zero in a word. If it is, this bit is
  * usually then written into the appropriate variable. */
 inline bool KartelConvert::checkBit(Word checkWord, unsigned int pos)
@@ -64,51 +82,113 @@ void KartelConvert::clearFrame()
   _frame.errSum = false;
 }
 
-/* Clear the line buffer variables so that the next line can be read */
-void KartelConvert::clearLineBuffer() {
-  _line.sync = 0;
-  _line.triggerOffset = 0;
-  _line.triggerNumber = 0;
-  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+/* Map a regular file into memory, so that it is decoded without copying it
+ * through the stream. Returns false if the file can't be mapped (e.g. it is
+ * a pipe), in which case the stream is used. */
+bool KartelConvert::mapInput(const char* fileName)
+{
+  const int fd = open(fileName, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  // Files too large for the address space (32 bit) are streamed instead
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+      (size_t)info.st_size < sizeof(Word) ||
+      (off_t)(size_t)info.st_size != info.st_size)
   {
-    _line.ch0[nplane] = 0;
-    _line.ch1[nplane] = 0;
+    close(fd);
+    return false;
   }
+
+  void* data = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid once the file is closed
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  // The file is read once from start to end: read ahead aggressively and drop
+  // the pages soon after they are used
+  madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+  _mapped = data;
+  _mappedSize = info.st_size;
+  _buffer = (const Word*)data;
+  _buffLength = _mappedSize / sizeof(Word); // Drop a trailing partial word
+  _buffPos = 0;
+  return true;
 }
 
 void KartelConvert::fillBuffer()
 {
-  // Read the buff_size length of Words into the file_buffer array
-  _kartelInput.read((char*)_fileBuffer, _buffSize * sizeof(Word));
+  _streamWords += _buffLength;
+  _buffPos = 0;
 
-  // How many chars were ACTUALLY read (not always specified amount)
-  _buffLength = _kartelInput.gcount();
+  unsigned int idle = 0; // Milliseconds waited for the file to grow
+  while (true)
+  {
+    // Read the buff_size length of Words into the file_buffer array
+    _kartelInput.read((char*)_fileBuffer, _buffSize * sizeof(Word));
 
-  // Could have stopped reading inside a word, round down
-  const unsigned int intLength =
-      (int)(_buffLength / sizeof(Word)) * sizeof(Word);
-  const unsigned int ndiscard = _buffLength - intLength;
-  for (unsigned int i = 0; i < ndiscard; i++) _kartelInput.unget();
-  _buffLength = intLength;
+    // How many chars were ACTUALLY read (not always specified amount)
+    const unsigned int nread = _kartelInput.gcount();
 
-  _buffPos = 0;
+    // A followed file can be read past its current end once it grows
+    if (_followTimeout > 0) _kartelInput.clear();
+
+    // Could have stopped reading inside a word, round down
+    const unsigned int ndiscard = nread % sizeof(Word);
+    for (unsigned int i = 0; i < ndiscard; i++) _kartelInput.unget();
+    _buffLength = nread / sizeof(Word);
+
+    if (_buffLength || idle >= 1000 * _followTimeout) break;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(_followPoll));
+    idle += _followPoll;
+  }
 }
 
-/* Read the next word from the input stream. Returns false if the end of file
- * is reached. */
-int KartelConvert::readNextWord()
+/* Byte offset of the next word to read in the input. When decoding in
+ * parallel, this is only meaningful for the serial decoder. */
+ULong64_t KartelConvert::inputPosition() const
 {
-  // If this is the last buffer, and there isn't a word left in it
-  if (!_kartelInput.good() && (_buffPos + 1) * sizeof(Word) > _buffLength)
+  if (_mapped) return _buffPos * sizeof(Word);
+  return (_streamWords + _buffPos) * sizeof(Word);
+}
+
+void KartelConvert::resumeAt(ULong64_t offset)
+{
+  const ULong64_t word = offset / sizeof(Word);
+
+  if (_mapped)
   {
-    _eofReached = true;
-    return -1;
+    _buffPos = word < _buffLength ? word : _buffLength;
+    return;
   }
 
-  if ((_buffPos + 1) * sizeof(Word) > _buffLength)
-    fillBuffer();
+  if (!_kartelInput.is_open()) return;
+  _kartelInput.clear();
+  _kartelInput.seekg(word * sizeof(Word));
+  _streamWords = word;
+  _buffLength = 0;
+  _buffPos = 0;
+}
+
+/* Read the next word from the input. Returns false if the end of file is
+ * reached. */
+inline int KartelConvert::readNextWord()
+{
+  if (_buffPos >= _buffLength)
+  {
+    // The mapped file is all in the buffer, only the stream can be re-filled
+    if (_buffer == _fileBuffer && _kartelInput.good()) fillBuffer();
+
+    if (_buffPos >= _buffLength)
+    {
+      _eofReached = true;
+      return -1;
+    }
+  }
 
-  _word = _fileBuffer[_buffPos];
+  _word = _buffer[_buffPos];
   _buffPos++;
 
   return 0;
@@ -122,7 +202,7 @@ int KartelConvert::findNextSync()
   while (!readNextWord())
   {
     // Check if the current word contains a synchronization signal bit
-    if (checkBit(_word, _bitMap.sync))
+    if (checkBit(_word, SYNC_BIT))
     {
       _buffPos--; // Seek back to the last word
       return 0; // Found the synchronization signal
@@ -133,46 +213,94 @@ int KartelConvert::findNextSync()
   return -1;
 }
 
-/* Read the next line from the input stream. Stores the various variable
- * information into the appropriate containers in the line buffer. Returns
- * -2 if there EOF is reached in the line. */
-int KartelConvert::readNextLine()
+/* Map the bits of one line of words to the line buffer. Each word holds one
+ * bit of every component, so the line is transposed as a 16x16 bit matrix,
+ * after which each component is a single word. */
+template <void (*Transpose)(const unsigned short*, unsigned short*)>
+void KartelConvert::decodeLine(const Word* words, LineBuffer& line,
+                               unsigned int lineCount, ULong64_t& timeStamp)
+{
+  Word bits[_lineLength];
+  Transpose(words, bits);
+
+  line.sync = bits[SYNC_BIT];
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    line.ch0[nplane] = bits[CH0_BITS[nplane]];
+    line.ch1[nplane] = bits[CH1_BITS[nplane]];
+  }
+
+  // The first line of a frame should have a trigger offset and number
+  line.triggerOffset = lineCount == 0 ? bits[TRIGGER_OFFSET_BIT] : 0;
+  line.triggerNumber = lineCount == 0 ? bits[TRIGGER_BIT] : 0;
+
+  // The time stamp is written over the first four lines of each frame
+  if (lineCount < 4)
+    timeStamp |= (ULong64_t)bits[TIME_STAMP_BIT] << (sizeof(Word) * lineCount);
+}
+
+/* Map the bits of one line of words to the line buffer, one at a time */
+void KartelConvert::decodeLineBitwise(const Word* words, LineBuffer& line,
+                                      unsigned int lineCount, ULong64_t& timeStamp)
 {
-  // Reset the line stream
-  clearLineBuffer();
+  memset(&line, 0, sizeof(LineBuffer));
 
-  // Read one line of words from the raw data, and map the bits to the stream
   for (unsigned int nbit = 0; nbit < _lineLength; nbit++)
   {
-    if (readNextWord()) return -1;
+    const Word word = words[nbit];
 
     // Copy the bit from the synch position of the stream to the appropriate line variable
-    if (checkBit(_word, _bitMap.sync)) setBit(_line.sync, nbit);
+    if (checkBit(word, SYNC_BIT)) setBit(line.sync, nbit);
 
     // Map the bits from each plane's channels
     for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
     {
-      if (checkBit(_word, _bitMap.ch0[nplane])) setBit(_line.ch0[nplane], nbit);
-      if (checkBit(_word, _bitMap.ch1[nplane])) setBit(_line.ch1[nplane], nbit);
+      if (checkBit(word, CH0_BITS[nplane])) setBit(line.ch0[nplane], nbit);
+      if (checkBit(word, CH1_BITS[nplane])) setBit(line.ch1[nplane], nbit);
     }
 
     // The first line of a frame should have a trigger offset
-    if (_frame.lineCount == 0)
-      if (checkBit(_word, _bitMap.triggerOffset)) setBit(_line.triggerOffset, nbit);
+    if (lineCount == 0)
+      if (checkBit(word, TRIGGER_OFFSET_BIT)) setBit(line.triggerOffset, nbit);
 
     // Should also have a trigger number
-    if (_frame.lineCount == 0)
-      if (checkBit(_word, _bitMap.trigger)) setBit(_line.triggerNumber, nbit);
+    if (lineCount == 0)
+      if (checkBit(word, TRIGGER_BIT)) setBit(line.triggerNumber, nbit);
 
     // The time stamp is written over the first four lines of each frame
-    if (_frame.lineCount < 4 && checkBit(_word, _bitMap.timeStamp))
+    if (lineCount < 4 && checkBit(word, TIME_STAMP_BIT))
     {
       // convert the current bit to a 64 bit position
-      const unsigned int pos = nbit + sizeof(Word) * _frame.lineCount;
-      _frame.timeStamp = _frame.timeStamp | (int)pow(2.0, pos);
+      const unsigned int pos = nbit + sizeof(Word) * lineCount;
+      timeStamp = timeStamp | (int)pow(2.0, pos);
+    }
+  }
+}
+
+/* Read the next line from the input stream. Stores the various variable
+ * information into the appropriate containers in the line buffer. Returns
+ * -1 if there EOF is reached in the line. */
+int KartelConvert::readNextLine()
+{
+  // Decode in place if the whole line is in the buffer
+  const Word* words = _buffer + _buffPos;
+  Word lineWords[_lineLength];
+
+  if (_buffLength - _buffPos >= _lineLength)
+  {
+    _buffPos += _lineLength;
+  }
+  else
+  {
+    for (unsigned int nword = 0; nword < _lineLength; nword++)
+    {
+      if (readNextWord()) return -1;
+      lineWords[nword] = _word;
     }
+    words = lineWords;
   }
 
+  decodeLine<transposeBits>(words, _line, _frame.lineCount, _frame.timeStamp);
   _frame.lineCount++;
 
   return 0;
@@ -392,6 +520,8 @@ int KartelConvert::readFrameInfo()
 
 void KartelConvert::writeFrame(bool invalid)
 {
+  if (!_storage && !_queue) throw "KartelConvert: no output to write to";
+
   // Currently, there is no timestamp. Instead, use trigger number and offset
   ULong64_t timeStamp = _frame.number[0] * _clock - _frame.triggerOffset;
 
@@ -416,6 +546,15 @@ void KartelConvert::writeFrame(bool invalid)
     }
   }
 
+  if (_queue)
+  {
+    _totalEvents++;
+    if (invalid) _invalidEvents++;
+    // The consumer writes and deletes the event (or the queue if it is closed)
+    _queue->push(event, inputPosition());
+    return;
+  }
+
   try
   {
     // If this fails, nothing was added to the file
@@ -446,7 +585,7 @@ void KartelConvert::writeFrame(bool invalid)
 
 int KartelConvert::processEvent(bool discard)
 {
-  if (!_kartelInput.is_open())
+  if (!_mapped && !_kartelInput.is_open())
   {
     _eofReached = true;
     return -1;
@@ -500,7 +639,7 @@ int KartelConvert::processEvent(bool discard)
   return 0;
 }
 
-int KartelConvert::processFile(Long64_t numEvents)
+void KartelConvert::clearCounters()
 {
   _errHeader = 0;
   _errSync = 0;
@@ -511,6 +650,53 @@ int KartelConvert::processFile(Long64_t numEvents)
   _totalEvents = 0;
   _totalFrames = 0;
   _possibleDesync = 0;
+  _errOffset = 0;
+}
+
+void KartelConvert::printProgress(Long64_t nevent, Long64_t numEvents)
+{
+  // Display a % of progress if numEvents is specified (and not a single one)
+  const unsigned int update = 1000;
+  if (numEvents > 1)
+  {
+    if (!(nevent % update) || nevent == numEvents - 1)
+      cout << "\rProgress: " << (nevent * 100) / (numEvents - 1) << "%" << std::flush;
+  }
+  // No progress because the files can be >= 4 GB and can't be indexed on 32 bit machines
+  else
+  {
+    if (!(nevent % update) || nevent == numEvents - 1)
+      cout << "\rProgress: " << nevent << std::flush;
+  }
+}
+
+void KartelConvert::printSummary(Long64_t numEvents)
+{
+  if (VERBOSE)
+  {
+    if (_eofReached)
+      cout << "EOF terminated the conversion" << endl;
+
+    cout << "\nProcess file summary:\n"
+         << "Errors:\n"
+         << "  Header : " << _errHeader << "\n"
+         << "  Sync   : " << _errSync << "\n"
+         << "  Offset : " << _errOffset << "\n"
+         << "  Hits   : " << _errHits << "\n"
+         << "  Sum    : " << _errSum << "\n"
+         << "  Write  : " << _errWrite << "\n"
+         << "Number of events:\n"
+         << "  Requested : " << numEvents << "\n"
+         << "  Read      : " << _totalEvents << "\n"
+         << "  Invalids  : " << _invalidEvents << "\n"
+         << "  Missed    : " << _possibleDesync << "\n"
+         << "  Frames    : " << _totalFrames << endl;
+  }
+}
+
+int KartelConvert::processFile(Long64_t numEvents)
+{
+  clearCounters();
 
   // Discard the first triggered event (junk trigger written by firmware)
   //processEvent(true);
@@ -528,44 +714,264 @@ int KartelConvert::processFile(Long64_t numEvents)
       _possibleDesync++;
     }
 
-    // Display a % of progress if numEvents is specified
-    const unsigned int update = 1000;
-    if (numEvents > 0)
+    printProgress(nevent, numEvents);
+
+    if (_eofReached || (_queue && _queue->isClosed())) break;
+  }
+  cout << endl;
+
+  printSummary(numEvents);
+
+  return 0;
+}
+
+/* Decode the frames whose first word is in [begin, end) into the batch, as
+ * processEvent would but without writing them. The last frame can run past
+ * the end of the chunk, and the next frame's start is kept so that the
+ * batches can be stitched back together. */
+void KartelConvert::decodeChunk(size_t begin, size_t end, FrameBatch& batch)
+{
+  batch.frames.clear();
+  batch.hits.clear();
+  batch.nextSync = _noFrame;
+
+  _eofReached = false;
+  _buffPos = begin;
+
+  while (!findNextSync())
+  {
+    if (_buffPos >= end)
     {
-      if (!(nevent % update) || nevent == numEvents - 1)
-        cout << "\rProgress: " << (nevent * 100) / (numEvents - 1) << "%" << std::flush;
+      batch.nextSync = _buffPos;
+      return;
     }
-    // No progress because the files can be >= 4 GB and can't be indexed on 32 bit machines
-    else
+
+    FrameRecord record;
+    record.start = _buffPos;
+
+    clearFrame();
+    record.invalid = readFrameInfo() != 0;
+    // Only triggered frames have their hits read
+    if (_frame.triggerFlag && !record.invalid)
+      record.invalid = readHits() != 0;
+
+    record.number = _frame.number[0];
+    record.triggerFlag = _frame.triggerFlag;
+    record.triggerOffset = _frame.triggerOffset;
+    record.errHeader = _frame.errHeader;
+    record.errSync = _frame.errSync;
+    record.errOffset = _frame.errOffset;
+    record.errHits = _frame.errHits;
+    record.errSum = _frame.errSum;
+
+    // Invalid frames are written without hits
+    record.planeHits[0] = batch.hits.size();
+    for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
     {
-      if (!(nevent % update) || nevent == numEvents - 1)
-        cout << "\rProgress: " << nevent << std::flush;
+      if (!record.invalid)
+        batch.hits.insert(batch.hits.end(),
+                          _frame.hits[nplane].begin(), _frame.hits[nplane].end());
+      record.planeHits[nplane + 1] = batch.hits.size();
     }
 
-    if (_eofReached) break;
+    batch.frames.push_back(record);
   }
-  cout << endl;
+}
 
-  if (VERBOSE)
+/* Write a decoded frame through writeFrame, as processEvent does once it has
+ * read the frame */
+void KartelConvert::writeRecord(const FrameRecord& record, const FrameBatch& batch)
+{
+  _frame.number[0] = record.number;
+  _frame.triggerOffset = record.triggerOffset;
+
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+    _frame.hits[nplane].assign(batch.hits.begin() + record.planeHits[nplane],
+                               batch.hits.begin() + record.planeHits[nplane + 1]);
+
+  writeFrame(record.invalid);
+}
+
+int KartelConvert::processFileParallel(Long64_t numEvents, unsigned int numThreads)
+{
+  // Workers need random access to the file
+  if (!_mapped || numThreads < 2) return processFile(numEvents);
+
+  clearCounters();
+
+  const size_t numChunks = (_buffLength + _chunkWords - 1) / _chunkWords;
+  // Decoded batches waiting to be written are bounded, to bound the memory
+  const size_t window = 2 * numThreads;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<FrameBatch*> ready(numChunks, 0);
+  std::vector<FrameBatch*> spare;
+  size_t nextChunk = 0; // Next chunk for a worker to decode
+  size_t written = 0;   // Chunks already written
+  bool stop = false;
+
+  // Each worker claims the next chunk within the window, and decodes it with
+  // its own copy of the decoding state
+  std::vector<std::thread> workers;
+  for (unsigned int nthread = 0; nthread < numThreads; nthread++)
   {
-    if (_eofReached)
-      cout << "EOF terminated the conversion" << endl;
+    workers.push_back(std::thread([&]() {
+      KartelConvert decoder(*this);
+      while (true)
+      {
+        size_t nchunk = 0;
+        FrameBatch* batch = 0;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&]() {
+            return stop || nextChunk >= numChunks || nextChunk < written + window; });
+          if (stop || nextChunk >= numChunks) return;
+          nchunk = nextChunk++;
+          if (!spare.empty())
+          {
+            batch = spare.back();
+            spare.pop_back();
+          }
+        }
 
-    cout << "\nProcess file summary:\n"
-         << "Errors:\n"
-         << "  Header : " << _errHeader << "\n"
-         << "  Sync   : " << _errSync << "\n"
-         << "  Offset : " << _errOffset << "\n"
-         << "  Hits   : " << _errHits << "\n"
-         << "  Sum    : " << _errSum << "\n"
-         << "  Write  : " << _errWrite << "\n"
-         << "Number of events:\n"
-         << "  Requested : " << numEvents << "\n"
-         << "  Read      : " << _totalEvents << "\n"
-         << "  Invalids  : " << _invalidEvents << "\n"
-         << "  Missed    : " << _possibleDesync << "\n"
-         << "  Frames    : " << _totalFrames << endl;
+        if (!batch) batch = new FrameBatch;
+        const size_t end = std::min((nchunk + 1) * _chunkWords, _buffLength);
+        decoder.decodeChunk(nchunk * _chunkWords, end, *batch);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ready[nchunk] = batch;
+        cond.notify_all();
+      }
+    }));
+  }
+
+  // The frames must be written as processEvent would have read them. A batch
+  // is in step with the previous one if its frames include the one which
+  // follows the previous batch's, which is the case unless the chunk started
+  // in the middle of a frame which was misread as a sync. Otherwise, the
+  // chunk is decoded again from that frame.
+  FrameBatch redo;
+  size_t sync = 0; // Start of the next frame to write, npos at EOF
+  Long64_t nevent = 0;
+  unsigned int consecCount = 0;
+  unsigned int lastFrameNumber = 0;
+
+  // The workers must be stopped and joined before leaving, also on errors.
+  // Batches in use are kept in the ready list until they are spare.
+  auto stopWorkers = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+      cond.notify_all();
+    }
+    for (size_t nthread = 0; nthread < workers.size(); nthread++)
+      workers[nthread].join();
+    for (size_t nchunk = 0; nchunk < numChunks; nchunk++)
+      delete ready[nchunk];
+    for (size_t nbatch = 0; nbatch < spare.size(); nbatch++)
+      delete spare[nbatch];
+  };
+
+  try
+  {
+    for (size_t nchunk = 0; nchunk < numChunks; nchunk++)
+    {
+      FrameBatch* batch = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return ready[nchunk] != 0; });
+        batch = ready[nchunk];
+      }
+
+      const size_t end = std::min((nchunk + 1) * _chunkWords, _buffLength);
+      size_t nframe = 0;
+
+      // The first chunk starts where processEvent would
+      if (nchunk > 0 && sync != _noFrame && sync < end)
+      {
+        while (nframe < batch->frames.size() && batch->frames[nframe].start < sync)
+          nframe++;
+        if (nframe == batch->frames.size() || batch->frames[nframe].start != sync)
+        {
+          decodeChunk(sync, end, redo);
+          std::swap(*batch, redo);
+          nframe = 0;
+        }
+      }
+      // The next frame is past this chunk, or the end of file was reached
+      else if (nchunk > 0)
+      {
+        nframe = batch->frames.size();
+      }
+
+      // Count and write the frames as processEvent does
+      for (; nframe < batch->frames.size() && nevent != numEvents; nframe++)
+      {
+        const FrameRecord& record = batch->frames[nframe];
+        _totalFrames++;
+
+        if (record.number == lastFrameNumber + 1)
+          consecCount++;
+        else
+          consecCount = 0;
+        lastFrameNumber = record.number;
+        _frame.consecCount = consecCount;
+
+        // As in processFile, a failed write is counted and the file goes on
+        if (record.triggerFlag)
+        {
+          try
+          {
+            writeRecord(record, *batch);
+          }
+          catch (const char* e)
+          {
+            cout << e << endl;
+            _possibleDesync++;
+          }
+        }
+
+        if (record.errHeader) _errHeader++;
+        if (record.errHits) _errHits++;
+        if (record.errSum) _errSum++;
+        if (record.errSync) _errSync++;
+        if (record.errOffset) _errOffset++;
+
+        // A triggered frame ends an event, the next one starts counting again
+        if (record.triggerFlag)
+        {
+          printProgress(nevent, numEvents);
+          nevent++;
+          consecCount = 0;
+          lastFrameNumber = 0;
+        }
+      }
+
+      if (nchunk == 0 || (sync != _noFrame && sync < end))
+        sync = batch->nextSync;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      ready[nchunk] = 0;
+      spare.push_back(batch);
+      written = nchunk + 1;
+      if (nevent == numEvents || (_queue && _queue->isClosed())) stop = true;
+      cond.notify_all();
+      if (stop) break;
+    }
+  }
+  catch (...)
+  {
+    stopWorkers();
+    throw;
   }
+  stopWorkers();
+
+  _eofReached = nevent != numEvents;
+  _buffPos = _buffLength;
+  cout << endl;
+
+  printSummary(numEvents);
 
   return 0;
 }
@@ -576,31 +982,22 @@ int KartelConvert::streamOutput(unsigned int nlines)
 
   for (unsigned int i = 0; i < nlines; i++)
   {
-    Word sync = 0;
-    Word offset = 0;
-    Word ch0[_numPlanes] = { 0 };
-    Word ch1[_numPlanes] = { 0 };
-
     // Read one line of words from the raw data, and map the bits to the output variables
-    for (unsigned int nbit = 0; nbit < _lineLength; nbit++)
+    Word words[_lineLength];
+    for (unsigned int nword = 0; nword < _lineLength; nword++)
     {
       if (readNextWord()) return -1;
-
-      if (checkBit(_word, _bitMap.sync)) setBit(sync, nbit);
-      if (checkBit(_word, _bitMap.triggerOffset)) setBit(offset, nbit);
-      for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
-      {
-        if (checkBit(_word, _bitMap.ch0[nplane])) setBit(ch0[nplane], nbit);
-        if (checkBit(_word, _bitMap.ch1[nplane])) setBit(ch1[nplane], nbit);
-      }
+      words[nword] = _word;
     }
+    Word bits[_lineLength];
+    transposeBits(words, bits);
 
     // Output
-    printf("% 8d | ", offset);
-    printf("%4X | ", sync);
+    printf("% 8d | ", bits[TRIGGER_OFFSET_BIT]);
+    printf("%4X | ", bits[SYNC_BIT]);
     for (unsigned int nplane = 0; nplane < _numPlanes; nplane++) {
-      printf("%4X | ", ch0[nplane]);
-      printf("%4X | ", ch1[nplane]);
+      printf("%4X | ", bits[CH0_BITS[nplane]]);
+      printf("%4X | ", bits[CH1_BITS[nplane]]);
     }
     printf("\n");
   }
@@ -608,45 +1005,111 @@ int KartelConvert::streamOutput(unsigned int nlines)
   return 0;
 }
 
+ULong64_t KartelConvert::benchDecoder(Long64_t numLines)
+{
+  // The mapped file is decoded in place, a stream is read in first
+  std::vector<Word> streamed;
+  const Word* words = _buffer;
+  size_t numWords = _buffLength;
+  if (!_mapped)
+  {
+    while ((numLines < 0 || streamed.size() < (size_t)numLines * _lineLength) &&
+           !readNextWord())
+      streamed.push_back(_word);
+    words = streamed.empty() ? 0 : &streamed[0];
+    numWords = streamed.size();
+  }
+
+  size_t nlines = numWords / _lineLength;
+  if (numLines >= 0 && nlines > (size_t)numLines) nlines = numLines;
+
+  // Lines are decoded as if they were in a frame of four, so that the trigger
+  // and time stamp bits are read
+  ULong64_t mismatches = 0;
+  for (size_t nline = 0; nline < nlines; nline++)
+  {
+    const Word* line = words + nline * _lineLength;
+    LineBuffer expected;
+    LineBuffer decoded;
+    ULong64_t expectedStamp = 0;
+    ULong64_t decodedStamp = 0;
+    decodeLineBitwise(line, expected, nline % 4, expectedStamp);
+
+    decodeLine<transposeBits>(line, decoded, nline % 4, decodedStamp);
+    bool same = !memcmp(&expected, &decoded, sizeof(LineBuffer)) &&
+                expectedStamp == decodedStamp;
+
+    decodedStamp = 0;
+    decodeLine<transposeBitsScalar>(line, decoded, nline % 4, decodedStamp);
+    same = same && !memcmp(&expected, &decoded, sizeof(LineBuffer)) &&
+           expectedStamp == decodedStamp;
+
+    if (!same) mismatches++;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  const char* names[3] = { "bitwise", "transpose (scalar)", "transpose" };
+
+  cout << "\nLine decoders over " << nlines << " lines:\n";
+  for (unsigned int ndecoder = 0; ndecoder < 3; ndecoder++)
+  {
+    // Fold the results so that the decoding can't be optimized away
+    Word checksum = 0;
+    const Clock::time_point start = Clock::now();
+    for (size_t nline = 0; nline < nlines; nline++)
+    {
+      const Word* line = words + nline * _lineLength;
+      LineBuffer decoded;
+      ULong64_t stamp = 0;
+      if (ndecoder == 0)
+        decodeLineBitwise(line, decoded, nline % 4, stamp);
+      else if (ndecoder == 1)
+        decodeLine<transposeBitsScalar>(line, decoded, nline % 4, stamp);
+      else
+        decodeLine<transposeBits>(line, decoded, nline % 4, stamp);
+      checksum ^= decoded.sync ^ decoded.ch0[nline % _numPlanes] ^ stamp;
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    cout << "  " << std::left;
+    cout.width(20);
+    cout << names[ndecoder] << std::right << " : "
+         << (seconds > 0 ? nlines / seconds / 1e6 : 0) << " Mlines/s, "
+         << (seconds > 0 ? nlines * _lineLength * sizeof(Word) / seconds / 1e6 : 0)
+         << " MB/s (" << checksum << ")\n";
+  }
+
+  cout << "  Mismatched lines     : " << mismatches << endl;
+
+  return mismatches;
+}
+
 bool KartelConvert::fileGood() { return !_eofReached; }
 
 double KartelConvert::fileProgress()
 {
+  if (_mapped) return (double)_buffPos / _buffLength;
   fstream::pos_type current = _kartelInput.tellg();
   return (double)current / _endPos;
 }
 
 KartelConvert::KartelConvert(const char* fileName, const char* outputName,
-                             const Mechanics::Device* device) :
+                             const Mechanics::Device* device, double followTimeout) :
+  _queue(0),
   _device(device),
+  _streamWords(0),
+  _followTimeout(followTimeout),
   _ncols(1152),
   _nrows(576),
-  _lineLength(8 * sizeof(Word)),
   _footer(0xAAAA),
   _sync(0xF),
   _header(0x8001)
 {
-  // Bytes get swaped by firmware, this is a temporary fix until the firmware is improved
-
-  // Offset the given position by 8 (wrap around if higher)
-  _bitMap.sync = 0; _bitMap.sync = _bitMap.sync + 8 - 16 * (_bitMap.sync > 7);
-  _bitMap.trigger = 15; _bitMap.trigger = _bitMap.trigger + 8 - 16 * (_bitMap.trigger > 7);
-  _bitMap.triggerOffset = 12; _bitMap.triggerOffset = _bitMap.triggerOffset + 8 - 16 * (_bitMap.triggerOffset > 7);
-  _bitMap.timeStamp = 3; _bitMap.timeStamp = _bitMap.timeStamp + 8 - 16 * (_bitMap.timeStamp > 7);
-  _bitMap.ch0[0] = 5; _bitMap.ch0[0] = _bitMap.ch0[0] + 8 - 16 * (_bitMap.ch0[0] > 7);
-  _bitMap.ch1[0] = 6; _bitMap.ch1[0] = _bitMap.ch1[0] + 8 - 16 * (_bitMap.ch1[0] > 7);
-  _bitMap.ch0[1] = 1; _bitMap.ch0[1] = _bitMap.ch0[1] + 8 - 16 * (_bitMap.ch0[1] > 7);
-  _bitMap.ch1[1] = 2; _bitMap.ch1[1] = _bitMap.ch1[1] + 8 - 16 * (_bitMap.ch1[1] > 7);
-  _bitMap.ch0[2] = 9; _bitMap.ch0[2] = _bitMap.ch0[2] + 8 - 16 * (_bitMap.ch0[2] > 7);
-  _bitMap.ch1[2] = 10; _bitMap.ch1[2] = _bitMap.ch1[2] + 8 - 16 * (_bitMap.ch1[2] > 7);
-  _bitMap.ch0[3] = 4; _bitMap.ch0[3] = _bitMap.ch0[3] + 8 - 16 * (_bitMap.ch0[3] > 7);
-  _bitMap.ch1[3] = 8; _bitMap.ch1[3] = _bitMap.ch1[3] + 8 - 16 * (_bitMap.ch1[3] > 7);
-  _bitMap.ch0[4] = 13; _bitMap.ch0[4] = _bitMap.ch0[4] + 8 - 16 * (_bitMap.ch0[4] > 7);
-  _bitMap.ch1[4] = 14; _bitMap.ch1[4] = _bitMap.ch1[4] + 8 - 16 * (_bitMap.ch1[4] > 7);
-  _bitMap.ch0[5] = 7; _bitMap.ch0[5] = _bitMap.ch0[5] + 8 - 16 * (_bitMap.ch0[5] > 7);
-  _bitMap.ch1[5] = 11; _bitMap.ch1[5] = _bitMap.ch1[5] + 8 - 16 * (_bitMap.ch1[5] > 7);
-
   _word = 0;
+  _mapped = 0;
+  _mappedSize = 0;
+  _buffer = _fileBuffer;
   _buffLength = 0;
   _buffPos = 0;
 
@@ -664,12 +1127,17 @@ KartelConvert::KartelConvert(const char* fileName, const char* outputName,
   if (_device && _device->getNumSensors() != _numPlanes)
     throw "KartelConvert: provided device doesn't have the correct number of planes";
 
-  // Open the specified file
-  _kartelInput.open(fileName, std::ios::in | std::ios::binary);
-
  const unsigned int treeMask = Storage::Flags::CLUSTERS | Storage::Flags::TRACKS;
-  _storage = new Storage::StorageIO(outputName, Storage::OUTPUT, _numPlanes,
-                                    treeMask);
+  // Without an output, the input can only be decoded (see benchDecoder)
+  _storage = 0;
+  if (outputName && strlen(outputName))
+    _storage = new Storage::StorageIO(outputName, Storage::OUTPUT, _numPlanes,
+                                      treeMask);
+
+  // Open the specified file, through the stream if it can't be mapped. A
+  // followed file is streamed, the mapping can't grow with it.
+  if (_followTimeout > 0 || !mapInput(fileName))
+    _kartelInput.open(fileName, std::ios::in | std::ios::binary);
 
   _eofReached = false;
   // Can't use this anymore due to unsafe handling of large files (64 bit seek)
@@ -678,12 +1146,36 @@ KartelConvert::KartelConvert(const char* fileName, const char* outputName,
   //end_pos = raw_input.tellg();
   //raw_input.seekg(start);
 
-  if (!_kartelInput.is_open()) _eofReached = true;
+  if (!_mapped && !_kartelInput.is_open()) _eofReached = true;
+}
+
+KartelConvert::KartelConvert(const KartelConvert& source) :
+  _storage(0),
+  _queue(0),
+  _device(source._device),
+  _mapped(0), // Not owned
+  _mappedSize(0),
+  _buffer(source._buffer),
+  _buffLength(source._buffLength),
+  _buffPos(0),
+  _streamWords(0),
+  _followTimeout(0),
+  _ncols(source._ncols),
+  _nrows(source._nrows),
+  _footer(source._footer),
+  _sync(source._sync),
+  _header(source._header),
+  _eofReached(false),
+  _word(0)
+{
+  assert(source._mapped && "KartelConvert: decoders need a mapped input");
+  clearFrame();
 }
 
 KartelConvert::~KartelConvert()
 {
   // Close if there is an open file
+  if (_mapped) munmap(_mapped, _mappedSize);
   if (_kartelInput.is_open()) _kartelInput.close();
   if (_storage) delete _storage;
 }
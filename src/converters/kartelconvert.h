@@ -14,6 +14,8 @@ namespace Mechanics { class Device; }
 
 namespace Converters {
 
+class EventQueue;
+
 /*******************************************************************************
  * Word in the memory-|
  *                    |
@@ -40,6 +42,9 @@ private:
   static const unsigned int _numPlanes = 6;
   static const unsigned int _buffSize = 4096;
   static const unsigned int _clock = 9216;
+  static const size_t _chunkWords = 1 << 22; // Words decoded per parallel task
+  static const size_t _noFrame = ~(size_t)0;
+  static const unsigned int _followPoll = 100; // Milliseconds between checks for growth
 
   struct Hit {
     unsigned int x;
@@ -68,14 +73,27 @@ private:
     bool errSum;    // Checksum error
   };
 
-  // Gives the bit position within a line of words for the various information
-  struct BitPos {
-    unsigned int sync;
-    unsigned int trigger;
+  // A frame decoded ahead by a parallel worker, with all that is needed to
+  // count and write it in order. Its hits are in the batch's hit list.
+  struct FrameRecord {
+    size_t start; // Position of the frame's first word
+    unsigned int number;
+    unsigned int triggerFlag;
     unsigned int triggerOffset;
-    unsigned int timeStamp;
-    unsigned int ch0[_numPlanes];
-    unsigned int ch1[_numPlanes];
+    size_t planeHits[_numPlanes + 1]; // Each plane's hits, up to the next's
+    bool invalid;
+    bool errHeader;
+    bool errSync;
+    bool errOffset;
+    bool errHits;
+    bool errSum;
+  };
+
+  // The frames starting in one chunk of the file
+  struct FrameBatch {
+    std::vector<FrameRecord> frames;
+    std::vector<Hit> hits;
+    size_t nextSync; // Start of the frame after the batch, _noFrame at EOF
   };
 
   // Contains information for one line of words in the stream
@@ -90,16 +108,28 @@ private:
   // The inputs and outputs
   std::fstream _kartelInput;
   Storage::StorageIO* _storage;
+  EventQueue* _queue; // Takes the events instead of the storage, if set
   const Mechanics::Device* _device;
 
-  // Buffer for the input
-  unsigned int _buffLength;
-  unsigned int _buffPos; // The position of the current word in the buffer
+  // Regular files are mapped and decoded in place, otherwise (e.g. a pipe)
+  // they are read through the stream into the file buffer
+  void* _mapped;
+  size_t _mappedSize; // In bytes
+
+  // Buffer for the input, either the mapped file or the file buffer
+  const Word* _buffer;
+  size_t _buffLength; // Number of words in the buffer
+  size_t _buffPos; // The position of the current word in the buffer
   Word _fileBuffer[_buffSize];
+  ULong64_t _streamWords; // Words read through the stream before the buffer
+
+  // When following a file being written, waits this long for it to grow
+  // before reaching its end (0 if not following)
+  double _followTimeout;
 
   const unsigned int _ncols;
   const unsigned int _nrows;
-  const unsigned int _lineLength; // Number of words to make one line
+  static const unsigned int _lineLength = 8 * sizeof(Word); // Number of words to make one line
   const Word _footer;    // The signal to terminate the hits read from a plane
   const Word _sync;   // The value of the word read from the synch bit positions
   const Word _header; // The value of the headers before hit information
@@ -107,16 +137,24 @@ private:
   bool _eofReached;
   std::fstream::pos_type _endPos;
 
-  BitPos      _bitMap; // Position of bits holding information for the various stream components
   LineBuffer  _line;   // Stores the value of the stream components read in one line
   Word        _word;   // Holds one word read from the raw data
   FrameBuffer _frame;  // Variable to hold the parsed stream information
 
+  bool mapInput(const char* fileName);
   void fillBuffer();
-  inline bool checkBit(Word checkWord, unsigned int pos);
-  inline void setBit(Word& setWord, unsigned int pos);
-  int readNextWord();
-  void clearLineBuffer();
+  static inline bool checkBit(Word checkWord, unsigned int pos);
+  static inline void setBit(Word& setWord, unsigned int pos);
+  inline int readNextWord();
+  ULong64_t inputPosition() const;
+  // Map the bits of a line's words to the stream components, with the given
+  // 16x16 bit transpose (see bittranspose.h)
+  template <void (*Transpose)(const unsigned short*, unsigned short*)>
+  static void decodeLine(const Word* words, LineBuffer& line,
+                         unsigned int lineCount, ULong64_t& timeStamp);
+  // The same, one bit at a time, used to check the above
+  static void decodeLineBitwise(const Word* words, LineBuffer& line,
+                                unsigned int lineCount, ULong64_t& timeStamp);
   int readNextLine();
   void clearFrame();
   int findNextSync();
@@ -126,6 +164,15 @@ private:
   int readHits();
   int readFrameInfo();
   void writeFrame(bool invalid = false);
+  void decodeChunk(size_t begin, size_t end, FrameBatch& batch);
+  void writeRecord(const FrameRecord& record, const FrameBatch& batch);
+  void clearCounters();
+  void printProgress(Long64_t nevent, Long64_t numEvents);
+  void printSummary(Long64_t numEvents);
+
+  // Decoder for a parallel worker, reading the file mapped by `source`
+  KartelConvert(const KartelConvert& source);
+  KartelConvert& operator=(const KartelConvert&); // Disable the assignment operator
 
 public:
   ULong64_t _errHeader;
@@ -139,13 +186,30 @@ public:
   ULong64_t _totalFrames;
   ULong64_t _possibleDesync;
 
+  // With a positive `followTimeout`, the input is followed as it is written
+  // (like tail -f): the end of the file is reached only once it hasn't grown
+  // for that many seconds.
   KartelConvert(const char* inputName, const char* outputName,
-                const Mechanics::Device* device = 0);
+                const Mechanics::Device* device = 0, double followTimeout = 0);
   ~KartelConvert();
 
+  // Hand the events to a queue rather than writing them (the converter can
+  // then be made without an output). Conversion stops if the queue is closed.
+  void setQueue(EventQueue* queue) { _queue = queue; }
+  // Continue from a byte offset in the input, e.g. a queued event's position
+  // (the end of its frame) saved from an earlier pass
+  void resumeAt(ULong64_t offset);
+
   int processEvent(bool discard = false);
   int processFile(Long64_t numEvents = -1);
+  // Decode chunks of the file on `numThreads` threads, writing the events in
+  // the same order as `processFile`. Falls back to it with fewer than two
+  // threads, or if the input isn't mapped (e.g. a pipe).
+  int processFileParallel(Long64_t numEvents = -1, unsigned int numThreads = 2);
   int streamOutput(unsigned int nlines);
+  // Decode the input's lines with each line decoder, checking that they agree,
+  // and print their rates. Returns the number of lines which differ.
+  ULong64_t benchDecoder(Long64_t numLines = -1);
   bool fileGood();
   double fileProgress();
 };
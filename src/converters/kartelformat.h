@@ -0,0 +1,27 @@
+#ifndef KARTELFORMAT_H
+#define KARTELFORMAT_H
+
+namespace Converters {
+
+/* Layout of the Kartel raw stream, shared by the converter and the generator
+ * of synthetic streams.
+ *
+ * Position of the bits holding the various stream components, in each word
+ * of a line. The bytes of the words get swapped by the firmware, which moves
+ * the positions by 8 (wrapping around), and this is accounted for here. */
+namespace KartelFormat {
+
+const unsigned int SYNC_BIT = (0 + 8) % 16;
+const unsigned int TRIGGER_BIT = (15 + 8) % 16;
+const unsigned int TRIGGER_OFFSET_BIT = (12 + 8) % 16;
+const unsigned int TIME_STAMP_BIT = (3 + 8) % 16;
+const unsigned int CH0_BITS[] = { (5 + 8) % 16, (1 + 8) % 16, (9 + 8) % 16,
+                                  (4 + 8) % 16, (13 + 8) % 16, (7 + 8) % 16 };
+const unsigned int CH1_BITS[] = { (6 + 8) % 16, (2 + 8) % 16, (10 + 8) % 16,
+                                  (8 + 8) % 16, (14 + 8) % 16, (11 + 8) % 16 };
+
+}
+
+}
+
+#endif // KARTELFORMAT_H
@@ -0,0 +1,243 @@
+#include "kartelgenerator.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "bittranspose.h"
+#include "kartelformat.h"
+
+using std::cout;
+using std::endl;
+
+namespace Converters {
+
+using namespace KartelFormat;
+
+void KartelGenerator::setActivePlanes(unsigned int value)
+{
+  if (value > _numPlanes)
+    throw "KartelGenerator: the stream has at most 6 planes";
+  _activePlanes = value;
+}
+
+/* Add a line to the stream, the opposite of KartelConvert::decodeLine: each
+ * component is one bit in each of the line's words. The transpose undoes
+ * itself, so the same one is used. */
+void KartelGenerator::addLine(Word sync, Word triggerOffset, Word trigger,
+                              const Word* ch0, const Word* ch1)
+{
+  Word components[_lineLength] = { 0 };
+  components[SYNC_BIT] = sync;
+  components[TRIGGER_OFFSET_BIT] = triggerOffset;
+  components[TRIGGER_BIT] = trigger;
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    components[CH0_BITS[nplane]] = ch0[nplane];
+    components[CH1_BITS[nplane]] = ch1[nplane];
+  }
+
+  const size_t start = _words.size();
+  _words.resize(start + _lineLength);
+  transposeBits(components, &_words[start]);
+}
+
+/* Make the hit words of a plane: each row with hits is followed by the runs
+ * of columns hit in it (at most 15) */
+void KartelGenerator::encodeHits(unsigned int nplane, bool badHit)
+{
+  std::vector<Word>& words = _planeWords[nplane];
+  words.clear();
+  _runs.clear();
+
+  // Runs are 2.5 columns long on average
+  if (nplane < _activePlanes && _occupancy > 0)
+  {
+    std::poisson_distribution<unsigned int> numRuns(_occupancy / 2.5);
+    const unsigned int nruns = numRuns(_random);
+    for (unsigned int nrun = 0; nrun < nruns; nrun++)
+    {
+      Run run;
+      run.num = _random() % 4;
+      run.row = _random() % _nrows;
+      run.col = _random() % (_ncols - run.num);
+      _runs.push_back(run);
+      _numHits += run.num + 1;
+    }
+  }
+
+  // The row fits in 11 bits, past the sensor
+  if (badHit)
+  {
+    Run run;
+    run.num = 0;
+    run.row = _nrows + _random() % (0x0800 - _nrows);
+    run.col = _random() % _ncols;
+    _runs.push_back(run);
+  }
+
+  std::sort(_runs.begin(), _runs.end(), [](const Run& a, const Run& b) {
+    return a.row < b.row || (a.row == b.row && a.col < b.col); });
+
+  for (size_t begin = 0; begin < _runs.size(); )
+  {
+    size_t end = begin + 1;
+    while (end < _runs.size() && end - begin < 15 && _runs[end].row == _runs[begin].row)
+      end++;
+
+    words.push_back(_runs[begin].row << 4 | (end - begin));
+    for (size_t nrun = begin; nrun < end; nrun++)
+      words.push_back(_runs[nrun].col << 2 | _runs[nrun].num);
+
+    begin = end;
+  }
+
+  // The footer must start a line's channel 0, otherwise the converter ends the
+  // plane as soon as it sees it in channel 1. Pad with a row without columns.
+  if (words.size() % 2) words.push_back(0);
+}
+
+void KartelGenerator::addFrame(unsigned int number)
+{
+  std::uniform_real_distribution<double> uniform(0, 1);
+
+  const bool triggered = uniform(_random) < _triggerRate;
+
+  // The converter only reads the hits of triggered frames
+  Error error = NUM_ERRORS;
+  for (unsigned int nerror = 0; nerror < NUM_ERRORS; nerror++)
+  {
+    if (!triggered && (nerror == ERR_HITS || nerror == ERR_SUM)) continue;
+    if (uniform(_random) >= _errorRates[nerror]) continue;
+    error = (Error)nerror;
+    break;
+  }
+
+  _numFrames++;
+  if (triggered) _numTriggers++;
+  if (error != NUM_ERRORS)
+  {
+    _injected[error]++;
+    if (triggered) _numInvalid++;
+  }
+
+  Word ch0[_numPlanes];
+  Word ch1[_numPlanes];
+
+  // Sync, trigger and headers. The firmware shifts the offset by one bit.
+  Word triggerOffset = _random() % _clock;
+  if (error == ERR_OFFSET) triggerOffset = _clock + _random() % 1000;
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+    ch0[nplane] = ch1[nplane] = _header;
+  if (error == ERR_HEADER) ch0[_random() % _numPlanes] ^= 0x0002;
+  // Found as a sync, but not a full one
+  const Word sync = error == ERR_SYNC ? 0x7 : _sync;
+  addLine(sync, triggerOffset << 1, triggered ? 1 : 0, ch0, ch1);
+
+  // Frame number
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    ch0[nplane] = number & 0xFFFF;
+    ch1[nplane] = number >> 16;
+  }
+  addLine(0, 0, 0, ch0, ch1);
+
+  // Frame length, split over the channels
+  unsigned int numLines = 0;
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    encodeHits(nplane, error == ERR_HITS && nplane == 0);
+    const unsigned int length = _planeWords[nplane].size();
+    ch0[nplane] = length / 2;
+    ch1[nplane] = length - length / 2;
+    numLines = std::max(numLines, length / 2 + 1);
+  }
+  if (error == ERR_SUM) ch1[0]++;
+  addLine(0, 0, 0, ch0, ch1);
+
+  // Hits, two words per plane in each line, then the footer
+  for (unsigned int nline = 0; nline < numLines; nline++)
+  {
+    for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+    {
+      const std::vector<Word>& words = _planeWords[nplane];
+      if (2 * nline < words.size())
+      {
+        ch0[nplane] = words[2 * nline];
+        ch1[nplane] = words[2 * nline + 1];
+      }
+      else
+      {
+        ch0[nplane] = 2 * nline == words.size() ? _footer : 0;
+        ch1[nplane] = ch0[nplane];
+      }
+    }
+    addLine(0, 0, 0, ch0, ch1);
+  }
+}
+
+void KartelGenerator::generate(const char* fileName, ULong64_t numFrames)
+{
+  std::ofstream output(fileName, std::ios::out | std::ios::binary);
+  if (!output.is_open()) throw "KartelGenerator: unable to open output file";
+
+  _numFrames = 0;
+  _numTriggers = 0;
+  _numInvalid = 0;
+  _numHits = 0;
+  _numBytes = 0;
+  for (unsigned int nerror = 0; nerror < NUM_ERRORS; nerror++)
+    _injected[nerror] = 0;
+
+  // Frame numbers are 32 bit, and start at 1
+  for (ULong64_t nframe = 0; nframe < numFrames; nframe++)
+  {
+    addFrame((unsigned int)(nframe + 1));
+
+    // Write in large blocks
+    if (_words.size() >= (1 << 20) || nframe + 1 == numFrames)
+    {
+      output.write((const char*)&_words[0], _words.size() * sizeof(Word));
+      _numBytes += _words.size() * sizeof(Word);
+      _words.clear();
+    }
+  }
+
+  if (!output.good()) throw "KartelGenerator: failed to write the output file";
+}
+
+void KartelGenerator::print() const
+{
+  cout << "\nGenerated stream:\n"
+       << "  Frames    : " << _numFrames << "\n"
+       << "  Triggers  : " << _numTriggers << "\n"
+       << "  Invalids  : " << _numInvalid << "\n"
+       << "  Hits      : " << _numHits << "\n"
+       << "  Bytes     : " << _numBytes << "\n"
+       << "Injected errors:\n"
+       << "  Header : " << _injected[ERR_HEADER] << "\n"
+       << "  Sync   : " << _injected[ERR_SYNC] << "\n"
+       << "  Offset : " << _injected[ERR_OFFSET] << "\n"
+       << "  Hits   : " << _injected[ERR_HITS] << "\n"
+       << "  Sum    : " << _injected[ERR_SUM] << endl;
+}
+
+KartelGenerator::KartelGenerator() :
+  _activePlanes(_numPlanes),
+  _occupancy(20),
+  _triggerRate(0.5),
+  _random(1),
+  _numFrames(0),
+  _numTriggers(0),
+  _numInvalid(0),
+  _numHits(0),
+  _numBytes(0)
+{
+  for (unsigned int nerror = 0; nerror < NUM_ERRORS; nerror++)
+  {
+    _errorRates[nerror] = 0;
+    _injected[nerror] = 0;
+  }
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef KARTELGENERATOR_H
+#define KARTELGENERATOR_H
+
+#include <vector>
+#include <random>
+
+#include <Rtypes.h>
+
+namespace Converters {
+
+/* Writes synthetic Kartel raw streams, to exercise and time KartelConvert
+ * without detector data. The frames follow the layout the converter expects
+ * (see kartelformat.h and KartelConvert::readFrameInfo): a line with the
+ * sync, trigger and headers, a line with the frame number, a line with the
+ * frame length, then the hit words of each plane up to its footer.
+ *
+ * Frames can be corrupted with each of the errors counted by the converter.
+ * A frame gets at most one error, and hit and checksum errors are only put
+ * in triggered frames, since the converter only reads the hits of those. So
+ * the converter's counters should match what was injected. */
+class KartelGenerator
+{
+public:
+  typedef unsigned short Word;
+
+  enum Error {
+    ERR_HEADER = 0, // Incorrect header
+    ERR_SYNC,       // Incomplete sync signal
+    ERR_OFFSET,     // Trigger offset past the clock cycles
+    ERR_HITS,       // Hit outside the sensor
+    ERR_SUM,        // Frame length not matching the hits
+    NUM_ERRORS
+  };
+
+private:
+  static const unsigned int _numPlanes = 6; // Read out by the converter
+  static const unsigned int _lineLength = 8 * sizeof(Word);
+  static const unsigned int _clock = 9216;
+  static const unsigned int _ncols = 1152;
+  static const unsigned int _nrows = 576;
+  static const Word _footer = 0xAAAA;
+  static const Word _sync = 0xF;
+  static const Word _header = 0x8001;
+
+  // A hit in the stream: a row, and a run of consecutive columns
+  struct Run {
+    unsigned int row;
+    unsigned int col;
+    unsigned int num; // Columns after the first one, up to 3
+  };
+
+  unsigned int _activePlanes; // Planes past these are read out empty
+  double _occupancy;          // Mean number of hits per active plane and frame
+  double _triggerRate;        // Fraction of frames which are triggered
+  double _errorRates[NUM_ERRORS];
+  std::mt19937 _random;
+
+  std::vector<Word> _words; // Words of the frames not yet written
+  std::vector<Run> _runs;
+  std::vector<Word> _planeWords[_numPlanes];
+
+  ULong64_t _numFrames;
+  ULong64_t _numTriggers;
+  ULong64_t _numInvalid; // Triggered frames with an error
+  ULong64_t _numHits;
+  ULong64_t _numBytes;
+  ULong64_t _injected[NUM_ERRORS];
+
+  void addLine(Word sync, Word triggerOffset, Word trigger,
+               const Word* ch0, const Word* ch1);
+  void encodeHits(unsigned int nplane, bool badHit);
+  void addFrame(unsigned int number);
+
+public:
+  KartelGenerator();
+
+  void setSeed(unsigned int seed) { _random.seed(seed); }
+  void setActivePlanes(unsigned int value);
+  void setOccupancy(double value) { _occupancy = value; }
+  void setTriggerRate(double value) { _triggerRate = value; }
+  void setErrorRate(Error error, double value) { _errorRates[error] = value; }
+
+  // Write `numFrames` frames to a new file
+  void generate(const char* fileName, ULong64_t numFrames);
+
+  ULong64_t getNumFrames() const { return _numFrames; }
+  ULong64_t getNumTriggers() const { return _numTriggers; }
+  ULong64_t getNumInvalid() const { return _numInvalid; }
+  ULong64_t getNumBytes() const { return _numBytes; }
+  ULong64_t getInjected(Error error) const { return _injected[error]; }
+
+  void print() const;
+};
+
+}
+
+#endif // KARTELGENERATOR_H
@@ -20,7 +20,11 @@ InputArgs::InputArgs() :
   _numEvents(0),
   _eventOffset(0),
   _synchroEventsOffset(1),  
-  _noBar(false)
+  _noBar(false),
+  _recycle(false),
+  _useIndex(false),
+  _numThreads(0),
+  _refresh(0)
 { }
 
 void InputArgs::usage()
@@ -31,7 +35,17 @@ void InputArgs::usage()
   const unsigned int w1 = 16;
   cout << "\nCommands (required arguments, [optional arguments]):\n";
   cout << setw(w1) << "  convert"
-       << " : convert KarTel data (-i, -o, [-r, -n])\n";
+       << " : convert KarTel data (-i, -o, [-r, -n, -j])\n";
+  cout << setw(w1) << "  convertProcess"
+       << " : convert and process KarTel data (-i, -o, -r, -t, [-n, -j])\n";
+  cout << setw(w1) << "  follow"
+       << " : monitor KarTel data as it is written (-i, -r, -t, -R, [-n, -u])\n";
+  cout << setw(w1) << "  generateKartel"
+       << " : write a synthetic KarTel stream (-o, [-n, -t])\n";
+  cout << setw(w1) << "  benchKartel"
+       << " : time the conversion of a synthetic stream (-o, [-n, -t, -j])\n";
+  cout << setw(w1) << "  benchConvert"
+       << " : time the KarTel line decoders (-i, [-n])\n";
   cout << setw(w1) << "  synchronize"
        << " : synchronize DUT and ref. files (-i, -o, -I, -O, -r, -d, -t, [-n, -s])\n";
   cout << setw(w1) << "  noiseScan"
@@ -54,6 +68,8 @@ void InputArgs::usage()
        << " : analyze device events (-i, -r, -t, -R, [-n, -s])\n";
   cout << setw(w1) << "  analysisDUT"
        << " : analyze DUT events with ref. data (-i, -I, -r, -d, -t, -R, [-n, -s])\n";
+  cout << setw(w1) << "  index"
+       << " : write the event index used by -x next to the input (-i)\n";
   cout << endl;
 
   const unsigned int w2 = 13;
@@ -74,6 +90,11 @@ void InputArgs::usage()
 
   cout << "Additional options:\n";
   cout << "  -b  " << setw(w2) << "--noBar" << " : do not print the progress bar\n";
+  cout << "  -e  " << setw(w2) << "--recycle" << " : re-use event memory between reads\n";
+  cout << "  -x  " << setw(w2) << "--useIndex" << " : skip events rejected by event cuts using the input index,\n"
+       << "      " << setw(w2) << "" << "   and write an index next to the output files\n";
+  cout << "  -j  " << setw(w2) << "--threads" << " : number of threads to convert with\n";
+  cout << "  -u  " << setw(w2) << "--refresh" << " : seconds between updates of followed results\n";
   cout << endl;
 
   cout << right;
@@ -170,6 +191,30 @@ void InputArgs::parseArgs(int* argc, char** argv)
         _noBar = true;
         cout << setw(w) << "  noBar" << " : true" << endl;
       }
+      else if ( (!arg.compare("-e") || !arg.compare("--recycle")) &&
+                !_recycle)
+      {
+        _recycle = true;
+        cout << setw(w) << "  recycle" << " : true" << endl;
+      }
+      else if ( (!arg.compare("-x") || !arg.compare("--useIndex")) &&
+                !_useIndex)
+      {
+        _useIndex = true;
+        cout << setw(w) << "  useIndex" << " : true" << endl;
+      }
+      else if ( (!arg.compare("-j") || !arg.compare("--threads")) &&
+                !_numThreads)
+      {
+        _numThreads = atoi( argv[++i] );
+        cout << setw(w) << "  threads" << " : " << _numThreads << endl;
+      }
+      else if ( (!arg.compare("-u") || !arg.compare("--refresh")) &&
+                !_refresh)
+      {
+        _refresh = atoi( argv[++i] );
+        cout << setw(w) << "  refresh" << " : " << _refresh << endl;
+      }
       else if ( (!arg.compare("-h")) || !arg.compare("--help"))
       {
         usage();
@@ -199,3 +244,7 @@ ULong64_t InputArgs::getNumEvents() const { return _numEvents; }
 ULong64_t InputArgs::getEventOffset() const { return _eventOffset; }
 Long64_t InputArgs::getSynchroEventsOffset() const { return _synchroEventsOffset; }
 bool InputArgs::getNoBar() const { return _noBar; }
+bool InputArgs::getRecycle() const { return _recycle; }
+bool InputArgs::getUseIndex() const { return _useIndex; }
+unsigned int InputArgs::getNumThreads() const { return _numThreads; }
+unsigned int InputArgs::getRefresh() const { return _refresh; }
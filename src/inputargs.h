@@ -19,6 +19,10 @@ private:
   ULong64_t _eventOffset;
   Long64_t _synchroEventsOffset;  
   bool _noBar;
+  bool _recycle;
+  bool _useIndex;
+  unsigned int _numThreads;
+  unsigned int _refresh;
 
 public:
   InputArgs();
@@ -39,6 +43,10 @@ public:
   ULong64_t getEventOffset() const;
   Long64_t getSynchroEventsOffset() const;  
   bool getNoBar() const;
+  bool getRecycle() const;
+  bool getUseIndex() const;
+  unsigned int getNumThreads() const;
+  unsigned int getRefresh() const;
 };
 
 #endif // INPUTARGS_H
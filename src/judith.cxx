@@ -5,12 +5,23 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <memory>
+#include <cstdio>
+#include <stdlib.h>
 
 #include <TApplication.h>
 
 #include "options.h"
 #include "storage/storagei.h"
 #include "storage/storageo.h"
+#include "storage/storagemapped.h"
+#include "storage/storagechain.h"
+#include "storage/event.h"
+#include "storage/hit.h"
 #include "mechanics/device.h"
 #include "mechanics/mechparsers.h"
 #include "processors/clustering.h"
@@ -28,6 +39,7 @@ void printHelp() {
   printf("\nArguments:\n");
   printf("  %2s %-15s %s\n", "-h", "--help", "Display this information");
   printf("  %2s %-15s %s\n", "-i", "--input", "Path to input file(s)");
+  printf("  %2s %-15s %s\n", "", "", "(a,b,... or a pattern chains the files of one run)");
   printf("  %2s %-15s %s\n", "-o", "--output", "Path to output file");
   printf("  %2s %-15s %s\n", "-s", "--settings", "Path to settings file (default: configs/settings.cfg)");
   printf("  %2s %-15s %s\n", "-r", "--results", "Path to results file");
@@ -37,11 +49,21 @@ void printHelp() {
   printf("  %2s %-15s %s\n", "-k", "--skip", "Skip this many events at each loop iteration");
   printf("  %2s %-15s %s\n", "", "--progress", "Display progress at this interval (0 is off)");
   printf("  %2s %-15s %s\n", "", "--draw", "Give visual feedback when availalbe (e.g. fits)");
+  printf("  %2s %-15s %s\n", "", "--prefetch", "Decode this many events ahead on a background thread");
+  printf("  %2s %-15s %s\n", "", "--write-queue", "Write this many events behind the loop on a background thread");
+  printf("  %2s %-15s %s\n", "", "--write-threads", "Compress the output with this many threads");
+  printf("  %2s %-15s %s\n", "", "--compression", "Output compression, e.g. lz4:4 (none, zlib, lzma, lz4, zstd)");
+  printf("  %2s %-15s %s\n", "", "--basket-size", "Output branch buffer size in bytes");
+  printf("  %2s %-15s %s\n", "", "--auto-flush", "Output entries between flushes (bytes if negative)");
+  printf("  %2s %-15s %s\n", "", "--stored-clusters", "align-corr: use the input's clusters, processed with the device's alignment");
 
   printf("\nCommands:\n");
   printf("  %-15s %s\n", "process", "Generate clusters and tracks from the given input");
   printf("  %-15s %s\n", "align-corr", "Align the sensors by plane correlations");
   printf("  %-15s %s\n", "align-tracks", "Align the sensors using track residuals");
+  printf("  %-15s %s\n", "to-mapped", "Convert a ROOT input to the memory mapped format");
+  printf("  %-15s %s\n", "from-mapped", "Convert a memory mapped input to the ROOT format");
+  printf("  %-15s %s\n", "bench-storage", "Time writing and reading the input, or random events, per compression");
   std::cout << std::endl;
 }
 
@@ -109,6 +131,148 @@ void maskPlanes(const Options& options, Mechanics::Devices& devices) {
   }
 }
 
+/** Open a ROOT or a memory mapped (.jmap) input, based on the extension.
+  * A list of ROOT files, or a pattern matching several, is chained. Hits in
+  * the pixels of the noise masks are removed, or only flagged if the input's
+  * clusters are read since they could be part of one. */
+Storage::EventInput* openInput(
+    const std::string& path,
+    int treeMask,
+    const std::vector<bool>* planeMask,
+    const std::vector<Storage::PixelMask>& noiseMasks =
+        std::vector<Storage::PixelMask>()) {
+  const Storage::StorageIO::MaskMode maskMode =
+      (treeMask & Storage::StorageIO::CLUSTERS) ?
+          Storage::StorageIO::REMOVE : Storage::StorageIO::PASSIVE;
+
+  const std::string ext = ".jmap";
+  if (path.size() > ext.size() &&
+      path.compare(path.size()-ext.size(), ext.size(), ext) == 0) {
+    if (!noiseMasks.empty())
+      std::cerr << "WARNING: noise masks aren't applied to mapped inputs"
+          << std::endl;
+    return new Storage::StorageMapped(path, treeMask, planeMask);
+  }
+
+  const std::vector<std::string> paths =
+      Storage::StorageChain::expandPaths(path);
+  if (paths.size() > 1) {
+    Storage::StorageChain* chain =
+        new Storage::StorageChain(paths, treeMask, planeMask);
+    chain->setNoiseMasks(noiseMasks, maskMode);
+    return chain;
+  }
+
+  Storage::StorageI* input =
+      new Storage::StorageI(paths.at(0), treeMask, planeMask);
+  input->setNoiseMasks(noiseMasks, maskMode);
+  return input;
+}
+
+/** Compression and buffering of the output trees, from the options */
+Storage::StorageO::Settings outputSettings(const Options& options) {
+  Storage::StorageO::Settings settings;
+  if (options.hasArg("compression"))
+    Storage::StorageO::parseCompression(
+        options.getValue("compression"), settings);
+  if (options.hasArg("basket-size"))
+    settings.basketSize = strToInt(options.getValue("basket-size"));
+  if (options.hasArg("auto-flush"))
+    settings.autoFlush = strToInt(options.getValue("auto-flush"));
+  return settings;
+}
+
+/** Write events to a file under each compression setting, and read them back,
+  * reporting the file size and throughputs. The events are read from the
+  * input if one is given, otherwise random hits are generated. */
+int benchStorage(const Options& options) {
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<std::string> specs = options.getValues("bench-compression");
+  if (specs.empty()) {
+    specs.push_back("none");
+    specs.push_back("zlib:1");
+    specs.push_back("zlib:6");
+    specs.push_back("lz4:4");
+    specs.push_back("lzma:6");
+  }
+
+  std::unique_ptr<Storage::EventInput> input;
+  if (options.hasArg("input"))
+    input.reset(openInput(options.getValue("input"), 0, 0));
+
+  Long64_t numEvents = input ? input->getNumEvents() : 10000;
+  if (options.hasArg("events"))
+    numEvents = std::min(numEvents, (Long64_t)strToInt(options.getValue("events")));
+  const size_t numPlanes = input ? input->getNumPlanes() : 6;
+  const std::string path =
+      options.hasArg("output") ? options.getValue("output") : "bench.root";
+
+  printf("%-10s %10s %12s %12s %12s %12s\n",
+      "setting", "size [MB]", "write MB/s", "write ev/s", "read MB/s", "read ev/s");
+
+  for (size_t i = 0; i < specs.size(); i++) {
+    Storage::StorageO::Settings settings = outputSettings(options);
+    Storage::StorageO::parseCompression(specs[i], settings);
+
+    // Same events for each setting
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> numHits(0, 40);
+    std::uniform_int_distribution<int> pixX(0, 1151);
+    std::uniform_int_distribution<int> pixY(0, 575);
+
+    // Only the time spent in the storage is counted, not that of reading the
+    // input or generating the events
+    Clock::duration writeTime(0);
+    Storage::StorageO* output = new Storage::StorageO(
+        path, numPlanes, Storage::StorageIO::NONE,
+        0, 0, 0, 0, "", settings);
+    for (Long64_t n = 0; n < numEvents; n++) {
+      Storage::Event* event = 0;
+      if (input) {
+        event = &input->readEvent(n);
+      } else {
+        event = &output->newEvent();
+        for (size_t nplane = 0; nplane < numPlanes; nplane++) {
+          const int num = numHits(random);
+          for (int nhit = 0; nhit < num; nhit++)
+            event->newHit(nplane).setPix(pixX(random), pixY(random));
+        }
+      }
+      const Clock::time_point start = Clock::now();
+      output->writeEvent(*event);
+      writeTime += Clock::now() - start;
+    }
+    Clock::time_point start = Clock::now();
+    delete output;  // Writes the file
+    writeTime += Clock::now() - start;
+
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    const double size = file.tellg() / 1048576.;
+
+    start = Clock::now();
+    {
+      Storage::StorageI reader(path);
+      for (Long64_t n = 0; n < reader.getNumEvents(); n++)
+        reader.readEvent(n);
+    }
+    const Clock::duration readTime = Clock::now() - start;
+
+    const double writeSec = std::chrono::duration<double>(writeTime).count();
+    const double readSec = std::chrono::duration<double>(readTime).count();
+    printf("%-10s %10.2f %12.1f %12.0f %12.1f %12.0f\n",
+        specs[i].c_str(),
+        size,
+        size / writeSec,
+        numEvents / writeSec,
+        size / readSec,
+        numEvents / readSec);
+  }
+
+  std::remove(path.c_str());
+  return 0;
+}
+
 void configureLooper(const Options& options, Loopers::Looper& looper) {
   // Configure a base `Looper` object from standard options
   if (options.hasArg("first"))
@@ -120,6 +284,25 @@ void configureLooper(const Options& options, Loopers::Looper& looper) {
   if (options.hasArg("progress"))
     looper.m_printInterval = strToInt(options.getValue("progress"));
   looper.m_draw = options.evalBoolArg("draw");
+  if (options.hasArg("prefetch"))
+    looper.m_prefetch = strToInt(options.getValue("prefetch"));
+}
+
+void configureClustering(const Options& options,
+                         Processors::Clustering& clustering) {
+  // Configure a `Clustering` object from the process-clusters options
+  if (options.hasArg("process-clusters-nrows"))
+    clustering.m_maxRows = strToInt(options.getValue("process-clusters-nrows"));
+  if (options.hasArg("process-clusters-ncols"))
+    clustering.m_maxCols = strToInt(options.getValue("process-clusters-ncols"));
+  if (options.hasArg("process-clusters-sweep"))
+    clustering.m_algorithm = options.evalBoolArg("process-clusters-sweep") ?
+        Processors::Clustering::SWEEP : Processors::Clustering::SCAN;
+  if (options.hasArg("process-clusters-dense"))
+    clustering.m_denseOccupancy =
+        strToFloat(options.getValue("process-clusters-dense"));
+  if (options.hasArg("process-clusters-threads"))
+    clustering.m_threads = strToInt(options.getValue("process-clusters-threads"));
 }
 
 int main(int argc, const char** argv) {
@@ -200,14 +383,41 @@ int main(int argc, const char** argv) {
     inHitsOff.insert("PosY");
     inHitsOff.insert("PosZ");
 
-    Storage::StorageI input(
-        options.getValue("input"),
+    // The input can be split across several files (comma separated list or
+    // pattern), which are processed as one run
+    Storage::StorageChain input(
+        Storage::StorageChain::expandPaths(options.getValue("input")),
         // Don't read back clusters and tracks since they are not used
         Storage::StorageIO::CLUSTERS | Storage::StorageIO::TRACKS,
         // Turn off reading masked sensors
         &devices[0].getSensorMask(),
         // Don't read hit global positions since they will be re-generated
         &inHitsOff);
+    // Drop the hits in noisy pixels before they are clustered
+    input.setNoiseMasks(devices[0].getNoiseMasks());
+
+    // Write only the clusters and tracks, as friends of the input's hits. The
+    // friend is keyed to the input entries, so these must match one to one.
+    std::string friendOf;
+    if (options.evalBoolArg("process-friend")) {
+      const std::vector<bool>& sensorMask = devices[0].getSensorMask();
+      // Removing noisy hits would also shift the hit entries
+      if (input.getNumSegments() != 1 ||
+          std::find(sensorMask.begin(), sensorMask.end(), true) != sensorMask.end() ||
+          !devices[0].getNoiseMasks().empty()) {
+        std::cerr << "ERROR: friend output needs a single input file, "
+            << "no masked sensors and no noise mask" << std::endl;
+        return -1;
+      }
+      // The friend is read from anywhere, so keep the input's full path
+      char* path = realpath(options.getValue("input").c_str(), 0);
+      if (!path) {
+        std::cerr << "ERROR: can't resolve the input path" << std::endl;
+        return -1;
+      }
+      friendOf = path;
+      free(path);
+    }
 
     int outTreeMask = 0;
 
@@ -217,11 +427,11 @@ int main(int argc, const char** argv) {
       outTreeMask |= Storage::StorageIO::TRACKS;
 
     // Match the active branches from the input to those in the output
-    if (input.isHitsBranchOff("Value")) {
+    if (input.getSegment().isHitsBranchOff("Value")) {
       hitBranchesOff.insert("Value");
       clusterBranchesOff.insert("Value");
     }
-    if (input.isHitsBranchOff("Timing")) {
+    if (input.getSegment().isHitsBranchOff("Timing")) {
       hitBranchesOff.insert("Timing");
       clusterBranchesOff.insert("Timing");
     }
@@ -233,14 +443,22 @@ int main(int argc, const char** argv) {
         &hitBranchesOff,
         &clusterBranchesOff,
         &trackBranchesOff,
-        &eventInfoBranchesOff);
-
-    // Build a clustering object from the options
-    Processors::Clustering clustering;
-    if (options.hasArg("process-clusters-nrows"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-nrows"));
-    if (options.hasArg("process-clusters-ncols"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-ncols"));
+        &eventInfoBranchesOff,
+        friendOf,
+        outputSettings(options));
+
+    // Write the events behind the loop, so that it waits on the output only
+    // when the queue is full
+    if (options.hasArg("write-queue"))
+      output.startWriter(
+          strToInt(options.getValue("write-queue")),
+          options.hasArg("write-threads") ?
+              strToInt(options.getValue("write-threads")) : 0);
+
+    // Build a clustering object from the options. The device's sensor sizes
+    // allow clustering dense planes in a bitmap.
+    Processors::Clustering clustering(devices[0]);
+    configureClustering(options, clustering);
 
     // Build an alignment object from the device
     Processors::Aligning aligning(devices[0]);
@@ -264,6 +482,14 @@ int main(int argc, const char** argv) {
     // Run the looper
     looper.loop();
     looper.finalize();
+    // Flush the queued events
+    output.stopWriter();
+
+    // Largest multiplicities the storage arrays were grown to hold
+    std::cout << "Most hits / clusters / tracks (per plane, per event): "
+        << input.getMaxHits() << " / "
+        << output.getMaxClusters() << " / "
+        << output.getMaxTracks() << std::endl;
   }
 
   /////////////////////////////////////////////////////////////////////////////
@@ -280,30 +506,38 @@ int main(int argc, const char** argv) {
       return -1;
     }
 
+    // Correlate the clusters already in processed inputs, whose positions
+    // are those of the device's current alignment
+    const bool storedClusters = options.evalBoolArg("stored-clusters");
+
     // Build the input storages for the devices to align
-    std::vector<Storage::StorageI*> inputs;
+    std::vector<Storage::EventInput*> inputs;
     for (size_t i = 0; i < inputNames.size(); i++) {
-      Storage::StorageI* input = new Storage::StorageI(
+      Storage::EventInput* input = openInput(
           inputNames[i],
-          // Don't read tracks or clusters, new clusters will be made
-          Storage::StorageIO::TRACKS | Storage::StorageIO::CLUSTERS,
-          &devices[i].getSensorMask());
+          // Don't read tracks, nor clusters unless they are used
+          storedClusters ?
+              (int)Storage::StorageIO::TRACKS :
+              Storage::StorageIO::TRACKS | Storage::StorageIO::CLUSTERS,
+          &devices[i].getSensorMask(),
+          devices[i].getNoiseMasks());
       inputs.push_back(input);
     }
 
     // Prepare a processing looper with the devices which it will align
     Loopers::LoopAlignCorr looper(inputs, devices.getVector());
 
-    Processors::Clustering clustering;
-    if (options.hasArg("process-clusters-nrows"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-nrows"));
-    if (options.hasArg("process-clusters-ncols"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-ncols"));
-    looper.addProcessor(clustering);
+    Processors::Clustering clustering(devices.getVector());
+    configureClustering(options, clustering);
 
     // Alignment also needs to compute the spatial positions of the clusters
     Processors::Aligning aligning(devices.getVector());
-    looper.addProcessor(aligning);
+
+    // Without processors, the residuals are read from event views
+    if (!storedClusters) {
+      looper.addProcessor(clustering);
+      looper.addProcessor(aligning);
+    }
 
     // Apply generic looping options to the looper
     configureLooper(options, looper);
@@ -317,7 +551,7 @@ int main(int argc, const char** argv) {
       Mechanics::writeAlignment(devices[i]);
 
     // Clear the inputs from memory
-    for (std::vector<Storage::StorageI*>::iterator it = inputs.begin();
+    for (std::vector<Storage::EventInput*>::iterator it = inputs.begin();
         it != inputs.end(); ++it)
       delete *it;
   }
@@ -341,12 +575,13 @@ int main(int argc, const char** argv) {
     }
 
     // Build the input storages for the devices to align
-    std::vector<Storage::StorageI*> inputs;
+    std::vector<Storage::EventInput*> inputs;
     for (size_t i = 0; i < inputNames.size(); i++) {
-      Storage::StorageI* input = new Storage::StorageI(
+      Storage::EventInput* input = openInput(
           inputNames[i],  // ith input file
           Storage::StorageIO::TRACKS | Storage::StorageIO::CLUSTERS,
-          &devices[i].getSensorMask());
+          &devices[i].getSensorMask(),
+          devices[i].getNoiseMasks());
       inputs.push_back(input);
     }
 
@@ -354,11 +589,8 @@ int main(int argc, const char** argv) {
     Loopers::LoopAlignTracks looper(inputs, devices.getVector());
 
     // Alignment needs clusters
-    Processors::Clustering clustering;
-    if (options.hasArg("process-clusters-nrows"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-nrows"));
-    if (options.hasArg("process-clusters-ncols"))
-      clustering.m_maxRows = strToInt(options.getValue("process-clusters-ncols"));
+    Processors::Clustering clustering(devices.getVector());
+    configureClustering(options, clustering);
     looper.addProcessor(clustering);
 
     // Need to align clusters to global coordinates
@@ -396,11 +628,45 @@ int main(int argc, const char** argv) {
       Mechanics::writeAlignment(devices[i]);
 
     // Clear the inputs from memory
-    for (std::vector<Storage::StorageI*>::iterator it = inputs.begin();
+    for (std::vector<Storage::EventInput*>::iterator it = inputs.begin();
         it != inputs.end(); ++it)
       delete *it;
   }
 
+  /////////////////////////////////////////////////////////////////////////////
+  // Format conversion
+
+  else if (command == "to-mapped" || command == "from-mapped") {
+    if (!options.hasArg("input") || !options.hasArg("output")) {
+      std::cerr << "ERROR: " << command << " requires an input and output"
+          << std::endl;
+      return -1;
+    }
+
+    if (command == "to-mapped") {
+      Storage::StorageI input(options.getValue("input"));
+      Storage::StorageMappedO output(
+          options.getValue("output"),
+          input.getNumPlanes());
+      for (Long64_t n = 0; n < input.getNumEvents(); n++)
+        output.writeEvent(input.readEvent(n));
+      output.close();
+    }
+
+    else {
+      Storage::StorageMapped input(options.getValue("input"));
+      Storage::StorageO output(
+          options.getValue("output"), input.getNumPlanes(),
+          Storage::StorageIO::NONE, 0, 0, 0, 0, "", outputSettings(options));
+      for (Long64_t n = 0; n < input.getNumEvents(); n++)
+        output.writeEvent(input.readEvent(n));
+    }
+  }
+
+  else if (command == "bench-storage") {
+    return benchStorage(options);
+  }
+
   else {
     std::cerr << "ERROR: unknown command " << command << std::endl;
     printHelp();
@@ -14,8 +14,17 @@ namespace Loopers {
 
 void Analysis::loop()
 {
+  enableRecycling();
+
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
   {
+    // Don't read events which all the analyzers' event cuts would reject
+    if (skipEvent(nevent))
+    {
+      progressBar(nevent);
+      continue;
+    }
+
     Storage::Event* refEvent = _refStorage->readEvent(nevent);
 
     for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
@@ -23,7 +32,7 @@ void Analysis::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
   }
 
   for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
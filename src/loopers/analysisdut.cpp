@@ -10,19 +10,33 @@
 #include "../analyzers/singleanalyzer.h"
 #include "../analyzers/dualanalyzer.h"
 #include "../processors/trackmatcher.h"
+#include "skim.h"
 
 namespace Loopers {
 
 void AnalysisDut::loop()
 {
+  enableRecycling();
+
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
   {
+    // Don't read events which all the analyzers' event cuts would reject
+    if (skipEvent(nevent))
+    {
+      progressBar(nevent);
+      continue;
+    }
+
     Storage::Event* refEvent = _refStorage->readEvent(nevent);
-    Storage::Event* dutEvent = _dutStorage->readEvent(nevent);
+    // A ref. skim read against the full DUT file points to its DUT event
+    Storage::Event* dutEvent = _dutStorage->readEvent(_mapSourceEntries ?
+        refEvent->getSourceEntry() : (Long64_t)nevent);
 
     // Match ref tracks to dut clusters (information stored in event)
     _trackMatcher->matchEvent(refEvent, dutEvent);
 
+    if (_skim) _skim->writeEvent(refEvent, dutEvent);
+
     for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
       _singleAnalyzers.at(i)->processEvent(refEvent);
     for (unsigned int i = 0; i < _numDualAnalyzers; i++)
@@ -30,8 +44,8 @@ void AnalysisDut::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
-    delete dutEvent;
+    _refStorage->releaseEvent(refEvent);
+    _dutStorage->releaseEvent(dutEvent);
   }
 
   for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
@@ -47,9 +61,13 @@ AnalysisDut::AnalysisDut(Storage::StorageIO* refInput,
                          ULong64_t numEvents,
                          Long64_t eventSkip) :
   Looper(refInput, dutInput, startEvent, numEvents, eventSkip),
-  _trackMatcher(trackMatcher)
+  _trackMatcher(trackMatcher),
+  _mapSourceEntries(false)
 {
   assert(refInput && dutInput && trackMatcher && "Looper: initialized with null object(s)");
+
+  // Two skims written together are already in step
+  _mapSourceEntries = refInput->hasSourceEntries() && !dutInput->hasSourceEntries();
 }
 
 }
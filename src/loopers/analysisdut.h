@@ -13,6 +13,7 @@ class AnalysisDut : public Looper
 {
 private:
   Processors::TrackMatcher* _trackMatcher;
+  bool _mapSourceEntries; // Read the DUT event at the ref. event's source entry
 
 public:
   AnalysisDut(/* These arguments are needed to be passed to the base looper class */
@@ -12,6 +12,7 @@
 #include "../storage/hit.h"
 #include "../mechanics/device.h"
 #include "../mechanics/sensor.h"
+#include "../mechanics/noisemask.h"
 
 #ifndef VERBOSE
 #define VERBOSE 1
@@ -25,23 +26,22 @@ namespace Loopers {
 
 void ApplyMask::loop()
 {
+  enableRecycling();
+
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
   {
     Storage::Event* refEvent = _refStorage->readEvent(nevent);
 
     Storage::Event* maskedEvent = new Storage::Event(_refDevice->getNumSensors());
 
+    // The input's noise masks have already dropped the noisy hits
     for (unsigned int nhit = 0; nhit < refEvent->getNumHits(); nhit++) {
       Storage::Hit* hit = refEvent->getHit(nhit);
       const unsigned int nplane = hit->getPlane()->getPlaneNum(); 
-      const unsigned int x = hit->getPixX();
-      const unsigned int y = hit->getPixY();
-      if (!_refDevice->getSensor(nplane)->isPixelNoisy(x, y)) {
-        Storage::Hit* copy = maskedEvent->newHit(nplane);
-        copy->setPix(x, y);
-        copy->setValue(hit->getValue());
-        copy->setTiming(hit->getTiming());
-      }
+      Storage::Hit* copy = maskedEvent->newHit(nplane);
+      copy->setPix(hit->getPixX(), hit->getPixY());
+      copy->setValue(hit->getValue());
+      copy->setTiming(hit->getTiming());
     }
 
     maskedEvent->setTimeStamp(refEvent->getTimeStamp());
@@ -55,7 +55,7 @@ void ApplyMask::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
     delete maskedEvent;
   }
 }
@@ -74,6 +74,10 @@ ApplyMask::ApplyMask(Mechanics::Device* refDevice,
          "Looper: initialized with null object(s)");
   assert(refInput->getNumPlanes() == refDevice->getNumSensors() &&
          "Loopers: number of planes / sensors mis-match");
+
+  // The input drops the noisy hits as it reads them
+  _noiseMasks = _refDevice->getNoiseMask()->getMaskArrays();
+  refInput->setNoiseMasks(&_noiseMasks);
 }
 
 }
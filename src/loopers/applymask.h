@@ -1,9 +1,11 @@
 #ifndef APPLYMASK_H
 #define APPLYMASK_H
 
+#include <vector>
+
 #include "looper.h"
 
-namespace Storage { class StorageIO; }
+namespace Storage { class StorageIO; class PixelMask; }
 namespace Mechanics { class Device; }
 
 namespace Loopers {
@@ -13,6 +15,7 @@ class ApplyMask : public Looper
 private:
   Mechanics::Device* _refDevice;
   Storage::StorageIO* _refOutput;
+  std::vector<const Storage::PixelMask*> _noiseMasks; // Applied by the input
 
 public:
   ApplyMask(/* Use if you need mechanics (noise mask, pixel arrangement ...) */
@@ -111,6 +111,8 @@ ROOT::Math::IBaseFunctionMultiDim* Chi2Align::Chi2Minimizer::Clone() const {
 
 void Chi2Align::loop()
 {
+  enableRecycling();
+
   std::list<Tracklet> tracklets;
 
   double sumchi2 = 0;
@@ -125,7 +127,7 @@ void Chi2Align::loop()
 
     // Cluster the event
     for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-      _clusterMaker->generateClusters(refEvent, nplane);
+      _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
 
     // Apply the alignment to the event 
     Processors::applyAlignment(refEvent, _refDevice);
@@ -188,7 +190,7 @@ void Chi2Align::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
   }
 
   // Build the default minimizer (probably Minuit with Migrad)
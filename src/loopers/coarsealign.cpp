@@ -21,6 +21,8 @@ namespace Loopers {
 
 void CoarseAlign::loop()
 {
+  enableRecycling();
+
   // Coarse align specific analyzers
   Analyzers::Correlation correlation(_refDevice, 0); // 0  for no ouput
 
@@ -31,7 +33,7 @@ void CoarseAlign::loop()
     if (refEvent->getNumClusters())
       throw "CoarseAlign: can't recluster an event, mask the tree in the input";
     for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-      _clusterMaker->generateClusters(refEvent, nplane);
+      _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
 
     Processors::applyAlignment(refEvent, _refDevice);
 
@@ -39,7 +41,7 @@ void CoarseAlign::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
   }
 
   double cummulativeX = 0;
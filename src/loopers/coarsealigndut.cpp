@@ -25,6 +25,8 @@ namespace Loopers {
 
 void CoarseAlignDut::loop()
 {
+  enableRecycling();
+
   Analyzers::DUTCorrelation correlation(_refDevice, _dutDevice, 0);
 
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
@@ -36,10 +38,10 @@ void CoarseAlignDut::loop()
       throw "CoarseAlignDut: can't recluster an event, mask the tree in the input";
     //std::cout << "telescope" << std::endl;
     for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-      _clusterMaker->generateClusters(refEvent, nplane);
+      _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
     //std::cout << "DUT----" << std::endl;    
     for (unsigned int nplane = 0; nplane < dutEvent->getNumPlanes(); nplane++)
-      _clusterMaker->generateClusters(dutEvent, nplane);
+      _clusterMaker->generateClusters(dutEvent, nplane, _dutDevice);
 
     Processors::applyAlignment(refEvent, _refDevice);
     Processors::applyAlignment(dutEvent, _dutDevice);
@@ -48,8 +50,8 @@ void CoarseAlignDut::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
-    delete dutEvent;
+    _refStorage->releaseEvent(refEvent);
+    _dutStorage->releaseEvent(dutEvent);
   }
 
 
@@ -19,6 +19,8 @@ namespace Loopers {
 
 void ExampleLooper::loop()
 {
+  enableRecycling();
+
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
   {
     Storage::Event* refEvent = _refStorage->readEvent(nevent);
@@ -26,10 +28,10 @@ void ExampleLooper::loop()
 
     if (refEvent->getNumClusters() == 0)
       for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-        _clusterMaker->generateClusters(refEvent, nplane);
+        _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
     if (dutEvent->getNumClusters() == 0)
       for (unsigned int nplane = 0; nplane < dutEvent->getNumPlanes(); nplane++)
-        _clusterMaker->generateClusters(dutEvent, nplane);
+        _clusterMaker->generateClusters(dutEvent, nplane, _dutDevice);
 
     Processors::applyAlignment(refEvent, _refDevice);
     Processors::applyAlignment(dutEvent, _dutDevice);
@@ -50,8 +52,8 @@ void ExampleLooper::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
-    delete dutEvent;
+    _refStorage->releaseEvent(refEvent);
+    _dutStorage->releaseEvent(dutEvent);
   }
 
   for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
@@ -31,6 +31,8 @@ namespace Loopers {
 
 void FineAlign::loop()
 {
+  enableRecycling();
+
   // Build a vector of sensor indices which will be permutated at each iteration
   std::vector<unsigned int> sensorPermutations(_refDevice->getNumSensors(), 0);
   for (unsigned int i = 0; i < _refDevice->getNumSensors(); i++)
@@ -150,7 +152,7 @@ void FineAlign::loop()
         if (refEvent->getNumClusters())
           throw "FineAlign: can't recluster an event, mask the tree in the input";
         for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-          _clusterMaker->generateClusters(refEvent, nplane); // make clusters in the plane
+          _clusterMaker->generateClusters(refEvent, nplane, _refDevice); // make clusters in the plane
 
         Processors::applyAlignment(refEvent, _refDevice);
 
@@ -176,7 +178,7 @@ void FineAlign::loop()
 
         progressBar(nevent);
 
-        delete refEvent;
+        _refStorage->releaseEvent(refEvent);
       }
 
       double offsetX = 0, offsetY = 0, rotation = 0;
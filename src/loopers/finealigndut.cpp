@@ -31,6 +31,8 @@ namespace Loopers {
 
 void FineAlignDut::loop()
 {
+  enableRecycling();
+
   for (unsigned int niter = 0; niter < _numIterations; niter++)
   {
     cout << "Iteration " << niter << " of " << _numIterations - 1 << endl;
@@ -85,9 +87,9 @@ void FineAlignDut::loop()
 	    if (refEvent->getNumClusters() || dutEvent->getNumClusters())
 	      throw "FineAlignDut: can't recluster an event, mask the tree in the input";
 	    for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-	      _clusterMaker->generateClusters(refEvent, nplane);
+	      _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
 	    for (unsigned int nplane = 0; nplane < dutEvent->getNumPlanes(); nplane++)
-	      _clusterMaker->generateClusters(dutEvent, nplane);
+	      _clusterMaker->generateClusters(dutEvent, nplane, _dutDevice);
 	    
 	    Processors::applyAlignment(refEvent, _refDevice);
 	    Processors::applyAlignment(dutEvent, _dutDevice);
@@ -102,8 +104,8 @@ void FineAlignDut::loop()
 
 	    progressBar(nevent);
 
-	    delete refEvent;
-	    delete dutEvent;
+	    _refStorage->releaseEvent(refEvent);
+	    _dutStorage->releaseEvent(dutEvent);
 	  }
 
 	for (unsigned int nsens = 0; nsens < _dutDevice->getNumSensors(); nsens++)
@@ -8,7 +8,7 @@
 #include <TCanvas.h>
 
 #include "utils.h"
-#include "storage/storagei.h"
+#include "storage/eventinput.h"
 #include "mechanics/device.h"
 #include "analyzers/clusterresiduals.h"
 #include "loopers/loopaligncorr.h"
@@ -16,7 +16,7 @@
 namespace Loopers {
 
 LoopAlignCorr::LoopAlignCorr(
-    const std::vector<Storage::StorageI*>& inputs,
+    const std::vector<Storage::EventInput*>& inputs,
     const std::vector<Mechanics::Device*>& devices) :
     Looper(inputs, devices),
     m_residuals(devices) {
@@ -25,7 +25,7 @@ LoopAlignCorr::LoopAlignCorr(
 }
 
 LoopAlignCorr::LoopAlignCorr(
-    Storage::StorageI& input,
+    Storage::EventInput& input,
     Mechanics::Device& device) :
     Looper(input, device),
     m_residuals(device) {
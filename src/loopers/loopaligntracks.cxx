@@ -17,7 +17,7 @@
 namespace Loopers {
 
 LoopAlignTracks::LoopAlignTracks(
-    const std::vector<Storage::StorageI*>& inputs,
+    const std::vector<Storage::EventInput*>& inputs,
     const std::vector<Mechanics::Device*>& devices) :
     Looper(inputs, devices),
     m_trackChi2(devices),
@@ -32,7 +32,7 @@ LoopAlignTracks::LoopAlignTracks(
 }
 
 LoopAlignTracks::LoopAlignTracks(
-    Storage::StorageI& input,
+    Storage::EventInput& input,
     Mechanics::Device& device) :
     Looper(input, device),
     m_trackChi2(device),
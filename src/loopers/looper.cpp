@@ -8,8 +8,10 @@
 #include <Rtypes.h>
 
 #include "../storage/storageio.h"
+#include "../storage/eventindex.h"
 #include "../analyzers/singleanalyzer.h"
 #include "../analyzers/dualanalyzer.h"
+#include "skim.h"
 
 using std::cout;
 using std::endl;
@@ -18,6 +20,33 @@ using std::flush;
 namespace Loopers {
 
 bool Looper::noBar = false;
+bool Looper::recycleEvents = false;
+bool Looper::useIndex = false;
+
+void Looper::enableRecycling()
+{
+  if (!recycleEvents) return;
+  _refStorage->setRecycleEvents(true);
+  if (_dutStorage) _dutStorage->setRecycleEvents(true);
+}
+
+bool Looper::skipEvent(ULong64_t nevent)
+{
+  if (!useIndex || !_refStorage->hasIndex()) return false;
+  // Nothing to decide on if no analyzer has cuts
+  if (!_numSingleAnalyzers && !_numDualAnalyzers && !_skim) return false;
+
+  const Storage::EventSummary* summary = _refStorage->readSummary(nevent);
+
+  if (_skim && _skim->checkEventCuts(summary)) return false;
+
+  for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
+    if (_singleAnalyzers.at(i)->checkEventCuts(summary)) return false;
+  for (unsigned int i = 0; i < _numDualAnalyzers; i++)
+    if (_dualAnalyzers.at(i)->checkEventCuts(summary)) return false;
+
+  return true;
+}
 
 void Looper::progressBar(ULong64_t nevent)
 {
@@ -56,6 +85,11 @@ void Looper::addAnalyzer(Analyzers::DualAnalyzer* analyzer)
   _numDualAnalyzers++;
 }
 
+void Looper::setSkim(Skim* skim)
+{
+  _skim = (skim && skim->isActive()) ? skim : 0;
+}
+
 Looper::Looper(Storage::StorageIO* refStorage,
                Storage::StorageIO* dutStorage,
                ULong64_t startEvent,
@@ -69,7 +103,8 @@ Looper::Looper(Storage::StorageIO* refStorage,
   _totalEvents(0),
   _endEvent(0),
   _numSingleAnalyzers(0),
-  _numDualAnalyzers(0)
+  _numDualAnalyzers(0),
+  _skim(0)
 {
   assert(refStorage && "Looper: null ref. storage passed");
 
@@ -4,7 +4,7 @@
 
 #include <TStopwatch.h>
 
-#include "storage/storagei.h"
+#include "storage/eventinput.h"
 #include "storage/event.h"
 #include "mechanics/device.h"
 #include "processors/processor.h"
@@ -13,9 +13,10 @@
 
 namespace Loopers {
 
-Looper::Looper(const std::vector<Storage::StorageI*>& inputs) :
+Looper::Looper(const std::vector<Storage::EventInput*>& inputs) :
     m_inputs(inputs),
     m_events(m_inputs.size()),  // reserve event vector size
+    m_views(m_inputs.size()),
     m_devices(),
     m_maxEvents(0),
     m_minEvents(-1),  // largest unsigned integer
@@ -25,20 +26,22 @@ Looper::Looper(const std::vector<Storage::StorageI*>& inputs) :
     m_nprocess(-1),  // causes iteration over entire range
     m_nstep(1),
     m_printInterval(1E4),
-    m_draw(false) {
+    m_draw(false),
+    m_prefetch(0) {
   // Keep track of the smallest and largest event indices at end of inputs
   for (size_t i = 0; i < m_inputs.size(); i++) {
-    const Storage::StorageI& input = *m_inputs[i];
+    const Storage::EventInput& input = *m_inputs[i];
     m_minEvents = std::min(m_minEvents, (ULong64_t)input.getNumEvents());
     m_maxEvents = std::max(m_maxEvents, (ULong64_t)input.getNumEvents());
   }
 }
 
 Looper::Looper(
-    const std::vector<Storage::StorageI*>& inputs,
+    const std::vector<Storage::EventInput*>& inputs,
     const std::vector<Mechanics::Device*>& devices) :
     m_inputs(inputs),
     m_events(m_inputs.size()),  // reserve event vector size
+    m_views(m_inputs.size()),
     m_devices(devices),
     m_maxEvents(0),
     m_minEvents(-1),  // largest unsigned integer
@@ -48,10 +51,11 @@ Looper::Looper(
     m_nprocess(-1),  // causes iteration over entire range
     m_nstep(1),
     m_printInterval(1E4),
-    m_draw(false) {
+    m_draw(false),
+    m_prefetch(0) {
   // Keep track of the smallest and largest event indices at end of inputs
   for (size_t i = 0; i < m_inputs.size(); i++) {
-    const Storage::StorageI& input = *m_inputs[i];
+    const Storage::EventInput& input = *m_inputs[i];
     m_minEvents = std::min(m_minEvents, (ULong64_t)input.getNumEvents());
     m_maxEvents = std::max(m_maxEvents, (ULong64_t)input.getNumEvents());
   }
@@ -67,10 +71,11 @@ Looper::Looper(
       throw std::runtime_error("Looper::Looper: device/inputs planes mismatch");
 }
 
-Looper::Looper(Storage::StorageI& input) :
+Looper::Looper(Storage::EventInput& input) :
     // Single input vector, filled with input address
     m_inputs(1, &input),
     m_events(m_inputs.size()),
+    m_views(m_inputs.size()),
     m_maxEvents(0),
     m_minEvents(-1),  // largest unsigned integer
     m_finalized(false),
@@ -79,15 +84,17 @@ Looper::Looper(Storage::StorageI& input) :
     m_nprocess(-1),  // causes iteration over entire range
     m_nstep(1),
     m_printInterval(1E4),
-    m_draw(false) {
+    m_draw(false),
+    m_prefetch(0) {
   m_minEvents = (ULong64_t)input.getNumEvents();
   m_maxEvents = (ULong64_t)input.getNumEvents();
 }
 
-Looper::Looper(Storage::StorageI& input, Mechanics::Device& device) :
+Looper::Looper(Storage::EventInput& input, Mechanics::Device& device) :
     // Single input vector, filled with input address
     m_inputs(1, &input),
     m_events(m_inputs.size()),
+    m_views(m_inputs.size()),
     // Single vector again
     m_devices(1, &device),
     m_maxEvents(0),
@@ -98,7 +105,8 @@ Looper::Looper(Storage::StorageI& input, Mechanics::Device& device) :
     m_nprocess(-1),  // causes iteration over entire range
     m_nstep(1),
     m_printInterval(1E4),
-    m_draw(false) {
+    m_draw(false),
+    m_prefetch(0) {
   m_minEvents = (ULong64_t)input.getNumEvents();
   m_maxEvents = (ULong64_t)input.getNumEvents();
   if (m_devices[0]->getNumSensors() != m_inputs[0]->getNumPlanes())
@@ -136,16 +144,36 @@ void Looper::loop() {
     throw std::runtime_error("Looper::loop: nprocess exceeds range");
   if (m_nstep < 1)
     throw std::runtime_error("Looper::loop: step size can't be smaller than 1");
+
+  // Views build no objects, so there is nothing to decode ahead
+  const bool views = readsViews();
+  const bool prefetch = m_prefetch && !views;
+
+  // Decode the events of this range ahead of the loop, if requested
+  if (prefetch)
+    for (size_t i = 0; i < m_inputs.size(); i++)
+      m_inputs[i]->startPrefetch(
+          m_prefetch, m_start, m_start+m_nprocess, m_nstep);
   
   for (m_ievent = m_start; m_ievent < m_start+m_nprocess; m_ievent += m_nstep) {
     // If a print interval is given, and this event is on it, print progress
     if (m_printInterval && (m_ievent%m_printInterval == 0)) printProgress();
+    if (views) {
+      for (size_t i = 0; i < m_inputs.size(); i++)
+        m_views[i] = &m_inputs[i]->readView(m_ievent);
+      executeViews();
+      continue;
+    }
     // Read this event from each input file
     for (size_t i = 0; i < m_inputs.size(); i++)
       m_events[i] = &m_inputs[i]->readEvent(m_ievent);
     // Execute this looper's event code
     execute();
   }
+  // Release the read-ahead threads and their events
+  if (prefetch)
+    for (size_t i = 0; i < m_inputs.size(); i++)
+      m_inputs[i]->stopPrefetch();
   // Print the 100% progress and finish that line
   printProgress();
   std::cout << std::endl;
@@ -162,6 +190,20 @@ void Looper::execute() {
     (*it)->execute(m_events);
 }
 
+bool Looper::readsViews() const {
+  if (!m_processors.empty() || m_analyzers.empty()) return false;
+  for (std::vector<Analyzers::Analyzer*>::const_iterator it = m_analyzers.begin();
+      it != m_analyzers.end(); ++it)
+    if (!(*it)->hasViews()) return false;
+  return true;
+}
+
+void Looper::executeViews() {
+  for (std::vector<Analyzers::Analyzer*>::iterator it = m_analyzers.begin();
+      it != m_analyzers.end(); ++it)
+    (*it)->execute(m_views);
+}
+
 void Looper::finalize() {
   if (m_finalized)
     throw std::runtime_error("Looper::finalize: looper already finalized");
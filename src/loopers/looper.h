@@ -11,6 +11,8 @@ namespace Analyzers { class DualAnalyzer; }
 
 namespace Loopers {
 
+class Skim;
+
 class Looper
 {
 protected:
@@ -27,6 +29,8 @@ protected:
   std::vector<Analyzers::DualAnalyzer*> _dualAnalyzers;
   unsigned int _numDualAnalyzers;
 
+  Skim* _skim; // Writes the selected events, if set (not owned)
+
   Looper(Storage::StorageIO* refStorage,
          Storage::StorageIO* dutStorage = 0,
          ULong64_t startEvent = 0,
@@ -35,12 +39,21 @@ protected:
   virtual ~Looper();
 
   void progressBar(ULong64_t nevent);
+  // Called by loops done with each event before reading the next one
+  void enableRecycling();
+  // True if the ref. storage's index shows that no analyzer (nor the skim)
+  // would use the event, in which case it needn't be read
+  bool skipEvent(ULong64_t nevent);
 
 public:
   static bool noBar;
+  static bool recycleEvents; // Re-use the events read by the storages
+  static bool useIndex; // Skip events using the ref. storage's index
 
   void addAnalyzer(Analyzers::SingleAnalyzer* analyzer);
   void addAnalyzer(Analyzers::DualAnalyzer* analyzer);
+  // Only used by the loopers which support skimming (process, analysisDUT)
+  void setSkim(Skim* skim);
 
   ULong64_t getStartEvent() const { return _startEvent; }
   ULong64_t getEndEvent() const { return _endEvent; }
@@ -11,7 +11,7 @@
 namespace Loopers {
 
 LoopProcess::LoopProcess(
-    Storage::StorageI& input,
+    Storage::EventInput& input,
     Storage::StorageO& output) :
     Looper(input),
     m_output(output) {}
@@ -8,7 +8,7 @@
 #include <TCanvas.h>
 
 #include "utils.h"
-#include "storage/storagei.h"
+#include "storage/eventinput.h"
 #include "mechanics/device.h"
 #include "processors/tracking.h"
 #include "analyzers/clusterresiduals.h"
@@ -17,7 +17,7 @@
 namespace Loopers {
 
 LoopTransfers::LoopTransfers(
-    const std::vector<Storage::StorageI*>& inputs,
+    const std::vector<Storage::EventInput*>& inputs,
     const std::vector<Mechanics::Device*>& devices) :
     Looper(inputs, devices),
     m_residuals(devices) {
@@ -26,7 +26,7 @@ LoopTransfers::LoopTransfers(
 }
 
 LoopTransfers::LoopTransfers(
-    Storage::StorageI& input,
+    Storage::EventInput& input,
     Mechanics::Device& device) :
     Looper(input, device),
     m_residuals(device) {
@@ -29,6 +29,8 @@ namespace Loopers {
 
 void NoiseScan::loop()
 {
+  enableRecycling();
+
   Analyzers::Occupancy occupancy(_refDevice, 0);
 
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; nevent++)
@@ -39,7 +41,7 @@ void NoiseScan::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
   }
 
   occupancy.postProcessing();
@@ -5,6 +5,7 @@
 #include <iostream>
 
 #include <Rtypes.h>
+#include <TStopwatch.h>
 
 #include "../storage/storageio.h"
 #include "../storage/event.h"
@@ -15,6 +16,7 @@
 #include "../processors/trackmaker.h"
 #include "../analyzers/singleanalyzer.h"
 #include "../analyzers/dualanalyzer.h"
+#include "skim.h"
 
 #ifndef VERBOSE
 #define VERBOSE 1
@@ -28,6 +30,8 @@ namespace Loopers {
 
 void ProcessEvents::loop()
 {
+  enableRecycling();
+
   // Some statistics for reporting
   ULong64_t statProcessedEvents = 0;
   ULong64_t statGeneratedClusters = 0;
@@ -40,14 +44,17 @@ void ProcessEvents::loop()
   ULong64_t statMostTracksEvent = 0;
   unsigned int statMostTracks = 0;
 
+  // Throughput of the event loop (e.g. to compare with and without recycling)
+  TStopwatch statTimer;
+  statTimer.Start();
+
   for (ULong64_t nevent = _startEvent; nevent <= _endEvent; ++nevent)
   {
     Storage::Event* refEvent = _refStorage->readEvent(nevent);
 
     if (refEvent->getNumClusters())
       throw "ProcessEvents: can't recluster an event, mask the tree in the input";
-    for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-      if (_clusterMaker) _clusterMaker->generateClusters(refEvent, nplane);
+    if (_clusterMaker) _clusterMaker->generateEventClusters(refEvent, _refDevice);
 
     Processors::applyAlignment(refEvent, _refDevice);
 
@@ -60,6 +67,7 @@ void ProcessEvents::loop()
 
     // Write the event
     _refOutput->writeEvent(refEvent);
+    if (_skim) _skim->writeEvent(refEvent);
 
     for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
       _singleAnalyzers.at(i)->processEvent(refEvent);
@@ -87,9 +95,11 @@ void ProcessEvents::loop()
 
     progressBar(nevent);
 
-    delete refEvent;
+    _refStorage->releaseEvent(refEvent);
   }
 
+  statTimer.Stop();
+
   for (unsigned int i = 0; i < _numSingleAnalyzers; i++)
     _singleAnalyzers.at(i)->postProcessing();
   for (unsigned int i = 0; i < _numDualAnalyzers; i++)
@@ -118,6 +128,11 @@ void ProcessEvents::loop()
             statMostClustersEvent << ")\n";
     cout << "  Most Tracks (event):   " << statMostTracks << " (" <<
             statMostTracksEvent << ")\n";
+    cout << "  Events per second:     " << (statTimer.RealTime() > 0 ?
+            (double)statProcessedEvents / statTimer.RealTime() : 0) << "\n";
+    cout << "  Most hits (plane):     " << _refStorage->getMaxHits() << "\n";
+    cout << "  Recycled events:       " <<
+            (_refStorage->getRecycleEvents() ? "yes" : "no") << "\n";
     cout << flush;
   }
 }
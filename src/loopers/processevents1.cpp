@@ -46,8 +46,7 @@ void ProcessEvents::loop()
 
     if (refEvent->getNumClusters())
       throw "ProcessEvents: can't recluster an event, mask the tree in the input";
-    for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-      if (_clusterMaker) _clusterMaker->generateClusters(refEvent, nplane);
+    if (_clusterMaker) _clusterMaker->generateEventClusters(refEvent, _refDevice);
 
     Processors::applyAlignment(refEvent, _refDevice);
 
@@ -0,0 +1,139 @@
+#include "skim.h"
+
+#include <cassert>
+#include <vector>
+#include <iostream>
+
+#include <Rtypes.h>
+
+#include "../storage/storageio.h"
+#include "../storage/event.h"
+#include "../storage/eventindex.h"
+#include "../analyzers/cuts.h"
+
+using std::cout;
+using std::endl;
+
+namespace Loopers {
+
+void Skim::addCut(const Analyzers::EventCut* cut)
+{
+  assert(cut && "Skim: tried to add a null cut");
+  _eventCuts.push_back(cut);
+}
+
+void Skim::addCut(const Analyzers::TrackCut* cut)
+{
+  assert(cut && "Skim: tried to add a null cut");
+  _trackCuts.push_back(cut);
+}
+
+void Skim::openOutputs(unsigned int refPlanes, unsigned int refMask,
+                       unsigned int dutPlanes, unsigned int dutMask)
+{
+  if (!isActive()) throw "Skim: no output set";
+  if (_refOutput) throw "Skim: outputs are already open";
+  if (!_dutOutputName.empty() && !dutPlanes)
+    throw "Skim: DUT output set without a DUT input";
+
+  // The event tree is kept, it records the source entries
+  _refOutput = new Storage::StorageIO(_refOutputName.c_str(), Storage::OUTPUT,
+                                      refPlanes, refMask & ~Storage::Flags::EVENTINFO);
+  _refOutput->enableSourceEntries();
+
+  if (_dutOutputName.empty()) return;
+
+  _dutOutput = new Storage::StorageIO(_dutOutputName.c_str(), Storage::OUTPUT,
+                                      dutPlanes, dutMask & ~Storage::Flags::EVENTINFO);
+  _dutOutput->enableSourceEntries();
+}
+
+unsigned int Skim::countGoodTracks(const Storage::Event* event) const
+{
+  unsigned int numGood = 0;
+  for (unsigned int ntrack = 0; ntrack < event->getNumTracks(); ntrack++)
+  {
+    const Storage::Track* track = event->getTrack(ntrack);
+    bool good = true;
+    for (unsigned int ncut = 0; ncut < _trackCuts.size() && good; ncut++)
+      good = _trackCuts.at(ncut)->check(track);
+    if (good) numGood++;
+  }
+  return numGood;
+}
+
+bool Skim::checkEvent(const Storage::Event* event) const
+{
+  for (unsigned int ncut = 0; ncut < _eventCuts.size(); ncut++)
+    if (!_eventCuts.at(ncut)->check(event)) return false;
+
+  // Counting is only needed if it can reject the event
+  if (!_minGoodTracks && _maxGoodTracks < 0) return true;
+
+  const unsigned int numGood = countGoodTracks(event);
+  if (numGood < _minGoodTracks) return false;
+  if (_maxGoodTracks >= 0 && numGood > (unsigned int)_maxGoodTracks) return false;
+  return true;
+}
+
+bool Skim::checkEventCuts(const Storage::EventSummary* summary) const
+{
+  for (unsigned int ncut = 0; ncut < _eventCuts.size(); ncut++)
+    if (!_eventCuts.at(ncut)->check(summary)) return false;
+  // Good tracks are at most all the tracks
+  if (summary->getNumTracks() < _minGoodTracks) return false;
+  return true;
+}
+
+bool Skim::writeEvent(Storage::Event* refEvent, Storage::Event* dutEvent)
+{
+  if (!_refOutput) throw "Skim: outputs aren't open";
+
+  _numChecked++;
+  if (!checkEvent(refEvent)) return false;
+
+  _refOutput->writeEvent(refEvent);
+  if (_dutOutput)
+  {
+    if (!dutEvent) throw "Skim: no DUT event to write";
+    _dutOutput->writeEvent(dutEvent);
+  }
+
+  _numWritten++;
+  return true;
+}
+
+void Skim::print() const
+{
+  if (!isActive()) return;
+
+  cout << "\nSKIM:\n";
+  cout << "  Ref. output:           " << _refOutputName << "\n";
+  if (!_dutOutputName.empty())
+    cout << "  DUT output:            " << _dutOutputName << "\n";
+  cout << "  Checked events:        " << _numChecked << "\n";
+  cout << "  Written events:        " << _numWritten << " (" <<
+          (_numChecked ? 100 * _numWritten / (double)_numChecked : 0) << "%)" << endl;
+}
+
+Skim::Skim() :
+  _refOutput(0),
+  _dutOutput(0),
+  _minGoodTracks(0),
+  _maxGoodTracks(-1),
+  _numChecked(0),
+  _numWritten(0)
+{ }
+
+Skim::~Skim()
+{
+  // Closing writes the files
+  delete _refOutput;
+  delete _dutOutput;
+  for (unsigned int i = 0; i < _eventCuts.size(); i++)
+    delete _eventCuts.at(i);
+  for (unsigned int i = 0; i < _trackCuts.size(); i++)
+    delete _trackCuts.at(i);
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef SKIM_H
+#define SKIM_H
+
+#include <vector>
+#include <string>
+
+#include <Rtypes.h>
+
+namespace Storage { class StorageIO; }
+namespace Storage { class Event; }
+namespace Storage { class EventSummary; }
+namespace Analyzers { class EventCut; }
+namespace Analyzers { class TrackCut; }
+
+namespace Loopers {
+
+/* Writes the events passing a chain of event and track cuts to new files,
+ * which a later analysis can run over instead of the full run. The skimmed
+ * events record their entry in the full file, so that a telescope skim can
+ * be read back against the full DUT file (and vice versa).
+ *
+ * A track is good if it passes all the track cuts, and the event must have
+ * between the minimum and maximum number of good tracks. */
+class Skim
+{
+private:
+  std::string _refOutputName;
+  std::string _dutOutputName;
+  Storage::StorageIO* _refOutput;
+  Storage::StorageIO* _dutOutput;
+
+  std::vector<const Analyzers::EventCut*> _eventCuts;
+  std::vector<const Analyzers::TrackCut*> _trackCuts;
+  unsigned int _minGoodTracks;
+  int _maxGoodTracks; // No limit if negative
+
+  ULong64_t _numChecked;
+  ULong64_t _numWritten;
+
+  unsigned int countGoodTracks(const Storage::Event* event) const;
+
+public:
+  Skim();
+  ~Skim(); // Closes the outputs and deletes the cuts
+
+  void setRefOutput(const char* name) { _refOutputName = name; }
+  void setDutOutput(const char* name) { _dutOutputName = name; }
+  void setMinGoodTracks(unsigned int value) { _minGoodTracks = value; }
+  void setMaxGoodTracks(int value) { _maxGoodTracks = value; }
+  void addCut(const Analyzers::EventCut* cut); // The skim takes ownership
+  void addCut(const Analyzers::TrackCut* cut);
+
+  bool isActive() const { return !_refOutputName.empty(); }
+
+  /* Create the skim files, with the planes and trees to write for each
+   * device. The DUT file is only made if the DUT output is set. */
+  void openOutputs(unsigned int refPlanes, unsigned int refMask,
+                   unsigned int dutPlanes = 0, unsigned int dutMask = 0);
+
+  bool checkEvent(const Storage::Event* event) const;
+  // False if the event's index summary shows that it can't pass
+  bool checkEventCuts(const Storage::EventSummary* summary) const;
+
+  // Write the events if the ref. event passes, returns true if written
+  bool writeEvent(Storage::Event* refEvent, Storage::Event* dutEvent = 0);
+
+  void print() const;
+
+private:
+  Skim(const Skim&); // Disable the copy constructor
+  Skim& operator=(const Skim&); // Disable the assignment operator
+};
+
+}
+
+#endif // SKIM_H
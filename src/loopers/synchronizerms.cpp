@@ -172,9 +172,9 @@ void SynchronizeRMS::loop()
 	if (refEvent->getNumClusters() || dutEvent->getNumClusters())
 	  throw "SynchronizeRMS: can't recluster an event, mask the tree in the input";
 	for (unsigned int nplane = 0; nplane < refEvent->getNumPlanes(); nplane++)
-	  _clusterMaker->generateClusters(refEvent, nplane);
+	  _clusterMaker->generateClusters(refEvent, nplane, _refDevice);
 	for (unsigned int nplane = 0; nplane < dutEvent->getNumPlanes(); nplane++)
-	  _clusterMaker->generateClusters(dutEvent, nplane);
+	  _clusterMaker->generateClusters(dutEvent, nplane, _dutDevice);
 
 	// applies the alignment to the newly created clusters
 	Processors::applyAlignment(refEvent, _refDevice);
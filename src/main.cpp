@@ -2,8 +2,14 @@
 #include <vector>
 #include <string.h>
 #include <iomanip>
+#include <fstream>
+#include <thread>
+#include <chrono>
 
 #include <TFile.h>
+#include <TKey.h>
+#include <TH1.h>
+#include <TTree.h>
 #include <TApplication.h>
 #include <TStyle.h>
 #include <TCanvas.h>
@@ -15,7 +21,11 @@
 #include "storage/plane.h"
 #include "storage/cluster.h"
 #include "storage/hit.h"
+#include "storage/eventindex.h"
 #include "converters/kartelconvert.h"
+#include "converters/eventqueue.h"
+#include "converters/kartelgenerator.h"
+#include "converters/configconverters.h"
 #include "mechanics/configmechanics.h"
 #include "mechanics/sensor.h"
 #include "mechanics/device.h"
@@ -28,6 +38,8 @@
 #include "processors/trackmatcher.h"
 #include "processors/processors.h"
 #include "analyzers/configanalyzers.h"
+#include "analyzers/occupancy.h"
+#include "analyzers/correlation.h"
 #include "loopers/analysis.h"
 #include "loopers/analysisdut.h"
 #include "loopers/coarsealign.h"
@@ -40,6 +52,7 @@
 #include "loopers/processevents.h"
 #include "loopers/synchronize.h"
 #include "loopers/synchronizerms.h"
+#include "loopers/skim.h"
 #include "loopers/configloopers.h"
 #include "configparser.h"
 #include "inputargs.h"
@@ -303,11 +316,19 @@ void process(const char* inputName, const char* outputName,
     unsigned int outMask = 0;
     if (device->getNumSensors() <= 2) outMask = Storage::Flags::TRACKS;
     Storage::StorageIO output(outputName, Storage::OUTPUT, device->getNumSensors(), outMask);
+    // Processing a skim keeps its events pointing back to the full file
+    if (input.hasSourceEntries()) output.enableSourceEntries();
+
+    // Optionally also write the selected events to a smaller file
+    Loopers::Skim skim;
+    Analyzers::configSkim(runConfig, skim);
+    if (skim.isActive()) skim.openOutputs(device->getNumSensors(), outMask);
     
     if (device->getAlignment()) device->getAlignment()->readFile();
 
     Loopers::ProcessEvents looper(device, &output, clusterMaker, trackMaker,
                                   &input, startEvent, numEvents);
+    looper.setSkim(&skim);
     const Storage::Event* start = input.readEvent(looper.getStartEvent());
     const Storage::Event* end = input.readEvent(looper.getEndEvent());
     device->setTimeStart(start->getTimeStamp());
@@ -322,6 +343,7 @@ void process(const char* inputName, const char* outputName,
     Analyzers::configLooper(runConfig, &looper, device, 0, results);
     std::cout << "S.F #######3"<< std::endl;
     looper.loop();
+    skim.print();
 
     if (results)
     {
@@ -378,7 +400,7 @@ void applyMask(const char* inputName, const char* outputName,
 }
 
 void convert(const char* input, const char* output, Long64_t triggers,
-             const char* deviceCfg = "")
+             const char* deviceCfg = "", unsigned int numThreads = 0)
 {
   try
   {
@@ -390,7 +412,412 @@ void convert(const char* input, const char* output, Long64_t triggers,
       device->getNoiseMask()->readMask();
     }
     Converters::KartelConvert convert(input, output, device);
-    convert.processFile(triggers);
+    if (numThreads > 1) convert.processFileParallel(triggers, numThreads);
+    else convert.processFile(triggers);
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " <<  e << endl;
+  }
+}
+
+void convertProcess(const char* input, const char* outputName, Long64_t triggers,
+                    const char* deviceCfg, const char* tbCfg,
+                    unsigned int numThreads = 0)
+{
+  try
+  {
+    ConfigParser deviceConfig(deviceCfg);
+    Mechanics::Device* device = Mechanics::generateDevice(deviceConfig);
+    device->getNoiseMask()->readMask();
+    if (device->getAlignment()) device->getAlignment()->readFile();
+
+    ConfigParser runConfig(tbCfg);
+    Processors::ClusterMaker* clusterMaker = Processors::generateClusterMaker(runConfig);
+
+    Processors::TrackMaker* trackMaker = 0;
+    if (device->getNumSensors() > 2)
+      trackMaker = Processors::generateTrackMaker(runConfig);
+
+    // Hits, clusters and tracks are all written to the one output
+    unsigned int outMask = 0;
+    if (device->getNumSensors() <= 2) outMask = Storage::Flags::TRACKS;
+    Storage::StorageIO output(outputName, Storage::OUTPUT, device->getNumSensors(), outMask);
+
+    // The converted events go through the queue instead of a file
+    Converters::KartelConvert convert(input, "", device);
+    Converters::EventQueue queue;
+    convert.setQueue(&queue);
+
+    const char* convertError = 0;
+    std::thread converter([&]() {
+      try
+      {
+        if (numThreads > 1) convert.processFileParallel(triggers, numThreads);
+        else convert.processFile(triggers);
+      }
+      catch (const char* e)
+      {
+        convertError = e;
+      }
+      queue.close();
+    });
+
+    ULong64_t numProcessed = 0;
+    Storage::Event* event = 0;
+    try
+    {
+      // Process the events as in ProcessEvents, in the order they are converted
+      while ((event = queue.pop()))
+      {
+        clusterMaker->generateEventClusters(event, device);
+
+        Processors::applyAlignment(event, device);
+
+        if (trackMaker) trackMaker->generateTracks(event,
+                                                   device->getBeamSlopeX(),
+                                                   device->getBeamSlopeY(), -1);
+
+        output.writeEvent(event);
+        delete event;
+        event = 0;
+        numProcessed++;
+      }
+    }
+    catch (...)
+    {
+      // Stop the converter before giving up
+      delete event;
+      queue.close();
+      converter.join();
+      throw;
+    }
+
+    converter.join();
+    if (convertError) throw convertError;
+
+    cout << "\nCONVERT AND PROCESS:\n";
+    cout << "  Processed events:      " << numProcessed << endl;
+
+    delete device;
+    delete clusterMaker;
+    if (trackMaker) delete trackMaker;
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " <<  e << endl;
+  }
+}
+
+/* Add the plots stored in the directory to those of the same name which the
+ * analyzers made in it, so that the results carry on from where they were
+ * last written */
+void reloadResults(TDirectory* dir)
+{
+  TIter next(dir->GetListOfKeys());
+  while (TKey* key = (TKey*)next())
+  {
+    // Only the latest cycle of each object holds its results
+    if (key->GetCycle() != dir->GetKey(key->GetName())->GetCycle()) continue;
+
+    if (!strcmp(key->GetClassName(), "TDirectoryFile"))
+    {
+      TDirectory* subDir = dir->GetDirectory(key->GetName());
+      if (subDir) reloadResults(subDir);
+      continue;
+    }
+
+    // Plots which the analyzers make only at the end are made again
+    TObject* current = dir->GetList()->FindObject(key->GetName());
+    if (!current) continue;
+
+    TObject* stored = key->ReadObj();
+    if (current->InheritsFrom(TH1::Class()) && stored->InheritsFrom(TH1::Class()))
+      ((TH1*)current)->Add((TH1*)stored);
+    else if (current->InheritsFrom(TTree::Class()) && stored->InheritsFrom(TTree::Class()))
+      ((TTree*)current)->CopyEntries((TTree*)stored);
+    delete stored;
+  }
+}
+
+void follow(const char* input, const char* resultsName, Long64_t triggers,
+            const char* deviceCfg, const char* tbCfg, unsigned int refresh)
+{
+  try
+  {
+    typedef std::chrono::steady_clock Clock;
+
+    // The run is over once the file hasn't grown for this long
+    const double idleTimeout = 60;
+    const double refreshPeriod = refresh ? refresh : 10;
+
+    ConfigParser deviceConfig(deviceCfg);
+    Mechanics::Device* device = Mechanics::generateDevice(deviceConfig);
+    device->getNoiseMask()->readMask();
+    if (device->getAlignment()) device->getAlignment()->readFile();
+
+    ConfigParser runConfig(tbCfg);
+    Processors::ClusterMaker* clusterMaker = Processors::generateClusterMaker(runConfig);
+
+    if (!strlen(resultsName)) throw "follow: no results file given";
+
+    // The byte offset after the last event in the results, to pick up from
+    // there if the monitoring is restarted. The results written up to then
+    // are needed to carry on, otherwise the run is followed from its start.
+    const std::string checkpointName = std::string(resultsName) + ".offset";
+    ULong64_t checkpoint = 0;
+    std::ifstream checkpointIn(checkpointName.c_str());
+    const bool resume = (checkpointIn >> checkpoint) && std::ifstream(resultsName).good();
+    checkpointIn.close();
+    if (!resume) checkpoint = 0;
+
+    TFile* results = new TFile(resultsName, resume ? "UPDATE" : "RECREATE");
+    if (results->IsZombie()) throw "follow: unable to open the results file";
+    Analyzers::Occupancy occupancy(device, results->GetDirectory(""));
+    Analyzers::Correlation correlation(device, results->GetDirectory(""));
+
+    Converters::KartelConvert convert(input, "", device, idleTimeout);
+    Converters::EventQueue queue;
+    convert.setQueue(&queue);
+
+    if (resume)
+    {
+      cout << "Resuming at byte " << checkpoint << " (" << checkpointName << ")" << endl;
+      reloadResults(results);
+      convert.resumeAt(checkpoint);
+    }
+
+    const char* convertError = 0;
+    std::thread converter([&]() {
+      try
+      {
+        convert.processFile(triggers);
+      }
+      catch (const char* e)
+      {
+        convertError = e;
+      }
+      queue.close();
+    });
+
+    // Latency from an event being decoded to its results being written
+    ULong64_t numProcessed = 0;
+    ULong64_t numRefreshes = 0;
+    double totalLatency = 0;
+    double maxLatency = 0;
+    bool pending = false; // Events processed since the last refresh
+    Clock::time_point oldestPending;
+
+    // Write the results as they stand, with the checkpoint they reach
+    auto refreshResults = [&]() {
+      results->Write(0, TObject::kOverwrite);
+
+      std::ofstream checkpointOut(checkpointName.c_str());
+      checkpointOut << checkpoint << endl;
+
+      if (!pending) return;
+      const double latency = std::chrono::duration<double>(Clock::now() - oldestPending).count();
+      totalLatency += latency;
+      if (latency > maxLatency) maxLatency = latency;
+      numRefreshes++;
+      pending = false;
+
+      cout << "\rEvents: " << numProcessed << ", latency: " << latency << " s" << std::flush;
+    };
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(refreshPeriod));
+    Clock::time_point nextRefresh = Clock::now() + period;
+
+    Storage::Event* event = 0;
+    try
+    {
+      while (!queue.isDone())
+      {
+        const double wait = std::chrono::duration<double>(nextRefresh - Clock::now()).count();
+        double queued = 0;
+        ULong64_t position = 0;
+        event = queue.pop(wait, &queued, &position);
+
+        if (event)
+        {
+          if (!pending)
+          {
+            oldestPending = Clock::now() - std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(queued));
+            pending = true;
+          }
+
+          clusterMaker->generateEventClusters(event, device);
+          Processors::applyAlignment(event, device);
+
+          occupancy.processEvent(event);
+          correlation.processEvent(event);
+
+          delete event;
+          event = 0;
+          checkpoint = position;
+          numProcessed++;
+        }
+
+        if (Clock::now() < nextRefresh) continue;
+        if (pending) refreshResults();
+        nextRefresh = Clock::now() + period;
+      }
+    }
+    catch (...)
+    {
+      // Stop the converter before giving up
+      delete event;
+      queue.close();
+      converter.join();
+      throw;
+    }
+
+    // The distributions are only filled once the run is over
+    occupancy.postProcessing();
+    refreshResults();
+
+    converter.join();
+    cout << endl;
+    if (convertError) throw convertError;
+
+    cout << "\nFOLLOW:\n";
+    cout << "  Processed events:      " << numProcessed << "\n";
+    cout << "  Refreshes:             " << numRefreshes << "\n";
+    cout << "  Mean latency:          " <<
+            (numRefreshes ? totalLatency / numRefreshes : 0) << " s\n";
+    // Bounded by the refresh period, plus the time to process what came in it
+    cout << "  Max latency:           " << maxLatency << " s\n";
+    cout << "  Refresh period:        " << refreshPeriod << " s" << endl;
+
+    delete results;
+    delete device;
+    delete clusterMaker;
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " <<  e << endl;
+  }
+}
+
+void generateKartel(const char* outputName, ULong64_t numFrames, const char* tbCfg)
+{
+  try
+  {
+    Converters::KartelGenerator generator;
+    if (strlen(tbCfg))
+    {
+      ConfigParser runConfig(tbCfg);
+      Converters::configGenerator(runConfig, generator);
+    }
+    generator.generate(outputName, numFrames ? numFrames : 10000);
+    generator.print();
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " <<  e << endl;
+  }
+}
+
+void benchKartel(const char* outputName, ULong64_t numFrames, const char* tbCfg,
+                 unsigned int numThreads = 0)
+{
+  try
+  {
+    Converters::KartelGenerator generator;
+    if (strlen(tbCfg))
+    {
+      ConfigParser runConfig(tbCfg);
+      Converters::configGenerator(runConfig, generator);
+    }
+    generator.generate(outputName, numFrames ? numFrames : 100000);
+    generator.print();
+
+    // Events are only made, not written, so this times the conversion alone
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    Converters::KartelConvert convert(outputName, "");
+    Converters::EventQueue queue;
+    convert.setQueue(&queue);
+
+    const char* convertError = 0;
+    std::thread converter([&]() {
+      try
+      {
+        if (numThreads > 1) convert.processFileParallel(-1, numThreads);
+        else convert.processFile(-1);
+      }
+      catch (const char* e)
+      {
+        convertError = e;
+      }
+      queue.close();
+    });
+
+    try
+    {
+      while (Storage::Event* event = queue.pop()) delete event;
+    }
+    catch (...)
+    {
+      // Stop the converter before giving up
+      queue.close();
+      converter.join();
+      throw;
+    }
+
+    converter.join();
+    if (convertError) throw convertError;
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    cout << "\nCONVERTER BENCHMARK:\n";
+    cout << "  MB per second:         " <<
+            (seconds > 0 ? generator.getNumBytes() / seconds / 1e6 : 0) << "\n";
+    cout << "  Frames per second:     " <<
+            (seconds > 0 ? convert._totalFrames / seconds : 0) << "\n";
+
+    // The converter should find exactly what was put in the stream
+    const char* names[] = { "header errors", "sync errors", "offset errors",
+                            "hit errors", "sum errors", "frames", "events",
+                            "invalid events" };
+    const ULong64_t injected[] = {
+      generator.getInjected(Converters::KartelGenerator::ERR_HEADER),
+      generator.getInjected(Converters::KartelGenerator::ERR_SYNC),
+      generator.getInjected(Converters::KartelGenerator::ERR_OFFSET),
+      generator.getInjected(Converters::KartelGenerator::ERR_HITS),
+      generator.getInjected(Converters::KartelGenerator::ERR_SUM),
+      generator.getNumFrames(), generator.getNumTriggers(), generator.getNumInvalid() };
+    const ULong64_t found[] = { convert._errHeader, convert._errSync, convert._errOffset,
+                                convert._errHits, convert._errSum, convert._totalFrames,
+                                convert._totalEvents, convert._invalidEvents };
+
+    unsigned int numMismatched = 0;
+    for (unsigned int i = 0; i < sizeof(found) / sizeof(ULong64_t); i++)
+    {
+      if (injected[i] == found[i]) continue;
+      cout << "  MISMATCH " << names[i] << ": generated " << injected[i]
+           << ", converted " << found[i] << "\n";
+      numMismatched++;
+    }
+    cout << "  Counters:              " << (numMismatched ? "mismatched" : "match") << endl;
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " <<  e << endl;
+  }
+}
+
+void benchConvert(const char* input, Long64_t numLines)
+{
+  try
+  {
+    // No output, the input is only decoded
+    Converters::KartelConvert convert(input, "");
+    const ULong64_t mismatches = convert.benchDecoder(numLines);
+    if (mismatches) cout << "\nWARNING :: line decoders disagree" << endl;
   }
   catch (const char* e)
   {
@@ -522,6 +949,12 @@ void analysisDUT(const char* refInputName, const char* dutInputName,
     
     Loopers::AnalysisDut looper(&refInput, &dutInput, trackMatcher, startEvent, numEvents);
 
+    Loopers::Skim skim;
+    Analyzers::configSkim(runConfig, skim);
+    if (skim.isActive())
+      skim.openOutputs(refInput.getNumPlanes(), 0, dutInput.getNumPlanes(), 0);
+    looper.setSkim(&skim);
+
     const Storage::Event* start = refInput.readEvent(looper.getStartEvent());
     const Storage::Event* end = refInput.readEvent(looper.getEndEvent());
     refDevice->setTimeStart(start->getTimeStamp());
@@ -534,6 +967,7 @@ void analysisDUT(const char* refInputName, const char* dutInputName,
       results = new TFile(resultsName, "RECREATE");
     Analyzers::configLooper(runConfig, &looper, refDevice, dutDevice, results);
     looper.loop();
+    skim.print();
     if (results)
     {
       results->Write();
@@ -596,6 +1030,33 @@ void analysis(const char* inputName,
   }
 }
 
+void writeIndex(const char* inputName)
+{
+  try
+  {
+    Storage::StorageIO input(inputName, Storage::INPUT);
+    input.setRecycleEvents(true);
+
+    Storage::EventIndex output(Storage::EventIndex::indexPath(inputName),
+                               Storage::OUTPUT, input.getNumPlanes(),
+                               input.missingTrees());
+
+    for (Long64_t nevent = 0; nevent < input.getNumEvents(); nevent++)
+    {
+      Storage::Event* event = input.readEvent(nevent);
+      output.writeEvent(event);
+      input.releaseEvent(event);
+    }
+
+    output.stampStorage(inputName);
+    cout << "Indexed " << output.getNumEvents() << " events" << endl;
+  }
+  catch (const char* e)
+  {
+    cout << "ERR :: " << e << endl;
+  }
+}
+
 void noiseScan(const char* inputName, const char* deviceCfg,
                const char* tbCfg,
                ULong64_t startEvent, ULong64_t numEvents)
@@ -649,6 +1110,12 @@ int main(int argc, char** argv)
   // Static variables
   cout << "\nRead args\n" << endl;
   if (inArgs.getNoBar()) Loopers::Looper::noBar = true;
+  if (inArgs.getRecycle()) Loopers::Looper::recycleEvents = true;
+  if (inArgs.getUseIndex())
+  {
+    Loopers::Looper::useIndex = true;
+    Storage::StorageIO::writeIndexes = true;
+  }
 
   if ( !inArgs.getCommand().compare("convert") )
   {
@@ -658,7 +1125,53 @@ int main(int argc, char** argv)
                 inArgs.getInputRef().c_str(),
                 inArgs.getOutputRef().c_str(),
                 inArgs.getNumEvents() ? inArgs.getNumEvents() : -1,
-                inArgs.getCfgRef().c_str() );
+                inArgs.getCfgRef().c_str(),
+                inArgs.getNumThreads() );
+  }
+  else if ( !inArgs.getCommand().compare("convertProcess") )
+  {
+    convertProcess( // converts KarTel data and makes clusters and tracks in
+                    // one pass, without writing the hits to a file first
+                inArgs.getInputRef().c_str(),
+                inArgs.getOutputRef().c_str(),
+                inArgs.getNumEvents() ? inArgs.getNumEvents() : -1,
+                inArgs.getCfgRef().c_str(),
+                inArgs.getCfgTestbeam().c_str(),
+                inArgs.getNumThreads() );
+  }
+  else if ( !inArgs.getCommand().compare("follow") )
+  {
+    follow( // converts KarTel data while it is being written, refreshing the
+            // occupancy and correlation results every few seconds
+                inArgs.getInputRef().c_str(),
+                inArgs.getResults().c_str(),
+                inArgs.getNumEvents() ? inArgs.getNumEvents() : -1,
+                inArgs.getCfgRef().c_str(),
+                inArgs.getCfgTestbeam().c_str(),
+                inArgs.getRefresh() );
+  }
+  else if ( !inArgs.getCommand().compare("generateKartel") )
+  {
+    generateKartel( // writes a synthetic KarTel stream of NumEvents frames
+                inArgs.getOutputRef().c_str(),
+                inArgs.getNumEvents(),
+                inArgs.getCfgTestbeam().c_str() );
+  }
+  else if ( !inArgs.getCommand().compare("benchKartel") )
+  {
+    benchKartel( // generates a stream, then times its conversion and checks
+                 // the converter's error counters against the generated ones
+                inArgs.getOutputRef().c_str(),
+                inArgs.getNumEvents(),
+                inArgs.getCfgTestbeam().c_str(),
+                inArgs.getNumThreads() );
+  }
+  else if ( !inArgs.getCommand().compare("benchConvert") )
+  {
+    benchConvert( // compares and times the KarTel line decoders
+                  // over NumEvents lines (0=ALL)
+                inArgs.getInputRef().c_str(),
+                inArgs.getNumEvents() ? inArgs.getNumEvents() : -1 );
   }
   else if ( !inArgs.getCommand().compare("synchronize") )
   {
@@ -801,6 +1314,11 @@ int main(int argc, char** argv)
                 inArgs.getCfgTestbeam().c_str(),
                 inArgs.getResults().c_str() );
   }
+  else if ( !inArgs.getCommand().compare("index") )
+  {
+    writeIndex( // writes the per-event summaries used to skip events with -x
+                inArgs.getInputRef().c_str() );
+  }
   else if (inArgs.getCommand().size())
   {
     inArgs.usage();
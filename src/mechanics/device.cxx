@@ -23,6 +23,7 @@ Device::Device(size_t numSensors) :
     m_spaceUnit(),
     m_timeUnit(),
     m_alignmentFile(),
+    m_noiseMaskFile(),
     m_timeStart(0),
     m_timeEnd(0) {
   updateSensors();
@@ -38,6 +39,7 @@ Device::Device(const Device& copy) :
     m_readOutWindow(copy.m_readOutWindow),
     m_spaceUnit(copy.m_spaceUnit),
     m_timeUnit(copy.m_timeUnit),
+    m_noiseMaskFile(copy.m_noiseMaskFile),
     m_timeStart(copy.m_timeStart),
     m_timeEnd(copy.m_timeEnd) {
   updateSensors();
@@ -90,4 +92,12 @@ void Device::maskSensor(size_t n, bool mask) {
   updateSensors();
 }
 
+std::vector<Storage::PixelMask> Device::getNoiseMasks() const {
+  std::vector<Storage::PixelMask> masks;
+  if (m_noiseMaskFile.empty()) return masks;
+  for (size_t i = 0; i < getNumSensors(); i++)
+    masks.push_back(getSensorConst(i).m_noiseMask);
+  return masks;
+}
+
 }
@@ -67,6 +67,7 @@ struct DeviceBuff : public SpatialBuff {
   std::string spaceUnit;
   std::string timeUnit;
   std::string alignmentFile;
+  std::string noiseMaskFile;
   double clock;
   int window;
   DeviceBuff() : clock(0), window(0) {}
@@ -175,6 +176,7 @@ Device* parseDevice(const std::string& filePath) {
       else if (key == "clock") device.clock = strToFloat(value);
       else if (key == "window") device.window = strToInt(value);
       else if (key == "alignment") device.alignmentFile = value;
+      else if (key == "noise-mask") device.noiseMaskFile = value;
       else if (spatialKey(key, value, device)) continue;
       else throw std::runtime_error("Mechanics: parseDevice: unknown device key");
     }
@@ -247,6 +249,7 @@ Device* parseDevice(const std::string& filePath) {
   deviceObj->m_spaceUnit = device.spaceUnit;
   deviceObj->m_timeUnit = device.timeUnit;
   deviceObj->m_alignmentFile = device.alignmentFile;
+  deviceObj->m_noiseMaskFile = device.noiseMaskFile;
   // Set the spatial alignment
   setBuffAlignment(*deviceObj, device);
 
@@ -272,9 +275,52 @@ Device* parseDevice(const std::string& filePath) {
     if (pass) parseAlignment(*deviceObj);
   }
 
+  // Likewise for the noise mask
+  if (!deviceObj->m_noiseMaskFile.empty()) {
+    std::ifstream test(deviceObj->m_noiseMaskFile.c_str());
+    const bool pass = test.is_open();
+    test.close();
+    if (pass) parseNoiseMask(*deviceObj);
+  }
+
   return deviceObj;
 }
 
+void parseNoiseMask(Device& device) {
+  std::ifstream file(device.m_noiseMaskFile.c_str());
+  if (!file) throw std::runtime_error(
+        "Mechanics: parseNoiseMask: unable to open file");
+
+  // Start from a clear mask the size of each sensor
+  for (size_t i = 0; i < device.getNumSensors(); i++) {
+    Sensor& sensor = device.getSensor(i);
+    sensor.m_noiseMask.resize(sensor.m_ncols, sensor.m_nrows);
+  }
+
+  std::string line;
+  // Each line flags a pixel as: sensor, column, row
+  while (std::getline(file, line)) {
+    prepareLine(line);  // crop to #, and trim leading space
+    if (line.empty()) continue;
+
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::stringstream ss(line);
+    size_t nsensor = 0;
+    unsigned col = 0;
+    unsigned row = 0;
+    if (!(ss >> nsensor >> col >> row))
+      throw std::runtime_error("Mechanics: parseNoiseMask: bad line");
+
+    if (nsensor >= device.getNumSensors())
+      throw std::runtime_error("Mechanics: parseNoiseMask: sensor not found");
+    Sensor& sensor = device.getSensor(nsensor);
+    if (col >= sensor.m_ncols || row >= sensor.m_nrows)
+      throw std::runtime_error("Mechanics: parseNoiseMask: pixel outside sensor");
+    sensor.m_noiseMask.set(col, row);
+  }
+  file.close();
+}
+
 void parseAlignment(Device& device) {
   std::ifstream file(device.m_alignmentFile.c_str());
   if (!file) throw std::runtime_error(
@@ -100,10 +100,10 @@ void NoiseMask::readMask()
   file.close();
 }
 
-std::vector<bool**> NoiseMask::getMaskArrays() const {
-  std::vector<bool**> masks;
+std::vector<const Storage::PixelMask*> NoiseMask::getMaskArrays() const {
+  std::vector<const Storage::PixelMask*> masks;
   for (unsigned int nsens = 0; nsens < _device->getNumSensors(); nsens++)
-    masks.push_back(_device->getSensor(nsens)->getNoiseMask());
+    masks.push_back(&_device->getSensor(nsens)->getNoiseMask());
   return masks;
 }
 
@@ -6,6 +6,8 @@
 #include <sstream>
 #include <string>
 
+#include "../../include/storage/pixelmask.h"
+
 /*******************************************************************************
  * Writes and reads from a textfile of all noisy pixels in the format:
  * sensor, x, y
@@ -30,7 +32,7 @@ public:
   void writeMask();
   void readMask();
 
-  std::vector<bool**> getMaskArrays() const;
+  std::vector<const Storage::PixelMask*> getMaskArrays() const;
 
   const char* getFileName();
 };
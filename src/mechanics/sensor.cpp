@@ -33,7 +33,7 @@ void Sensor::print()
   cout << "  Noisy pixels (" << _numNoisyPixels << ")" << endl;
   for (unsigned int nx = 0; nx < getNumX(); nx++)
     for (unsigned int ny = 0; ny < getNumY(); ny++)
-      if (_noisyPixels[nx][ny]) cout << "    " << nx << " : " << ny << endl;
+      if (_noisyPixels.get(nx, ny)) cout << "    " << nx << " : " << ny << endl;
 
 }
 
@@ -81,15 +81,13 @@ void Sensor::calculateRotation()
 void Sensor::addNoisyPixel(unsigned int x, unsigned int y)
 {
   assert(x < _numX && y < _numY && "Storage: tried to add noisy pixel outside sensor");
-  _noisyPixels[x][y] = true;
+  _noisyPixels.set(x, y);
   _numNoisyPixels++;
 }
 
 void Sensor::clearNoisyPixels()
 {
-  for (unsigned int x = 0; x < _numX; x++)
-    for (unsigned int y = 0; y < _numY; y++)
-      _noisyPixels[x][y] = false;
+  _noisyPixels.clear();
 }
 
 void Sensor::setOffX(double offset) { _offX = offset; }
@@ -248,7 +246,7 @@ double Sensor::getPosSensitiveY() const {
   return size;
 }
 
-bool** Sensor::getNoiseMask() const { return _noisyPixels; }
+const Storage::PixelMask& Sensor::getNoiseMask() const { return _noisyPixels; }
 unsigned int Sensor::getNumX() const { return _numX; }
 unsigned int Sensor::getNumY() const { return _numY; }
 double Sensor::getPitchX() const { return _pitchX; }
@@ -280,26 +278,14 @@ Sensor::Sensor(unsigned int numX, unsigned int numY, double pitchX, double pitch
   _depth(depth), _device(device), _name(name), _xox0(xox0),
   _offX(offX), _offY(offY), _offZ(offZ),
   _rotX(rotX), _rotY(rotY), _rotZ(rotZ),
-  _sensitiveX(pitchX * numX), _sensitiveY(pitchY * numY), _numNoisyPixels(0)
+  _sensitiveX(pitchX * numX), _sensitiveY(pitchY * numY), _numNoisyPixels(0),
+  _noisyPixels(numX, numY)
 {
   assert(device && "Sensor: need to link the sensor back to a device.");
 
   calculateRotation();
-
-  _noisyPixels = new bool*[_numX];
-  for (unsigned int x = 0; x < _numX; x++)
-  {
-    bool* row = new bool[_numY];
-    _noisyPixels[x] = row;
-  }
-  clearNoisyPixels();
 }
 
-Sensor::~Sensor()
-{
-  for (unsigned int x = 0; x < _numX; x++)
-    delete[] _noisyPixels[x];
-  delete[] _noisyPixels;
-}
+Sensor::~Sensor() { }
 
 }
@@ -26,7 +26,8 @@ Sensor::Sensor(const Sensor& copy) :
     m_ncols(copy.m_ncols),
     m_rowPitch(copy.m_rowPitch),
     m_colPitch(copy.m_colPitch),
-    m_xox0(copy.m_xox0) {}
+    m_xox0(copy.m_xox0),
+    m_noiseMask(copy.m_noiseMask) {}
 
 void Sensor::print() const {
   std::printf(
@@ -83,9 +84,10 @@ unsigned Sensor::getPixelIndex(unsigned row, unsigned col) const {
 }
 
 bool Sensor::getPixelMask(unsigned row, unsigned col) const {
-  if (m_noiseMask.empty()) throw std::runtime_error(
+  if (m_noiseMask.getNumCols() != m_ncols ||
+      m_noiseMask.getNumRows() != m_nrows) throw std::runtime_error(
       "Sensor::getPixelMask: mask is not set");
-  return m_noiseMask[getPixelIndex(row, col)];
+  return m_noiseMask.get(col, row);
 }
 
 bool Sensor::getPixelNoise(unsigned row, unsigned col) const {
@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 
+#include "../../include/storage/pixelmask.h"
+
 namespace Mechanics {
 
 class Device;
@@ -28,7 +30,7 @@ private:
   const double _sensitiveX;
   const double _sensitiveY;
   unsigned int _numNoisyPixels;
-  bool** _noisyPixels;
+  Storage::PixelMask _noisyPixels;
 
   double _rotation[3][3]; // The rotation matrix for the plane
   double _unRotate[3][3]; // Invert the rotation
@@ -51,7 +53,7 @@ public:
   void addNoisyPixel(unsigned int x, unsigned int y);
   void clearNoisyPixels();
   inline bool isPixelNoisy(unsigned int x, unsigned int y) const
-      { return _noisyPixels[x][y]; }
+      { return _noisyPixels.get(x, y); }
 
   void setOffX(double offset);
   void setOffY(double offset);
@@ -70,7 +72,7 @@ public:
   void getGlobalOrigin(double& x, double& y, double& z) const;
   void getNormalVector(double& x, double& y, double& z) const;
 
-  bool** getNoiseMask() const;
+  const Storage::PixelMask& getNoiseMask() const;
   unsigned int getNumX() const;
   unsigned int getNumY() const;
   unsigned int getPosNumX() const;
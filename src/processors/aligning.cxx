@@ -24,11 +24,9 @@ void Aligning::processEvent(
     const Storage::Plane& plane = event.getPlane(iplane);
 
     // Iterate through all hits in this place
-    const std::vector<Storage::Hit*>& hits = plane.getHits();
-    for (std::vector<Storage::Hit*>::const_iterator it = hits.begin();
-        it != hits.end(); ++it) {
+    for (size_t ihit = 0; ihit < plane.getNumHits(); ihit++) {
       double x, y, z;
-      Storage::Hit& hit = **it;
+      Storage::Hit& hit = plane.getHit(ihit);
       // Ask the device to apply first local, then global transformation to
       // the hit's pixel coordinates
       device.pixelToSpace(
@@ -37,11 +35,9 @@ void Aligning::processEvent(
     }
 
     // Iterate through all clusters in this plane
-    const std::vector<Storage::Cluster*>& clusters = plane.getClusters();
-    for (std::vector<Storage::Cluster*>::const_iterator it = clusters.begin();
-        it != clusters.end(); ++it) {
+    for (size_t icluster = 0; icluster < plane.getNumClusters(); icluster++) {
       double x, y, z;
-      Storage::Cluster& cluster = **it;
+      Storage::Cluster& cluster = plane.getCluster(icluster);
       device.pixelToSpace(
           cluster.getPixX(), cluster.getPixY(), iplane, x, y, z);
       cluster.setPos(x, y, z);
@@ -4,11 +4,15 @@
 #include <list>
 #include <stack>
 #include <cmath>
+#include <algorithm>
+#include <utility>
 
 #include "storage/hit.h"
 #include "storage/cluster.h"
 #include "storage/plane.h"
 #include "storage/event.h"
+#include "mechanics/device.h"
+#include "mechanics/sensor.h"
 #include "processors/clustering.h"
 
 namespace Processors {
@@ -49,7 +53,7 @@ void Clustering::clusterSeed(
 
 void Clustering::buildCluster(
     Storage::Cluster& cluster,
-    std::list<Storage::Hit*>& clustered) {
+    const std::vector<Storage::Hit*>& clustered) {
   const size_t nhits = clustered.size();
   cluster.reserveHits(nhits);
 
@@ -61,7 +65,7 @@ void Clustering::buildCluster(
   double m2X = 0;
   double m2Y = 0;
 
-  for (std::list<Storage::Hit*>::iterator it = clustered.begin();
+  for (std::vector<Storage::Hit*>::const_iterator it = clustered.begin();
       it != clustered.end(); ++it) {
     // Add the hit to the cluster
     Storage::Hit& hit = **it;
@@ -99,42 +103,239 @@ void Clustering::buildCluster(
         std::sqrt(m2Y/sumw * nhits/(double)(nhits-1)));
 }
 
-void Clustering::processEvent(Storage::Event& event) {
+void Clustering::scanPlane(
+    const Storage::Plane& plane,
+    PlaneClusters& clusters) {
+  // Store all hits in this plane in a list
+  std::list<Storage::Hit*> hits;
+  for (size_t ihit = 0; ihit < plane.getNumHits(); ihit++)
+    hits.push_back(&plane.getHit(ihit));
+
+  while (!hits.empty()) {
+    // Use the last hit as the seed hit, and remove from hits to cluster
+    Storage::Hit& seed = *hits.back();
+    hits.pop_back();
+    // Build the cluster, removing all clustered hits along the way
+    std::list<Storage::Hit*> clustered;
+    clusterSeed(seed, hits, clustered);
+    clusters.starts.push_back(clusters.hits.size());
+    clusters.hits.insert(clusters.hits.end(), clustered.begin(), clustered.end());
+    // Note that the clustered hits are no longer in the `hits` list, so the
+    // next pass will pick the next hit which wasn't clustered in this one
+  }
+}
+
+namespace {
+
+/** Order of the sweep, by column then row. Also compares a hit with a
+  * position, which can be past the range of the pixel indices. */
+struct SweepBefore {
+  typedef std::pair<long long, long long> Position;
+  template <class T>
+  bool operator()(const T& hit, const Position& pos) const {
+    return hit.x < pos.first || (hit.x == pos.first && hit.y < pos.second);
+  }
+  template <class T>
+  bool operator()(const T& hit1, const T& hit2) const {
+    return hit1.x < hit2.x || (hit1.x == hit2.x && hit1.y < hit2.y);
+  }
+};
+
+}
+
+void Clustering::sweepPlane(
+    const Storage::Plane& plane,
+    PlaneClusters& clusters,
+    WorkSpace& work) const {
+  const std::uint32_t nhits = plane.getNumHits();
+
+  std::vector<SweepHit>& sweep = work.sweep;
+  sweep.resize(nhits);
+  for (std::uint32_t ihit = 0; ihit < nhits; ihit++) {
+    const Storage::Hit& hit = plane.getHit(ihit);
+    sweep[ihit].x = hit.getPixX();
+    sweep[ihit].y = hit.getPixY();
+    sweep[ihit].index = ihit;
+  }
+  const SweepBefore before;
+  std::sort(sweep.begin(), sweep.end(), before);
+  work.isClustered.assign(nhits, 0);
+
+  // Seeds, searches and neighbours are taken in the same order as the scan:
+  // the last unclustered hit seeds the next cluster, the search is a stack,
+  // and the neighbours of a hit are added in their order in the plane
+  for (std::uint32_t iseed = nhits; iseed-- > 0; ) {
+    if (work.isClustered[iseed]) continue;
+    work.isClustered[iseed] = 1;
+    clusters.starts.push_back(clusters.hits.size());
+    clusters.hits.push_back(&plane.getHit(iseed));
+    work.search.assign(1, iseed);
+
+    while (!work.search.empty()) {
+      const Storage::Hit& target = plane.getHit(work.search.back());
+      work.search.pop_back();
+
+      const long long lowX = (long long)target.getPixX() - m_maxRows;
+      const long long highX = (long long)target.getPixX() + m_maxRows;
+      const long long lowY = (long long)target.getPixY() - m_maxCols;
+      const long long highY = (long long)target.getPixY() + m_maxCols;
+
+      // Walk the window one column at a time, jumping over the rows out of
+      // range in each
+      work.neighbours.clear();
+      std::vector<SweepHit>::iterator it = std::lower_bound(
+          sweep.begin(), sweep.end(),
+          SweepBefore::Position(lowX, lowY), before);
+      while (it != sweep.end() && it->x <= highX) {
+        if (it->y < lowY || it->y > highY) {
+          const long long x = it->y < lowY ? it->x : (long long)it->x+1;
+          it = std::lower_bound(
+              it, sweep.end(), SweepBefore::Position(x, lowY), before);
+          continue;
+        }
+        if (!work.isClustered[it->index]) {
+          work.isClustered[it->index] = 1;
+          work.neighbours.push_back(it->index);
+        }
+        ++it;
+      }
+
+      std::sort(work.neighbours.begin(), work.neighbours.end());
+      for (std::vector<std::uint32_t>::const_iterator ineigh =
+          work.neighbours.begin(); ineigh != work.neighbours.end(); ++ineigh) {
+        clusters.hits.push_back(&plane.getHit(*ineigh));
+        work.search.push_back(*ineigh);
+      }
+    }
+  }
+}
+
+bool Clustering::bitmapPlane(
+    const Storage::Plane& plane,
+    PlaneClusters& clusters,
+    WorkSpace& work,
+    PixelBitmap& bitmap) const {
+  const std::uint32_t nhits = plane.getNumHits();
+
+  work.pixels.resize(nhits);
+  for (std::uint32_t ihit = 0; ihit < nhits; ihit++) {
+    const Storage::Hit& hit = plane.getHit(ihit);
+    if (!bitmap.contains(hit.getPixX(), hit.getPixY())) return false;
+    work.pixels[ihit].col = hit.getPixX();
+    work.pixels[ihit].row = hit.getPixY();
+  }
+
+  // Rows of the bitmap are along y, and x is limited by `m_maxRows`
+  const std::uint32_t nlabels = bitmap.label(work.pixels, m_maxRows, m_maxCols);
+  const std::vector<std::uint32_t>& labels = bitmap.getLabels();
+
+  // Order the clusters as the other algorithms seed them, from the last hit,
+  // and count their hits
+  const std::uint32_t none = nlabels;
+  std::vector<std::uint32_t>& labelClusters = work.labelClusters;
+  std::vector<std::uint32_t>& starts = clusters.starts;
+  labelClusters.assign(nlabels, none);
+  starts.assign(nlabels+1, 0);
+  std::uint32_t nclusters = 0;
+  for (std::uint32_t ihit = nhits; ihit-- > 0; ) {
+    std::uint32_t& icluster = labelClusters[labels[ihit]];
+    if (icluster == none) icluster = nclusters++;
+    starts[icluster+1]++;
+  }
+  for (std::uint32_t icluster = 0; icluster < nclusters; icluster++)
+    starts[icluster+1] += starts[icluster];
+
+  // Hits of each cluster from the last one, so the seed comes first. Filling
+  // moves each start to the next cluster's.
+  clusters.hits.resize(nhits);
+  for (std::uint32_t ihit = nhits; ihit-- > 0; ) {
+    const std::uint32_t icluster = labelClusters[labels[ihit]];
+    clusters.hits[starts[icluster]++] = &plane.getHit(ihit);
+  }
+  starts.insert(starts.begin(), 0);
+  starts.resize(nclusters);
+
+  return true;
+}
+
+void Clustering::groupPlane(
+    const Storage::Plane& plane,
+    const Mechanics::Device* device,
+    size_t ndevice,
+    PlaneClusters& clusters,
+    WorkSpace& work) {
+  clusters.hits.clear();
+  clusters.starts.clear();
+  const size_t nhits = plane.getNumHits();
+  if (nhits == 0) return;
+
+  // Planes with enough of their sensor hit are painted in its bitmap
+  const size_t iplane = plane.getPlaneNum();
+  if (device && m_denseOccupancy > 0 && iplane < device->getNumSensors()) {
+    const Mechanics::Sensor& sensor = device->getSensorConst(iplane);
+    const double npixels = (double)sensor.m_ncols * sensor.m_nrows;
+    if (nhits >= m_denseOccupancy * npixels) {
+      PixelBitmap& bitmap = m_bitmaps[ndevice][iplane];
+      bitmap.resize(sensor.m_ncols, sensor.m_nrows);
+      if (bitmapPlane(plane, clusters, work, bitmap)) return;
+    }
+  }
+
+  if (m_algorithm == SWEEP) sweepPlane(plane, clusters, work);
+  else scanPlane(plane, clusters);
+}
+
+void Clustering::processEvent(Storage::Event& event, size_t ndevice) {
   // Don't add new clusters atop existing ones in an event
   if (event.getNumClusters())
     throw std::runtime_error("Clustering::process: event is already clustered");
 
-  // Cluster each plane's hits, plane by plane
   const size_t nplanes = event.getNumPlanes();
+  const Mechanics::Device* device =
+      ndevice < m_devices.size() ? m_devices[ndevice] : 0;
+  if (device) {
+    // Bitmaps are made up front, so that threads only use their plane's
+    if (m_bitmaps.size() < m_devices.size()) m_bitmaps.resize(m_devices.size());
+    if (m_bitmaps[ndevice].size() < nplanes) m_bitmaps[ndevice].resize(nplanes);
+  }
+  if (m_planeClusters.size() < nplanes) m_planeClusters.resize(nplanes);
+
+  // Find each plane's clusters, either in turn or spread over the threads
+  const unsigned nthreads = std::max(1u, m_threads);
+  if (m_workSpaces.size() < nthreads) m_workSpaces.resize(nthreads);
+  if (nthreads > 1 && nplanes > 1) {
+    if (!m_pool || m_pool->getNumThreads() != nthreads)
+      m_pool.reset(new ThreadPool(nthreads));
+    m_pool->run(nplanes, [&](size_t iplane, unsigned ithread) {
+      groupPlane(event.getPlane(iplane), device, ndevice,
+          m_planeClusters[iplane], m_workSpaces[ithread]); });
+  } else {
+    for (size_t iplane = 0; iplane < nplanes; iplane++)
+      groupPlane(event.getPlane(iplane), device, ndevice,
+          m_planeClusters[iplane], m_workSpaces[0]);
+  }
+
+  // Make the clusters plane by plane, so that their order and indices don't
+  // depend on which plane was grouped first
   for (size_t iplane = 0; iplane < nplanes; iplane++) {
-    const Storage::Plane& plane = event.getPlane(iplane);
-    if (plane.getNumHits() == 0) continue;
-
-    // Store all hits in this plane in a list
-    std::list<Storage::Hit*> hits(
-        plane.getHits().cbegin(), plane.getHits().cend());
-
-    while (!hits.empty()) {
-      // Use the last hit as the seed hit, and remove from hits to cluster
-      Storage::Hit& seed = *hits.back();
-      hits.pop_back();
-      // Build the cluster, removing all clustered hits along the way
-      std::list<Storage::Hit*> clustered;
-      clusterSeed(seed, hits, clustered);
+    const PlaneClusters& clusters = m_planeClusters[iplane];
+    const size_t nclusters = clusters.starts.size();
+    for (size_t icluster = 0; icluster < nclusters; icluster++) {
+      const std::uint32_t end = icluster+1 < nclusters ?
+          clusters.starts[icluster+1] : clusters.hits.size();
+      m_clusterHits.assign(
+          clusters.hits.begin() + clusters.starts[icluster],
+          clusters.hits.begin() + end);
       // Compute the cluster's values and store in cluster object
       Storage::Cluster& cluster = event.newCluster(iplane);
-      buildCluster(cluster, clustered);
-      // Note that the clustered hits are no longer in the `hits` list, so the
-      // next pass will pick the next hit which wasn't clustered in this one
+      buildCluster(cluster, m_clusterHits);
     }
   }
 }
 
 void Clustering::process() {
-  for (std::vector<Storage::Event*>::iterator it = m_events.begin();
-      it != m_events.end(); ++it)
-    processEvent(**it);
+  for (size_t ndevice = 0; ndevice < m_events.size(); ndevice++)
+    processEvent(*m_events[ndevice], ndevice);
 }
 
 }
-
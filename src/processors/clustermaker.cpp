@@ -4,77 +4,345 @@
 #include <iostream>
 #include <math.h>
 #include <float.h>
+#include <algorithm>
 
 #include "../storage/plane.h"
 #include "../storage/cluster.h"
 #include "../storage/hit.h"
 #include "../storage/event.h"
+#include "../mechanics/device.h"
+#include "../mechanics/sensor.h"
 #include "processors.h"
 
 namespace Processors {
 
-void ClusterMaker::addNeighbours(const Storage::Hit* hit, const  Storage::Plane* plane,
-                                  Storage::Cluster* cluster)
+/* The hits are neighbours if they are within the maximum separation, either
+ * in real coordinates if it is defined, or else in pixels */
+bool ClusterMaker::isNeighbour(const Storage::Hit* hit,
+                               const Storage::Hit* compare) const
 {
-  // Go through all hits
-  for (unsigned int nhit = 0; nhit < plane->getNumHits(); nhit++)
+  if (_maxSeparation > 0)
   {
-     Storage::Hit* compare = plane->getHit(nhit);
+    const double distX = compare->getPosX() - hit->getPosX();
+    const double distY = compare->getPosY() - hit->getPosY();
+    const double dist = sqrt(pow(distX, 2) + pow(distY, 2));
+    return !(dist > _maxSeparation);
+  }
+
+  const int distX = compare->getPixX() - hit->getPixX();
+  const int distY = compare->getPixY() - hit->getPixY();
+  return !(fabs(distX) > _maxSeparationX || fabs(distY) > _maxSeparationY);
+}
 
-    // Continue if this hit is already clustered or if it is the one being considered
-    if (compare->getCluster() || compare == hit) continue;
+/* Range of cells which can hold the neighbours of a hit. In real coordinates,
+ * the range is widened a little so that rounding can't leave one out. */
+void ClusterMaker::cellRange(const Storage::Hit* hit, const WorkSpace& work, Long64_t& minX,
+                             Long64_t& maxX, Long64_t& minY, Long64_t& maxY) const
+{
+  if (work.singleCell)
+  {
+    minX = maxX = minY = maxY = 0;
+  }
+  else if (_maxSeparation > 0)
+  {
+    const double x = hit->getPosX();
+    const double y = hit->getPosY();
+    const double reachX = _maxSeparation + 1e-6 * (_maxSeparation + fabs(x));
+    const double reachY = _maxSeparation + 1e-6 * (_maxSeparation + fabs(y));
+    minX = floor((x - reachX) / _maxSeparation);
+    maxX = floor((x + reachX) / _maxSeparation);
+    minY = floor((y - reachY) / _maxSeparation);
+    maxY = floor((y + reachY) / _maxSeparation);
+  }
+  else
+  {
+    const ULong64_t x = hit->getPixX();
+    const ULong64_t y = hit->getPixY();
+    const ULong64_t sizeX = (ULong64_t)_maxSeparationX + 1;
+    const ULong64_t sizeY = (ULong64_t)_maxSeparationY + 1;
+    minX = (x > _maxSeparationX ? x - _maxSeparationX : 0) / sizeX;
+    maxX = (x + _maxSeparationX) / sizeX;
+    minY = (y > _maxSeparationY ? y - _maxSeparationY : 0) / sizeY;
+    maxY = (y + _maxSeparationY) / sizeY;
+  }
+}
 
-    // If a maximum separation has been defined in real coordinates, check now
-    if (_maxSeparation > 0)
+/* Sort the plane's hits by the cell they are in */
+void ClusterMaker::fillGrid(const Storage::Plane* plane, WorkSpace& work) const
+{
+  const unsigned int numHits = plane->getNumHits();
+  work.cells.resize(numHits);
+
+  // Positions which don't make sensible cells (e.g. not finite) share one, so
+  // that every hit is compared to every other one
+  work.singleCell = false;
+  if (_maxSeparation > 0)
+  {
+    for (unsigned int nhit = 0; nhit < numHits && !work.singleCell; nhit++)
     {
-      const double distX = compare->getPosX() - hit->getPosX();
-      const double distY = compare->getPosY() - hit->getPosY();
-      const double dist = sqrt(pow(distX, 2) + pow(distY, 2));
-      if (dist > _maxSeparation) continue;
+      const Storage::Hit* hit = plane->getHit(nhit);
+      const double x = hit->getPosX() / _maxSeparation;
+      const double y = hit->getPosY() / _maxSeparation;
+      if (!(fabs(x) < 1e15 && fabs(y) < 1e15)) work.singleCell = true;
+    }
+  }
+
+  for (unsigned int nhit = 0; nhit < numHits; nhit++)
+  {
+    const Storage::Hit* hit = plane->getHit(nhit);
+    CellHit& cell = work.cells[nhit];
+    cell.nhit = nhit;
+    if (work.singleCell)
+    {
+      cell.x = cell.y = 0;
+    }
+    else if (_maxSeparation > 0)
+    {
+      cell.x = floor(hit->getPosX() / _maxSeparation);
+      cell.y = floor(hit->getPosY() / _maxSeparation);
     }
     else
     {
-      const int distX = compare->getPixX() - hit->getPixX();
-      const int distY = compare->getPixY() - hit->getPixY();
-      if (fabs(distX) > _maxSeparationX || fabs(distY) > _maxSeparationY)
-        continue;
+      cell.x = hit->getPixX() / ((ULong64_t)_maxSeparationX + 1);
+      cell.y = hit->getPixY() / ((ULong64_t)_maxSeparationY + 1);
     }
+  }
 
-    // Add this hit to the cluster we are making
-    cluster->addHit(compare);
+  std::sort(work.cells.begin(), work.cells.end());
+}
+
+/* Push a frame with the unclustered neighbours of the hit, in the order of
+ * the plane's hits */
+void ClusterMaker::pushNeighbours(const Storage::Plane* plane, unsigned int nhit,
+                                  WorkSpace& work) const
+{
+  const Storage::Hit* hit = plane->getHit(nhit);
 
-    // Continue adding neigbours of this hit into the cluster
-    addNeighbours(compare, plane, cluster);
+  Frame frame;
+  frame.begin = work.neighbours.size();
+
+  Long64_t minX = 0, maxX = 0, minY = 0, maxY = 0;
+  cellRange(hit, work, minX, maxX, minY, maxY);
+
+  // The cells of one column of the grid are contiguous
+  for (Long64_t x = minX; x <= maxX; x++)
+  {
+    CellHit first = { x, minY, 0 };
+    std::vector<CellHit>::const_iterator it =
+        std::lower_bound(work.cells.begin(), work.cells.end(), first);
+    for (; it != work.cells.end() && it->x == x && it->y <= maxY; ++it)
+    {
+      if (work.clustered[it->nhit] || it->nhit == nhit) continue;
+      if (isNeighbour(hit, plane->getHit(it->nhit)))
+        work.neighbours.push_back(it->nhit);
+    }
   }
+
+  std::sort(work.neighbours.begin() + frame.begin, work.neighbours.end());
+  frame.next = frame.begin;
+  frame.end = work.neighbours.size();
+  work.frames.push_back(frame);
 }
 
-void ClusterMaker::generateClusters(Storage::Event* event, unsigned int planeNum)
+/* Group the plane's hits into clusters of neighbours, in the order the
+ * recursive search of earlier versions made them: a cluster starts at its
+ * first hit, and a neighbour's own neighbours are added as soon as it is.
+ * The search keeps its own stack, so large clusters can't overflow the call
+ * stack, and only compares hits in neighbouring cells of the grid. */
+void ClusterMaker::findClusters(const Storage::Plane* plane, WorkSpace& work,
+                                PlaneClusters& clusters) const
 {
-   Storage::Plane* plane = event->getPlane(planeNum);
-  if (plane->getNumClusters() > 0)
-    throw "ClusterMaker: clusters already exist for this hit";
+  const unsigned int numHits = plane->getNumHits();
 
-  for (unsigned int nhit = 0; nhit < plane->getNumHits(); nhit++)
+  std::vector<unsigned int>& order = clusters.order;
+  order.clear();
+  clusters.starts.clear();
+  work.clustered.assign(numHits, false);
+  fillGrid(plane, work);
+
+  for (unsigned int nhit = 0; nhit < numHits; nhit++)
   {
-     Storage::Hit* hit = plane->getHit(nhit);
-     //std::cout << "addHit: " << nhit  << " isclustered: " <<hit->getCluster() << " isHit: " << hit->getIsHit() << std::endl;
+    if (work.clustered[nhit]) continue;
+
     // If the hit isn't clustered, make a new cluster
-    if (!hit->getCluster()) {
-       Storage::Cluster* cluster = event->newCluster(planeNum);
-      cluster->addHit(hit);
+    clusters.starts.push_back(order.size());
+    order.push_back(nhit);
+    work.clustered[nhit] = true;
+    pushNeighbours(plane, nhit, work);
+
+    while (!work.frames.empty())
+    {
+      Frame& frame = work.frames.back();
+
+      // Neighbours can have been clustered since the frame was pushed
+      while (frame.next < frame.end && work.clustered[work.neighbours[frame.next]])
+        frame.next++;
+
+      if (frame.next == frame.end)
+      {
+        // Its neighbours are the last ones on the stack
+        work.neighbours.resize(frame.begin);
+        work.frames.pop_back();
+        continue;
+      }
+
+      // Add this hit to the cluster, then its own neighbours
+      const unsigned int neighbour = work.neighbours[frame.next++];
+      order.push_back(neighbour);
+      work.clustered[neighbour] = true;
+      pushNeighbours(plane, neighbour, work);
     }
+  }
+}
+
+/* Group the hits with the sensor's occupancy bitmap, in pixel mode only. The
+ * clusters are the same as findClusters, in the same order, but their hits
+ * are in the order of the plane, which can change the rounding of the
+ * cluster values. Returns false if a hit is outside the sensor, leaving it
+ * to findClusters. */
+bool ClusterMaker::findBitmapClusters(const Storage::Plane* plane, PixelBitmap& bitmap,
+                                      WorkSpace& work, PlaneClusters& clusters) const
+{
+  const unsigned int numHits = plane->getNumHits();
+
+  work.pixels.resize(numHits);
+  for (unsigned int nhit = 0; nhit < numHits; nhit++)
+  {
+    const Storage::Hit* hit = plane->getHit(nhit);
+    if (!bitmap.contains(hit->getPixX(), hit->getPixY())) return false;
+    work.pixels[nhit].col = hit->getPixX();
+    work.pixels[nhit].row = hit->getPixY();
+  }
+
+  const unsigned int numLabels = bitmap.label(work.pixels, _maxSeparationX, _maxSeparationY);
+  const std::vector<std::uint32_t>& labels = bitmap.getLabels();
+
+  // Clusters are started by their first hit, then counted in the starts
+  std::vector<unsigned int>& labelClusters = work.labelClusters;
+  std::vector<unsigned int>& starts = clusters.starts;
+  const unsigned int none = numLabels;
+  labelClusters.assign(numLabels, none);
+  starts.assign(numLabels + 1, 0);
+  unsigned int numClusters = 0;
+  for (unsigned int nhit = 0; nhit < numHits; nhit++)
+  {
+    unsigned int& ncluster = labelClusters[labels[nhit]];
+    if (ncluster == none) ncluster = numClusters++;
+    starts[ncluster + 1]++;
+  }
+  starts.resize(numClusters + 1);
+  for (unsigned int ncluster = 0; ncluster < numClusters; ncluster++)
+    starts[ncluster + 1] += starts[ncluster];
+
+  // Place the hits, which moves each start to the next cluster's
+  clusters.order.resize(numHits);
+  for (unsigned int nhit = 0; nhit < numHits; nhit++)
+    clusters.order[starts[labelClusters[labels[nhit]]]++] = nhit;
+  starts.insert(starts.begin(), 0);
+  starts.resize(numClusters);
+
+  return true;
+}
+
+/* The bitmap with which to cluster a plane, or 0 if it isn't dense enough.
+ * Only called from one thread, as it makes the bitmaps. */
+PixelBitmap* ClusterMaker::denseBitmap(const Storage::Plane* plane,
+                                       const Mechanics::Device* device)
+{
+  const unsigned int planeNum = plane->getPlaneNum();
+  if (!device || _maxSeparation > 0 || _denseOccupancy <= 0 ||
+      planeNum >= device->getNumSensors())
+    return 0;
+
+  const Mechanics::Sensor* sensor = device->getSensor(planeNum);
+  const double numPixels = (double)sensor->getNumX() * sensor->getNumY();
+  if (plane->getNumHits() < _denseOccupancy * numPixels) return 0;
+
+  PixelBitmap& bitmap = _bitmaps[sensor];
+  bitmap.resize(sensor->getNumX(), sensor->getNumY());
+  return &bitmap;
+}
+
+void ClusterMaker::groupPlane(const Storage::Plane* plane, PixelBitmap* bitmap,
+                              WorkSpace& work, PlaneClusters& clusters) const
+{
+  if (!bitmap || !findBitmapClusters(plane, *bitmap, work, clusters))
+    findClusters(plane, work, clusters);
+}
+
+void ClusterMaker::makeClusters(Storage::Event* event, unsigned int planeNum,
+                                const PlaneClusters& clusters)
+{
+  Storage::Plane* plane = event->getPlane(planeNum);
+  const std::vector<unsigned int>& order = clusters.order;
+  const std::vector<unsigned int>& starts = clusters.starts;
+
+  for (size_t ncluster = 0; ncluster < starts.size(); ncluster++)
+  {
+    const size_t begin = starts[ncluster];
+    const size_t end = ncluster + 1 < starts.size() ? starts[ncluster + 1] : order.size();
 
-    // Add neighbouring clusters to this hit (this is recursive)
-     Storage::Cluster* lastCluster = plane->getCluster(plane->getNumClusters() - 1);
-    assert(lastCluster && "ClusterMaker: hits didn't generate any clusters");
-    addNeighbours(hit, plane, lastCluster);
+    Storage::Cluster* cluster = event->newCluster(planeNum);
+    for (size_t n = begin; n < end; n++)
+      cluster->addHit(plane->getHit(order[n]));
   }
 
-  // Recursive search has ended, finalize all the cluster information
+  // Finalize all the cluster information
   for (unsigned int i = 0; i < plane->getNumClusters(); i++)
     calculateCluster(plane->getCluster(i));
 }
 
+void ClusterMaker::generateClusters(Storage::Event* event, unsigned int planeNum,
+                                    const Mechanics::Device* device)
+{
+  Storage::Plane* plane = event->getPlane(planeNum);
+  if (plane->getNumClusters() > 0)
+    throw "ClusterMaker: clusters already exist for this hit";
+
+  if (_work.empty()) _work.resize(1);
+  if (_planeClusters.empty()) _planeClusters.resize(1);
+
+  groupPlane(plane, denseBitmap(plane, device), _work[0], _planeClusters[0]);
+  makeClusters(event, planeNum, _planeClusters[0]);
+}
+
+void ClusterMaker::generateEventClusters(Storage::Event* event,
+                                         const Mechanics::Device* device)
+{
+  const unsigned int numPlanes = event->getNumPlanes();
+  if (_numThreads <= 1 || numPlanes <= 1)
+  {
+    for (unsigned int nplane = 0; nplane < numPlanes; nplane++)
+      generateClusters(event, nplane, device);
+    return;
+  }
+
+  for (unsigned int nplane = 0; nplane < numPlanes; nplane++)
+    if (event->getPlane(nplane)->getNumClusters() > 0)
+      throw "ClusterMaker: clusters already exist for this hit";
+
+  if (_work.size() < _numThreads) _work.resize(_numThreads);
+  if (_planeClusters.size() < numPlanes) _planeClusters.resize(numPlanes);
+  if (!_pool || _pool->getNumThreads() != _numThreads)
+  {
+    delete _pool;
+    _pool = new ThreadPool(_numThreads);
+  }
+
+  // The bitmaps are made before the threads use them
+  _planeBitmaps.resize(numPlanes);
+  for (unsigned int nplane = 0; nplane < numPlanes; nplane++)
+    _planeBitmaps[nplane] = denseBitmap(event->getPlane(nplane), device);
+
+  _pool->run(numPlanes, [&](size_t nplane, unsigned int nthread) {
+    groupPlane(event->getPlane(nplane), _planeBitmaps[nplane],
+               _work[nthread], _planeClusters[nplane]);
+  });
+
+  for (unsigned int nplane = 0; nplane < numPlanes; nplane++)
+    makeClusters(event, nplane, _planeClusters[nplane]);
+}
+
 void ClusterMaker::calculateCluster(Storage::Cluster* cluster)
 {
   const double rt12 = 1.0 / sqrt(12);
@@ -128,12 +396,20 @@ void ClusterMaker::calculateCluster(Storage::Cluster* cluster)
 }
 
 ClusterMaker::ClusterMaker(unsigned int maxSeparationX, unsigned int maxSeparationY,
-                           double maxSeparation) :
+                           double maxSeparation, double denseOccupancy) :
   _maxSeparationX(maxSeparationX), _maxSeparationY(maxSeparationY),
-  _maxSeparation(maxSeparation)
+  _maxSeparation(maxSeparation), _denseOccupancy(denseOccupancy),
+  _numThreads(1), _pool(0)
 {
   if (_maxSeparation < 0)
     throw "ClusterMaker: max separation must be positive";
+  if (_denseOccupancy < 0)
+    throw "ClusterMaker: dense occupancy must be positive";
+}
+
+ClusterMaker::~ClusterMaker()
+{
+  delete _pool;
 }
 
 }
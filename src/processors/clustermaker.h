@@ -1,10 +1,20 @@
 #ifndef CLUSTERMAKER_H
 #define CLUSTERMAKER_H
 
+#include <vector>
+#include <map>
+
+#include <Rtypes.h>
+
+#include "../../include/processors/pixelbitmap.h"
+#include "../../include/processors/threadpool.h"
+
 namespace Storage { class Hit; }
 namespace Storage { class Cluster; }
 namespace Storage { class Plane; }
 namespace Storage { class Event; }
+namespace Mechanics { class Sensor; }
+namespace Mechanics { class Device; }
 
 namespace Processors {
 
@@ -14,16 +24,91 @@ private:
   const unsigned int _maxSeparationX;
   const unsigned int _maxSeparationY;
   const double _maxSeparation;
+  const double _denseOccupancy; // Fraction of a sensor hit to use its bitmap, 0 is off
+
+  // A hit in the grid of cells as large as the separation, so that its
+  // neighbours are in the adjacent cells
+  struct CellHit {
+    Long64_t x;
+    Long64_t y;
+    unsigned int nhit;
+    bool operator<(const CellHit& other) const {
+      if (x != other.x) return x < other.x;
+      if (y != other.y) return y < other.y;
+      return nhit < other.nhit;
+    }
+  };
+
+  // A hit whose neighbours are being added, in the flat search stack
+  struct Frame {
+    size_t begin; // Its first neighbour in the stack
+    size_t next;  // Next neighbour to add
+    size_t end;  // Past its last neighbour
+  };
+
+  // Work space of a thread, kept between planes to avoid allocations
+  struct WorkSpace {
+    std::vector<CellHit> cells;
+    std::vector<bool> clustered;
+    std::vector<unsigned int> neighbours;
+    std::vector<Frame> frames;
+    std::vector<PixelBitmap::Pixel> pixels;
+    std::vector<unsigned int> labelClusters;
+    bool singleCell; // All hits in one cell, if positions don't fit a grid
+  };
 
-  void addNeighbours(const Storage::Hit* hit, const Storage::Plane* plane,
-                     Storage::Cluster* cluster);
+  // The hits of a plane grouped into clusters
+  struct PlaneClusters {
+    std::vector<unsigned int> order; // Hits in the order they are clustered
+    std::vector<unsigned int> starts; // Each cluster's first hit in the order
+  };
+
+  std::vector<WorkSpace> _work; // One per thread
+  std::vector<PlaneClusters> _planeClusters; // One per plane of the event
+  std::vector<PixelBitmap*> _planeBitmaps; // Bitmap for each dense plane, or 0
+
+  // Occupancy bitmap of each sensor clustered with one
+  std::map<const Mechanics::Sensor*, PixelBitmap> _bitmaps;
+
+  unsigned int _numThreads;
+  ThreadPool* _pool; // Made when first needed
+
+  ClusterMaker(const ClusterMaker&); // Disable the copy constructor
+  ClusterMaker& operator=(const ClusterMaker&); // Disable the assignment
+
+  bool isNeighbour(const Storage::Hit* hit, const Storage::Hit* compare) const;
+  void fillGrid(const Storage::Plane* plane, WorkSpace& work) const;
+  void cellRange(const Storage::Hit* hit, const WorkSpace& work, Long64_t& minX,
+                 Long64_t& maxX, Long64_t& minY, Long64_t& maxY) const;
+  void pushNeighbours(const Storage::Plane* plane, unsigned int nhit,
+                      WorkSpace& work) const;
+  void findClusters(const Storage::Plane* plane, WorkSpace& work,
+                    PlaneClusters& clusters) const;
+  bool findBitmapClusters(const Storage::Plane* plane, PixelBitmap& bitmap,
+                          WorkSpace& work, PlaneClusters& clusters) const;
+  PixelBitmap* denseBitmap(const Storage::Plane* plane, const Mechanics::Device* device);
+  void groupPlane(const Storage::Plane* plane, PixelBitmap* bitmap,
+                  WorkSpace& work, PlaneClusters& clusters) const;
+  void makeClusters(Storage::Event* event, unsigned int planeNum,
+                    const PlaneClusters& clusters);
   void calculateCluster(Storage::Cluster* cluster);
 
 public:
   ClusterMaker(unsigned int maxSeparationX, unsigned int maxSeparationY,
-               double maxSeparation);
+               double maxSeparation, double denseOccupancy = 0);
+  ~ClusterMaker();
+
+  // Threads grouping the planes of an event in generateEventClusters
+  void setNumThreads(unsigned int value) { _numThreads = value ? value : 1; }
 
-  void generateClusters(Storage::Event* event, unsigned int planeNum);
+  // With the device, planes with many hits can be clustered in a bitmap
+  void generateClusters(Storage::Event* event, unsigned int planeNum,
+                        const Mechanics::Device* device = 0);
+  // Cluster all the planes of the event. The planes are grouped on the
+  // threads at once, but the clusters are made in plane order, so the event
+  // is the same as when clustering one plane after the other.
+  void generateEventClusters(Storage::Event* event,
+                             const Mechanics::Device* device = 0);
 };
 
 }
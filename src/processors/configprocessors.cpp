@@ -53,6 +53,8 @@ ClusterMaker* generateClusterMaker(const ConfigParser& config)
   unsigned int maxSeparationX = 0;
   unsigned int maxSeparationY = 0;
   double maxSeparation = 0;
+  double denseOccupancy = 0; // Bitmap clustering is opt-in
+  unsigned int numThreads = 1;
 
   for (unsigned int i = 0; i < config.getNumRows(); i++)
   {
@@ -64,7 +66,9 @@ ClusterMaker* generateClusterMaker(const ConfigParser& config)
         throw "Processors: not enough parameters to produce cluster maker";
 
       ClusterMaker* clusterMaker =
-          new ClusterMaker(maxSeparationX, maxSeparationY, maxSeparation);
+          new ClusterMaker(maxSeparationX, maxSeparationY, maxSeparation,
+                           denseOccupancy);
+      clusterMaker->setNumThreads(numThreads);
 
       return clusterMaker;
     }
@@ -81,6 +85,10 @@ ClusterMaker* generateClusterMaker(const ConfigParser& config)
       maxSeparationY = ConfigParser::valueToNumerical(row->value);
     else if (!row->key.compare("separation"))
       maxSeparation = ConfigParser::valueToNumerical(row->value);
+    else if (!row->key.compare("dense occupancy"))
+      denseOccupancy = ConfigParser::valueToNumerical(row->value);
+    else if (!row->key.compare("threads"))
+      numThreads = ConfigParser::valueToNumerical(row->value);
     else
       throw "Processors: can't parse cluster maker row";
   }
@@ -24,6 +24,7 @@ void Tracking::buildTrack(
   std::vector<double> ye(nclusters, 0);
   std::vector<double> z(nclusters, 0);
 
+  track.reserveClusters(nclusters);
   size_t icluster = 0;
   for (std::list<Storage::Cluster*>::const_iterator it = clusters.begin();
       it != clusters.end(); ++it) {
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <vector>
+#include <algorithm>
 #include <math.h>
 #include <iostream>
 #include <float.h>
@@ -22,6 +23,172 @@ using namespace Storage;
 
 namespace Processors {
 
+// Positions and errors past this aren't indexed, so that the search window
+// can't overflow
+static const double maxIndexed = 1e150;
+
+/* Index the clusters of a plane by their projection along the beam. Planes
+ * with positions or errors which aren't finite, or with null errors, aren't
+ * indexed: their distances can be infinite or not a number, which the search
+ * doesn't treat as a distance. */
+void TrackMaker::buildGrid(unsigned int nplane)
+{
+  const Plane* plane = _event->getPlane(nplane);
+  const unsigned int numClusters = plane->getNumClusters();
+  PlaneGrid& grid = _grids[nplane];
+
+  grid.use = false;
+  if (numClusters < _minGridClusters) return;
+  if (!(_maxClusterDist > 0 && _maxClusterDist < maxIndexed)) return;
+  if (!(fabs(_beamAngleX) < maxIndexed && fabs(_beamAngleY) < maxIndexed)) return;
+
+  grid.projX.resize(numClusters);
+  grid.projY.resize(numClusters);
+  grid.maxErrX = 0;
+  grid.maxErrY = 0;
+  grid.maxPos = 0;
+  double maxX = 0, maxY = 0;
+
+  for (unsigned int ncluster = 0; ncluster < numClusters; ncluster++)
+  {
+    const Cluster* cluster = plane->getCluster(ncluster);
+    const double errX = fabs(cluster->getPosErrX());
+    const double errY = fabs(cluster->getPosErrY());
+    if (!(errX > 0 && errX < maxIndexed && errY > 0 && errY < maxIndexed)) return;
+
+    const double offsetX = _beamAngleX * cluster->getPosZ();
+    const double offsetY = _beamAngleY * cluster->getPosZ();
+    const double pos = std::max(fabs(cluster->getPosX()) + fabs(offsetX),
+                                fabs(cluster->getPosY()) + fabs(offsetY));
+    if (!(pos < maxIndexed)) return;
+
+    const double x = cluster->getPosX() - offsetX;
+    const double y = cluster->getPosY() - offsetY;
+    grid.projX[ncluster] = x;
+    grid.projY[ncluster] = y;
+
+    grid.maxErrX = std::max(grid.maxErrX, errX);
+    grid.maxErrY = std::max(grid.maxErrY, errY);
+    grid.maxPos = std::max(grid.maxPos, pos);
+    if (!ncluster || x < grid.minX) grid.minX = x;
+    if (!ncluster || y < grid.minY) grid.minY = y;
+    if (!ncluster || x > maxX) maxX = x;
+    if (!ncluster || y > maxY) maxY = y;
+  }
+
+  // Cells as large as the window of a track whose errors are the plane's,
+  // made larger until there are few of them compared to the clusters
+  grid.cellX = _maxClusterDist * grid.maxErrX * sqrt(2.);
+  grid.cellY = _maxClusterDist * grid.maxErrY * sqrt(2.);
+  const double maxCells = 4. * numClusters;
+  while (((maxX - grid.minX) / grid.cellX + 1) * ((maxY - grid.minY) / grid.cellY + 1) > maxCells)
+  {
+    grid.cellX *= 2;
+    grid.cellY *= 2;
+  }
+  grid.numX = (unsigned int)((maxX - grid.minX) / grid.cellX) + 1;
+  grid.numY = (unsigned int)((maxY - grid.minY) / grid.cellY) + 1;
+
+  // Sort the clusters by cell, keeping their order within each cell
+  grid.starts.assign(grid.numX * grid.numY + 1, 0);
+  for (unsigned int ncluster = 0; ncluster < numClusters; ncluster++)
+  {
+    const unsigned int nx = std::min((unsigned int)((grid.projX[ncluster] - grid.minX) / grid.cellX), grid.numX - 1);
+    const unsigned int ny = std::min((unsigned int)((grid.projY[ncluster] - grid.minY) / grid.cellY), grid.numY - 1);
+    grid.starts[ny * grid.numX + nx + 1]++;
+  }
+  for (unsigned int ncell = 0; ncell < grid.numX * grid.numY; ncell++)
+    grid.starts[ncell + 1] += grid.starts[ncell];
+
+  // Placing the clusters moves each start to the next cell's
+  grid.clusters.resize(numClusters);
+  for (unsigned int ncluster = 0; ncluster < numClusters; ncluster++)
+  {
+    const unsigned int nx = std::min((unsigned int)((grid.projX[ncluster] - grid.minX) / grid.cellX), grid.numX - 1);
+    const unsigned int ny = std::min((unsigned int)((grid.projY[ncluster] - grid.minY) / grid.cellY), grid.numY - 1);
+    grid.clusters[grid.starts[ny * grid.numX + nx]++] = ncluster;
+  }
+  grid.starts.insert(grid.starts.begin(), 0);
+  grid.starts.pop_back();
+
+  grid.use = true;
+}
+
+/* List the clusters of the plane which can be within the maximal distance
+ * of the last cluster of a track, in their order in the plane. Those are the
+ * ones whose projection is within the distance for the plane's largest
+ * errors, widened for rounding. The distance is then checked as for any
+ * cluster, so the grid only skips clusters which can't match. */
+void TrackMaker::findReach(const Cluster* lastCluster, unsigned int nplane)
+{
+  const Plane* plane = _event->getPlane(nplane);
+  const PlaneGrid& grid = _grids[nplane];
+  std::vector<unsigned int>& reach = _reach[nplane];
+  reach.clear();
+
+  bool useGrid = grid.use;
+  double x = 0, y = 0, halfX = 0, halfY = 0;
+  if (useGrid)
+  {
+    const double errX = fabs(lastCluster->getPosErrX());
+    const double errY = fabs(lastCluster->getPosErrY());
+    const double offsetX = _beamAngleX * lastCluster->getPosZ();
+    const double offsetY = _beamAngleY * lastCluster->getPosZ();
+    const double pos = grid.maxPos + std::max(fabs(lastCluster->getPosX()) + fabs(offsetX),
+                                              fabs(lastCluster->getPosY()) + fabs(offsetY));
+
+    x = lastCluster->getPosX() - offsetX;
+    y = lastCluster->getPosY() - offsetY;
+    halfX = _maxClusterDist * sqrt(pow(grid.maxErrX, 2) + pow(errX, 2)) * (1 + 1e-9) + 1e-9 * pos;
+    halfY = _maxClusterDist * sqrt(pow(grid.maxErrY, 2) + pow(errY, 2)) * (1 + 1e-9) + 1e-9 * pos;
+    useGrid = halfX < maxIndexed && halfY < maxIndexed && pos < maxIndexed;
+  }
+
+  if (!useGrid)
+  {
+    for (unsigned int ncluster = 0; ncluster < plane->getNumClusters(); ncluster++)
+      reach.push_back(ncluster);
+    return;
+  }
+
+  const double lowX = (x - halfX - grid.minX) / grid.cellX;
+  const double highX = (x + halfX - grid.minX) / grid.cellX;
+  const double lowY = (y - halfY - grid.minY) / grid.cellY;
+  const double highY = (y + halfY - grid.minY) / grid.cellY;
+  if (highX < 0 || lowX >= grid.numX || highY < 0 || lowY >= grid.numY) return;
+
+  const unsigned int beginX = lowX > 0 ? (unsigned int)lowX : 0;
+  const unsigned int beginY = lowY > 0 ? (unsigned int)lowY : 0;
+  const unsigned int endX = highX < grid.numX - 1 ? (unsigned int)highX : grid.numX - 1;
+  const unsigned int endY = highY < grid.numY - 1 ? (unsigned int)highY : grid.numY - 1;
+
+  // A window covering more cells than there are clusters is cheaper to scan
+  const unsigned int numClusters = plane->getNumClusters();
+  if ((double)(endX - beginX + 1) * (endY - beginY + 1) > numClusters)
+  {
+    for (unsigned int ncluster = 0; ncluster < numClusters; ncluster++)
+      if (fabs(grid.projX[ncluster] - x) <= halfX && fabs(grid.projY[ncluster] - y) <= halfY)
+        reach.push_back(ncluster);
+    return;
+  }
+
+  for (unsigned int ny = beginY; ny <= endY; ny++)
+  {
+    for (unsigned int nx = beginX; nx <= endX; nx++)
+    {
+      const unsigned int ncell = ny * grid.numX + nx;
+      for (unsigned int n = grid.starts[ncell]; n < grid.starts[ncell + 1]; n++)
+      {
+        const unsigned int ncluster = grid.clusters[n];
+        if (fabs(grid.projX[ncluster] - x) <= halfX && fabs(grid.projY[ncluster] - y) <= halfY)
+          reach.push_back(ncluster);
+      }
+    }
+  }
+
+  std::sort(reach.begin(), reach.end());
+}
+
 void TrackMaker::searchPlane(Track* track, std::vector<Track*>& candidates,
                              unsigned int nplane)
 {
@@ -30,21 +197,27 @@ void TrackMaker::searchPlane(Track* track, std::vector<Track*>& candidates,
   assert(track && "TrackMaker: can't search plane with a void track");
   assert((int)nplane != _maskedPlane && "TrackMaker: ouch");
 
+  assert(track->getNumClusters() && "TrackMaker: the track should have been seeded");
+
   const Plane* plane = _event->getPlane(nplane);
 
+  // Only the clusters in reach of the track are tried. This plane's list isn't
+  // changed by the searches of the next planes.
+  findReach(track->getCluster(track->getNumClusters() - 1), nplane);
+  const std::vector<unsigned int>& reach = _reach[nplane];
+
   // Search over clusters in this event
   bool matchedCluster = false;
-  for (unsigned int ncluster = 0; ncluster < plane->getNumClusters() + 1; ncluster++)
+  for (unsigned int nreach = 0; nreach < reach.size() + 1; nreach++)
   {
     Track* trialTrack = 0;
 
-    assert(track->getNumClusters() && "TrackMaker: the track should have been seeded");
     Cluster* lastCluster = track->getCluster(track->getNumClusters() - 1);
 
     // Try to add the clusters to the track
-    if (ncluster < plane->getNumClusters())
+    if (nreach < reach.size())
     {
-      Cluster* cluster = plane->getCluster(ncluster);
+      Cluster* cluster = plane->getCluster(reach[nreach]);
       if (cluster->getTrack()) continue;
 
       const double errX = sqrt(pow(cluster->getPosErrX(), 2) + pow(lastCluster->getPosErrX(), 2));
@@ -65,7 +238,8 @@ void TrackMaker::searchPlane(Track* track, std::vector<Track*>& candidates,
 
       // Found a good cluster, bifurcate the track and add the cluster
       matchedCluster = true;
-      trialTrack = new Track(*track);
+      trialTrack = _event->newTrialTrack();
+      *trialTrack = *track;
       trialTrack->addCluster(cluster);
     }
     // There were no more clusters in the track
@@ -77,7 +251,7 @@ void TrackMaker::searchPlane(Track* track, std::vector<Track*>& candidates,
     else
     {
       // At least one good cluster has been found
-      delete track;
+      _event->deleteTrialTrack(track);
       continue; // This iteration of the loop isn't necessary
     }
 
@@ -101,7 +275,7 @@ void TrackMaker::searchPlane(Track* track, std::vector<Track*>& candidates,
     else if (trialTrack->getNumClusters() < _minClusters)
     {
       // This track can't continue and doesn't meet the cluster requirement
-      delete trialTrack;
+      _event->deleteTrialTrack(trialTrack);
     }
     else
     {
@@ -164,6 +338,15 @@ void TrackMaker::generateTracks(Event* event,
   assert(numSeedPlanes < _event->getNumPlanes() &&
          "TrackMaker: num seed planes is outside the plane range");
 
+  // Index the clusters of the planes searched for tracks
+  if (_grids.size() < _event->getNumPlanes())
+  {
+    _grids.resize(_event->getNumPlanes());
+    _reach.resize(_event->getNumPlanes());
+  }
+  for (unsigned int nplane = 1; nplane < _event->getNumPlanes(); nplane++)
+    if ((int)nplane != _maskedPlane) buildGrid(nplane);
+
   for (unsigned int nplane = 0; nplane < numSeedPlanes; nplane++)
   {
     if ((int)nplane == _maskedPlane) continue;
@@ -177,7 +360,7 @@ void TrackMaker::generateTracks(Event* event,
       if (cluster->getTrack()) continue;
 
       std::vector<Track*> candidates;
-      Track* seedTrack = new Track();
+      Track* seedTrack = _event->newTrialTrack();
       seedTrack->setOrigin(cluster->getPosX(), cluster->getPosY());
       seedTrack->setOriginErr(cluster->getPosErrX(), cluster->getPosErrY());
       seedTrack->addCluster(cluster);
@@ -222,7 +405,7 @@ void TrackMaker::generateTracks(Event* event,
         for (it = candidates.begin(); it != candidates.end(); ++it)
         {
           Track* candidate = *(it);
-          if (candidate != bestCandidate) delete candidate;
+          if (candidate != bestCandidate) _event->deleteTrialTrack(candidate);
         }
       }
 
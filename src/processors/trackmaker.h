@@ -21,6 +21,34 @@ private:
   Storage::Event* _event;
   int _maskedPlane;
 
+  // The clusters of a plane in a grid of cells, by their position projected
+  // along the beam to z = 0. The slope corrected distance between two
+  // clusters is then the difference of their projections.
+  struct PlaneGrid {
+    bool use; // Otherwise every cluster of the plane is tried
+    std::vector<double> projX; // Projection of each cluster
+    std::vector<double> projY;
+    double maxErrX; // Largest cluster error, which bounds the search window
+    double maxErrY;
+    double maxPos; // Largest coordinate used in the projections, for rounding
+    double minX;
+    double minY;
+    double cellX;
+    double cellY;
+    unsigned int numX;
+    unsigned int numY;
+    std::vector<unsigned int> starts; // First entry of each cell in clusters
+    std::vector<unsigned int> clusters;
+  };
+
+  static const unsigned int _minGridClusters = 8; // Fewer are all tried
+
+  std::vector<PlaneGrid> _grids;
+  // Clusters which can be in reach of the track, per plane being searched
+  std::vector< std::vector<unsigned int> > _reach;
+
+  void buildGrid(unsigned int nplane);
+  void findReach(const Storage::Cluster* lastCluster, unsigned int nplane);
   void searchPlane(Storage::Track* track, std::vector<Storage::Track*>& candidates,
                    unsigned int nplane);
 
@@ -59,6 +59,30 @@ Hit* Cluster::getHit(unsigned int n) const
 
 Plane* Cluster::getPlane() const { return _plane; }
 
+void Cluster::clear()
+{
+  _pixX = 0;
+  _pixY = 0;
+  _pixErrX = 0;
+  _pixErrY = 0;
+  _posX = 0;
+  _posY = 0;
+  _posZ = 0;
+  _posErrX = 0;
+  _posErrY = 0;
+  _posErrZ = 0;
+  _timing = 0;
+  _value = 0;
+  _t0 = 0.0;
+  _matchDistance = 0;
+  _track = 0;
+  _matchedTrack = 0;
+  _numHits = 0;
+  _hits.clear(); // Keeps its capacity for the next event
+  _index = -1;
+  _plane = 0;
+}
+
 Cluster::Cluster() :
   _posX(0), _posY(0), _posZ(0), _posErrX(0), _posErrY(0), _posErrZ(0),
   _timing(0), _value(0), _t0(0.0), _matchDistance(0), _track(0), _matchedTrack(0),
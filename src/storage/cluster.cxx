@@ -5,12 +5,16 @@
 
 #include "storage/hit.h"
 #include "storage/cluster.h"
+#include "storage/track.h"
+#include "storage/plane.h"
+#include "storage/event.h"
 
 namespace Storage {
 
 Cluster::Cluster() :
-    m_track(0),
+    m_event(0),
     m_matchedTrack(0),
+    m_ownTrack(0),
     m_matchDistance(0),
     m_pixX(0),
     m_pixY(0),
@@ -28,9 +32,12 @@ Cluster::Cluster() :
     m_plane(0) {}
 
 void Cluster::clear() {
-  m_hits.clear();
-  m_track = 0;
+  // The event resets its own table, and sets it again if re-using the cluster
+  m_event = 0;
+  m_hits = MemberRange();
   m_matchedTrack = 0;
+  m_ownTrack = 0;
+  m_ownHits.clear();
   m_matchDistance = 0;
   m_pixX = 0;
   m_pixY = 0;
@@ -60,23 +67,54 @@ void Cluster::print() {
       "  Plane:    "  << fetchPlane() << std::endl;
 }
 
+Track* Cluster::fetchTrack() const {
+  if (!m_event) return m_ownTrack;
+  return m_track ? &m_event->m_trackSlab[m_track-1] : 0;
+}
+
+Track* Cluster::fetchMatchedTrack() const {
+  if (!m_event || !m_matchedTrack) return 0;
+  return &m_event->m_trackSlab[m_matchedTrack-1];
+}
+
+Plane* Cluster::fetchPlane() const {
+  return m_event ? &m_event->getPlane(m_plane) : 0;
+}
+
 void Cluster::setTrack(Track& track) {
-  if (m_track)
+  if (fetchTrack())
     throw std::runtime_error(
         "Cluster::setTrack: cluster already in a track");
-  m_track = &track;
+  if (track.m_event != m_event)
+    throw std::runtime_error(
+        "Cluster::setTrack: cluster and track in different events");
+  if (m_event)
+    m_track = track.m_index+1;
+  else
+    m_ownTrack = &track;
+}
+
+void Cluster::reserveHits(size_t n) {
+  if (m_event)
+    m_event->m_clusterHits.reserve(m_hits, n);
+  else
+    m_ownHits.reserve(n);
 }
 
 void Cluster::addHit(Hit& hit) {
   hit.setCluster(*this);
-  m_hits.push_back(&hit);
+  if (m_event)
+    m_event->m_clusterHits.add(m_hits, m_event->m_hitSlab.indexOf(hit));
+  else
+    m_ownHits.push_back(&hit);
 }
 
 Hit& Cluster::getHit(size_t n) const {
   if (n >= getNumHits())
     throw std::out_of_range(
         "Cluster::getHit: requested hit out of range");
-  return *m_hits[n];
+  if (!m_event) return *m_ownHits[n];
+  return m_event->m_hitSlab[m_event->m_clusterHits.get(m_hits, n)];
 }
 
 }
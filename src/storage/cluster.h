@@ -38,6 +38,7 @@ protected:
   Plane* _plane; // The plane containing the cluster
   Cluster(); // The Event class manages the memory, not the user
   ~Cluster() { ; } // The user can't delete Cluster pointers
+  void clear(); // Reset the values so a recycled cluster can be re-used
 
 public:
   void print();
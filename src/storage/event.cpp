@@ -10,6 +10,7 @@
 #include "cluster.h"
 #include "track.h"
 #include "plane.h"
+#include "storageio.h"
 
 using std::cout;
 using std::endl;
@@ -33,7 +34,7 @@ void Event::print()
 
 Hit* Event::newHit(unsigned int nplane)
 {
-  Hit* hit = new Hit();
+  Hit* hit = _storage ? _storage->newHit() : new Hit();
   _hits.push_back(hit);
   _planes.at(nplane)->addHit(hit);
   _numHits++;
@@ -42,7 +43,7 @@ Hit* Event::newHit(unsigned int nplane)
 
 Cluster* Event::newCluster(unsigned int nplane)
 {
-  Cluster* cluster = new Cluster();
+  Cluster* cluster = _storage ? _storage->newCluster() : new Cluster();
   cluster->_index = _numClusters;
   _clusters.push_back(cluster);
   _planes.at(nplane)->addCluster(cluster);
@@ -59,11 +60,22 @@ void Event::addTrack(Track* track)
 
 Track* Event::newTrack()
 {
-  Track* track = new Track();
+  Track* track = _storage ? _storage->newTrack() : new Track();
   addTrack(track);
   return track;
 }
 
+Track* Event::newTrialTrack()
+{
+  return _storage ? _storage->newTrack() : new Track();
+}
+
+void Event::deleteTrialTrack(Track* track)
+{
+  if (_storage) _storage->releaseTrack(track);
+  else delete track;
+}
+
 Hit* Event::getHit(unsigned int n) const
 {
   assert(n < getNumHits() && "Event: hit index exceeds vector range");
@@ -88,9 +100,43 @@ Track* Event::getTrack(unsigned int n) const
   return _tracks.at(n);
 }
 
+void Event::clear()
+{
+  // The objects aren't deleted: a recycling storage takes them back first
+  _hits.clear();
+  _numHits = 0;
+  _clusters.clear();
+  _numClusters = 0;
+  _tracks.clear();
+  _numTracks = 0;
+
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+    _planes.at(nplane)->clear();
+
+  _timeStamp = 0;
+  _frameNumber = 0;
+  _triggerOffset = 0;
+  _triggerInfo = 0;
+  _invalid = false;
+  _sourceEntry = -1;
+}
+
 Event::Event(unsigned int numPlanes) :
-  _timeStamp(0), _frameNumber(0), _triggerOffset(0), _invalid(false),
-  _numHits(0), _numClusters(0), _numPlanes(numPlanes), _numTracks(0)
+  _storage(0), _timeStamp(0), _frameNumber(0), _triggerOffset(0),
+  _triggerInfo(0), _invalid(false), _sourceEntry(-1), _numHits(0), _numClusters(0),
+  _numPlanes(numPlanes), _numTracks(0)
+{
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    Plane* plane = new Plane(nplane);
+    _planes.push_back(plane);
+  }
+}
+
+Event::Event(StorageIO* storage, unsigned int numPlanes) :
+  _storage(storage), _timeStamp(0), _frameNumber(0), _triggerOffset(0),
+  _triggerInfo(0), _invalid(false), _sourceEntry(-1), _numHits(0), _numClusters(0),
+  _numPlanes(numPlanes), _numTracks(0)
 {
   for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
   {
@@ -101,6 +147,14 @@ Event::Event(unsigned int numPlanes) :
 
 Event::~Event()
 {
+  // Hits, clusters and tracks of a recycled event belong to the storage pools
+  if (_storage)
+  {
+    for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+      delete _planes.at(nplane);
+    return;
+  }
+
   for (unsigned int nhit = 0; nhit < _numHits; nhit++)
     delete _hits.at(nhit);
   for (unsigned int ncluster = 0; ncluster < _numClusters; ncluster++)
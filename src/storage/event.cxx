@@ -22,11 +22,9 @@ Event::Event(StorageIO& storage) :
     m_triggerOffset(0),
     m_triggerInfo(0),
     m_invalid(false) {
-  if (m_storage->m_event)
-    throw std::runtime_error("Event::Event: StorageIO already owns an event");
   // Allocate the planes used to associate hits and clusters
   for (size_t i = 0; i < m_planes.size(); i++)
-    m_planes[i] = new Plane(i);
+    m_planes[i] = new Plane(*this, i);
 }
 
 Event::Event(size_t numPlanes) :
@@ -39,30 +37,24 @@ Event::Event(size_t numPlanes) :
     m_invalid(false) {
   // Allocate the planes used to associate hits and clusters
   for (size_t i = 0; i < m_planes.size(); i++)
-    m_planes[i] = new Plane(i);
+    m_planes[i] = new Plane(*this, i);
 }
 
 Event::~Event() {
-  for (std::vector<Hit*>::iterator it = m_hits.begin();
-      it != m_hits.end(); ++it)
-    delete (*it);
-  for (std::vector<Cluster*>::iterator it = m_clusters.begin();
-      it != m_clusters.end(); ++it)
-    delete (*it);
+  // Hits, clusters and tracks are freed with their slabs
   for (std::vector<Plane*>::iterator it = m_planes.begin();
       it != m_planes.end(); ++it)
     delete (*it);
-  for (std::vector<Track*>::iterator it = m_tracks.begin();
-      it != m_tracks.end(); ++it)
-    delete (*it);
 }
 
 void Event::clear() {
-  // WARNING: clearing will reqlinquish ownership of objects within. These
-  // objects will be cached by StorageIO and cleared when needed again
-  m_hits.clear();
-  m_clusters.clear();
-  m_tracks.clear();
+  // The objects stay in the slabs, and are cleared when handed out again
+  m_hitSlab.clear();
+  m_clusterSlab.clear();
+  m_trackSlab.clear();
+  m_clusterHits.clear();
+  m_trackClusters.clear();
+  m_matchedClusters.clear();
   
   // Still own planes, so clear manually
   for (std::vector<Plane*>::iterator it = m_planes.begin();
@@ -92,61 +84,69 @@ void Event::print() {
 }
 
 Hit& Event::newHit(size_t nplane) {
-  Hit* hit = 0;
-  // If the event is managed by storage, use its cache for the hit
-  if (m_storage) {
-    hit = &m_storage->newHit();
-    hit->clear();  // Clear prior values
-  } else {
-    hit = new Hit();
-  }
-  // This event now owns the hit's memory, unless it is cleared
-  m_hits.push_back(hit);
+  Plane& plane = getPlane(nplane);
+  const std::uint32_t index = m_hitSlab.size();
+  Hit& hit = m_hitSlab.add();
+  hit.clear();  // Clear prior values
+  hit.m_event = this;
   // Do the two way plane association
-  m_planes[nplane]->m_hits.push_back(hit);
-  hit->m_plane = m_planes[nplane];
+  plane.m_hits.extend(index);
+  hit.m_plane = nplane;
   // Return a reference to make ownership clear
-  return *hit;
+  return hit;
 }
 
 Cluster& Event::newCluster(size_t nplane) {
-  Cluster* cluster = 0;
-  if (m_storage) {
-    cluster = &m_storage->newCluster();
-  } else {
-    cluster = new Cluster();
-  }
-  cluster->m_index = getNumClusters();
-  m_clusters.push_back(cluster);
-  m_planes[nplane]->m_clusters.push_back(cluster);
-  cluster->m_plane = m_planes[nplane];
-  return *cluster;
+  Plane& plane = getPlane(nplane);
+  const std::uint32_t index = m_clusterSlab.size();
+  Cluster& cluster = m_clusterSlab.add();
+  cluster.clear();
+  cluster.m_event = this;
+  cluster.m_index = index;
+  plane.m_clusters.extend(index);
+  cluster.m_plane = nplane;
+  return cluster;
 }
 
 Track& Event::newTrack() {
-  Track* track = 0;
-  if (m_storage) {
-    track = &m_storage->newTrack();
-  } else {
-    track = new Track();
-  }
-  track->m_index = getNumTracks();
-  m_tracks.push_back(track);
-  return *track;
+  const std::uint32_t index = m_trackSlab.size();
+  Track& track = m_trackSlab.add();
+  track.clear();
+  track.m_event = this;
+  track.m_index = index;
+  return track;
+}
+
+/** Objects of `range` in `slab` as one array, if they are contiguous */
+template <class T>
+static bool slabSpan(const Slab<T>& slab, const SlabRange& range, Span<T>& span) {
+  if (!range.isRange() || !slab.isContiguous(range.begin, range.end))
+    return false;
+  span = range.begin == range.end ?
+      Span<T>() : Span<T>(&slab[range.begin], range.end-range.begin);
+  return true;
+}
+
+bool Event::getPlaneHits(size_t nplane, Span<Hit>& hits) const {
+  return slabSpan(m_hitSlab, getPlane(nplane).getHitRange(), hits);
+}
+
+bool Event::getPlaneClusters(size_t nplane, Span<Cluster>& clusters) const {
+  return slabSpan(m_clusterSlab, getPlane(nplane).getClusterRange(), clusters);
 }
 
 Hit& Event::getHit(size_t n) const {
   if (n >= getNumHits())
     throw std::out_of_range(
         "Event::getHit: requested hit out of range");
-  return *m_hits[n];
+  return m_hitSlab[n];
 }
 
 Cluster& Event::getCluster(size_t n) const {
   if (n >= getNumClusters())
     throw std::out_of_range(
         "Event::getCluster: requested cluster out of range");
-  return *m_clusters[n];
+  return m_clusterSlab[n];
 }
 
 Plane& Event::getPlane(size_t n) const {
@@ -160,7 +160,7 @@ Track& Event::getTrack(size_t n) const {
   if (n >= getNumTracks())
     throw std::out_of_range(
         "Event::getTrack: requested track out of range");
-  return *m_tracks[n];
+  return m_trackSlab[n];
 }
 
 }
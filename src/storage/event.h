@@ -14,15 +14,19 @@ class Hit;
 class Cluster;
 class Track;
 class Plane;
+class StorageIO;
 
 class Event
 {
 private:
+  StorageIO* _storage; // Storage recycling this event's objects, if any
+
   ULong64_t _timeStamp;
   ULong64_t _frameNumber;
   unsigned int _triggerOffset;
   unsigned int _triggerInfo; // Dammit Andrej!
   bool _invalid;
+  Long64_t _sourceEntry; // Entry of this event in the full (unskimmed) file
 
   unsigned int _numHits;
   std::vector<Hit*> _hits;
@@ -39,6 +43,16 @@ private:
 protected:
   void addTrack(Track* track);
 
+  /* Tracks tried by the TrackMaker before it adds the best ones. Those of a
+   * recycled event come from and go back to the storage's pool. */
+  Track* newTrialTrack();
+  void deleteTrialTrack(Track* track);
+
+  /* Recycled events are owned by a storage which provides their hits,
+   * clusters and tracks from its pools. */
+  Event(StorageIO* storage, unsigned int numPlanes);
+  void clear(); // Forget all objects and values so the event can be re-used
+
 public:
   Event(unsigned int numPlanes);
   ~Event();
@@ -59,6 +73,7 @@ public:
   inline void setFrameNumber(ULong64_t frameNumber) { _frameNumber = frameNumber; }
   inline void setTriggerOffset(unsigned int triggerOffset) { _triggerOffset = triggerOffset; }
   inline void setTriggerInfo(unsigned int triggerInfo) { _triggerInfo = triggerInfo; }
+  inline void setSourceEntry(Long64_t entry) { _sourceEntry = entry; }
 
   inline unsigned int getNumHits() const { return _numHits; }
   inline unsigned int getNumClusters() const { return _numClusters; }
@@ -69,8 +84,10 @@ public:
   inline ULong64_t getFrameNumber() const { return _frameNumber; }
   inline unsigned int getTriggerOffset() const { return _triggerOffset; }
   inline unsigned int getTriggerInfo() const { return _triggerInfo; }
+  inline Long64_t getSourceEntry() const { return _sourceEntry; }
 
   friend class Processors::TrackMaker;
+  friend class StorageIO; // Recycles the event and its objects
 };
 
 }
@@ -0,0 +1,219 @@
+#include "eventindex.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include "event.h"
+#include "plane.h"
+
+namespace Storage {
+
+/* File layout, in the byte order of the machine which wrote it: an 8 byte
+ * magic, the format version, the number of planes and the storage's tree
+ * mask, the size and modification time of the finished storage file, then
+ * one record of 32 bit words per event:
+ *   time stamp (2 words), frame number (2 words), trigger offset, invalid,
+ *   number of tracks, number of hits in each plane, number of clusters in
+ *   each plane */
+static const char INDEX_MAGIC[8] = { 'J', 'U', 'D', 'I', 'D', 'X', 0, 0 };
+static const UInt_t INDEX_VERSION = 2;
+static const size_t INDEX_STAMP = sizeof(INDEX_MAGIC) + 3 * sizeof(UInt_t);
+static const size_t INDEX_HEADER = INDEX_STAMP + 2 * sizeof(Long64_t);
+static const size_t INDEX_FIXED = 7; // Words before the plane counts
+
+// Size and modification time of a file, false if it can't be found
+static bool statFile(const char* path, Long64_t& size, Long64_t& time)
+{
+  struct stat info;
+  if (stat(path, &info) != 0) return false;
+  size = info.st_size;
+  time = info.st_mtime;
+  return true;
+}
+
+EventSummary::EventSummary() :
+  _timeStamp(0), _frameNumber(0), _triggerOffset(0), _invalid(false),
+  _numTracks(0), _numHits(0), _numClusters(0), _hitsExact(true)
+{ }
+
+size_t EventIndex::getRecordSize() const
+{
+  return (INDEX_FIXED + 2 * _numPlanes) * sizeof(UInt_t);
+}
+
+const EventSummary* EventIndex::readSummary(Long64_t n)
+{
+  if (_fileMode == OUTPUT) throw "EventIndex: can't read summary in output mode";
+  if (n < 0 || n >= _numEvents) throw "EventIndex: requested event outside range";
+
+  _file.seekg(INDEX_HEADER + n * getRecordSize());
+  _file.read((char*)&_record[0], getRecordSize());
+  if (!_file) throw "EventIndex: error reading index record";
+
+  if (!(_treeMask & Flags::EVENTINFO))
+  {
+    std::memcpy(&_summary._timeStamp, &_record[0], sizeof(ULong64_t));
+    std::memcpy(&_summary._frameNumber, &_record[2], sizeof(ULong64_t));
+    _summary._triggerOffset = _record[4];
+    _summary._invalid = _record[5];
+  }
+
+  _summary._numTracks = (_treeMask & Flags::TRACKS) ? 0 : _record[6];
+
+  _summary._numHits = 0;
+  _summary._numClusters = 0;
+  for (unsigned int nplane = 0; nplane < _planes.size(); nplane++)
+  {
+    const unsigned int nfile = _planes.at(nplane);
+    _summary._planeHits.at(nplane) = (_treeMask & Flags::HITS) ?
+        0 : _record[INDEX_FIXED + nfile];
+    _summary._planeClusters.at(nplane) = (_treeMask & Flags::CLUSTERS) ?
+        0 : _record[INDEX_FIXED + _numPlanes + nfile];
+    _summary._numHits += _summary._planeHits.at(nplane);
+    _summary._numClusters += _summary._planeClusters.at(nplane);
+  }
+
+  return &_summary;
+}
+
+void EventIndex::writeEvent(const Event* event)
+{
+  if (_fileMode == INPUT) throw "EventIndex: can't write event in input mode";
+  if (event->getNumPlanes() != _numPlanes)
+    throw "EventIndex: event planes don't match the index";
+
+  // Record what the storage will read back: nothing from masked trees
+  _record.assign(_record.size(), 0);
+
+  if (!(_treeMask & Flags::EVENTINFO))
+  {
+    const ULong64_t timeStamp = event->getTimeStamp();
+    const ULong64_t frameNumber = event->getFrameNumber();
+    std::memcpy(&_record[0], &timeStamp, sizeof(ULong64_t));
+    std::memcpy(&_record[2], &frameNumber, sizeof(ULong64_t));
+    _record[4] = event->getTriggerOffset();
+    _record[5] = event->getInvalid();
+  }
+
+  if (!(_treeMask & Flags::TRACKS)) _record[6] = event->getNumTracks();
+
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    const Plane* plane = event->getPlane(nplane);
+    if (!(_treeMask & Flags::HITS))
+      _record[INDEX_FIXED + nplane] = plane->getNumHits();
+    if (!(_treeMask & Flags::CLUSTERS))
+      _record[INDEX_FIXED + _numPlanes + nplane] = plane->getNumClusters();
+  }
+
+  _file.write((const char*)&_record[0], getRecordSize());
+  if (!_file) throw "EventIndex: error writing index record";
+  _numEvents++;
+}
+
+void EventIndex::stampStorage(const char* storagePath)
+{
+  if (_fileMode == INPUT) throw "EventIndex: can't stamp the storage in input mode";
+  if (!statFile(storagePath, _storageSize, _storageTime))
+    throw "EventIndex: unable to find the indexed storage";
+
+  const Long64_t stamp[2] = { _storageSize, _storageTime };
+  _file.seekp(INDEX_STAMP);
+  _file.write((const char*)stamp, sizeof(stamp));
+  _file.seekp(0, std::ios::end);
+  if (!_file) throw "EventIndex: error writing index header";
+}
+
+bool EventIndex::matchesStorage(const char* storagePath) const
+{
+  Long64_t size = 0;
+  Long64_t time = 0;
+  if (!statFile(storagePath, size, time)) return false;
+  return size == _storageSize && time == _storageTime;
+}
+
+void EventIndex::setHitsExact(bool value) { _summary._hitsExact = value; }
+
+Long64_t EventIndex::getNumEvents() const { return _numEvents; }
+
+unsigned int EventIndex::getNumPlanes() const { return _numPlanes; }
+
+unsigned int EventIndex::getStorageMask() const { return _storageMask; }
+
+std::string EventIndex::indexPath(const char* storagePath)
+{
+  return std::string(storagePath) + ".idx";
+}
+
+EventIndex::EventIndex(const std::string& filePath, Mode fileMode, unsigned int numPlanes,
+                       const unsigned int treeMask, const std::vector<bool>* planeMask) :
+  _filePath(filePath), _fileMode(fileMode), _numPlanes(0), _numEvents(0),
+  _storageMask(treeMask), _storageSize(0), _storageTime(0), _treeMask(treeMask)
+{
+  if (fileMode == OUTPUT)
+  {
+    if (planeMask) throw "EventIndex: can't use a plane mask in output mode";
+
+    _file.open(_filePath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!_file) throw "EventIndex: unable to create index file";
+
+    // The stamp stays empty, so the index isn't used, until the storage is
+    // finished and `stampStorage` is called
+    _numPlanes = numPlanes;
+    const UInt_t header[3] = { INDEX_VERSION, _numPlanes, _storageMask };
+    const Long64_t stamp[2] = { 0, 0 };
+    _file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    _file.write((const char*)header, sizeof(header));
+    _file.write((const char*)stamp, sizeof(stamp));
+  }
+  else
+  {
+    _file.open(_filePath.c_str(), std::ios::in | std::ios::binary);
+    if (!_file) throw "EventIndex: unable to open index file";
+
+    char magic[sizeof(INDEX_MAGIC)];
+    UInt_t header[3] = { 0, 0, 0 };
+    Long64_t stamp[2] = { 0, 0 };
+    _file.read(magic, sizeof(magic));
+    _file.read((char*)header, sizeof(header));
+    if (!_file || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)))
+      throw "EventIndex: not an index file";
+    if (header[0] != INDEX_VERSION)
+      throw "EventIndex: unsupported index version";
+    _file.read((char*)stamp, sizeof(stamp));
+    if (!_file) throw "EventIndex: index file is truncated";
+    _numPlanes = header[1];
+    _storageMask = header[2];
+    _storageSize = stamp[0];
+    _storageTime = stamp[1];
+
+    // The records have a fixed size, so the file size gives the event count
+    _file.seekg(0, std::ios::end);
+    const Long64_t size = (Long64_t)_file.tellg() - (Long64_t)INDEX_HEADER;
+    if (size < 0 || size % getRecordSize())
+      throw "EventIndex: index file is truncated";
+    _numEvents = size / getRecordSize();
+
+    // Plane mask holds a true for masked planes
+    if (planeMask && planeMask->size() < _numPlanes)
+      throw "EventIndex: plane mask is too small";
+    for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+      if (!planeMask || !planeMask->at(nplane)) _planes.push_back(nplane);
+
+    _summary._planeHits.assign(_planes.size(), 0);
+    _summary._planeClusters.assign(_planes.size(), 0);
+  }
+
+  _record.assign(INDEX_FIXED + 2 * _numPlanes, 0);
+}
+
+EventIndex::~EventIndex()
+{
+  _file.close();
+}
+
+}
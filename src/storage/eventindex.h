@@ -0,0 +1,109 @@
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <Rtypes.h>
+
+#include "storageio.h"
+
+namespace Storage
+{
+
+class Event;
+
+/* Counts and event information of one event, as read from an index. Holds
+ * the same values which the event built by `StorageIO::readEvent` would
+ * report, so that event cuts can be evaluated without reading the event. */
+class EventSummary
+{
+private:
+  ULong64_t _timeStamp;
+  ULong64_t _frameNumber;
+  unsigned int _triggerOffset;
+  bool _invalid;
+
+  unsigned int _numTracks;
+  unsigned int _numHits;
+  unsigned int _numClusters;
+  std::vector<unsigned int> _planeHits;
+  std::vector<unsigned int> _planeClusters;
+
+  /* False when the storage drops hits as it reads them (noise masks, DUT hit
+   * quality), in which case the hit counts are only upper bounds */
+  bool _hitsExact;
+
+public:
+  EventSummary();
+
+  inline ULong64_t getTimeStamp() const { return _timeStamp; }
+  inline ULong64_t getFrameNumber() const { return _frameNumber; }
+  inline unsigned int getTriggerOffset() const { return _triggerOffset; }
+  inline bool getInvalid() const { return _invalid; }
+  inline unsigned int getNumTracks() const { return _numTracks; }
+  inline unsigned int getNumHits() const { return _numHits; }
+  inline unsigned int getNumClusters() const { return _numClusters; }
+  inline unsigned int getNumPlanes() const { return _planeHits.size(); }
+  inline unsigned int getNumHits(unsigned int nplane) const { return _planeHits.at(nplane); }
+  inline unsigned int getNumClusters(unsigned int nplane) const { return _planeClusters.at(nplane); }
+  inline bool getHitsExact() const { return _hitsExact; }
+
+  friend class EventIndex;
+};
+
+/* Sidecar file of fixed size records, one per event of a storage file, with
+ * the event information and the number of tracks, and of hits and clusters
+ * in each plane. It is written next to the storage (`<file>.idx`) and lets
+ * loopers skip the events which no analyzer's event cuts accept, without
+ * reading their hit, cluster and track trees. */
+class EventIndex
+{
+private:
+  std::string _filePath;
+  std::fstream _file;
+  const Mode _fileMode;
+  unsigned int _numPlanes; // Planes in the file, regardless of the plane mask
+  Long64_t _numEvents;
+
+  unsigned int _storageMask; // Trees which the storage was written without
+  Long64_t _storageSize; // Size and modification time of the indexed storage
+  Long64_t _storageTime;
+
+  std::vector<unsigned int> _planes; // File planes which are read back
+  unsigned int _treeMask; // Trees which read back as empty
+  std::vector<unsigned int> _record; // Re-used buffer for one record
+  EventSummary _summary;
+
+  size_t getRecordSize() const;
+
+public:
+  EventIndex(const std::string& filePath, Mode fileMode, unsigned int numPlanes = 0,
+             const unsigned int treeMask = 0, const std::vector<bool>* planeMask = 0);
+  ~EventIndex();
+
+  const EventSummary* readSummary(Long64_t n); // Valid until the next read
+  void writeEvent(const Event* event); // Append the event's record
+
+  // Record the finished storage's size and time, the index is used only for it
+  void stampStorage(const char* storagePath);
+  bool matchesStorage(const char* storagePath) const;
+
+  void setHitsExact(bool value);
+
+  Long64_t getNumEvents() const;
+  unsigned int getNumPlanes() const;
+  unsigned int getStorageMask() const;
+
+  // Path of the index accompanying a storage file
+  static std::string indexPath(const char* storagePath);
+
+private:
+  EventIndex(const EventIndex&); // Disable the copy constructor
+  EventIndex& operator=(const EventIndex&); // Disable the assignment operator
+};
+
+}
+
+#endif // EVENTINDEX_H
@@ -37,6 +37,24 @@ Cluster* Hit::getCluster() const { return _cluster; }
 
 Plane* Hit::getPlane() const { return _plane; }
 
+void Hit::clear()
+{
+  _pixX = 0;
+  _pixY = 0;
+  _posX = 0;
+  _posY = 0;
+  _posZ = 0;
+  _value = 0;
+  _valueInt = 0;
+  _timing = 0;
+  _t0 = 0;
+  _isHit = 1;
+  _isValidFit = 1;
+  _Chi2 = 0.0;
+  _cluster = 0;
+  _plane = 0;
+}
+
 Hit::Hit() :
   _pixX(0), _pixY(0), _posX(0), _posY(0), _posZ(0),
   _value(0), _valueInt(0), _timing(0), _t0(0), _isHit(1),
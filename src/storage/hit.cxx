@@ -3,11 +3,15 @@
 #include <stdexcept>
 
 #include "storage/hit.h"
+#include "storage/cluster.h"
+#include "storage/plane.h"
+#include "storage/event.h"
 
 namespace Storage {
 
 Hit::Hit() :
-    m_cluster(0),
+    m_event(0),
+    m_ownCluster(0),
     m_pixX(0),
     m_pixY(0),
     m_posX(0),
@@ -19,7 +23,8 @@ Hit::Hit() :
     m_plane(0) {}
 
 void Hit::clear() {
-  m_cluster = 0;
+  m_event = 0;
+  m_ownCluster = 0;
   m_pixX = 0;
   m_pixY = 0;
   m_posX = 0;
@@ -43,11 +48,26 @@ void Hit::print() {
       "  Plane:   "  << fetchPlane() << std::endl;
 }
 
+Cluster* Hit::fetchCluster() const {
+  if (!m_event) return m_ownCluster;
+  return m_cluster ? &m_event->m_clusterSlab[m_cluster-1] : 0;
+}
+
+Plane* Hit::fetchPlane() const {
+  return m_event ? &m_event->getPlane(m_plane) : 0;
+}
+
 void Hit::setCluster(Cluster& cluster) {
-  if (m_cluster)
+  if (fetchCluster())
     throw std::runtime_error(
         "Hit::setCluster: hit already in a cluster");
-  m_cluster = &cluster;
+  if (cluster.m_event != m_event)
+    throw std::runtime_error(
+        "Hit::setCluster: hit and cluster in different events");
+  if (m_event)
+    m_cluster = cluster.m_index+1;
+  else
+    m_ownCluster = &cluster;
 }
 
 }
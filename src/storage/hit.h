@@ -28,6 +28,7 @@ protected:
   Plane* _plane; // Plane in which the hit is found
   Hit(); // Hits memory is managed by the event class
   ~Hit() { ; } // The user can get Hit pointers but can't delete them
+  void clear(); // Reset the values so a recycled hit can be re-used
 
 public:
   void print();
@@ -53,6 +53,14 @@ void Plane::addCluster(Cluster* cluster)
   _numClusters++;
 }
 
+void Plane::clear()
+{
+  _hits.clear();
+  _numHits = 0;
+  _clusters.clear();
+  _numClusters = 0;
+}
+
 Hit* Plane::getHit(unsigned int n) const
 {
   assert(n < getNumHits() && "Plane: hit index exceeds vector size");
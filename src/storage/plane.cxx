@@ -6,10 +6,13 @@
 #include "storage/hit.h"
 #include "storage/cluster.h"
 #include "storage/plane.h"
+#include "storage/event.h"
 
 namespace Storage {
 
-Plane::Plane(size_t nplane) : m_planeNum(nplane) {}
+Plane::Plane(Event& event, size_t nplane) :
+    m_event(event),
+    m_planeNum(nplane) {}
 
 void Plane::clear() {
   m_hits.clear();
@@ -23,27 +26,25 @@ void Plane::print() {
       "  Num hits: " << getNumHits() << "\n"
       "  Num clusters: " << getNumClusters() << std::endl;
 
-  for (std::vector<Cluster*>::iterator it = m_clusters.begin();
-      it != m_clusters.end(); ++it)
-    (*it)->print();
+  for (size_t n = 0; n < getNumClusters(); n++)
+    getCluster(n).print();
 
-  for (std::vector<Hit*>::iterator it = m_hits.begin();
-      it != m_hits.end(); ++it)
-    (*it)->print();
+  for (size_t n = 0; n < getNumHits(); n++)
+    getHit(n).print();
 }
 
 Hit& Plane::getHit(size_t n) const {
   if (n >= getNumHits())
     throw std::out_of_range(
         "Plane::getHit: requested hit out of range");
-  return *m_hits[n];
+  return m_event.m_hitSlab[m_hits[n]];
 }
 
 Cluster& Plane::getCluster(size_t n) const {
   if (n >= getNumClusters())
     throw std::out_of_range(
         "Plane::getCluster: requated cluster out of range");
-  return *m_clusters[n];
+  return m_event.m_clusterSlab[m_clusters[n]];
 }
 
 }
@@ -27,6 +27,7 @@ protected:
   void addCluster(Cluster* cluster);
   Plane(unsigned int planeNum);
   ~Plane() { ; }
+  void clear(); // Forget the hits and clusters of a recycled event
 
 public:
   Hit* getHit(unsigned int n) const;
@@ -0,0 +1,279 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include <glob.h>
+
+#include <TROOT.h>
+
+#include "storage/storagei.h"
+#include "storage/storagechain.h"
+
+namespace Storage {
+
+StorageChain::StorageChain(
+    const std::vector<std::string>& paths,
+    int treeMask,
+    const std::vector<bool>* planeMask,
+    const std::set<std::string>* hitsBranchesOff,
+    const std::set<std::string>* clustersBranchesOff,
+    const std::set<std::string>* tracksBranchesOff,
+    const std::set<std::string>* eventInfoBranchesOff) :
+    m_paths(paths),
+    m_treeMask(treeMask),
+    m_planeMask(planeMask ? *planeMask : std::vector<bool>()),
+    m_usePlaneMask(planeMask != 0),
+    m_maskMode(StorageIO::REMOVE),
+    m_offsets(1, 0),
+    m_numPlanes(0),
+    m_current(0),
+    m_ncurrent(0),
+    m_next(0),
+    m_nnext(0),
+    m_prefetchDepth(0),
+    m_prefetchStart(0),
+    m_prefetchEnd(0),
+    m_prefetchStep(1),
+    m_maxHits(0),
+    m_maxClusters(0),
+    m_maxTracks(0) {
+  if (m_paths.empty())
+    throw std::runtime_error("StorageChain::StorageChain: no files given");
+
+  if (hitsBranchesOff) m_branchesOff[0] = *hitsBranchesOff;
+  if (clustersBranchesOff) m_branchesOff[1] = *clustersBranchesOff;
+  if (tracksBranchesOff) m_branchesOff[2] = *tracksBranchesOff;
+  if (eventInfoBranchesOff) m_branchesOff[3] = *eventInfoBranchesOff;
+
+  // Count the events of each file. The first is kept open for reading.
+  m_current = openSegment(0);
+  m_numPlanes = m_current->getNumPlanes();
+  m_offsets.push_back(m_current->getNumEvents());
+  try {
+    for (size_t i = 1; i < m_paths.size(); i++) {
+      StorageI* segment = openSegment(i);
+      const size_t numPlanes = segment->getNumPlanes();
+      const Long64_t numEvents = segment->getNumEvents();
+      delete segment;
+      if (numPlanes != m_numPlanes)
+        throw std::runtime_error(
+            "StorageChain::StorageChain: files have different planes");
+      m_offsets.push_back(m_offsets.back() + numEvents);
+    }
+  } catch (...) {
+    delete m_current;
+    throw;
+  }
+
+  // Following files are opened while the open one is read
+  if (m_paths.size() > 1) ROOT::EnableThreadSafety();
+  openFollowing();
+}
+
+StorageChain::~StorageChain() {
+  joinOpener();
+  delete m_next;
+  delete m_current;
+}
+
+std::vector<std::string> StorageChain::expandPaths(const std::string& spec) {
+  std::vector<std::string> paths;
+
+  size_t begin = 0;
+  while (begin <= spec.size()) {
+    size_t end = spec.find(',', begin);
+    if (end == std::string::npos) end = spec.size();
+    const std::string item = spec.substr(begin, end-begin);
+    begin = end+1;
+    if (item.empty()) continue;
+
+    // Plain paths are kept as given, even if they don't exist yet, so that
+    // the error is reported when opening them
+    if (item.find_first_of("*?[") == std::string::npos) {
+      paths.push_back(item);
+      continue;
+    }
+
+    glob_t matches;
+    const int status = glob(item.c_str(), 0, 0, &matches);
+    if (status != 0) {
+      globfree(&matches);
+      throw std::runtime_error(
+          "StorageChain::expandPaths: no files match " + item);
+    }
+    // glob returns the matches sorted
+    for (size_t i = 0; i < matches.gl_pathc; i++)
+      paths.push_back(matches.gl_pathv[i]);
+    globfree(&matches);
+  }
+
+  return paths;
+}
+
+StorageI* StorageChain::openSegment(size_t nsegment) const {
+  StorageI* segment = new StorageI(
+      m_paths.at(nsegment),
+      m_treeMask,
+      m_usePlaneMask ? &m_planeMask : 0,
+      &m_branchesOff[0],
+      &m_branchesOff[1],
+      &m_branchesOff[2],
+      &m_branchesOff[3]);
+  try {
+    segment->setNoiseMasks(m_noiseMasks, m_maskMode);
+  } catch (...) {
+    delete segment;
+    throw;
+  }
+  return segment;
+}
+
+void StorageChain::setNoiseMasks(
+    const std::vector<PixelMask>& masks,
+    StorageIO::MaskMode mode) {
+  // The file opening in the background takes the masks as it is opened
+  joinOpener();
+  m_current->setNoiseMasks(masks, mode);
+  if (m_next) m_next->setNoiseMasks(masks, mode);
+  m_noiseMasks = masks;
+  m_maskMode = mode;
+}
+
+void StorageChain::joinOpener() {
+  if (m_opener.joinable()) m_opener.join();
+}
+
+void StorageChain::selectSegment(size_t nsegment) {
+  if (m_current && nsegment == m_ncurrent) return;
+
+  // Keep the high-water marks of the file being closed
+  if (m_current) {
+    m_maxHits = std::max(m_maxHits, m_current->getMaxHits());
+    m_maxClusters = std::max(m_maxClusters, m_current->getMaxClusters());
+    m_maxTracks = std::max(m_maxTracks, m_current->getMaxTracks());
+    delete m_current;
+    m_current = 0;
+  }
+
+  // Use the file opened in the background if it is the one needed
+  joinOpener();
+  if (m_next && m_nnext == nsegment) {
+    m_current = m_next;
+    m_next = 0;
+  } else if (!m_openerError.empty() && m_nnext == nsegment) {
+    const std::string error = m_openerError;
+    m_openerError.clear();
+    throw std::runtime_error(error);
+  } else {
+    m_current = openSegment(nsegment);
+  }
+  m_ncurrent = nsegment;
+  prefetchSegment();
+  openFollowing();
+}
+
+void StorageChain::openFollowing() {
+  // Start opening the following file, unless it was already opened
+  const size_t following = m_ncurrent+1;
+  if (following >= m_paths.size()) return;
+  if (m_next && m_nnext == following) return;
+  joinOpener();
+  delete m_next;
+  m_next = 0;
+  m_nnext = following;
+  m_openerError.clear();
+  m_opener = std::thread([this, following]() {
+    try {
+      m_next = openSegment(following);
+    } catch (std::exception& e) {
+      m_openerError = e.what();
+    }
+  });
+}
+
+Long64_t StorageChain::seek(Long64_t n) {
+  if (n < 0 || n >= getNumEvents())
+    throw std::out_of_range("StorageChain::seek: event out of range");
+
+  // Most reads are in the open file, check it before searching
+  if (!m_current || n < m_offsets[m_ncurrent] || n >= m_offsets[m_ncurrent+1]) {
+    const size_t nsegment =
+        std::upper_bound(m_offsets.begin(), m_offsets.end(), n) -
+        m_offsets.begin() - 1;
+    selectSegment(nsegment);
+  }
+
+  return n - m_offsets[m_ncurrent];
+}
+
+Event& StorageChain::readEvent(Long64_t n) {
+  const Long64_t local = seek(n);
+  return m_current->readEvent(local);
+}
+
+const EventView& StorageChain::readView(Long64_t n) {
+  const Long64_t local = seek(n);
+  return m_current->readView(local);
+}
+
+void StorageChain::prefetchSegment() {
+  if (!m_prefetchDepth) return;
+
+  const Long64_t first = m_offsets[m_ncurrent];
+  const Long64_t last = m_offsets[m_ncurrent+1];
+
+  // First entry of the range in this file, keeping in step with the range
+  Long64_t start = m_prefetchStart;
+  if (start < first)
+    start += ((first-start + m_prefetchStep-1) / m_prefetchStep) * m_prefetchStep;
+  const Long64_t end = std::min(m_prefetchEnd, last);
+  if (start >= end) return;
+
+  m_current->startPrefetch(
+      m_prefetchDepth, start-first, end-first, m_prefetchStep);
+}
+
+void StorageChain::startPrefetch(
+    size_t depth,
+    Long64_t start,
+    Long64_t end,
+    Long64_t step) {
+  stopPrefetch();
+  if (depth == 0 || step <= 0) return;
+
+  m_prefetchDepth = depth;
+  m_prefetchStart = start;
+  m_prefetchEnd = end;
+  m_prefetchStep = step;
+
+  // Open the file holding the start of the range, which sets off its
+  // read-ahead. Otherwise start it in the already open file.
+  if (start >= 0 && start < getNumEvents()) {
+    const bool opened = m_current &&
+        start >= m_offsets[m_ncurrent] && start < m_offsets[m_ncurrent+1];
+    if (opened) prefetchSegment();
+    else seek(start);
+  }
+}
+
+void StorageChain::stopPrefetch() {
+  m_prefetchDepth = 0;
+  if (m_current) m_current->stopPrefetch();
+}
+
+Int_t StorageChain::getMaxHits() const {
+  return std::max(m_maxHits, m_current->getMaxHits());
+}
+
+Int_t StorageChain::getMaxClusters() const {
+  return std::max(m_maxClusters, m_current->getMaxClusters());
+}
+
+Int_t StorageChain::getMaxTracks() const {
+  return std::max(m_maxTracks, m_current->getMaxTracks());
+}
+
+}
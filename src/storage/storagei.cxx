@@ -5,11 +5,16 @@
 #include <sstream>
 #include <stdexcept>
 #include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
+#include <TROOT.h>
 #include <TFile.h>
 #include <TDirectory.h>
 #include <TTree.h>
 #include <TBranch.h>
+#include <TNamed.h>
 
 #include "storage/hit.h"
 #include "storage/cluster.h"
@@ -18,6 +23,7 @@
 #include "storage/event.h"
 #include "storage/storageio.h"
 #include "storage/storagei.h"
+#include "storage/eventview.h"
 
 #ifndef VERBOSE
 #define VERBOSE 1
@@ -34,7 +40,15 @@ StorageI::StorageI(
     const std::set<std::string>* tracksBranchesOff,
     const std::set<std::string>* eventInfoBranchesOff) :
     // Initialize base with 0 planes and count them as they are read in
-    StorageIO(filePath, INPUT, 0, treeMask) {
+    StorageIO(filePath, INPUT, 0, treeMask),
+    m_prefetchStart(0),
+    m_prefetchEnd(0),
+    m_prefetchStep(1),
+    m_prefetchDepth(0),
+    m_filled(0),
+    m_taken(0),
+    m_prefetchStop(false),
+    m_viewBound(false) {
 
   // Invert the mask to not have to check !
   treeMask = ~treeMask;
@@ -45,6 +59,19 @@ StorageI::StorageI(
   if (tracksBranchesOff) m_tracksBranchesOff = *tracksBranchesOff;
   if (eventInfoBranchesOff) m_eventInfoBranchesOff = *eventInfoBranchesOff;
 
+  // The hits and event information might be in the file from which this one
+  // was processed
+  TNamed* friendOf = 0;
+  m_file.GetObject("FriendOf", friendOf);
+  if (friendOf) {
+    m_baseFile.reset(TFile::Open(friendOf->GetTitle(), "READ"));
+    if (!m_baseFile || !m_baseFile->IsOpen())
+      throw std::runtime_error(
+          std::string("StorageI::StorageI: can't open friend base ") +
+          friendOf->GetTitle());
+  }
+  TDirectory* base = friendOf ? (TDirectory*)m_baseFile.get() : &m_file;
+
   // Keep track of the number of planes read from the file (not the same as the
   // number stored in `m_numPlanes` since some might be masked)
   size_t planeCount = 0;
@@ -75,7 +102,18 @@ StorageI::StorageI(
     TTree* hits = 0;
     // Try to load the tree if hits are enabled
     if (treeMask & HITS)
-      m_file.GetObject((ss.str()+"/Hits").c_str(), hits);
+      base->GetObject((ss.str()+"/Hits").c_str(), hits);
+    // Hit associations written beside the clusters, in place of the hits
+    TTree* links = 0;
+    if (hits && friendOf && (treeMask & CLUSTERS))
+      m_file.GetObject((ss.str()+"/HitLinks").c_str(), links);
+    if (links) {
+      m_linksTrees.push_back(links);
+      links->SetBranchAddress("NHits", &numHits);
+      // Don't read the associations of the base, if it has any
+      if (hits->GetBranch("InCluster")) hits->SetBranchStatus("InCluster", 0);
+      bindLinksBranches(links);
+    }
     // Check that a hits tree was loaded
     if (hits) {
       // Add this tree to the current plane
@@ -83,42 +121,17 @@ StorageI::StorageI(
       // Associate the tree's branch to local memory
       m_hitsBranchesOff.insert("NHits");
       hits->SetBranchAddress("NHits", &numHits);
-      // Check if the branch is flagged off
-      if (!isHitsBranchOff("PixX")) {
-        // Check if the branch is in the file, and flag off if not
-        if (!hits->GetBranch("PixX")) m_hitsBranchesOff.insert("PixX");
-        // Associate the branch to local memory
-        else hits->SetBranchAddress("PixX", hitPixX);
-      }
-      if (!isHitsBranchOff("PixY")) {
-        if (!hits->GetBranch("PixY")) m_hitsBranchesOff.insert("PixY");
-        else hits->SetBranchAddress("PixY", hitPixY);
-      }
-      if (!isHitsBranchOff("PosX")) {
-        if (!hits->GetBranch("PosX")) m_hitsBranchesOff.insert("PosX");
-        else hits->SetBranchAddress("PosX", hitPosX);
-      }
-      if (!isHitsBranchOff("PosY")) {
-        if (!hits->GetBranch("PosY")) m_hitsBranchesOff.insert("PosY");
-        else hits->SetBranchAddress("PosY", hitPosY);
-      }
-      if (!isHitsBranchOff("PosZ")) {
-        if (!hits->GetBranch("PosZ")) m_hitsBranchesOff.insert("PosZ");
-        else hits->SetBranchAddress("PosZ", hitPosZ);
-      }
-      if (!isHitsBranchOff("Value")) {
-        if (!hits->GetBranch("Value")) m_hitsBranchesOff.insert("Value");
-        else hits->SetBranchAddress("Value", hitValue);
-      }
-      if (!isHitsBranchOff("Timing")) {
-        if (!hits->GetBranch("Timing")) m_hitsBranchesOff.insert("Timing");
-        else hits->SetBranchAddress("Timing", hitTiming);
-      }
-      // Also check if cluster tree is masked before enabling association branch
-      if (!isHitsBranchOff("InCluster") && (treeMask & CLUSTERS)) {
-        if (!hits->GetBranch("InCluster")) m_hitsBranchesOff.insert("InCluster");
-        else hits->SetBranchAddress("InCluster", hitInCluster);
-      }
+      // Flag off the branches which aren't in the file
+      if (!hits->GetBranch("PixX")) m_hitsBranchesOff.insert("PixX");
+      if (!hits->GetBranch("PixY")) m_hitsBranchesOff.insert("PixY");
+      if (!hits->GetBranch("PosX")) m_hitsBranchesOff.insert("PosX");
+      if (!hits->GetBranch("PosY")) m_hitsBranchesOff.insert("PosY");
+      if (!hits->GetBranch("PosZ")) m_hitsBranchesOff.insert("PosZ");
+      if (!hits->GetBranch("Value")) m_hitsBranchesOff.insert("Value");
+      if (!hits->GetBranch("Timing")) m_hitsBranchesOff.insert("Timing");
+      if (!hits->GetBranch("InCluster") && !links) m_hitsBranchesOff.insert("InCluster");
+      // Associate the remaining branches to local memory
+      bindHitsBranches(hits);
     }
 
     TTree* clusters = 0;
@@ -127,62 +140,20 @@ StorageI::StorageI(
     if (clusters) {
       m_clustersTrees.push_back(clusters);
       clusters->SetBranchAddress("NClusters", &numClusters);
-      if (!isClustersBranchOff("PixX")) {
-        if (!clusters->GetBranch("PixX")) m_clustersBranchesOff.insert("PixX");
-        else clusters->SetBranchAddress("PixX", clusterPixX);
-      }
-      if (!isClustersBranchOff("PixY")) {
-        if (!clusters->GetBranch("PixY")) m_clustersBranchesOff.insert("PixY");
-        else clusters->SetBranchAddress("PixY", clusterPixY);
-      }
-      if (!isClustersBranchOff("PixY")) {
-        if (!clusters->GetBranch("PixY")) m_clustersBranchesOff.insert("PixY");
-        else clusters->SetBranchAddress("PixY", clusterPixY);
-      }
-      if (!isClustersBranchOff("PixErrX")) {
-        if (!clusters->GetBranch("PixErrX")) m_clustersBranchesOff.insert("PixErrX");
-        else clusters->SetBranchAddress("PixErrX", clusterPixErrX);
-      }
-      if (!isClustersBranchOff("PixErrY")) {
-        if (!clusters->GetBranch("PixErrY")) m_clustersBranchesOff.insert("PixErrY");
-        else clusters->SetBranchAddress("PixErrY", clusterPixErrY);
-      }
-      if (!isClustersBranchOff("PosX")) {
-        if (!clusters->GetBranch("PosX")) m_clustersBranchesOff.insert("PosX");
-        else clusters->SetBranchAddress("PosX", clusterPosX);
-      }
-      if (!isClustersBranchOff("PosY")) {
-        if (!clusters->GetBranch("PosY")) m_clustersBranchesOff.insert("PosY");
-        else clusters->SetBranchAddress("PosY", clusterPosY);
-      }
-      if (!isClustersBranchOff("PosZ")) {
-        if (!clusters->GetBranch("PosZ")) m_clustersBranchesOff.insert("PosZ");
-        else clusters->SetBranchAddress("PosZ", clusterPosZ);
-      }
-      if (!isClustersBranchOff("PosErrX")) {
-        if (!clusters->GetBranch("PosErrX")) m_clustersBranchesOff.insert("PosErrX");
-        else clusters->SetBranchAddress("PosErrX", clusterPosErrX);
-      }
-      if (!isClustersBranchOff("PosErrY")) {
-        if (!clusters->GetBranch("PosErrY")) m_clustersBranchesOff.insert("PosErrY");
-        else clusters->SetBranchAddress("PosErrY", clusterPosErrY);
-      }
-      if (!isClustersBranchOff("PosErrZ")) {
-        if (!clusters->GetBranch("PosErrZ")) m_clustersBranchesOff.insert("PosErrZ");
-        else clusters->SetBranchAddress("PosErrZ", clusterPosErrZ);
-      }
-      if (!isClustersBranchOff("Value")) {
-        if (!clusters->GetBranch("Value")) m_clustersBranchesOff.insert("Value");
-        else clusters->SetBranchAddress("Value", clusterValue);
-      }
-      if (!isClustersBranchOff("Timing")) {
-        if (!clusters->GetBranch("Timing")) m_clustersBranchesOff.insert("Timing");
-        else clusters->SetBranchAddress("Timing", clusterTiming);
-      }
-      if (!isClustersBranchOff("InTrack") && (treeMask & TRACKS)) {
-        if (!clusters->GetBranch("InTrack")) m_clustersBranchesOff.insert("InTrack");
-        else clusters->SetBranchAddress("InTrack", clusterInTrack);
-      }
+      if (!clusters->GetBranch("PixX")) m_clustersBranchesOff.insert("PixX");
+      if (!clusters->GetBranch("PixY")) m_clustersBranchesOff.insert("PixY");
+      if (!clusters->GetBranch("PixErrX")) m_clustersBranchesOff.insert("PixErrX");
+      if (!clusters->GetBranch("PixErrY")) m_clustersBranchesOff.insert("PixErrY");
+      if (!clusters->GetBranch("PosX")) m_clustersBranchesOff.insert("PosX");
+      if (!clusters->GetBranch("PosY")) m_clustersBranchesOff.insert("PosY");
+      if (!clusters->GetBranch("PosZ")) m_clustersBranchesOff.insert("PosZ");
+      if (!clusters->GetBranch("PosErrX")) m_clustersBranchesOff.insert("PosErrX");
+      if (!clusters->GetBranch("PosErrY")) m_clustersBranchesOff.insert("PosErrY");
+      if (!clusters->GetBranch("PosErrZ")) m_clustersBranchesOff.insert("PosErrZ");
+      if (!clusters->GetBranch("Value")) m_clustersBranchesOff.insert("Value");
+      if (!clusters->GetBranch("Timing")) m_clustersBranchesOff.insert("Timing");
+      if (!clusters->GetBranch("InTrack")) m_clustersBranchesOff.insert("InTrack");
+      bindClustersBranches(clusters);
     }
   }  // Loop over planes
 
@@ -198,6 +169,10 @@ StorageI::StorageI(
     throw std::runtime_error(
         "StorageI::StorageI: clusters trees number does not match planes");
 
+  if (!m_linksTrees.empty() && m_linksTrees.size() != m_numPlanes)
+    throw std::runtime_error(
+        "StorageI::StorageI: hit links trees number does not match planes");
+
   // Check if clusters are given, hits are given, but hits aren't associated
   // with clusters
   if (!m_clustersTrees.empty() &&
@@ -207,7 +182,7 @@ StorageI::StorageI(
         "StorageI::StorageI: clusters are provided without hit associations");
 
   if (treeMask & EVENTINFO)
-    m_file.GetObject("Event", m_eventInfoTree);
+    base->GetObject("Event", m_eventInfoTree);
   if (m_eventInfoTree) {
     if (!isEventInfoBranchOff("TimeStamp")) {
       if (!m_eventInfoTree->GetBranch("TimeStamp")) m_eventInfoBranchesOff.insert("TimeStamp");
@@ -235,50 +210,18 @@ StorageI::StorageI(
     m_file.GetObject("Tracks", m_tracksTree);
   if (m_tracksTree) {
     m_tracksTree->SetBranchAddress("NTracks", &numTracks);
-    if (!isTracksBranchOff("SlopeX")) {
-      if (!m_tracksTree->GetBranch("SlopeX")) m_tracksBranchesOff.insert("SlopeX");
-      else m_tracksTree->SetBranchAddress("SlopeX", trackSlopeX);
-    }
-    if (!isTracksBranchOff("SlopeY")) {
-      if (!m_tracksTree->GetBranch("SlopeY")) m_tracksBranchesOff.insert("SlopeY");
-      else m_tracksTree->SetBranchAddress("SlopeY", trackSlopeY);
-    }
-    if (!isTracksBranchOff("SlopeErrX")) {
-      if (!m_tracksTree->GetBranch("SlopeErrX")) m_tracksBranchesOff.insert("SlopeErrX");
-      else m_tracksTree->SetBranchAddress("SlopeErrX", trackSlopeErrX);
-    }
-    if (!isTracksBranchOff("SlopeErrY")) {
-      if (!m_tracksTree->GetBranch("SlopeErrY")) m_tracksBranchesOff.insert("SlopeErrY");
-      else m_tracksTree->SetBranchAddress("SlopeErrY", trackSlopeErrY);
-    }
-    if (!isTracksBranchOff("OriginX")) {
-      if (!m_tracksTree->GetBranch("OriginX")) m_tracksBranchesOff.insert("OriginX");
-      else m_tracksTree->SetBranchAddress("OriginX", trackOriginX);
-    }
-    if (!isTracksBranchOff("OriginY")) {
-      if (!m_tracksTree->GetBranch("OriginY")) m_tracksBranchesOff.insert("OriginY");
-      else m_tracksTree->SetBranchAddress("OriginY", trackOriginY);
-    }
-    if (!isTracksBranchOff("OriginErrX")) {
-      if (!m_tracksTree->GetBranch("OriginErrX")) m_tracksBranchesOff.insert("OriginErrX");
-      else m_tracksTree->SetBranchAddress("OriginErrX", trackOriginErrX);
-    }
-    if (!isTracksBranchOff("OriginErrY")) {
-      if (!m_tracksTree->GetBranch("OriginErrY")) m_tracksBranchesOff.insert("OriginErrY");
-      else m_tracksTree->SetBranchAddress("OriginErrY", trackOriginErrY);
-    }
-    if (!isTracksBranchOff("CovarianceX")) {
-      if (!m_tracksTree->GetBranch("CovarianceX")) m_tracksBranchesOff.insert("CovarianceX");
-      else m_tracksTree->SetBranchAddress("CovarianceX", trackCovarianceX);
-    }
-    if (!isTracksBranchOff("CovarianceY")) {
-      if (!m_tracksTree->GetBranch("CovarianceY")) m_tracksBranchesOff.insert("CovarianceY");
-      else m_tracksTree->SetBranchAddress("CovarianceY", trackCovarianceY);
-    }
-    if (!isTracksBranchOff("Chi2")) {
-      if (!m_tracksTree->GetBranch("Chi2")) m_tracksBranchesOff.insert("Chi2");
-      else m_tracksTree->SetBranchAddress("Chi2", trackChi2);
-    }
+    if (!m_tracksTree->GetBranch("SlopeX")) m_tracksBranchesOff.insert("SlopeX");
+    if (!m_tracksTree->GetBranch("SlopeY")) m_tracksBranchesOff.insert("SlopeY");
+    if (!m_tracksTree->GetBranch("SlopeErrX")) m_tracksBranchesOff.insert("SlopeErrX");
+    if (!m_tracksTree->GetBranch("SlopeErrY")) m_tracksBranchesOff.insert("SlopeErrY");
+    if (!m_tracksTree->GetBranch("OriginX")) m_tracksBranchesOff.insert("OriginX");
+    if (!m_tracksTree->GetBranch("OriginY")) m_tracksBranchesOff.insert("OriginY");
+    if (!m_tracksTree->GetBranch("OriginErrX")) m_tracksBranchesOff.insert("OriginErrX");
+    if (!m_tracksTree->GetBranch("OriginErrY")) m_tracksBranchesOff.insert("OriginErrY");
+    if (!m_tracksTree->GetBranch("CovarianceX")) m_tracksBranchesOff.insert("CovarianceX");
+    if (!m_tracksTree->GetBranch("CovarianceY")) m_tracksBranchesOff.insert("CovarianceY");
+    if (!m_tracksTree->GetBranch("Chi2")) m_tracksBranchesOff.insert("Chi2");
+    bindTracksBranches(m_tracksTree);
   }
 
   // Check if tracks are given, clustesr are given, but clusters aren't
@@ -295,19 +238,23 @@ StorageI::StorageI(
   Long64_t nTracks = (m_tracksTree) ? m_tracksTree->GetEntries() : 0;
   Long64_t nHits = 0;
   Long64_t nClusters = 0;
+  Long64_t nLinks = 0;
   for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
     if (!m_hitsTrees.empty())
         nHits += m_hitsTrees[nplane]->GetEntries();
     if (!m_clustersTrees.empty())
         nClusters += m_clustersTrees[nplane]->GetEntriesFast();
+    if (!m_linksTrees.empty())
+        nLinks += m_linksTrees[nplane]->GetEntries();
   }
 
-  if (nHits % m_numPlanes || nClusters % m_numPlanes)
+  if (nHits % m_numPlanes || nClusters % m_numPlanes || nLinks % m_numPlanes)
     throw std::runtime_error(
         "StorageI::StorageI: number of events in different planes mismatch");
 
   nHits /= m_numPlanes;
   nClusters /= m_numPlanes;
+  nLinks /= m_numPlanes;
 
   // Try to read the number of events from any active tree
   if (!m_numEvents && nEventInfo) m_numEvents = nEventInfo;
@@ -319,12 +266,53 @@ StorageI::StorageI(
   if ((nEventInfo && m_numEvents != nEventInfo) ||
       (nTracks && m_numEvents != nTracks) ||
       (nHits && m_numEvents != nHits) ||
-      (nClusters && m_numEvents != nClusters))
+      (nClusters && m_numEvents != nClusters) ||
+      (nLinks && m_numEvents != nLinks))
     throw std::runtime_error(
         "StoragI::StorageI: all trees don't have the same number of events");
 }
 
+StorageI::~StorageI() {
+  // The thread must not outlive the trees and caches it uses
+  stopPrefetch();
+}
+
+void StorageI::readCount(TTree* tree, const char* name, Long64_t n) {
+  TBranch* branch = tree->GetBranch(name);
+  if (!branch || branch->GetEntry(n) <= 0)
+    throw std::runtime_error(
+        "StorageI::readCount: error reading multiplicity branch");
+}
+
 Event& StorageI::readEvent(Long64_t n) {
+  if (m_prefetchThread.joinable()) {
+    const Long64_t next = m_prefetchStart + m_taken*m_prefetchStep;
+    if (n == next && n < m_prefetchEnd) {
+      std::unique_lock<std::mutex> lock(m_prefetchMutex);
+      // The event returned by the previous call is released, so the thread
+      // can move on to its slot
+      const size_t k = m_taken++;
+      m_prefetchCond.notify_all();
+      while (m_filled <= k && m_prefetchError.empty())
+        m_prefetchCond.wait(lock);
+      if (m_filled <= k)
+        throw std::runtime_error("StorageI::readEvent: " + m_prefetchError);
+      return *m_ring[k % m_ring.size()];
+    }
+    // Out of order access, the ring is of no use
+    stopPrefetch();
+  }
+
+  // The trees might have been left bound to the view columns
+  if (m_viewBound) bindView(false);
+
+  // This will clear the previous event and cache its objects
+  Event& event = newEvent();
+  fillEvent(n, event);
+  return event;
+}
+
+void StorageI::fillEvent(Long64_t n, Event& event) {
   // NOTE: fill in reversed order: tracks first, hits last. This is so that
   // once a hit is produced, it can immediately recieve the address of its
   // parent cluster, likewise for clusters and track.
@@ -340,15 +328,18 @@ Event& StorageI::readEvent(Long64_t n) {
         "StorageIO::error reading event tree");
 
   // Try to read the track information
-  if (m_tracksTree && m_tracksTree->GetEntry(n) <= 0)
-    throw std::runtime_error(
-        "StorageIO::readEvent: error reading tracks tree");
+  if (m_tracksTree) {
+    // Make room for the tracks before the arrays are read in
+    readCount(m_tracksTree, "NTracks", n);
+    reserveTracks(numTracks);
+    if (m_tracksTree->GetEntry(n) <= 0)
+      throw std::runtime_error(
+          "StorageIO::readEvent: error reading tracks tree");
+  }
 
   // NOTE: masks need to be re-applied here. The array values aren't zeroed
   // so they can't be read in
 
-  // This will clear the previous event and cache its objects
-  Event& event = newEvent();
   // Fill the event info fro what was read from the event info tree
   event.setTimeStamp(timeStamp);
   event.setFrameNumber(frameNumber);
@@ -370,14 +361,25 @@ Event& StorageI::readEvent(Long64_t n) {
 
   for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
     // Try to read the hits tree for this plane
-    if (!m_hitsTrees.empty() && m_hitsTrees[nplane]->GetEntry(n) <= 0)
-      throw std::runtime_error(
-          "StorageIO::readEvent: error reading hits tree");
+    if (!m_hitsTrees.empty()) {
+      readCount(m_hitsTrees[nplane], "NHits", n);
+      reserveHits(numHits);
+      if (m_hitsTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageIO::readEvent: error reading hits tree");
+      if (!m_linksTrees.empty() && m_linksTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageIO::readEvent: error reading hit links tree");
+    }
     
     // Try to read the clusters tree for this plane
-    if (!m_clustersTrees.empty() && m_clustersTrees[nplane]->GetEntry(n) <= 0)
-      throw std::runtime_error(
-          "StorageIO::readEvent: error reading clusters tree");
+    if (!m_clustersTrees.empty()) {
+      readCount(m_clustersTrees[nplane], "NClusters", n);
+      reserveClusters(numClusters);
+      if (m_clustersTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageIO::readEvent: error reading clusters tree");
+    }
 
     // Generate the cluster objects
     for (Int_t ncluster = 0; ncluster < numClusters; ncluster++) {
@@ -402,11 +404,15 @@ Event& StorageI::readEvent(Long64_t n) {
       }
     }
 
+    // Look up the mask of the plane's hits in one pass, before making any
+    // hit objects
+    const bool masking = !m_noiseMasks.empty() &&
+        m_noiseMasks[nplane].filter(
+            &hitPixX[0], &hitPixY[0], numHits, &hitMasked[0]) > 0;
+
     // Generate a list of all hit objects
     for (Int_t nhit = 0; nhit < numHits; nhit++) {
-      const bool isMasked = 
-          !m_noiseMasks.empty() &&
-          m_noiseMasks[nplane].at(hitPixX[nhit], hitPixY[nhit]);
+      const bool isMasked = masking && hitMasked[nhit];
 
       // Don't make a hit object for masked hits if they are to be removed.
       // This will also prevent it being written out.
@@ -432,8 +438,304 @@ Event& StorageI::readEvent(Long64_t n) {
       }
     }
   }  // Loop over planes
+}
 
-  return event;
+const EventView& StorageI::readView(Long64_t n) {
+  // The read-ahead thread shares the trees
+  stopPrefetch();
+
+  if (n >= m_numEvents)
+    throw std::out_of_range(
+        "StorageI::readView: event out of bounds");
+
+  if (!m_viewBound) bindView(true);
+
+  if (m_eventInfoTree && m_eventInfoTree->GetEntry(n) <= 0)
+    throw std::runtime_error(
+        "StorageI::readView: error reading event tree");
+
+  m_view.timeStamp = timeStamp;
+  m_view.frameNumber = frameNumber;
+  m_view.triggerOffset = triggerOffset;
+  m_view.triggerInfo = triggerInfo;
+  m_view.invalid = invalid;
+
+  // Tracks are global to the event, the event arrays are used as-is
+  numTracks = 0;
+  if (m_tracksTree) {
+    readCount(m_tracksTree, "NTracks", n);
+    reserveTracks(numTracks);
+    if (m_tracksTree->GetEntry(n) <= 0)
+      throw std::runtime_error(
+          "StorageI::readView: error reading tracks tree");
+  }
+
+  m_view.numTracks = numTracks;
+  m_view.trackSlopeX = Span<Double_t>(&trackSlopeX[0], numTracks);
+  m_view.trackSlopeY = Span<Double_t>(&trackSlopeY[0], numTracks);
+  m_view.trackSlopeErrX = Span<Double_t>(&trackSlopeErrX[0], numTracks);
+  m_view.trackSlopeErrY = Span<Double_t>(&trackSlopeErrY[0], numTracks);
+  m_view.trackOriginX = Span<Double_t>(&trackOriginX[0], numTracks);
+  m_view.trackOriginY = Span<Double_t>(&trackOriginY[0], numTracks);
+  m_view.trackOriginErrX = Span<Double_t>(&trackOriginErrX[0], numTracks);
+  m_view.trackOriginErrY = Span<Double_t>(&trackOriginErrY[0], numTracks);
+  m_view.trackCovarianceX = Span<Double_t>(&trackCovarianceX[0], numTracks);
+  m_view.trackCovarianceY = Span<Double_t>(&trackCovarianceY[0], numTracks);
+  m_view.trackChi2 = Span<Double_t>(&trackChi2[0], numTracks);
+
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    PlaneColumns& cols = m_columns[nplane];
+    EventView::PlaneView& plane = m_view.planes[nplane];
+
+    numHits = 0;
+    if (!m_hitsTrees.empty()) {
+      readCount(m_hitsTrees[nplane], "NHits", n);
+      if (numHits > m_maxHits) m_maxHits = numHits;
+      reserveViewHits(nplane, numHits);
+      if (m_hitsTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageI::readView: error reading hits tree");
+      if (!m_linksTrees.empty() && m_linksTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageI::readView: error reading hit links tree");
+    }
+
+    numClusters = 0;
+    if (!m_clustersTrees.empty()) {
+      readCount(m_clustersTrees[nplane], "NClusters", n);
+      if (numClusters > m_maxClusters) m_maxClusters = numClusters;
+      reserveViewClusters(nplane, numClusters);
+      if (m_clustersTrees[nplane]->GetEntry(n) <= 0)
+        throw std::runtime_error(
+            "StorageI::readView: error reading clusters tree");
+    }
+
+    plane.numHits = numHits;
+    plane.hitPixX = Span<Int_t>(&cols.hitPixX[0], numHits);
+    plane.hitPixY = Span<Int_t>(&cols.hitPixY[0], numHits);
+    plane.hitPosX = Span<Double_t>(&cols.hitPosX[0], numHits);
+    plane.hitPosY = Span<Double_t>(&cols.hitPosY[0], numHits);
+    plane.hitPosZ = Span<Double_t>(&cols.hitPosZ[0], numHits);
+    plane.hitValue = Span<Int_t>(&cols.hitValue[0], numHits);
+    plane.hitTiming = Span<Int_t>(&cols.hitTiming[0], numHits);
+    plane.hitInCluster = Span<Int_t>(&cols.hitInCluster[0], numHits);
+
+    // The mask is the only column computed rather than read
+    if (!m_noiseMasks.empty()) {
+      m_noiseMasks[nplane].filter(
+          &cols.hitPixX[0], &cols.hitPixY[0], numHits, &cols.hitMasked[0]);
+      plane.hitMasked = Span<char>(&cols.hitMasked[0], numHits);
+    }
+
+    plane.numClusters = numClusters;
+    plane.clusterPixX = Span<Double_t>(&cols.clusterPixX[0], numClusters);
+    plane.clusterPixY = Span<Double_t>(&cols.clusterPixY[0], numClusters);
+    plane.clusterPixErrX = Span<Double_t>(&cols.clusterPixErrX[0], numClusters);
+    plane.clusterPixErrY = Span<Double_t>(&cols.clusterPixErrY[0], numClusters);
+    plane.clusterPosX = Span<Double_t>(&cols.clusterPosX[0], numClusters);
+    plane.clusterPosY = Span<Double_t>(&cols.clusterPosY[0], numClusters);
+    plane.clusterPosZ = Span<Double_t>(&cols.clusterPosZ[0], numClusters);
+    plane.clusterPosErrX = Span<Double_t>(&cols.clusterPosErrX[0], numClusters);
+    plane.clusterPosErrY = Span<Double_t>(&cols.clusterPosErrY[0], numClusters);
+    plane.clusterPosErrZ = Span<Double_t>(&cols.clusterPosErrZ[0], numClusters);
+    plane.clusterValue = Span<Double_t>(&cols.clusterValue[0], numClusters);
+    plane.clusterTiming = Span<Double_t>(&cols.clusterTiming[0], numClusters);
+    plane.clusterInTrack = Span<Int_t>(&cols.clusterInTrack[0], numClusters);
+  }
+
+  return m_view;
+}
+
+void StorageI::reserveViewHits(size_t nplane, Int_t num) {
+  PlaneColumns& cols = m_columns[nplane];
+  if (num <= (Int_t)cols.hitPixX.size()) return;
+
+  // Same doubling as the event arrays
+  size_t size = cols.hitPixX.empty() ? 1 : cols.hitPixX.size();
+  while (size < (size_t)num) size *= 2;
+  cols.hitPixX.resize(size, 0);
+  cols.hitPixY.resize(size, 0);
+  cols.hitPosX.resize(size, 0);
+  cols.hitPosY.resize(size, 0);
+  cols.hitPosZ.resize(size, 0);
+  cols.hitValue.resize(size, 0);
+  cols.hitTiming.resize(size, 0);
+  cols.hitInCluster.resize(size, 0);
+  cols.hitMasked.resize(size, 0);
+
+  bindViewHits(nplane);
+}
+
+void StorageI::reserveViewClusters(size_t nplane, Int_t num) {
+  PlaneColumns& cols = m_columns[nplane];
+  if (num <= (Int_t)cols.clusterPixX.size()) return;
+
+  size_t size = cols.clusterPixX.empty() ? 1 : cols.clusterPixX.size();
+  while (size < (size_t)num) size *= 2;
+  cols.clusterPixX.resize(size, 0);
+  cols.clusterPixY.resize(size, 0);
+  cols.clusterPixErrX.resize(size, 0);
+  cols.clusterPixErrY.resize(size, 0);
+  cols.clusterPosX.resize(size, 0);
+  cols.clusterPosY.resize(size, 0);
+  cols.clusterPosZ.resize(size, 0);
+  cols.clusterPosErrX.resize(size, 0);
+  cols.clusterPosErrY.resize(size, 0);
+  cols.clusterPosErrZ.resize(size, 0);
+  cols.clusterValue.resize(size, 0);
+  cols.clusterTiming.resize(size, 0);
+  cols.clusterInTrack.resize(size, 0);
+
+  bindViewClusters(nplane);
+}
+
+void StorageI::bindViewHits(size_t nplane) {
+  if (m_hitsTrees.empty()) return;
+  TTree* tree = m_hitsTrees[nplane];
+  PlaneColumns& cols = m_columns[nplane];
+  bindBranch(tree, "PixX", &cols.hitPixX[0], isHitsBranchOff("PixX"));
+  bindBranch(tree, "PixY", &cols.hitPixY[0], isHitsBranchOff("PixY"));
+  bindBranch(tree, "PosX", &cols.hitPosX[0], isHitsBranchOff("PosX"));
+  bindBranch(tree, "PosY", &cols.hitPosY[0], isHitsBranchOff("PosY"));
+  bindBranch(tree, "PosZ", &cols.hitPosZ[0], isHitsBranchOff("PosZ"));
+  bindBranch(tree, "Value", &cols.hitValue[0], isHitsBranchOff("Value"));
+  bindBranch(tree, "Timing", &cols.hitTiming[0], isHitsBranchOff("Timing"));
+  bindBranch(tree, "InCluster", &cols.hitInCluster[0],
+      isHitsBranchOff("InCluster") || (m_treeMask & CLUSTERS));
+  if (!m_linksTrees.empty())
+    bindBranch(m_linksTrees[nplane], "InCluster", &cols.hitInCluster[0],
+        m_treeMask & CLUSTERS);
+}
+
+void StorageI::bindViewClusters(size_t nplane) {
+  if (m_clustersTrees.empty()) return;
+  TTree* tree = m_clustersTrees[nplane];
+  PlaneColumns& cols = m_columns[nplane];
+  bindBranch(tree, "PixX", &cols.clusterPixX[0], isClustersBranchOff("PixX"));
+  bindBranch(tree, "PixY", &cols.clusterPixY[0], isClustersBranchOff("PixY"));
+  bindBranch(tree, "PixErrX", &cols.clusterPixErrX[0], isClustersBranchOff("PixErrX"));
+  bindBranch(tree, "PixErrY", &cols.clusterPixErrY[0], isClustersBranchOff("PixErrY"));
+  bindBranch(tree, "PosX", &cols.clusterPosX[0], isClustersBranchOff("PosX"));
+  bindBranch(tree, "PosY", &cols.clusterPosY[0], isClustersBranchOff("PosY"));
+  bindBranch(tree, "PosZ", &cols.clusterPosZ[0], isClustersBranchOff("PosZ"));
+  bindBranch(tree, "PosErrX", &cols.clusterPosErrX[0], isClustersBranchOff("PosErrX"));
+  bindBranch(tree, "PosErrY", &cols.clusterPosErrY[0], isClustersBranchOff("PosErrY"));
+  bindBranch(tree, "PosErrZ", &cols.clusterPosErrZ[0], isClustersBranchOff("PosErrZ"));
+  bindBranch(tree, "Value", &cols.clusterValue[0], isClustersBranchOff("Value"));
+  bindBranch(tree, "Timing", &cols.clusterTiming[0], isClustersBranchOff("Timing"));
+  bindBranch(tree, "InTrack", &cols.clusterInTrack[0],
+      isClustersBranchOff("InTrack") || (m_treeMask & TRACKS));
+}
+
+void StorageI::bindView(bool view) {
+  m_viewBound = view;
+
+  if (!view) {
+    // Back to the shared event arrays
+    for (size_t nplane = 0; nplane < m_hitsTrees.size(); nplane++)
+      bindHitsBranches(m_hitsTrees[nplane]);
+    for (size_t nplane = 0; nplane < m_linksTrees.size(); nplane++)
+      bindLinksBranches(m_linksTrees[nplane]);
+    for (size_t nplane = 0; nplane < m_clustersTrees.size(); nplane++)
+      bindClustersBranches(m_clustersTrees[nplane]);
+    return;
+  }
+
+  // First use allocates (and binds) the columns of each plane
+  if (m_columns.empty()) {
+    m_columns.resize(m_numPlanes);
+    m_view.planes.resize(m_numPlanes);
+    for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+      reserveViewHits(nplane, INIT_HITS);
+      reserveViewClusters(nplane, INIT_CLUSTERS);
+    }
+    return;
+  }
+
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    bindViewHits(nplane);
+    bindViewClusters(nplane);
+  }
+}
+
+void StorageI::startPrefetch(
+    size_t depth,
+    Long64_t start,
+    Long64_t end,
+    Long64_t step) {
+  stopPrefetch();
+  if (depth == 0 || step <= 0) return;
+
+  // Reading and writing other files from the main thread meanwhile
+  ROOT::EnableThreadSafety();
+
+  if (m_viewBound) bindView(false);
+
+  m_prefetchStart = start;
+  m_prefetchEnd = (end < m_numEvents) ? end : m_numEvents;
+  m_prefetchStep = step;
+  m_prefetchDepth = depth;
+  m_filled = 0;
+  m_taken = 0;
+  m_prefetchStop = false;
+  m_prefetchError.clear();
+
+  m_ring.resize(depth+1, 0);
+  for (size_t i = 0; i < m_ring.size(); i++)
+    m_ring[i] = makeEvent();
+
+  m_prefetchThread = std::thread(&StorageI::prefetchLoop, this);
+}
+
+void StorageI::stopPrefetch() {
+  if (m_prefetchThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_prefetchMutex);
+      m_prefetchStop = true;
+    }
+    m_prefetchCond.notify_all();
+    m_prefetchThread.join();
+  }
+
+  // Give the ring's objects back to the cache before discarding the events
+  for (size_t i = 0; i < m_ring.size(); i++) {
+    recycleEvent(*m_ring[i]);
+    delete m_ring[i];
+  }
+  m_ring.clear();
+}
+
+void StorageI::prefetchLoop() {
+  for (size_t k = 0; ; k++) {
+    const Long64_t n = m_prefetchStart + k*m_prefetchStep;
+    if (n >= m_prefetchEnd) break;
+
+    {
+      // Wait until the slot for entry `k` is no longer in use
+      std::unique_lock<std::mutex> lock(m_prefetchMutex);
+      while (!m_prefetchStop && k >= m_taken + m_prefetchDepth)
+        m_prefetchCond.wait(lock);
+      if (m_prefetchStop) break;
+    }
+
+    Event& event = *m_ring[k % m_ring.size()];
+    try {
+      recycleEvent(event);
+      fillEvent(n, event);
+    } catch (std::exception& e) {
+      // Report the error to the reader, which is waiting for this entry
+      std::lock_guard<std::mutex> lock(m_prefetchMutex);
+      m_prefetchError = e.what();
+      m_prefetchCond.notify_all();
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_prefetchMutex);
+      m_filled = k+1;
+    }
+    m_prefetchCond.notify_all();
+  }
 }
 
 }
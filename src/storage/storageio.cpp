@@ -4,6 +4,7 @@
 #include <sstream>
 #include <vector>
 #include <iostream>
+#include <fstream>
 
 #include <TFile.h>
 #include <TDirectory.h>
@@ -16,6 +17,7 @@
 #include "plane.h"
 #include "cluster.h"
 #include "hit.h"
+#include "eventindex.h"
 
 #ifndef VERBOSE
 #define VERBOSE 1
@@ -26,12 +28,15 @@ using std::endl;
 
 namespace Storage {
 
+bool StorageIO::writeIndexes = false;
+
 void StorageIO::clearVariables()
 {
   timeStamp = 0;
   frameNumber = 0;
   triggerOffset = 0;
   invalid = false;
+  sourceEntry = -1;
   numHits = 0;
   numClusters = 0;
   numTracks = 0;
@@ -47,14 +52,21 @@ Event* StorageIO::readEvent(Long64_t n)
   if (n >= _numEvents) throw "StorageIO: requested event outside range";
 
   if (_eventInfo &&_eventInfo->GetEntry(n) <= 0) throw "StorageIO: error reading event tree";
-  if (_tracks && _tracks->GetEntry(n) <= 0) throw "StorageIO: error reading tracks tree";
+  if (_tracks)
+  {
+    // Make room for the tracks before the arrays are read in
+    readCount(_tracks, "NTracks", n);
+    reserveTracks(numTracks);
+    if (_tracks->GetEntry(n) <= 0) throw "StorageIO: error reading tracks tree";
+  }
 
-  Event* event = new Event(_numPlanes);
+  Event* event = _recycleEvents ? recycleEvent() : new Event(_numPlanes);
   event->setTimeStamp(timeStamp);
   event->setFrameNumber(frameNumber);
   event->setTriggerOffset(triggerOffset);
   event->setTriggerInfo(triggerInfo);
   event->setInvalid(invalid);
+  event->setSourceEntry(_sourceEntries ? sourceEntry : n);
 
   // Generate a list of track objects
   for (int ntrack = 0; ntrack < numTracks; ntrack++)
@@ -70,10 +82,20 @@ Event* StorageIO::readEvent(Long64_t n)
   //std::cout << "Nplanes: " << _numPlanes << std::endl;
   for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
   {
-    if (_hits.at(nplane) && _hits.at(nplane)->GetEntry(n) <= 0)
-      throw "StorageIO: error reading hits tree";
-    if (_clusters.at(nplane) && _clusters.at(nplane)->GetEntry(n) <= 0)
-      throw "StorageIO: error reading clusters tree";
+    if (_hits.at(nplane))
+    {
+      readCount(_hits.at(nplane), "NHits", n);
+      reserveHits(numHits);
+      if (_hits.at(nplane)->GetEntry(n) <= 0)
+        throw "StorageIO: error reading hits tree";
+    }
+    if (_clusters.at(nplane))
+    {
+      readCount(_clusters.at(nplane), "NClusters", n);
+      reserveClusters(numClusters);
+      if (_clusters.at(nplane)->GetEntry(n) <= 0)
+        throw "StorageIO: error reading clusters tree";
+    }
 
     // Generate the cluster objects
     for (int ncluster = 0; ncluster < numClusters; ncluster++)
@@ -96,12 +118,18 @@ Event* StorageIO::readEvent(Long64_t n)
     // Kill if there are no hits for Tower Jazz, only for 1 plane dut
     if(bHitIsHit && bHitValidFit && numHits==0 && _numPlanes==1) event->setInvalid(true);
     
+    // Flag the masked hits of the whole plane before building any of them
+    const bool masking = _noiseMasks && numHits > 0 &&
+        _noiseMasks->at(nplane)->filter(&hitPixX[0], &hitPixY[0], numHits,
+                                        &hitMasked[0]) > 0;
+
     // Generate a list of all hit objects
     for (int nhit = 0; nhit < numHits; nhit++)
     {
-      if (_noiseMasks && _noiseMasks->at(nplane)[hitPixX[nhit]][hitPixY[nhit]])
+      if (masking && hitMasked[nhit])
       {
-        if (hitInCluster[nhit] >= 0)
+        // Only breaks a cluster if the clusters are read
+        if (_clusters.at(nplane) && hitInCluster[nhit] >= 0)
           throw "StorageIO: tried to mask a hit which is already in a cluster";
         continue;
       }
@@ -151,9 +179,10 @@ void StorageIO::writeEvent(Event* event)
   triggerOffset = event->getTriggerOffset();
   triggerInfo = event->getTriggerInfo();
   invalid = event->getInvalid();
+  sourceEntry = event->getSourceEntry();
 
   numTracks = event->getNumTracks();
-  if (numTracks > MAX_TRACKS) throw "StorageIO: event exceeds MAX_TRACKS";
+  reserveTracks(numTracks);
 
   // Set the object track values into the arrays for writing to the root file
   for (int ntrack = 0; ntrack < numTracks; ntrack++)
@@ -177,7 +206,7 @@ void StorageIO::writeEvent(Event* event)
     Plane* plane = event->getPlane(nplane);
 
     numClusters = plane->getNumClusters();
-    if (numClusters > MAX_CLUSTERS) throw "StorageIO: event exceeds MAX_CLUSTERS";
+    reserveClusters(numClusters);
 
     // Set the object cluster values into the arrays for writig into the root file
     for (int ncluster = 0; ncluster < numClusters; ncluster++)
@@ -197,7 +226,7 @@ void StorageIO::writeEvent(Event* event)
     }
 
     numHits = plane->getNumHits();
-    if (numHits > MAX_HITS) throw "StorageIO: event exceeds MAX_HITS";
+    reserveHits(numHits);
 
     // Set the object hit values into the arrays for writing into the root file
     for (int nhit = 0; nhit < numHits; nhit++)
@@ -228,17 +257,331 @@ void StorageIO::writeEvent(Event* event)
   // Write the track and event info here so that if any errors occured they won't be desynchronized
   if (_tracks) _tracks->Fill();
   if (_eventInfo) _eventInfo->Fill();
+  if (_index) _index->writeEvent(event);
 
   _numEvents++;
 }
 
-void StorageIO::setNoiseMasks(std::vector<bool**>* noiseMasks)
+void StorageIO::readCount(TTree* tree, const char* name, Long64_t n)
+{
+  // Fills the `num` variable bound to the branch, but none of the arrays
+  TBranch* branch = tree->GetBranch(name);
+  if (!branch || branch->GetEntry(n) <= 0)
+    throw "StorageIO: error reading the multiplicity of an event";
+}
+
+// Doubling the size keeps the number of re-binds small
+static unsigned int growSize(unsigned int size, unsigned int num)
+{
+  if (size < 1) size = 1;
+  while (size < num) size *= 2;
+  return size;
+}
+
+void StorageIO::reserveHits(Int_t num)
+{
+  if (num > _maxHits) _maxHits = num;
+  if (num <= (Int_t)hitPixX.size()) return;
+
+  const unsigned int size = growSize(hitPixX.size(), num);
+  hitPixX.resize(size, 0);
+  hitPixY.resize(size, 0);
+  hitPosX.resize(size, 0);
+  hitPosY.resize(size, 0);
+  hitPosZ.resize(size, 0);
+  hitValue.resize(size, 0);
+  hitT0.resize(size, -1000.0);
+  hitValueInt.resize(size, 0);
+  hitTiming.resize(size, 0);
+  hitTimingInt.resize(size, 0);
+  hitInCluster.resize(size, 0);
+  hitMasked.resize(size, 0);
+  hitChi2.resize(size, 0);
+  hitIsHit.resize(size, 0);
+  hitValidFit.resize(size, 0);
+
+  // The arrays have moved, the trees need the new addresses
+  for (unsigned int nplane = 0; nplane < _hits.size(); nplane++)
+    if (_hits.at(nplane)) bindHitBranches(_hits.at(nplane));
+}
+
+void StorageIO::reserveClusters(Int_t num)
+{
+  if (num > _maxClusters) _maxClusters = num;
+  if (num <= (Int_t)clusterPixX.size()) return;
+
+  const unsigned int size = growSize(clusterPixX.size(), num);
+  clusterPixX.resize(size, 0);
+  clusterPixY.resize(size, 0);
+  clusterPixErrX.resize(size, 0);
+  clusterPixErrY.resize(size, 0);
+  clusterPosX.resize(size, 0);
+  clusterPosY.resize(size, 0);
+  clusterPosZ.resize(size, 0);
+  clusterPosErrX.resize(size, 0);
+  clusterPosErrY.resize(size, 0);
+  clusterPosErrZ.resize(size, 0);
+  clusterInTrack.resize(size, 0);
+
+  for (unsigned int nplane = 0; nplane < _clusters.size(); nplane++)
+    if (_clusters.at(nplane)) bindClusterBranches(_clusters.at(nplane));
+}
+
+void StorageIO::reserveTracks(Int_t num)
+{
+  if (num > _maxTracks) _maxTracks = num;
+  if (num <= (Int_t)trackSlopeX.size()) return;
+
+  const unsigned int size = growSize(trackSlopeX.size(), num);
+  trackSlopeX.resize(size, 0);
+  trackSlopeY.resize(size, 0);
+  trackSlopeErrX.resize(size, 0);
+  trackSlopeErrY.resize(size, 0);
+  trackOriginX.resize(size, 0);
+  trackOriginY.resize(size, 0);
+  trackOriginErrX.resize(size, 0);
+  trackOriginErrY.resize(size, 0);
+  trackCovarianceX.resize(size, 0);
+  trackCovarianceY.resize(size, 0);
+  trackChi2.resize(size, 0);
+
+  if (_tracks) bindTrackBranches(_tracks);
+}
+
+void StorageIO::bindHitBranches(TTree* hits)
+{
+  hits->SetBranchAddress("PixX", &hitPixX[0], &bHitPixX);
+  hits->SetBranchAddress("PixY", &hitPixY[0], &bHitPixY);
+  if(hits->GetBranch("T0"))
+    hits->SetBranchAddress("T0", &hitT0[0], &bHitT0);
+  if (hitValueType==kInt)
+    hits->SetBranchAddress("Value", &hitValueInt[0], &bHitValueInt);
+  else if (hitValueType==kDouble)
+    hits->SetBranchAddress("Value", &hitValue[0], &bHitValue);
+  if (hitTimingType==kInt)
+    hits->SetBranchAddress("Timing", &hitTimingInt[0], &bHitTimingInt);
+  else if (hitTimingType==kDouble)
+    hits->SetBranchAddress("Timing", &hitTiming[0], &bHitTiming);
+  if(hits->GetBranchStatus("HitInCluster"))
+    hits->SetBranchAddress("HitInCluster", &hitInCluster[0], &bHitInCluster);
+  else
+    hits->SetBranchAddress("InCluster", &hitInCluster[0], &bHitInCluster);
+  hits->SetBranchAddress("PosX", &hitPosX[0], &bHitPosX);
+  hits->SetBranchAddress("PosY", &hitPosY[0], &bHitPosY);
+  hits->SetBranchAddress("PosZ", &hitPosZ[0], &bHitPosZ);
+  if(hits->GetBranch("Chi2")) hits->SetBranchAddress("Chi2", &hitChi2[0], &bHitChi2);
+  else bHitChi2=NULL;
+  if(hits->GetBranch("IsHit")) hits->SetBranchAddress("IsHit", &hitIsHit[0], &bHitIsHit);
+  else bHitIsHit=NULL;
+  if(hits->GetBranch("ValidFit")) hits->SetBranchAddress("ValidFit", &hitValidFit[0], &bHitValidFit);
+  else bHitValidFit=NULL;
+}
+
+void StorageIO::bindClusterBranches(TTree* clusters)
+{
+  clusters->SetBranchAddress("PixX", &clusterPixX[0], &bClusterPixX);
+  clusters->SetBranchAddress("PixY", &clusterPixY[0], &bClusterPixY);
+  clusters->SetBranchAddress("PixErrX", &clusterPixErrX[0], &bClusterPixErrX);
+  clusters->SetBranchAddress("PixErrY", &clusterPixErrY[0], &bClusterPixErrY);
+  clusters->SetBranchAddress("InTrack", &clusterInTrack[0], &bClusterInTrack);
+  clusters->SetBranchAddress("PosX", &clusterPosX[0], &bClusterPosX);
+  clusters->SetBranchAddress("PosY", &clusterPosY[0], &bClusterPosY);
+  clusters->SetBranchAddress("PosZ", &clusterPosZ[0], &bClusterPosZ);
+  clusters->SetBranchAddress("PosErrX", &clusterPosErrX[0], &bClusterPosErrX);
+  clusters->SetBranchAddress("PosErrY", &clusterPosErrY[0], &bClusterPosErrY);
+  clusters->SetBranchAddress("PosErrZ", &clusterPosErrZ[0], &bClusterPosErrZ);
+}
+
+void StorageIO::bindTrackBranches(TTree* tracks)
+{
+  tracks->SetBranchAddress("SlopeX", &trackSlopeX[0], &bTrackSlopeX);
+  tracks->SetBranchAddress("SlopeY", &trackSlopeY[0], &bTrackSlopeY);
+  tracks->SetBranchAddress("SlopeErrX", &trackSlopeErrX[0], &bTrackSlopeErrX);
+  tracks->SetBranchAddress("SlopeErrY", &trackSlopeErrY[0], &bTrackSlopeErrY);
+  tracks->SetBranchAddress("OriginX", &trackOriginX[0], &bTrackOriginX);
+  tracks->SetBranchAddress("OriginY", &trackOriginY[0], &bTrackOriginY);
+  tracks->SetBranchAddress("OriginErrX", &trackOriginErrX[0], &bTrackOriginErrX);
+  tracks->SetBranchAddress("OriginErrY", &trackOriginErrY[0], &bTrackOriginErrY);
+  tracks->SetBranchAddress("CovarianceX", &trackCovarianceX[0], &bTrackCovarianceX);
+  tracks->SetBranchAddress("CovarianceY", &trackCovarianceY[0], &bTrackCovarianceY);
+  tracks->SetBranchAddress("Chi2", &trackChi2[0], &bTrackChi2);
+}
+
+Hit* StorageIO::newHit()
+{
+  if (_hitPool.empty())
+  {
+    // Allocate a whole slab when the pool runs dry. Pushed in reverse so that
+    // hits are handed out in memory order.
+    Hit* slab = new Hit[POOL_SLAB_SIZE];
+    _hitSlabs.push_back(slab);
+    for (unsigned int i = POOL_SLAB_SIZE; i > 0; i--)
+      _hitPool.push_back(slab + i - 1);
+  }
+  Hit* hit = _hitPool.back();
+  _hitPool.pop_back();
+  hit->clear();
+  return hit;
+}
+
+Cluster* StorageIO::newCluster()
+{
+  if (_clusterPool.empty())
+  {
+    Cluster* slab = new Cluster[POOL_SLAB_SIZE];
+    _clusterSlabs.push_back(slab);
+    for (unsigned int i = POOL_SLAB_SIZE; i > 0; i--)
+      _clusterPool.push_back(slab + i - 1);
+  }
+  Cluster* cluster = _clusterPool.back();
+  _clusterPool.pop_back();
+  cluster->clear();
+  return cluster;
+}
+
+Track* StorageIO::newTrack()
+{
+  if (_trackPool.empty()) return new Track();
+  Track* track = _trackPool.back();
+  _trackPool.pop_back();
+  track->clear();
+  return track;
+}
+
+void StorageIO::releaseTrack(Track* track)
+{
+  _trackPool.push_back(track);
+}
+
+Event* StorageIO::recycleEvent()
+{
+  if (!_event)
+  {
+    _event = new Event(this, _numPlanes);
+    return _event;
+  }
+
+  // Return the previous event's objects to the pools, last first so that the
+  // next event gets them back in the same order
+  for (unsigned int nhit = _event->getNumHits(); nhit > 0; nhit--)
+    _hitPool.push_back(_event->getHit(nhit - 1));
+  for (unsigned int ncluster = _event->getNumClusters(); ncluster > 0; ncluster--)
+    _clusterPool.push_back(_event->getCluster(ncluster - 1));
+  // The TrackMaker takes its tracks from the pool, so it stays bounded
+  for (unsigned int ntrack = _event->getNumTracks(); ntrack > 0; ntrack--)
+    _trackPool.push_back(_event->getTrack(ntrack - 1));
+
+  _event->clear();
+  return _event;
+}
+
+void StorageIO::setRecycleEvents(bool value) { _recycleEvents = value; }
+
+bool StorageIO::getRecycleEvents() const { return _recycleEvents; }
+
+Int_t StorageIO::getMaxHits() const { return _maxHits; }
+
+Int_t StorageIO::getMaxClusters() const { return _maxClusters; }
+
+Int_t StorageIO::getMaxTracks() const { return _maxTracks; }
+
+void StorageIO::releaseEvent(Event* event)
+{
+  // The recycled event is re-filled by the next read
+  if (event != _event) delete event;
+}
+
+void StorageIO::setNoiseMasks(std::vector<const PixelMask*>* noiseMasks)
 {
   if (noiseMasks && _numPlanes != noiseMasks->size())
     throw "StorageIO: noise mask has more planes than will be read in";
   _noiseMasks = noiseMasks;
+  if (_index && _fileMode == INPUT) _index->setHitsExact(!dropsHits());
+}
+
+void StorageIO::enableSourceEntries()
+{
+  if (_fileMode == INPUT) throw "StorageIO: can't record source entries in input mode";
+  if (_sourceEntries) return;
+  if (!_eventInfo) throw "StorageIO: source entries need the event tree";
+  if (_numEvents) throw "StorageIO: source entries must be enabled before writing";
+  _eventInfo->Branch("SourceEntry", &sourceEntry, "SourceEntry/L");
+  _sourceEntries = true;
 }
 
+bool StorageIO::hasSourceEntries() const { return _sourceEntries; }
+
+bool StorageIO::dropsHits() const
+{
+  // Same conditions as the hit filtering in `readEvent`
+  if (_noiseMasks) return true;
+  return _numPlanes == 1 && _hits.at(0) && bHitIsHit && bHitValidFit;
+}
+
+unsigned int StorageIO::missingTrees() const
+{
+  bool noHits = true;
+  bool noClusters = true;
+  for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
+  {
+    if (_hits.at(nplane)) noHits = false;
+    if (_clusters.at(nplane)) noClusters = false;
+  }
+
+  unsigned int treeMask = 0;
+  if (noHits) treeMask |= Flags::HITS;
+  if (noClusters) treeMask |= Flags::CLUSTERS;
+  if (!_tracks) treeMask |= Flags::TRACKS;
+  if (!_eventInfo) treeMask |= Flags::EVENTINFO;
+  return treeMask;
+}
+
+void StorageIO::openIndex(unsigned int filePlanes, unsigned int treeMask,
+                          const std::vector<bool>* planeMask)
+{
+  const std::string path = EventIndex::indexPath(_filePath);
+
+  if (_fileMode == OUTPUT)
+  {
+    if (writeIndexes) _index = new EventIndex(path, OUTPUT, _numPlanes, treeMask);
+    return;
+  }
+
+  // The index is optional when reading, it is only used if it is present
+  if (!std::ifstream(path.c_str()).good()) return;
+
+  // Trees missing from the file read back as empty, like masked trees
+  const unsigned int missing = missingTrees();
+
+  try
+  {
+    _index = new EventIndex(path, INPUT, 0, treeMask | missing, planeMask);
+    if (_index->getNumPlanes() != filePlanes || _index->getNumEvents() != _numEvents)
+      throw "StorageIO: index doesn't match the file, re-generate it";
+    // The trees which are read must be those the index was written for, and
+    // the file must be the one it was written with
+    if ((_index->getStorageMask() ^ missing) & ~treeMask)
+      throw "StorageIO: index trees don't match the file, re-generate it";
+    if (!_index->matchesStorage(_filePath))
+      throw "StorageIO: index is older than the file, re-generate it";
+    _index->setHitsExact(!dropsHits());
+  }
+  catch (const char* e)
+  {
+    if (VERBOSE) cout << "WARNING :: " << e << ", not using " << path << endl;
+    delete _index;
+    _index = 0;
+  }
+}
+
+const EventSummary* StorageIO::readSummary(Long64_t n)
+{
+  if (!_index || _fileMode != INPUT) return 0;
+  return _index->readSummary(n);
+}
+
+bool StorageIO::hasIndex() const { return _index && _fileMode == INPUT; }
+
 Long64_t StorageIO::getNumEvents() const
 {
   assert(_fileMode != OUTPUT && "StorageIO: can't get number of entries in output mode");
@@ -252,7 +595,50 @@ Storage::Mode StorageIO::getMode() const { return _fileMode; }
 StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes,
                      const unsigned int treeMask, const std::vector<bool>* planeMask) :
   _filePath(filePath), _file(0), _fileMode(fileMode), _numPlanes(0), _numEvents(0),
-  _noiseMasks(0)
+  _noiseMasks(0), _sourceEntries(false), _index(0), _recycleEvents(false), _event(0),
+  numHits(0),
+  hitPixX(INIT_HITS, 0),
+  hitPixY(INIT_HITS, 0),
+  hitPosX(INIT_HITS, 0),
+  hitPosY(INIT_HITS, 0),
+  hitPosZ(INIT_HITS, 0),
+  hitValue(INIT_HITS, 0),
+  hitT0(INIT_HITS, -1000.0),
+  hitValueInt(INIT_HITS, 0),
+  hitTiming(INIT_HITS, 0),
+  hitTimingInt(INIT_HITS, 0),
+  hitInCluster(INIT_HITS, 0),
+  hitMasked(INIT_HITS, 0),
+  hitChi2(INIT_HITS, 0),
+  hitIsHit(INIT_HITS, 0),
+  hitValidFit(INIT_HITS, 0),
+  numClusters(0),
+  clusterPixX(INIT_CLUSTERS, 0),
+  clusterPixY(INIT_CLUSTERS, 0),
+  clusterPixErrX(INIT_CLUSTERS, 0),
+  clusterPixErrY(INIT_CLUSTERS, 0),
+  clusterPosX(INIT_CLUSTERS, 0),
+  clusterPosY(INIT_CLUSTERS, 0),
+  clusterPosZ(INIT_CLUSTERS, 0),
+  clusterPosErrX(INIT_CLUSTERS, 0),
+  clusterPosErrY(INIT_CLUSTERS, 0),
+  clusterPosErrZ(INIT_CLUSTERS, 0),
+  clusterInTrack(INIT_CLUSTERS, 0),
+  numTracks(0),
+  trackSlopeX(INIT_TRACKS, 0),
+  trackSlopeY(INIT_TRACKS, 0),
+  trackSlopeErrX(INIT_TRACKS, 0),
+  trackSlopeErrY(INIT_TRACKS, 0),
+  trackOriginX(INIT_TRACKS, 0),
+  trackOriginY(INIT_TRACKS, 0),
+  trackOriginErrX(INIT_TRACKS, 0),
+  trackOriginErrY(INIT_TRACKS, 0),
+  trackCovarianceX(INIT_TRACKS, 0),
+  trackCovarianceY(INIT_TRACKS, 0),
+  trackChi2(INIT_TRACKS, 0),
+  _maxHits(0),
+  _maxClusters(0),
+  _maxTracks(0)
 {
   if      (fileMode == INPUT)  _file = new TFile(_filePath, "READ");
   else if (fileMode == OUTPUT) _file = new TFile(_filePath, "RECREATE");
@@ -261,14 +647,10 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
 
   _tracks = 0;
   _eventInfo = 0;
+  bSourceEntry = 0;
 
   timeStamp = 0;
-  numHits = 0;
-  numClusters = 0;
-  numTracks = 0;
-
-  for(unsigned nh=0; nh<MAX_CLUSTERS;++nh)
-    hitT0[nh]=-1000.0;
+  sourceEntry = -1;
 
   // Plane mask holds a true for masked planes
   if (planeMask && fileMode == OUTPUT)
@@ -281,6 +663,8 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       cout << "WARNING :: StorageIO: disregarding plane mask in output mode";
 
     _numPlanes = numPlanes;
+    hitValueType = kDouble; // Written as doubles, used when re-binding
+    hitTimingType = kDouble;
 
     for (unsigned int nplane = 0; nplane < _numPlanes; nplane++)
     {
@@ -296,32 +680,32 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       _hits.push_back(hits);
       _clusters.push_back(clusters);
       hits->Branch("NHits", &numHits, "NHits/I");
-      hits->Branch("PixX", hitPixX, "HitPixX[NHits]/I");
-      hits->Branch("PixY", hitPixY, "HitPixY[NHits]/I");
-      hits->Branch("Value", hitValue, "HitValue[NHits]/D"); //Matevz 20141203 I to D
-      hits->Branch("T0", hitT0, "HitDelay[NHits]/D");
-      hits->Branch("Timing", hitTiming, "HitTiming[NHits]/D"); //S.F --> I to D
-      hits->Branch("HitInCluster", hitInCluster, "HitInCluster[NHits]/I");
-      hits->Branch("PosX", hitPosX, "HitPosX[NHits]/D");
-      hits->Branch("PosY", hitPosY, "HitPosY[NHits]/D");
-      hits->Branch("PosZ", hitPosZ, "HitPosZ[NHits]/D");
+      hits->Branch("PixX", &hitPixX[0], "HitPixX[NHits]/I");
+      hits->Branch("PixY", &hitPixY[0], "HitPixY[NHits]/I");
+      hits->Branch("Value", &hitValue[0], "HitValue[NHits]/D"); //Matevz 20141203 I to D
+      hits->Branch("T0", &hitT0[0], "HitDelay[NHits]/D");
+      hits->Branch("Timing", &hitTiming[0], "HitTiming[NHits]/D"); //S.F --> I to D
+      hits->Branch("HitInCluster", &hitInCluster[0], "HitInCluster[NHits]/I");
+      hits->Branch("PosX", &hitPosX[0], "HitPosX[NHits]/D");
+      hits->Branch("PosY", &hitPosY[0], "HitPosY[NHits]/D");
+      hits->Branch("PosZ", &hitPosZ[0], "HitPosZ[NHits]/D");
       
-      hits->Branch("IsHit", hitIsHit, "HitIsHit[NHits]/D");
-      hits->Branch("ValidFit", hitValidFit, "HitValidFit[NHits]/D");
-      hits->Branch("Chi2", hitChi2, "HitChi2[NHits]/D");      
+      hits->Branch("IsHit", &hitIsHit[0], "HitIsHit[NHits]/D");
+      hits->Branch("ValidFit", &hitValidFit[0], "HitValidFit[NHits]/D");
+      hits->Branch("Chi2", &hitChi2[0], "HitChi2[NHits]/D");      
 
       clusters->Branch("NClusters", &numClusters, "NClusters/I");
-      clusters->Branch("PixX", clusterPixX, "ClusterPixX[NClusters]/D");
-      clusters->Branch("PixY", clusterPixY, "ClusterPixY[NClusters]/D");
-      clusters->Branch("PixErrX", clusterPixErrX, "ClusterPixErrX[NClusters]/D");
-      clusters->Branch("PixErrY", clusterPixErrY, "ClusterPixErrY[NClusters]/D");
-      clusters->Branch("InTrack", clusterInTrack, "ClusterInTrack[NClusters]/I");
-      clusters->Branch("PosX", clusterPosX, "ClusterPosX[NClusters]/D");
-      clusters->Branch("PosY", clusterPosY, "ClusterPosY[NClusters]/D");
-      clusters->Branch("PosZ", clusterPosZ, "ClusterPosZ[NClusters]/D");
-      clusters->Branch("PosErrX", clusterPosErrX, "ClusterPosErrX[NClusters]/D");
-      clusters->Branch("PosErrY", clusterPosErrY, "ClusterPosErrY[NClusters]/D");
-      clusters->Branch("PosErrZ", clusterPosErrZ, "ClusterPosErrZ[NClusters]/D");
+      clusters->Branch("PixX", &clusterPixX[0], "ClusterPixX[NClusters]/D");
+      clusters->Branch("PixY", &clusterPixY[0], "ClusterPixY[NClusters]/D");
+      clusters->Branch("PixErrX", &clusterPixErrX[0], "ClusterPixErrX[NClusters]/D");
+      clusters->Branch("PixErrY", &clusterPixErrY[0], "ClusterPixErrY[NClusters]/D");
+      clusters->Branch("InTrack", &clusterInTrack[0], "ClusterInTrack[NClusters]/I");
+      clusters->Branch("PosX", &clusterPosX[0], "ClusterPosX[NClusters]/D");
+      clusters->Branch("PosY", &clusterPosY[0], "ClusterPosY[NClusters]/D");
+      clusters->Branch("PosZ", &clusterPosZ[0], "ClusterPosZ[NClusters]/D");
+      clusters->Branch("PosErrX", &clusterPosErrX[0], "ClusterPosErrX[NClusters]/D");
+      clusters->Branch("PosErrY", &clusterPosErrY[0], "ClusterPosErrY[NClusters]/D");
+      clusters->Branch("PosErrZ", &clusterPosErrZ[0], "ClusterPosErrZ[NClusters]/D");
     }
 
     _file->cd();
@@ -335,19 +719,21 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
     _eventInfo->Branch("Invalid", &invalid, "Invalid/O");
 
     _tracks->Branch("NTracks", &numTracks, "NTracks/I");
-    _tracks->Branch("SlopeX", trackSlopeX, "TrackSlopeX[NTracks]/D");
-    _tracks->Branch("SlopeY", trackSlopeY, "TrackSlopeY[NTracks]/D");
-    _tracks->Branch("SlopeErrX", trackSlopeErrX, "TrackSlopeErrX[NTracks]/D");
-    _tracks->Branch("SlopeErrY", trackSlopeErrY, "TrackSlopeErrY[NTracks]/D");
-    _tracks->Branch("OriginX", trackOriginX, "TrackOriginX[NTracks]/D");
-    _tracks->Branch("OriginY", trackOriginY, "TrackOriginY[NTracks]/D");
-    _tracks->Branch("OriginErrX", trackOriginErrX, "TrackOriginErrX[NTracks]/D");
-    _tracks->Branch("OriginErrY", trackOriginErrY, "TrackOriginErrY[NTracks]/D");
-    _tracks->Branch("CovarianceX", trackCovarianceX, "TrackCovarianceX[NTracks]/D");
-    _tracks->Branch("CovarianceY", trackCovarianceY, "TrackCovarianceY[NTracks]/D");
-    _tracks->Branch("Chi2", trackChi2, "TrackChi2[NTracks]/D");
+    _tracks->Branch("SlopeX", &trackSlopeX[0], "TrackSlopeX[NTracks]/D");
+    _tracks->Branch("SlopeY", &trackSlopeY[0], "TrackSlopeY[NTracks]/D");
+    _tracks->Branch("SlopeErrX", &trackSlopeErrX[0], "TrackSlopeErrX[NTracks]/D");
+    _tracks->Branch("SlopeErrY", &trackSlopeErrY[0], "TrackSlopeErrY[NTracks]/D");
+    _tracks->Branch("OriginX", &trackOriginX[0], "TrackOriginX[NTracks]/D");
+    _tracks->Branch("OriginY", &trackOriginY[0], "TrackOriginY[NTracks]/D");
+    _tracks->Branch("OriginErrX", &trackOriginErrX[0], "TrackOriginErrX[NTracks]/D");
+    _tracks->Branch("OriginErrY", &trackOriginErrY[0], "TrackOriginErrY[NTracks]/D");
+    _tracks->Branch("CovarianceX", &trackCovarianceX[0], "TrackCovarianceX[NTracks]/D");
+    _tracks->Branch("CovarianceY", &trackCovarianceY[0], "TrackCovarianceY[NTracks]/D");
+    _tracks->Branch("Chi2", &trackChi2[0], "TrackChi2[NTracks]/D");
   }
 
+  unsigned int planeCount = 0; // Planes in the file, including masked ones
+
   // In input mode,
   if (_fileMode == INPUT)
   {
@@ -356,7 +742,6 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       cout << "WARNING :: StorageIO: disregarding specified number of planes" << endl;
     _numPlanes = 0; // Determine num planes from file structure
 
-    unsigned int planeCount = 0;
     while (true)
     {
       
@@ -389,10 +774,6 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       {
         
         hits->SetBranchAddress("NHits", &numHits, &bNumHits);
-        hits->SetBranchAddress("PixX", hitPixX, &bHitPixX);
-        hits->SetBranchAddress("PixY", hitPixY, &bHitPixY);
-	if(hits->GetBranch("T0"))
-	   hits->SetBranchAddress("T0", hitT0, &bHitT0);
 	//**************VALUE:
 	TLeaf *la = 0;
 	if(hits->GetBranch("Value")->GetListOfLeaves()) {
@@ -404,13 +785,8 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
 	}
 
 	hitValueType = getType(la->GetTypeName());
-        if (hitValueType==kInt) {
-          hits->SetBranchAddress("Value", hitValueInt, &bHitValueInt);
-        } else if (hitValueType==kDouble) {
-          hits->SetBranchAddress("Value", hitValue, &bHitValue);
-        } else {
+        if (hitValueType!=kInt && hitValueType!=kDouble)
           cout<<"ERROR WHILE READING THE HITVALUE"<<endl;
-        }
       
 	//***************Timing:
 	la=0;
@@ -422,44 +798,17 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
 	  hits->GetBranch("Timing")->Print();
 	}
 	hitTimingType = getType(la->GetTypeName());
-        if (hitTimingType==kInt) {
-          hits->SetBranchAddress("Timing", hitTimingInt, &bHitTimingInt);
-        } else if (hitTimingType==kDouble) {
-          hits->SetBranchAddress("Timing", hitTiming, &bHitTiming);
-        } else {
+        if (hitTimingType!=kInt && hitTimingType!=kDouble)
           cout<<"ERROR WHILE READING THE HITTIME"<<endl;
-        }
 	
 	//***********************
-        if(hits->GetBranchStatus("HitInCluster"))
-	  hits->SetBranchAddress("HitInCluster", hitInCluster, &bHitInCluster);
-	else
-	  hits->SetBranchAddress("InCluster", hitInCluster, &bHitInCluster);	
-        hits->SetBranchAddress("PosX", hitPosX, &bHitPosX);
-        hits->SetBranchAddress("PosY", hitPosY, &bHitPosY);
-        hits->SetBranchAddress("PosZ", hitPosZ, &bHitPosZ);
-        if(hits->GetBranch("Chi2")) hits->SetBranchAddress("Chi2", hitChi2, &bHitChi2);
-	else bHitChi2=NULL;
-        if(hits->GetBranch("IsHit")) hits->SetBranchAddress("IsHit", hitIsHit, &bHitIsHit);
-	else bHitIsHit=NULL;
-        if(hits->GetBranch("ValidFit")) hits->SetBranchAddress("ValidFit", hitValidFit, &bHitValidFit);
-	else bHitValidFit=NULL;
+        bindHitBranches(hits);
       }
 
       if (clusters)
       {
         clusters->SetBranchAddress("NClusters", &numClusters, &bNumClusters);
-        clusters->SetBranchAddress("PixX", clusterPixX, &bClusterPixX);
-        clusters->SetBranchAddress("PixY", clusterPixY, &bClusterPixY);
-        clusters->SetBranchAddress("PixErrX", clusterPixErrX, &bClusterPixErrX);
-        clusters->SetBranchAddress("PixErrY", clusterPixErrY, &bClusterPixErrY);
-        clusters->SetBranchAddress("InTrack", clusterInTrack, &bClusterInTrack);
-        clusters->SetBranchAddress("PosX", clusterPosX, &bClusterPosX);
-        clusters->SetBranchAddress("PosY", clusterPosY, &bClusterPosY);
-        clusters->SetBranchAddress("PosZ", clusterPosZ, &bClusterPosZ);
-        clusters->SetBranchAddress("PosErrX", clusterPosErrX, &bClusterPosErrX);
-        clusters->SetBranchAddress("PosErrY", clusterPosErrY, &bClusterPosErrY);
-        clusters->SetBranchAddress("PosErrZ", clusterPosErrZ, &bClusterPosErrZ);
+        bindClusterBranches(clusters);
       }
     }
 
@@ -473,22 +822,18 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       _eventInfo->SetBranchAddress("TriggerOffset", &triggerOffset, &bTriggerOffset);
       _eventInfo->SetBranchAddress("TriggerInfo", &triggerInfo, &bTriggerInfo);
       _eventInfo->SetBranchAddress("Invalid", &invalid, &bInvalid);
+      // Only skims record where their events came from
+      if (_eventInfo->GetBranch("SourceEntry"))
+      {
+        _eventInfo->SetBranchAddress("SourceEntry", &sourceEntry, &bSourceEntry);
+        _sourceEntries = true;
+      }
     }
 
     if (_tracks)
     {
       _tracks->SetBranchAddress("NTracks", &numTracks, &bNumTracks);
-      _tracks->SetBranchAddress("SlopeX", trackSlopeX, &bTrackSlopeX);
-      _tracks->SetBranchAddress("SlopeY", trackSlopeY, &bTrackSlopeY);
-      _tracks->SetBranchAddress("SlopeErrX", trackSlopeErrX, &bTrackSlopeErrX);
-      _tracks->SetBranchAddress("SlopeErrY", trackSlopeErrY, &bTrackSlopeErrY);
-      _tracks->SetBranchAddress("OriginX", trackOriginX, &bTrackOriginX);
-      _tracks->SetBranchAddress("OriginY", trackOriginY, &bTrackOriginY);
-      _tracks->SetBranchAddress("OriginErrX", trackOriginErrX, &bTrackOriginErrX);
-      _tracks->SetBranchAddress("OriginErrY", trackOriginErrY, &bTrackOriginErrY);
-      _tracks->SetBranchAddress("CovarianceX", trackCovarianceX, &bTrackCovarianceX);
-      _tracks->SetBranchAddress("CovarianceY", trackCovarianceY, &bTrackCovarianceY);
-      _tracks->SetBranchAddress("Chi2", trackChi2, &bTrackChi2);
+      bindTrackBranches(_tracks);
     }
   }
 
@@ -503,7 +848,12 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       if (treeMask & Flags::CLUSTERS) { delete _clusters.at(nplane); _clusters.at(nplane) = 0; }
     }
     if (treeMask & Flags::TRACKS) { delete _tracks; _tracks = 0; }
-    if (treeMask & Flags::EVENTINFO) { delete _eventInfo; _eventInfo = 0; }
+    if (treeMask & Flags::EVENTINFO)
+    {
+      delete _eventInfo;
+      _eventInfo = 0;
+      _sourceEntries = false;
+    }
   }
 
   assert(_hits.size() == _clusters.size() && "StorageIO: varying number of planes");
@@ -539,6 +889,8 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
         (nClusters && _numEvents != nClusters))
       throw "StorageIO: all trees don't have the same number of events";
   }
+
+  openIndex(planeCount, treeMask, planeMask);
 }
 
   //----------------------------------------------------------------------------
@@ -564,7 +916,30 @@ StorageIO::StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes
       {
 	_file->Write();
 	delete _file;
+	// The index is only trusted with the file as it is once closed
+	try
+	  {
+	    if (_index) _index->stampStorage(_filePath);
+	  }
+	catch (const char* e)
+	  {
+	    if (VERBOSE) cout << "WARNING :: " << e << ", index won't be used" << endl;
+	  }
+      }
+    delete _index;
+
+    // Pool the recycled event's objects so they are freed with the rest
+    if (_event)
+      {
+	recycleEvent();
+	delete _event;
       }
+    for (unsigned int i = 0; i < _hitSlabs.size(); i++)
+      delete[] _hitSlabs.at(i);
+    for (unsigned int i = 0; i < _clusterSlabs.size(); i++)
+      delete[] _clusterSlabs.at(i);
+    for (unsigned int i = 0; i < _trackPool.size(); i++)
+      delete _trackPool.at(i);
   }
   
 }
@@ -1,11 +1,9 @@
 #include <iostream>
 #include <cassert>
 #include <vector>
-#include <stack>
 #include <string>
 #include <stdexcept>
 #include <set>
-#include <cstring>
 
 #include <TTree.h>
 
@@ -29,44 +27,78 @@ StorageIO::StorageIO(
     int treeMask) :
     m_file(filePath.c_str(), (fileMode==INPUT) ? "READ" : "RECREATE"),
     m_fileMode(fileMode),
-    m_numPlanes(numPlanes),
-    m_treeMask(treeMask),
-    m_maskMode(REMOVE),
-    m_numEvents(0),
-    m_event(0),
-    m_tracksTree(0),
-    m_eventInfoTree(0) {
+    m_treeMask(treeMask) {
+  initialize(numPlanes);
   if (!m_file.IsOpen()) throw std::runtime_error(
         "StorageIO::StorageIO: file didn't initialize");
+}
+
+StorageIO::StorageIO(size_t numPlanes, int treeMask) :
+    // `m_file` is left closed
+    m_fileMode(INPUT),
+    m_treeMask(treeMask) {
+  initialize(numPlanes);
+}
 
-  // Zero all the buffer memory at once. C++ guarantees continuous memory for
-  // members declared sequentially not split by an access specifier, so this
-  // works.
+void StorageIO::initialize(size_t numPlanes) {
+  m_numPlanes = numPlanes;
+  m_maskMode = REMOVE;
+  m_numEvents = 0;
+  m_event = 0;
+  m_tracksTree = 0;
+  m_eventInfoTree = 0;
 
-  // Total size from numHits to the end of the last track array
-  size_t size = (size_t)(&trackChi2) - (size_t)(&numHits);
-  size += sizeof(Double_t)*MAX_TRACKS;
-  std::memset(&numHits, 0, size);
+  // Arrays sized for typical multiplicities, they grow as needed
+  numHits = 0;
+  hitPixX.assign(INIT_HITS, 0);
+  hitPixY.assign(INIT_HITS, 0);
+  hitPosX.assign(INIT_HITS, 0);
+  hitPosY.assign(INIT_HITS, 0);
+  hitPosZ.assign(INIT_HITS, 0);
+  hitValue.assign(INIT_HITS, 0);
+  hitTiming.assign(INIT_HITS, 0);
+  hitInCluster.assign(INIT_HITS, 0);
+  hitMasked.assign(INIT_HITS, 0);
+  numClusters = 0;
+  clusterPixX.assign(INIT_CLUSTERS, 0);
+  clusterPixY.assign(INIT_CLUSTERS, 0);
+  clusterPixErrX.assign(INIT_CLUSTERS, 0);
+  clusterPixErrY.assign(INIT_CLUSTERS, 0);
+  clusterPosX.assign(INIT_CLUSTERS, 0);
+  clusterPosY.assign(INIT_CLUSTERS, 0);
+  clusterPosZ.assign(INIT_CLUSTERS, 0);
+  clusterPosErrX.assign(INIT_CLUSTERS, 0);
+  clusterPosErrY.assign(INIT_CLUSTERS, 0);
+  clusterPosErrZ.assign(INIT_CLUSTERS, 0);
+  clusterValue.assign(INIT_CLUSTERS, 0);
+  clusterTiming.assign(INIT_CLUSTERS, 0);
+  clusterInTrack.assign(INIT_CLUSTERS, 0);
+  timeStamp = 0;
+  frameNumber = 0;
+  triggerOffset = 0;
+  triggerInfo = 0;
+  invalid = false;
+  numTracks = 0;
+  trackSlopeX.assign(INIT_TRACKS, 0);
+  trackSlopeY.assign(INIT_TRACKS, 0);
+  trackSlopeErrX.assign(INIT_TRACKS, 0);
+  trackSlopeErrY.assign(INIT_TRACKS, 0);
+  trackOriginX.assign(INIT_TRACKS, 0);
+  trackOriginY.assign(INIT_TRACKS, 0);
+  trackOriginErrX.assign(INIT_TRACKS, 0);
+  trackOriginErrY.assign(INIT_TRACKS, 0);
+  trackCovarianceX.assign(INIT_TRACKS, 0);
+  trackCovarianceY.assign(INIT_TRACKS, 0);
+  trackChi2.assign(INIT_TRACKS, 0);
+  m_maxHits = 0;
+  m_maxClusters = 0;
+  m_maxTracks = 0;
 }
 
 StorageIO::~StorageIO() {
   // Delete the chached event
   if (m_event) delete m_event;
 
-  // Clear cache
-  while (!m_cacheHits.empty()) {
-    delete m_cacheHits.top();
-    m_cacheHits.pop();
-  }
-  while (!m_cacheClusters.empty()) {
-    delete m_cacheClusters.top();
-    m_cacheClusters.pop();
-  }
-  while (!m_cacheTracks.empty()) {
-    delete m_cacheTracks.top();
-    m_cacheTracks.pop();
-  }
-
   // Clear trees
   for (std::vector<TTree*>::iterator it = m_hitsTrees.begin();
       it != m_hitsTrees.end(); ++it)
@@ -80,68 +112,167 @@ StorageIO::~StorageIO() {
   m_file.Close();
 }
 
+Event* StorageIO::makeEvent() {
+  return new Event(*this);
+}
+
+void StorageIO::recycleEvent(Event& event) {
+  event.clear();
+}
+
 Event& StorageIO::newEvent() {
   if (!m_event) {
     // First call will generate the event object used by the storage
-    m_event = new Event(*this);
+    m_event = makeEvent();
   } else {
-    // The current `m_event` will be overwritten. Take onwership of the event's
-    // objects and cache them
-    for (std::vector<Hit*>::iterator it = m_event->m_hits.begin();
-        it != m_event->m_hits.end(); ++it)
-      m_cacheHits.push(*it);
-    for (std::vector<Cluster*>::iterator it = m_event->m_clusters.begin();
-        it != m_event->m_clusters.end(); ++it)
-      m_cacheClusters.push(*it);
-    for (std::vector<Track*>::iterator it = m_event->m_tracks.begin();
-        it != m_event->m_tracks.end(); ++it)
-      m_cacheTracks.push(*it);
-    // Clear the event's state and object associations
-    m_event->clear();
+    // The current `m_event` will be overwritten
+    recycleEvent(*m_event);
   }
 
   return *m_event;
 }
 
-Track& StorageIO::newTrack() {
-  Track* track = 0;
-  // Look for track in cache
-  if (m_cacheTracks.empty()) {
-    // Cahce is empty, make new track
-    track = new Track();
-  } else {
-    // Cache has tracks, get last
-    track = m_cacheTracks.top();
-    // Remove from cache, calling `Event` now owns it
-    m_cacheTracks.pop();
-    // Clear prior state and associations
-    track->clear();
-  }
-  return *track;
+/** Size to which an array of `size` entries grows to hold `num` entries.
+  * Doubling keeps the number of re-binds logarithmic in the multiplicity. */
+static size_t growSize(size_t size, size_t num) {
+  if (size < 1) size = 1;
+  while (size < num) size *= 2;
+  return size;
 }
 
-Cluster& StorageIO::newCluster() {
-  Cluster* cluster = 0;
-  if (m_cacheClusters.empty()) {
-    cluster = new Cluster();
-  } else {
-    cluster = m_cacheClusters.top();
-    m_cacheClusters.pop();
-    cluster->clear();
-  }
-  return *cluster;
+void StorageIO::reserveHits(Int_t num) {
+  if (num > m_maxHits) m_maxHits = num;
+  if (num <= (Int_t)hitPixX.size()) return;
+
+  const size_t size = growSize(hitPixX.size(), num);
+  hitPixX.resize(size, 0);
+  hitPixY.resize(size, 0);
+  hitPosX.resize(size, 0);
+  hitPosY.resize(size, 0);
+  hitPosZ.resize(size, 0);
+  hitValue.resize(size, 0);
+  hitTiming.resize(size, 0);
+  hitInCluster.resize(size, 0);
+  hitMasked.resize(size, 0);
+
+  // The arrays have moved, so the trees need their new addresses
+  for (std::vector<TTree*>::iterator it = m_hitsTrees.begin();
+      it != m_hitsTrees.end(); ++it)
+    bindHitsBranches(*it);
+  for (std::vector<TTree*>::iterator it = m_linksTrees.begin();
+      it != m_linksTrees.end(); ++it)
+    bindLinksBranches(*it);
 }
 
-Hit& StorageIO::newHit() {
-  Hit* hit = 0;
-  if (m_cacheHits.empty()) {
-    hit = new Hit();
-  } else {
-    hit = m_cacheHits.top();
-    m_cacheHits.pop();
-    hit->clear();
-  }
-  return *hit;
+void StorageIO::reserveClusters(Int_t num) {
+  if (num > m_maxClusters) m_maxClusters = num;
+  if (num <= (Int_t)clusterPixX.size()) return;
+
+  const size_t size = growSize(clusterPixX.size(), num);
+  clusterPixX.resize(size, 0);
+  clusterPixY.resize(size, 0);
+  clusterPixErrX.resize(size, 0);
+  clusterPixErrY.resize(size, 0);
+  clusterPosX.resize(size, 0);
+  clusterPosY.resize(size, 0);
+  clusterPosZ.resize(size, 0);
+  clusterPosErrX.resize(size, 0);
+  clusterPosErrY.resize(size, 0);
+  clusterPosErrZ.resize(size, 0);
+  clusterValue.resize(size, 0);
+  clusterTiming.resize(size, 0);
+  clusterInTrack.resize(size, 0);
+
+  for (std::vector<TTree*>::iterator it = m_clustersTrees.begin();
+      it != m_clustersTrees.end(); ++it)
+    bindClustersBranches(*it);
+}
+
+void StorageIO::reserveTracks(Int_t num) {
+  if (num > m_maxTracks) m_maxTracks = num;
+  if (num <= (Int_t)trackSlopeX.size()) return;
+
+  const size_t size = growSize(trackSlopeX.size(), num);
+  trackSlopeX.resize(size, 0);
+  trackSlopeY.resize(size, 0);
+  trackSlopeErrX.resize(size, 0);
+  trackSlopeErrY.resize(size, 0);
+  trackOriginX.resize(size, 0);
+  trackOriginY.resize(size, 0);
+  trackOriginErrX.resize(size, 0);
+  trackOriginErrY.resize(size, 0);
+  trackCovarianceX.resize(size, 0);
+  trackCovarianceY.resize(size, 0);
+  trackChi2.resize(size, 0);
+
+  if (m_tracksTree) bindTracksBranches(m_tracksTree);
+}
+
+void StorageIO::bindBranch(
+    TTree* tree,
+    const char* name,
+    void* address,
+    bool off) {
+  if (m_fileMode == INPUT && off) return;
+  if (tree->GetBranch(name)) tree->SetBranchAddress(name, address);
+}
+
+void StorageIO::bindHitsBranches(TTree* tree) {
+  bindBranch(tree, "PixX", &hitPixX[0], isHitsBranchOff("PixX"));
+  bindBranch(tree, "PixY", &hitPixY[0], isHitsBranchOff("PixY"));
+  bindBranch(tree, "PosX", &hitPosX[0], isHitsBranchOff("PosX"));
+  bindBranch(tree, "PosY", &hitPosY[0], isHitsBranchOff("PosY"));
+  bindBranch(tree, "PosZ", &hitPosZ[0], isHitsBranchOff("PosZ"));
+  bindBranch(tree, "Value", &hitValue[0], isHitsBranchOff("Value"));
+  bindBranch(tree, "Timing", &hitTiming[0], isHitsBranchOff("Timing"));
+  // Associations aren't read if the clusters tree is masked
+  bindBranch(tree, "InCluster", &hitInCluster[0],
+      isHitsBranchOff("InCluster") || (m_treeMask & CLUSTERS));
+}
+
+void StorageIO::bindClustersBranches(TTree* tree) {
+  bindBranch(tree, "PixX", &clusterPixX[0], isClustersBranchOff("PixX"));
+  bindBranch(tree, "PixY", &clusterPixY[0], isClustersBranchOff("PixY"));
+  bindBranch(tree, "PixErrX", &clusterPixErrX[0], isClustersBranchOff("PixErrX"));
+  bindBranch(tree, "PixErrY", &clusterPixErrY[0], isClustersBranchOff("PixErrY"));
+  bindBranch(tree, "PosX", &clusterPosX[0], isClustersBranchOff("PosX"));
+  bindBranch(tree, "PosY", &clusterPosY[0], isClustersBranchOff("PosY"));
+  bindBranch(tree, "PosZ", &clusterPosZ[0], isClustersBranchOff("PosZ"));
+  bindBranch(tree, "PosErrX", &clusterPosErrX[0], isClustersBranchOff("PosErrX"));
+  bindBranch(tree, "PosErrY", &clusterPosErrY[0], isClustersBranchOff("PosErrY"));
+  bindBranch(tree, "PosErrZ", &clusterPosErrZ[0], isClustersBranchOff("PosErrZ"));
+  bindBranch(tree, "Value", &clusterValue[0], isClustersBranchOff("Value"));
+  bindBranch(tree, "Timing", &clusterTiming[0], isClustersBranchOff("Timing"));
+  bindBranch(tree, "InTrack", &clusterInTrack[0],
+      isClustersBranchOff("InTrack") || (m_treeMask & TRACKS));
+}
+
+void StorageIO::bindTracksBranches(TTree* tree) {
+  bindBranch(tree, "SlopeX", &trackSlopeX[0], isTracksBranchOff("SlopeX"));
+  bindBranch(tree, "SlopeY", &trackSlopeY[0], isTracksBranchOff("SlopeY"));
+  bindBranch(tree, "SlopeErrX", &trackSlopeErrX[0], isTracksBranchOff("SlopeErrX"));
+  bindBranch(tree, "SlopeErrY", &trackSlopeErrY[0], isTracksBranchOff("SlopeErrY"));
+  bindBranch(tree, "OriginX", &trackOriginX[0], isTracksBranchOff("OriginX"));
+  bindBranch(tree, "OriginY", &trackOriginY[0], isTracksBranchOff("OriginY"));
+  bindBranch(tree, "OriginErrX", &trackOriginErrX[0], isTracksBranchOff("OriginErrX"));
+  bindBranch(tree, "OriginErrY", &trackOriginErrY[0], isTracksBranchOff("OriginErrY"));
+  bindBranch(tree, "CovarianceX", &trackCovarianceX[0], isTracksBranchOff("CovarianceX"));
+  bindBranch(tree, "CovarianceY", &trackCovarianceY[0], isTracksBranchOff("CovarianceY"));
+  bindBranch(tree, "Chi2", &trackChi2[0], isTracksBranchOff("Chi2"));
+}
+
+void StorageIO::bindLinksBranches(TTree* tree) {
+  bindBranch(tree, "InCluster", &hitInCluster[0], m_treeMask & CLUSTERS);
+}
+
+void StorageIO::setNoiseMasks(
+    const std::vector<PixelMask>& masks,
+    MaskMode mode) {
+  if (!masks.empty() && masks.size() != m_numPlanes)
+    throw std::runtime_error(
+        "StorageIO::setNoiseMasks: number of masks does not match planes");
+  m_noiseMasks = masks;
+  m_maskMode = mode;
 }
 
 bool StorageIO::isHitsBranchOff(const std::string& name) const {
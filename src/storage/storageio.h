@@ -11,17 +11,29 @@
 #include "TBranchElement.h"
 #include "TClonesArray.h"
 
+#include "../../include/storage/pixelmask.h"
+
 /* NOTE: these sizes are used to initialize arrays of track, cluster and
  * hit information. BUT these arrays are generated ONLY ONCE and re-used
- * to load events. Vectors could have been used in the ROOT file format, but
+ * to load events, growing (and being re-bound to the branches) only when an
+ * event doesn't fit. Vectors could have been used in the ROOT file format, but
  * they would need to be constructed at each event reading step. */
-#define MAX_TRACKS 1000
-#define MAX_CLUSTERS 1000
-#define MAX_HITS 1000
+#define INIT_TRACKS 16
+#define INIT_CLUSTERS 64
+#define INIT_HITS 256
+
+/* Number of hits or clusters allocated at once when a recycling storage runs
+ * out of pooled objects */
+#define POOL_SLAB_SIZE 256
 
 namespace Storage {
 
 class Event;
+class Hit;
+class Cluster;
+class Track;
+class EventIndex;
+class EventSummary;
 
 enum Mode {
   INPUT,
@@ -57,7 +69,21 @@ private:
   unsigned int _numPlanes; // This can be read from the file structure
   Long64_t     _numEvents; // Number of events in the input file
 
-  const std::vector<bool**>* _noiseMasks;
+  const std::vector<const PixelMask*>* _noiseMasks;
+  bool _sourceEntries; // The event tree records where each event came from
+
+  EventIndex* _index; // Per-event summaries written or read alongside the file
+
+  /* In recycling mode, `readEvent` always returns the same event and its
+   * hits, clusters and tracks come from pools which are re-filled when the
+   * event is read over, rather than being freed. */
+  bool                  _recycleEvents;
+  Event*                _event; // The recycled event, owned by this storage
+  std::vector<Hit*>     _hitPool; // Hits ready to be handed out
+  std::vector<Hit*>     _hitSlabs; // Blocks of POOL_SLAB_SIZE hits
+  std::vector<Cluster*> _clusterPool;
+  std::vector<Cluster*> _clusterSlabs;
+  std::vector<Track*>   _trackPool; // Individually allocated, also lent to the TrackMaker
 
   /* NOTE: trees can easily be added and removed from a file. So each type
    * of information that might or might not be included in a file should be
@@ -72,56 +98,58 @@ private:
 
   // Variables in which the storage is output on an event-by-event basis
 
-  Int_t    numHits;
-  Int_t    hitPixX[MAX_HITS];
-  Int_t    hitPixY[MAX_HITS];
-  Double_t hitPosX[MAX_HITS];
-  Double_t hitPosY[MAX_HITS];
-  Double_t hitPosZ[MAX_HITS];
-  Double_t hitValue[MAX_HITS];
-  Double_t hitT0[MAX_HITS];  
-  Int_t    hitValueInt[MAX_HITS];
-  Double_t hitTiming[MAX_HITS];
-  Int_t    hitTimingInt[MAX_HITS];
-  Int_t    hitInCluster[MAX_HITS];
-  Double_t hitChi2[MAX_HITS];
-  Double_t hitIsHit[MAX_HITS];
-  Double_t hitValidFit[MAX_HITS];
+  Int_t                 numHits;
+  std::vector<Int_t>    hitPixX;
+  std::vector<Int_t>    hitPixY;
+  std::vector<Double_t> hitPosX;
+  std::vector<Double_t> hitPosY;
+  std::vector<Double_t> hitPosZ;
+  std::vector<Double_t> hitValue;
+  std::vector<Double_t> hitT0;
+  std::vector<Int_t>    hitValueInt;
+  std::vector<Double_t> hitTiming;
+  std::vector<Int_t>    hitTimingInt;
+  std::vector<Int_t>    hitInCluster;
+  std::vector<char>     hitMasked; // Noise mask flags, looked up per plane
+  std::vector<Double_t> hitChi2;
+  std::vector<Double_t> hitIsHit;
+  std::vector<Double_t> hitValidFit;
   
   VarType hitValueType;    
   VarType hitTimingType;
   
-  Int_t    numClusters;
-  Double_t clusterPixX[MAX_CLUSTERS];
-  Double_t clusterPixY[MAX_CLUSTERS];
-  Double_t clusterPixErrX[MAX_CLUSTERS];
-  Double_t clusterPixErrY[MAX_CLUSTERS];
-  Double_t clusterPosX[MAX_CLUSTERS];
-  Double_t clusterPosY[MAX_CLUSTERS];
-  Double_t clusterPosZ[MAX_CLUSTERS];
-  Double_t clusterPosErrX[MAX_CLUSTERS];
-  Double_t clusterPosErrY[MAX_CLUSTERS];
-  Double_t clusterPosErrZ[MAX_CLUSTERS];
-  Int_t    clusterInTrack[MAX_CLUSTERS];
+  Int_t                 numClusters;
+  std::vector<Double_t> clusterPixX;
+  std::vector<Double_t> clusterPixY;
+  std::vector<Double_t> clusterPixErrX;
+  std::vector<Double_t> clusterPixErrY;
+  std::vector<Double_t> clusterPosX;
+  std::vector<Double_t> clusterPosY;
+  std::vector<Double_t> clusterPosZ;
+  std::vector<Double_t> clusterPosErrX;
+  std::vector<Double_t> clusterPosErrY;
+  std::vector<Double_t> clusterPosErrZ;
+  std::vector<Int_t>    clusterInTrack;
 
   ULong64_t timeStamp;
   ULong64_t frameNumber;
   Int_t     triggerOffset;
   Int_t     triggerInfo;
   Bool_t    invalid;
+  Long64_t  sourceEntry;
 
-  Int_t    numTracks;
-  Double_t trackSlopeX[MAX_TRACKS];
-  Double_t trackSlopeY[MAX_TRACKS];
-  Double_t trackSlopeErrX[MAX_TRACKS];
-  Double_t trackSlopeErrY[MAX_TRACKS];
-  Double_t trackOriginX[MAX_TRACKS];
-  Double_t trackOriginY[MAX_TRACKS];
-  Double_t trackOriginErrX[MAX_TRACKS];
-  Double_t trackOriginErrY[MAX_TRACKS];
-  Double_t trackCovarianceX[MAX_TRACKS];
-  Double_t trackCovarianceY[MAX_TRACKS];
-  Double_t trackChi2[MAX_TRACKS];
+  Int_t                 numTracks;
+  std::vector<Double_t> trackSlopeX;
+  std::vector<Double_t> trackSlopeY;
+  std::vector<Double_t> trackSlopeErrX;
+  std::vector<Double_t> trackSlopeErrY;
+  std::vector<Double_t> trackOriginX;
+  std::vector<Double_t> trackOriginY;
+  std::vector<Double_t> trackOriginErrX;
+  std::vector<Double_t> trackOriginErrY;
+  std::vector<Double_t> trackCovarianceX;
+  std::vector<Double_t> trackCovarianceY;
+  std::vector<Double_t> trackChi2;
 
   // Branches corresponding to the above variables
 
@@ -159,6 +187,7 @@ private:
   TBranch* bTriggerOffset;
   TBranch* bTriggerInfo;
   TBranch* bInvalid;
+  TBranch* bSourceEntry;
 
   TBranch* bNumTracks;
   TBranch* bTrackSlopeX;
@@ -175,7 +204,32 @@ private:
 
   void clearVariables();
 
+  // Largest number of hits and clusters in a plane, and tracks in an event
+  Int_t _maxHits;
+  Int_t _maxClusters;
+  Int_t _maxTracks;
+
+  void readCount(TTree* tree, const char* name, Long64_t n); // Reads only the multiplicity
+  void reserveHits(Int_t num); // Grow the arrays and re-bind the branches if needed
+  void reserveClusters(Int_t num);
+  void reserveTracks(Int_t num);
+  void bindHitBranches(TTree* hits); // Point the array branches at the arrays
+  void bindClusterBranches(TTree* clusters);
+  void bindTrackBranches(TTree* tracks);
+
+  Hit* newHit(); // Pooled objects for the recycled event
+  Cluster* newCluster();
+  Track* newTrack();
+  void releaseTrack(Track* track); // Back to the pool, for trial tracks
+  Event* recycleEvent(); // Take back the recycled event's objects and clear it
+
+  bool dropsHits() const; // Some stored hits don't make it into read events
+  void openIndex(unsigned int filePlanes, unsigned int treeMask,
+                 const std::vector<bool>* planeMask);
+
 public:
+  static bool writeIndexes; // Output storages also write their index
+
   StorageIO(const char* filePath, Mode fileMode, unsigned int numPlanes = 0,
             const unsigned int treeMask = 0, const std::vector<bool>* planeMask = 0);
   ~StorageIO();
@@ -183,16 +237,41 @@ public:
   Event* readEvent(Long64_t n); // Read an event and generate its objects
   void writeEvent(Event* event); // Write an event at the end of the file
 
-  void setNoiseMasks(std::vector<bool**>* noiseMasks);
+  void setNoiseMasks(std::vector<const PixelMask*>* noiseMasks);
+
+  /* Opt-in: only for loops which are done with an event before reading the
+   * next one. Events must then be disposed of with `releaseEvent`. */
+  void setRecycleEvents(bool value);
+  void releaseEvent(Event* event); // Deletes the event unless it is recycled
+
+  /* Summary of event `n` from the file's index, or 0 if the file has none.
+   * The index is written with the file when `writeIndexes` is set, or later
+   * with the `index` command, and is only used while it matches the file.
+   * Much cheaper than `readEvent`, use it to skip events before reading. */
+  const EventSummary* readSummary(Long64_t n);
+  bool hasIndex() const;
+  unsigned int missingTrees() const; // Tree mask of the trees which aren't open
+
+  /* Record the entry of each event in the full file which it was skimmed
+   * from (`Event::getSourceEntry`), so that the file can be mapped back onto
+   * it. Output only, before any event is written. */
+  void enableSourceEntries();
+  bool hasSourceEntries() const; // The events come from another file
 
   Long64_t getNumEvents() const;
   unsigned int getNumPlanes() const;
   Storage::Mode getMode() const;
+  bool getRecycleEvents() const;
+  Int_t getMaxHits() const; // High-water marks of the arrays
+  Int_t getMaxClusters() const;
+  Int_t getMaxTracks() const;
   Storage::VarType getType(const std::string &t) const;
   
 private:
   StorageIO(const StorageIO&); // Disable the copy constructor
   StorageIO& operator=(const StorageIO&); // Disable the assignment operator
+
+  friend class Event; // Gets its objects from the pools
 };
 
 }
@@ -0,0 +1,482 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Rtypes.h>
+
+#include "storage/hit.h"
+#include "storage/cluster.h"
+#include "storage/plane.h"
+#include "storage/track.h"
+#include "storage/event.h"
+#include "storage/eventview.h"
+#include "storage/storageio.h"
+#include "storage/storagemapped.h"
+
+namespace Storage {
+
+namespace {
+
+const char MAGIC[8] = {'J', 'U', 'D', 'M', 'A', 'P', 0, 0};
+const UInt_t VERSION = 1;
+// Reads back differently on a host of the other endianness
+const UInt_t BYTE_ORDER_MARK = 0x01020304;
+
+struct FileHeader {
+  char magic[8];
+  UInt_t version;
+  UInt_t byteOrder;
+  ULong64_t numPlanes;
+  ULong64_t numEvents;
+  ULong64_t indexOffset;
+};
+
+struct EventHeader {
+  ULong64_t timeStamp;
+  ULong64_t frameNumber;
+  Int_t triggerOffset;
+  Int_t triggerInfo;
+  Int_t invalid;
+  UInt_t numTracks;
+};
+
+/** Bytes taken by `n` values of `T`, padded to keep the blocks aligned */
+template <class T>
+size_t columnSize(size_t n) {
+  return (n*sizeof(T) + 7) & ~(size_t)7;
+}
+
+/** Span over the column of `n` values at `cursor`, and move past it. The
+  * span is empty if the column isn't kept. */
+template <class T>
+Span<T> readColumn(
+    const char*& cursor,
+    const char* end,
+    size_t n,
+    bool keep=true) {
+  const size_t size = columnSize<T>(n);
+  if (cursor + size > end)
+    throw std::runtime_error(
+        "StorageMapped::readView: event block runs past the end of the file");
+  const T* column = reinterpret_cast<const T*>(cursor);
+  cursor += size;
+  return keep ? Span<T>(column, n) : Span<T>();
+}
+
+/** Column of `n` values to fill at `cursor`, and move past it */
+template <class T>
+T* writeColumn(char*& cursor, size_t n) {
+  T* column = reinterpret_cast<T*>(cursor);
+  cursor += columnSize<T>(n);
+  return column;
+}
+
+}
+
+StorageMapped::StorageMapped(
+    const std::string& filePath,
+    int treeMask,
+    const std::vector<bool>* planeMask) :
+    StorageIO(0, treeMask),
+    m_fd(-1),
+    m_data(0),
+    m_size(0),
+    m_index(0),
+    m_filePlanes(0) {
+  m_fd = ::open(filePath.c_str(), O_RDONLY);
+  if (m_fd < 0)
+    throw std::runtime_error("StorageMapped::StorageMapped: can't open file");
+
+  struct stat info;
+  if (::fstat(m_fd, &info) != 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+    ::close(m_fd);
+    throw std::runtime_error("StorageMapped::StorageMapped: file too small");
+  }
+  m_size = info.st_size;
+
+  void* data = ::mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (data == MAP_FAILED) {
+    ::close(m_fd);
+    throw std::runtime_error("StorageMapped::StorageMapped: can't map file");
+  }
+  m_data = static_cast<const char*>(data);
+  // Passes over the events will be repeated, ask for it all to be paged in
+  ::madvise(data, m_size, MADV_WILLNEED);
+
+  const FileHeader& header = *reinterpret_cast<const FileHeader*>(m_data);
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION ||
+      header.byteOrder != BYTE_ORDER_MARK ||
+      header.indexOffset + header.numEvents*sizeof(ULong64_t) > m_size) {
+    ::munmap(data, m_size);
+    ::close(m_fd);
+    throw std::runtime_error(
+        "StorageMapped::StorageMapped: not a valid mapped event file");
+  }
+
+  m_filePlanes = header.numPlanes;
+  m_numEvents = header.numEvents;
+  m_index = reinterpret_cast<const ULong64_t*>(m_data + header.indexOffset);
+
+  if (planeMask && planeMask->size() < m_filePlanes) {
+    ::munmap(data, m_size);
+    ::close(m_fd);
+    throw std::runtime_error(
+        "StorageMapped::StorageMapped: plane mask is too small");
+  }
+
+  m_planeMask.assign(m_filePlanes, false);
+  for (size_t nplane = 0; nplane < m_filePlanes; nplane++) {
+    if (planeMask) m_planeMask[nplane] = planeMask->at(nplane);
+    if (!m_planeMask[nplane]) m_numPlanes += 1;
+  }
+
+  if (m_numPlanes == 0) {
+    ::munmap(data, m_size);
+    ::close(m_fd);
+    throw std::runtime_error(
+        "StorageMapped::StorageMapped: zero planes read from file");
+  }
+
+  m_view.planes.resize(m_numPlanes);
+  m_firstClusters.resize(m_numPlanes);
+}
+
+StorageMapped::~StorageMapped() {
+  if (m_data) ::munmap(const_cast<char*>(m_data), m_size);
+  if (m_fd >= 0) ::close(m_fd);
+}
+
+void StorageMapped::fillView(Long64_t n) {
+  if (n < 0 || n >= m_numEvents)
+    throw std::out_of_range(
+        "StorageMapped::readView: event out of bounds");
+
+  const char* end = m_data + m_size;
+  const char* cursor = m_data + m_index[n];
+
+  const EventHeader& header = *readColumn<EventHeader>(cursor, end, 1).data();
+  m_view.timeStamp = header.timeStamp;
+  m_view.frameNumber = header.frameNumber;
+  m_view.triggerOffset = header.triggerOffset;
+  m_view.triggerInfo = header.triggerInfo;
+  m_view.invalid = header.invalid;
+
+  // Hits and clusters count of each plane, interleaved
+  const Span<UInt_t> counts = readColumn<UInt_t>(cursor, end, 2*m_filePlanes);
+
+  // Masked trees are read over but shown as empty
+  const size_t ntracks = header.numTracks;
+  const bool tracks = !(m_treeMask & TRACKS);
+  m_view.numTracks = tracks ? ntracks : 0;
+  m_view.trackSlopeX = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackSlopeY = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackSlopeErrX = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackSlopeErrY = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackOriginX = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackOriginY = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackOriginErrX = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackOriginErrY = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackCovarianceX = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackCovarianceY = readColumn<Double_t>(cursor, end, ntracks, tracks);
+  m_view.trackChi2 = readColumn<Double_t>(cursor, end, ntracks, tracks);
+
+  size_t iplane = 0;  // index of the plane in the view
+  size_t firstCluster = 0;  // event-wide index of the plane's first cluster
+  for (size_t nplane = 0; nplane < m_filePlanes; nplane++) {
+    const size_t nhits = counts[2*nplane];
+    const size_t nclusters = counts[2*nplane+1];
+
+    // Read over the columns of masked planes
+    EventView::PlaneView unused;
+    EventView::PlaneView& plane =
+        m_planeMask[nplane] ? unused : m_view.planes[iplane];
+    if (!m_planeMask[nplane]) m_firstClusters[iplane++] = firstCluster;
+    firstCluster += nclusters;
+
+    const bool hits = !(m_treeMask & HITS);
+    plane.numHits = hits ? nhits : 0;
+    plane.hitPixX = readColumn<Int_t>(cursor, end, nhits, hits);
+    plane.hitPixY = readColumn<Int_t>(cursor, end, nhits, hits);
+    plane.hitPosX = readColumn<Double_t>(cursor, end, nhits, hits);
+    plane.hitPosY = readColumn<Double_t>(cursor, end, nhits, hits);
+    plane.hitPosZ = readColumn<Double_t>(cursor, end, nhits, hits);
+    plane.hitValue = readColumn<Int_t>(cursor, end, nhits, hits);
+    plane.hitTiming = readColumn<Int_t>(cursor, end, nhits, hits);
+    plane.hitInCluster = readColumn<Int_t>(cursor, end, nhits, hits);
+
+    const bool clusters = !(m_treeMask & CLUSTERS);
+    plane.numClusters = clusters ? nclusters : 0;
+    plane.clusterPixX = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPixY = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPixErrX = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPixErrY = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosX = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosY = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosZ = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosErrX = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosErrY = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterPosErrZ = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterValue = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterTiming = readColumn<Double_t>(cursor, end, nclusters, clusters);
+    plane.clusterInTrack = readColumn<Int_t>(cursor, end, nclusters, clusters);
+  }
+}
+
+const EventView& StorageMapped::readView(Long64_t n) {
+  fillView(n);
+  return m_view;
+}
+
+Event& StorageMapped::readEvent(Long64_t n) {
+  fillView(n);
+
+  // This will clear the previous event and cache its objects
+  Event& event = newEvent();
+  event.setTimeStamp(m_view.timeStamp);
+  event.setFrameNumber(m_view.frameNumber);
+  event.setTriggerOffset(m_view.triggerOffset);
+  event.setTriggerInfo(m_view.triggerInfo);
+  event.setInvalid(m_view.invalid);
+
+  for (size_t ntrack = 0; ntrack < m_view.numTracks; ntrack++) {
+    Track& track = event.newTrack();
+    track.setOrigin(m_view.trackOriginX[ntrack], m_view.trackOriginY[ntrack]);
+    track.setOriginErr(
+        m_view.trackOriginErrX[ntrack],
+        m_view.trackOriginErrY[ntrack]);
+    track.setSlope(m_view.trackSlopeX[ntrack], m_view.trackSlopeY[ntrack]);
+    track.setSlopeErr(
+        m_view.trackSlopeErrX[ntrack],
+        m_view.trackSlopeErrY[ntrack]);
+    track.setCovariance(
+        m_view.trackCovarianceX[ntrack],
+        m_view.trackCovarianceY[ntrack]);
+    track.setChi2(m_view.trackChi2[ntrack]);
+  }
+
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    const EventView::PlaneView& plane = m_view.planes[nplane];
+
+    // Associations are stored as event-wide cluster indices, which differ
+    // from the event's if planes are masked
+    const Int_t firstCluster = event.getNumClusters();
+    const Int_t fileFirst = m_firstClusters[nplane];
+
+    for (size_t ncluster = 0; ncluster < plane.numClusters; ncluster++) {
+      Cluster& cluster = event.newCluster(nplane);
+      cluster.setPix(plane.clusterPixX[ncluster], plane.clusterPixY[ncluster]);
+      cluster.setPixErr(
+          plane.clusterPixErrX[ncluster],
+          plane.clusterPixErrY[ncluster]);
+      cluster.setPos(
+          plane.clusterPosX[ncluster],
+          plane.clusterPosY[ncluster],
+          plane.clusterPosZ[ncluster]);
+      cluster.setPosErr(
+          plane.clusterPosErrX[ncluster],
+          plane.clusterPosErrY[ncluster],
+          plane.clusterPosErrZ[ncluster]);
+      cluster.setTiming(plane.clusterTiming[ncluster]);
+      cluster.setValue(plane.clusterValue[ncluster]);
+
+      const Int_t intrack = plane.clusterInTrack[ncluster];
+      if (m_view.numTracks && intrack > 0)
+        event.getTrack(intrack-1).addCluster(cluster);
+    }
+
+    for (size_t nhit = 0; nhit < plane.numHits; nhit++) {
+      Hit& hit = event.newHit(nplane);
+      hit.setPix(plane.hitPixX[nhit], plane.hitPixY[nhit]);
+      hit.setPos(plane.hitPosX[nhit], plane.hitPosY[nhit], plane.hitPosZ[nhit]);
+      hit.setValue(plane.hitValue[nhit]);
+      hit.setTiming(plane.hitTiming[nhit]);
+
+      const Int_t incluster = plane.hitInCluster[nhit];
+      if (plane.numClusters && incluster > 0)
+        event.getCluster(firstCluster + incluster-1 - fileFirst).addHit(hit);
+    }
+  }
+
+  return event;
+}
+
+StorageMappedO::StorageMappedO(const std::string& filePath, size_t numPlanes) :
+    m_file(filePath.c_str(), std::ios::binary | std::ios::trunc),
+    m_numPlanes(numPlanes),
+    m_offset(sizeof(FileHeader)) {
+  if (!m_file.is_open())
+    throw std::runtime_error("StorageMappedO::StorageMappedO: can't open file");
+  // Placeholder header, completed once the number of events is known
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+StorageMappedO::~StorageMappedO() {
+  if (m_file.is_open()) close();
+}
+
+void StorageMappedO::writeEvent(Event& event) {
+  if (!m_file.is_open())
+    throw std::runtime_error("StorageMappedO::writeEvent: file is closed");
+  if (event.getNumPlanes() != m_numPlanes)
+    throw std::runtime_error(
+        "StorageMappedO::writeEvent: event planes don't match the storage");
+
+  const size_t ntracks = event.getNumTracks();
+
+  // Size the block up front so that the columns don't move while filled
+  size_t size = columnSize<EventHeader>(1);
+  size += columnSize<UInt_t>(2*m_numPlanes);
+  size += 11 * columnSize<Double_t>(ntracks);
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    const Plane& plane = event.getPlane(nplane);
+    size += 5 * columnSize<Int_t>(plane.getNumHits());
+    size += 3 * columnSize<Double_t>(plane.getNumHits());
+    size += 12 * columnSize<Double_t>(plane.getNumClusters());
+    size += columnSize<Int_t>(plane.getNumClusters());
+  }
+  // Zeroed so that the padding is reproducible
+  m_block.assign(size, 0);
+  char* cursor = &m_block[0];
+
+  EventHeader& header = *writeColumn<EventHeader>(cursor, 1);
+  header.timeStamp = event.getTimeStamp();
+  header.frameNumber = event.getFrameNumber();
+  header.triggerOffset = event.getTriggerOffset();
+  header.triggerInfo = event.getTriggerInfo();
+  header.invalid = event.getInvalid();
+  header.numTracks = ntracks;
+
+  UInt_t* counts = writeColumn<UInt_t>(cursor, 2*m_numPlanes);
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    counts[2*nplane] = event.getPlane(nplane).getNumHits();
+    counts[2*nplane+1] = event.getPlane(nplane).getNumClusters();
+  }
+
+  Double_t* slopeX = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* slopeY = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* slopeErrX = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* slopeErrY = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* originX = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* originY = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* originErrX = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* originErrY = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* covarianceX = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* covarianceY = writeColumn<Double_t>(cursor, ntracks);
+  Double_t* chi2 = writeColumn<Double_t>(cursor, ntracks);
+  for (size_t ntrack = 0; ntrack < ntracks; ntrack++) {
+    const Track& track = event.getTrack(ntrack);
+    slopeX[ntrack] = track.getSlopeX();
+    slopeY[ntrack] = track.getSlopeY();
+    slopeErrX[ntrack] = track.getSlopeErrX();
+    slopeErrY[ntrack] = track.getSlopeErrY();
+    originX[ntrack] = track.getOriginX();
+    originY[ntrack] = track.getOriginY();
+    originErrX[ntrack] = track.getOriginErrX();
+    originErrY[ntrack] = track.getOriginErrY();
+    covarianceX[ntrack] = track.getCovarianceX();
+    covarianceY[ntrack] = track.getCovarianceY();
+    chi2[ntrack] = track.getChi2();
+  }
+
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    const Plane& plane = event.getPlane(nplane);
+    const size_t nhits = plane.getNumHits();
+    const size_t nclusters = plane.getNumClusters();
+
+    Int_t* hitPixX = writeColumn<Int_t>(cursor, nhits);
+    Int_t* hitPixY = writeColumn<Int_t>(cursor, nhits);
+    Double_t* hitPosX = writeColumn<Double_t>(cursor, nhits);
+    Double_t* hitPosY = writeColumn<Double_t>(cursor, nhits);
+    Double_t* hitPosZ = writeColumn<Double_t>(cursor, nhits);
+    Int_t* hitValue = writeColumn<Int_t>(cursor, nhits);
+    Int_t* hitTiming = writeColumn<Int_t>(cursor, nhits);
+    Int_t* hitInCluster = writeColumn<Int_t>(cursor, nhits);
+    for (size_t nhit = 0; nhit < nhits; nhit++) {
+      const Hit& hit = plane.getHit(nhit);
+      hitPixX[nhit] = hit.getPixX();
+      hitPixY[nhit] = hit.getPixY();
+      hitPosX[nhit] = hit.getPosX();
+      hitPosY[nhit] = hit.getPosY();
+      hitPosZ[nhit] = hit.getPosZ();
+      hitValue[nhit] = hit.getValue();
+      hitTiming[nhit] = hit.getTiming();
+      // Index plus one, 0 is no cluster
+      hitInCluster[nhit] =
+          hit.fetchCluster() ? hit.fetchCluster()->getIndex()+1 : 0;
+    }
+
+    Double_t* pixX = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* pixY = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* pixErrX = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* pixErrY = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posX = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posY = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posZ = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posErrX = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posErrY = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* posErrZ = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* value = writeColumn<Double_t>(cursor, nclusters);
+    Double_t* timing = writeColumn<Double_t>(cursor, nclusters);
+    Int_t* inTrack = writeColumn<Int_t>(cursor, nclusters);
+    for (size_t ncluster = 0; ncluster < nclusters; ncluster++) {
+      const Cluster& cluster = plane.getCluster(ncluster);
+      pixX[ncluster] = cluster.getPixX();
+      pixY[ncluster] = cluster.getPixY();
+      pixErrX[ncluster] = cluster.getPixErrX();
+      pixErrY[ncluster] = cluster.getPixErrY();
+      posX[ncluster] = cluster.getPosX();
+      posY[ncluster] = cluster.getPosY();
+      posZ[ncluster] = cluster.getPosZ();
+      posErrX[ncluster] = cluster.getPosErrX();
+      posErrY[ncluster] = cluster.getPosErrY();
+      posErrZ[ncluster] = cluster.getPosErrZ();
+      value[ncluster] = cluster.getValue();
+      timing[ncluster] = cluster.getTiming();
+      inTrack[ncluster] =
+          cluster.fetchTrack() ? cluster.fetchTrack()->getIndex()+1 : 0;
+    }
+  }
+
+  m_file.write(&m_block[0], m_block.size());
+  if (!m_file)
+    throw std::runtime_error("StorageMappedO::writeEvent: error writing file");
+
+  m_index.push_back(m_offset);
+  m_offset += m_block.size();
+}
+
+void StorageMappedO::close() {
+  if (!m_file.is_open()) return;
+
+  // The index follows the last event block, which are all 8 byte aligned
+  if (!m_index.empty())
+    m_file.write(
+        reinterpret_cast<const char*>(&m_index[0]),
+        m_index.size()*sizeof(ULong64_t));
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.numPlanes = m_numPlanes;
+  header.numEvents = m_index.size();
+  header.indexOffset = m_offset;
+
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  m_file.close();
+}
+
+}
@@ -5,11 +5,18 @@
 #include <sstream>
 #include <stdexcept>
 #include <set>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
+#include <TROOT.h>
 #include <TFile.h>
 #include <TDirectory.h>
 #include <TTree.h>
 #include <TBranch.h>
+#include <TNamed.h>
 
 #include "storage/hit.h"
 #include "storage/cluster.h"
@@ -32,8 +39,12 @@ StorageO::StorageO(
     const std::set<std::string>* hitsBranchesOff,
     const std::set<std::string>* clustersBranchesOff,
     const std::set<std::string>* tracksBranchesOff,
-    const std::set<std::string>* eventInfoBranchesOff) :
-    StorageIO(filePath, OUTPUT, numPlanes, treeMask) {
+    const std::set<std::string>* eventInfoBranchesOff,
+    const std::string& friendOf,
+    const Settings& settings) :
+    StorageIO(filePath, OUTPUT, numPlanes, treeMask),
+    m_settings(settings),
+    m_writeStop(false) {
 
   // Copy any/all given branch masks
   if (hitsBranchesOff) m_hitsBranchesOff = *hitsBranchesOff;
@@ -41,9 +52,27 @@ StorageO::StorageO(
   if (tracksBranchesOff) m_tracksBranchesOff = *tracksBranchesOff;
   if (eventInfoBranchesOff) m_eventInfoBranchesOff = *eventInfoBranchesOff;
 
+  // Branches take the compression of the file when they are made
+  if (m_settings.compressionAlgorithm >= 0)
+    m_file.SetCompressionAlgorithm(m_settings.compressionAlgorithm);
+  if (m_settings.compressionLevel >= 0)
+    m_file.SetCompressionLevel(m_settings.compressionLevel);
+
   // Avoid always checking !
   treeMask = ~treeMask;
 
+  // The hits and event information stay in the original file
+  const bool isFriend = !friendOf.empty();
+  if (isFriend) {
+    if (!(treeMask & (CLUSTERS | TRACKS)))
+      throw std::runtime_error(
+          "StorageO::StorageO: friend output without clusters or tracks");
+    treeMask &= ~(HITS | EVENTINFO);
+    // Readers find the original file from this entry
+    TNamed original("FriendOf", friendOf.c_str());
+    m_file.WriteTObject(&original);
+  }
+
   // Make hit and clusters trees for all the planes
   for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
     // Make a directory for this plane
@@ -64,21 +93,29 @@ StorageO::StorageO(
       hitsTreePl->Branch("NHits", &numHits, "NHits/I");
       // Check if the `PixX` branch has been turned off, and make the branch otherwise
       if (!isHitsBranchOff("PixX"))
-        hitsTreePl->Branch("PixX", hitPixX, "HitPixX[NHits]/I");
+        hitsTreePl->Branch("PixX", &hitPixX[0], "HitPixX[NHits]/I");
       if (!isHitsBranchOff("PixY"))
-        hitsTreePl->Branch("PixY", hitPixY, "HitPixY[NHits]/I");
+        hitsTreePl->Branch("PixY", &hitPixY[0], "HitPixY[NHits]/I");
       if (!isHitsBranchOff("PosX"))
-        hitsTreePl->Branch("PosX", hitPosX, "HitPosX[NHits]/D");
+        hitsTreePl->Branch("PosX", &hitPosX[0], "HitPosX[NHits]/D");
       if (!isHitsBranchOff("PosY"))
-        hitsTreePl->Branch("PosY", hitPosY, "HitPosY[NHits]/D");
+        hitsTreePl->Branch("PosY", &hitPosY[0], "HitPosY[NHits]/D");
       if (!isHitsBranchOff("PosZ"))
-        hitsTreePl->Branch("PosZ", hitPosZ, "HitPosZ[NHits]/D");
+        hitsTreePl->Branch("PosZ", &hitPosZ[0], "HitPosZ[NHits]/D");
       if (!isHitsBranchOff("Value"))
-        hitsTreePl->Branch("Value", hitValue, "HitValue[NHits]/I");
+        hitsTreePl->Branch("Value", &hitValue[0], "HitValue[NHits]/I");
       if (!isHitsBranchOff("Timing"))
-        hitsTreePl->Branch("Timing", hitTiming, "HitTiming[NHits]/I");
+        hitsTreePl->Branch("Timing", &hitTiming[0], "HitTiming[NHits]/I");
       if (treeMask & CLUSTERS)
-        hitsTreePl->Branch("InCluster", hitInCluster, "HitInCluster[NHits]/I");
+        hitsTreePl->Branch("InCluster", &hitInCluster[0], "HitInCluster[NHits]/I");
+    }
+
+    // Associations of the original hits to the new clusters
+    if (isFriend && (treeMask & CLUSTERS)) {
+      TTree* linksTreePl = new TTree("HitLinks", "Hit to cluster links");
+      m_linksTrees.push_back(linksTreePl);
+      linksTreePl->Branch("NHits", &numHits, "NHits/I");
+      linksTreePl->Branch("InCluster", &hitInCluster[0], "HitInCluster[NHits]/I");
     }
 
     if (treeMask & CLUSTERS) {
@@ -86,31 +123,31 @@ StorageO::StorageO(
       m_clustersTrees.push_back(clustersTreePl);
       clustersTreePl->Branch("NClusters", &numClusters, "NClusters/I");
       if (!isClustersBranchOff("PixX"))
-        clustersTreePl->Branch("PixX", clusterPixX, "ClusterPixX[NClusters]/D");
+        clustersTreePl->Branch("PixX", &clusterPixX[0], "ClusterPixX[NClusters]/D");
       if (!isClustersBranchOff("PixY"))
-        clustersTreePl->Branch("PixY", clusterPixY, "ClusterPixY[NClusters]/D");
+        clustersTreePl->Branch("PixY", &clusterPixY[0], "ClusterPixY[NClusters]/D");
       if (!isClustersBranchOff("PixErrX"))
-        clustersTreePl->Branch("PixErrX", clusterPixErrX, "ClusterPixErrX[NClusters]/D");
+        clustersTreePl->Branch("PixErrX", &clusterPixErrX[0], "ClusterPixErrX[NClusters]/D");
       if (!isClustersBranchOff("PixErrY"))
-        clustersTreePl->Branch("PixErrY", clusterPixErrY, "ClusterPixErrY[NClusters]/D");
+        clustersTreePl->Branch("PixErrY", &clusterPixErrY[0], "ClusterPixErrY[NClusters]/D");
       if (!isClustersBranchOff("PosX"))
-        clustersTreePl->Branch("PosX", clusterPosX, "ClusterPosX[NClusters]/D");
+        clustersTreePl->Branch("PosX", &clusterPosX[0], "ClusterPosX[NClusters]/D");
       if (!isClustersBranchOff("PosY"))
-        clustersTreePl->Branch("PosY", clusterPosY, "ClusterPosY[NClusters]/D");
+        clustersTreePl->Branch("PosY", &clusterPosY[0], "ClusterPosY[NClusters]/D");
       if (!isClustersBranchOff("PosZ"))
-        clustersTreePl->Branch("PosZ", clusterPosZ, "ClusterPosZ[NClusters]/D");
+        clustersTreePl->Branch("PosZ", &clusterPosZ[0], "ClusterPosZ[NClusters]/D");
       if (!isClustersBranchOff("PosErrX"))
-        clustersTreePl->Branch("PosErrX", clusterPosErrX, "ClusterPosErrX[NClusters]/D");
+        clustersTreePl->Branch("PosErrX", &clusterPosErrX[0], "ClusterPosErrX[NClusters]/D");
       if (!isClustersBranchOff("PosErrY"))
-        clustersTreePl->Branch("PosErrY", clusterPosErrY, "ClusterPosErrY[NClusters]/D");
+        clustersTreePl->Branch("PosErrY", &clusterPosErrY[0], "ClusterPosErrY[NClusters]/D");
       if (!isClustersBranchOff("PosErrZ"))
-        clustersTreePl->Branch("PosErrZ", clusterPosErrZ, "ClusterPosErrZ[NClusters]/D");
+        clustersTreePl->Branch("PosErrZ", &clusterPosErrZ[0], "ClusterPosErrZ[NClusters]/D");
       if (!isClustersBranchOff("Value"))
-        clustersTreePl->Branch("Value", clusterValue, "ClusterValue[NClusters]/D");
+        clustersTreePl->Branch("Value", &clusterValue[0], "ClusterValue[NClusters]/D");
       if (!isClustersBranchOff("Timing"))
-        clustersTreePl->Branch("Timing", clusterTiming, "ClusterTiming[NClusters]/D");
+        clustersTreePl->Branch("Timing", &clusterTiming[0], "ClusterTiming[NClusters]/D");
       if (treeMask & TRACKS)
-        clustersTreePl->Branch("InTrack", clusterInTrack, "ClusterInTrack[NClusters]/I");
+        clustersTreePl->Branch("InTrack", &clusterInTrack[0], "ClusterInTrack[NClusters]/I");
     }
   }  // Loop over planes
 
@@ -135,129 +172,437 @@ StorageO::StorageO(
     m_tracksTree = new TTree("Tracks", "Track parameters");
     m_tracksTree->Branch("NTracks", &numTracks, "NTracks/I");
     if (!isTracksBranchOff("SlopeX"))
-      m_tracksTree->Branch("SlopeX", trackSlopeX, "TrackSlopeX[NTracks]/D");
+      m_tracksTree->Branch("SlopeX", &trackSlopeX[0], "TrackSlopeX[NTracks]/D");
     if (!isTracksBranchOff("SlopeY"))
-      m_tracksTree->Branch("SlopeY", trackSlopeY, "TrackSlopeY[NTracks]/D");
+      m_tracksTree->Branch("SlopeY", &trackSlopeY[0], "TrackSlopeY[NTracks]/D");
     if (!isTracksBranchOff("SlopeErrX"))
-      m_tracksTree->Branch("SlopeErrX", trackSlopeErrX, "TrackSlopeErrX[NTracks]/D");
+      m_tracksTree->Branch("SlopeErrX", &trackSlopeErrX[0], "TrackSlopeErrX[NTracks]/D");
     if (!isTracksBranchOff("SlopeErrY"))
-      m_tracksTree->Branch("SlopeErrY", trackSlopeErrY, "TrackSlopeErrY[NTracks]/D");
+      m_tracksTree->Branch("SlopeErrY", &trackSlopeErrY[0], "TrackSlopeErrY[NTracks]/D");
     if (!isTracksBranchOff("OriginX"))
-      m_tracksTree->Branch("OriginX", trackOriginX, "TrackOriginX[NTracks]/D");
+      m_tracksTree->Branch("OriginX", &trackOriginX[0], "TrackOriginX[NTracks]/D");
     if (!isTracksBranchOff("OriginY"))
-      m_tracksTree->Branch("OriginY", trackOriginY, "TrackOriginY[NTracks]/D");
+      m_tracksTree->Branch("OriginY", &trackOriginY[0], "TrackOriginY[NTracks]/D");
     if (!isTracksBranchOff("OriginErrX"))
-      m_tracksTree->Branch("OriginErrX", trackOriginErrX, "TrackOriginErrX[NTracks]/D");
+      m_tracksTree->Branch("OriginErrX", &trackOriginErrX[0], "TrackOriginErrX[NTracks]/D");
     if (!isTracksBranchOff("OriginErrY"))
-      m_tracksTree->Branch("OriginErrY", trackOriginErrY, "TrackOriginErrY[NTracks]/D");
+      m_tracksTree->Branch("OriginErrY", &trackOriginErrY[0], "TrackOriginErrY[NTracks]/D");
     if (!isTracksBranchOff("CovarianceX"))
-      m_tracksTree->Branch("CovarianceX", trackCovarianceX, "TrackCovarianceX[NTracks]/D");
+      m_tracksTree->Branch("CovarianceX", &trackCovarianceX[0], "TrackCovarianceX[NTracks]/D");
     if (!isTracksBranchOff("CovarianceY"))
-      m_tracksTree->Branch("CovarianceY", trackCovarianceY, "TrackCovarianceY[NTracks]/D");
+      m_tracksTree->Branch("CovarianceY", &trackCovarianceY[0], "TrackCovarianceY[NTracks]/D");
     if (!isTracksBranchOff("Chi2"))
-      m_tracksTree->Branch("Chi2", trackChi2, "TrackChi2[NTracks]/D");
+      m_tracksTree->Branch("Chi2", &trackChi2[0], "TrackChi2[NTracks]/D");
+  }
+
+  for (size_t nplane = 0; nplane < m_hitsTrees.size(); nplane++)
+    configureTree(m_hitsTrees[nplane]);
+  for (size_t nplane = 0; nplane < m_clustersTrees.size(); nplane++)
+    configureTree(m_clustersTrees[nplane]);
+  for (size_t nplane = 0; nplane < m_linksTrees.size(); nplane++)
+    configureTree(m_linksTrees[nplane]);
+  if (m_tracksTree) configureTree(m_tracksTree);
+  if (m_eventInfoTree) configureTree(m_eventInfoTree);
+}
+
+void StorageO::configureTree(TTree* tree) {
+  if (m_settings.basketSize > 0)
+    tree->SetBasketSize("*", m_settings.basketSize);
+  if (m_settings.autoFlush != 0)
+    tree->SetAutoFlush(m_settings.autoFlush);
+}
+
+void StorageO::parseCompression(const std::string& spec, Settings& settings) {
+  const size_t colon = spec.find(':');
+  const std::string name = spec.substr(0, colon);
+
+  // Numbering of ROOT's `ECompressionAlgorithm`
+  if (name == "none") {
+    settings.compressionLevel = 0;
+    return;
   }
+  else if (name == "zlib") settings.compressionAlgorithm = 1;
+  else if (name == "lzma") settings.compressionAlgorithm = 2;
+  else if (name == "lz4") settings.compressionAlgorithm = 4;
+  else if (name == "zstd") settings.compressionAlgorithm = 5;
+  else throw std::runtime_error(
+      "StorageO::parseCompression: unknown algorithm " + name);
+
+  if (colon == std::string::npos) return;
+  std::stringstream ss(spec.substr(colon+1));
+  int level = -1;
+  if (!(ss >> level) || !ss.eof() || level < 0 || level > 9)
+    throw std::runtime_error(
+        "StorageO::parseCompression: invalid level in " + spec);
+  settings.compressionLevel = level;
 }
 
 StorageO::~StorageO() {
+  // Queued events go in the file before it is written
+  const std::string error = joinWriter();
+  if (!error.empty())
+    std::cerr << "ERROR: StorageO: " << error << std::endl;
   m_file.Write();
 }
 
-void StorageO::writeEvent(Event& event) {
+template <class Columns>
+void StorageO::copyEventInfo(Event& event, Columns& cols) {
+  cols.timeStamp = event.getTimeStamp();
+  cols.frameNumber = event.getFrameNumber();
+  cols.triggerOffset = event.getTriggerOffset();
+  cols.triggerInfo = event.getTriggerInfo();
+  cols.invalid = event.getInvalid();
+}
+
+template <class Columns>
+void StorageO::copyTracks(Event& event, Columns& cols) {
+  for (size_t ntrack = 0; ntrack < event.getNumTracks(); ntrack++) {
+    Track& track = event.getTrack(ntrack);
+    cols.trackOriginX[ntrack] = track.getOriginX();
+    cols.trackOriginY[ntrack] = track.getOriginY();
+    cols.trackOriginErrX[ntrack] = track.getOriginErrX();
+    cols.trackOriginErrY[ntrack] = track.getOriginErrY();
+    cols.trackSlopeX[ntrack] = track.getSlopeX();
+    cols.trackSlopeY[ntrack] = track.getSlopeY();
+    cols.trackSlopeErrX[ntrack] = track.getSlopeErrX();
+    cols.trackSlopeErrY[ntrack] = track.getSlopeErrY();
+    cols.trackCovarianceX[ntrack] = track.getCovarianceX();
+    cols.trackCovarianceY[ntrack] = track.getCovarianceY();
+    cols.trackChi2[ntrack] = track.getChi2();
+  }
+}
+
+template <class Columns>
+void StorageO::copyClusters(Plane& plane, Columns& cols) {
+  for (size_t ncluster = 0; ncluster < plane.getNumClusters(); ncluster++) {
+    Cluster& cluster = plane.getCluster(ncluster);
+    cols.clusterPixX[ncluster] = cluster.getPixX();
+    cols.clusterPixY[ncluster] = cluster.getPixY();
+    cols.clusterPixErrX[ncluster] = cluster.getPixErrX();
+    cols.clusterPixErrY[ncluster] = cluster.getPixErrY();
+    cols.clusterPosX[ncluster] = cluster.getPosX();
+    cols.clusterPosY[ncluster] = cluster.getPosY();
+    cols.clusterPosZ[ncluster] = cluster.getPosZ();
+    cols.clusterPosErrX[ncluster] = cluster.getPosErrX();
+    cols.clusterPosErrY[ncluster] = cluster.getPosErrY();
+    cols.clusterPosErrZ[ncluster] = cluster.getPosErrZ();
+    cols.clusterTiming[ncluster] = cluster.getTiming();
+    cols.clusterValue[ncluster] = cluster.getValue();
+    // Index plus one, 0 is no track
+    cols.clusterInTrack[ncluster] =
+        cluster.fetchTrack() ? cluster.fetchTrack()->getIndex()+1 : 0;
+  }
+}
+
+template <class Columns>
+void StorageO::copyHits(Plane& plane, Columns& cols) {
+  for (size_t nhit = 0; nhit < plane.getNumHits(); nhit++) {
+    Hit& hit = plane.getHit(nhit);
+    cols.hitPixX[nhit] = hit.getPixX();
+    cols.hitPixY[nhit] = hit.getPixY();
+    cols.hitPosX[nhit] = hit.getPosX();
+    cols.hitPosY[nhit] = hit.getPosY();
+    cols.hitPosZ[nhit] = hit.getPosZ();
+    cols.hitValue[nhit] = hit.getValue();
+    cols.hitTiming[nhit] = hit.getTiming();
+    // Index plus one, 0 is no cluster
+    cols.hitInCluster[nhit] =
+        hit.fetchCluster() ? hit.fetchCluster()->getIndex()+1 : 0;
+  }
+}
+
+void StorageO::checkPlane(size_t nplane) const {
+  // There might not be any hit trees or cluster trees, so check first before
+  // comparing number of planes
+  if ((!m_hitsTrees.empty() && nplane >= m_hitsTrees.size()) ||
+      (!m_clustersTrees.empty() && nplane >= m_clustersTrees.size()) ||
+      (!m_linksTrees.empty() && nplane >= m_linksTrees.size()))
+    throw std::runtime_error(
+        "StorageO::writeEvent: event has too many planes for the storage");
+}
+
+void StorageO::fillPlaneTrees(size_t nplane) {
+  if (!m_hitsTrees.empty())
+    m_hitsTrees[nplane]->Fill();
+  if (!m_clustersTrees.empty())
+    m_clustersTrees[nplane]->Fill();
+  if (!m_linksTrees.empty())
+    m_linksTrees[nplane]->Fill();
+}
+
+void StorageO::fillEventTrees() {
+  // Write the track and event info here so that if any errors occured they
+  // won't be desynchronized
+  if (m_tracksTree) m_tracksTree->Fill();
+  if (m_eventInfoTree) m_eventInfoTree->Fill();
+}
+
+void StorageO::recordEvent(Event& event, EventRecord& record) const {
+  copyEventInfo(event, record);
+
+  const size_t numTracks = event.getNumTracks();
+  record.trackOriginX.resize(numTracks);
+  record.trackOriginY.resize(numTracks);
+  record.trackOriginErrX.resize(numTracks);
+  record.trackOriginErrY.resize(numTracks);
+  record.trackSlopeX.resize(numTracks);
+  record.trackSlopeY.resize(numTracks);
+  record.trackSlopeErrX.resize(numTracks);
+  record.trackSlopeErrY.resize(numTracks);
+  record.trackCovarianceX.resize(numTracks);
+  record.trackCovarianceY.resize(numTracks);
+  record.trackChi2.resize(numTracks);
+  copyTracks(event, record);
+
+  record.planes.resize(m_numPlanes);
+
+  // Copy the hits and clusters one plane at a time
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    checkPlane(nplane);
+    Plane& plane = event.getPlane(nplane);
+    PlaneRecord& cols = record.planes[nplane];
+
+    const size_t numClusters = plane.getNumClusters();
+    cols.clusterPixX.resize(numClusters);
+    cols.clusterPixY.resize(numClusters);
+    cols.clusterPixErrX.resize(numClusters);
+    cols.clusterPixErrY.resize(numClusters);
+    cols.clusterPosX.resize(numClusters);
+    cols.clusterPosY.resize(numClusters);
+    cols.clusterPosZ.resize(numClusters);
+    cols.clusterPosErrX.resize(numClusters);
+    cols.clusterPosErrY.resize(numClusters);
+    cols.clusterPosErrZ.resize(numClusters);
+    cols.clusterTiming.resize(numClusters);
+    cols.clusterValue.resize(numClusters);
+    cols.clusterInTrack.resize(numClusters);
+    copyClusters(plane, cols);
+
+    const size_t numHits = plane.getNumHits();
+    cols.hitPixX.resize(numHits);
+    cols.hitPixY.resize(numHits);
+    cols.hitPosX.resize(numHits);
+    cols.hitPosY.resize(numHits);
+    cols.hitPosZ.resize(numHits);
+    cols.hitValue.resize(numHits);
+    cols.hitTiming.resize(numHits);
+    cols.hitInCluster.resize(numHits);
+    copyHits(plane, cols);
+  }
+}
+
+void StorageO::fillTrees(const EventRecord& record) {
   m_file.cd();  // Ensure writing to the output file
 
-  // Set the event information in local memory to be read into the file
-  timeStamp = event.getTimeStamp();
-  frameNumber = event.getFrameNumber();
-  triggerOffset = event.getTriggerOffset();
-  triggerInfo = event.getTriggerInfo();
-  invalid = event.getInvalid();
+  timeStamp = record.timeStamp;
+  frameNumber = record.frameNumber;
+  triggerOffset = record.triggerOffset;
+  triggerInfo = record.triggerInfo;
+  invalid = record.invalid;
 
   // Make sure there is enough space allocated to store all the tracks
-  numTracks = event.getNumTracks();
-  if (numTracks > MAX_TRACKS) 
-    throw std::runtime_error(
-        "StorageIO: event exceeds MAX_TRACKS");
+  numTracks = record.trackChi2.size();
+  reserveTracks(numTracks);
+  std::copy(record.trackOriginX.begin(), record.trackOriginX.end(), trackOriginX.begin());
+  std::copy(record.trackOriginY.begin(), record.trackOriginY.end(), trackOriginY.begin());
+  std::copy(record.trackOriginErrX.begin(), record.trackOriginErrX.end(), trackOriginErrX.begin());
+  std::copy(record.trackOriginErrY.begin(), record.trackOriginErrY.end(), trackOriginErrY.begin());
+  std::copy(record.trackSlopeX.begin(), record.trackSlopeX.end(), trackSlopeX.begin());
+  std::copy(record.trackSlopeY.begin(), record.trackSlopeY.end(), trackSlopeY.begin());
+  std::copy(record.trackSlopeErrX.begin(), record.trackSlopeErrX.end(), trackSlopeErrX.begin());
+  std::copy(record.trackSlopeErrY.begin(), record.trackSlopeErrY.end(), trackSlopeErrY.begin());
+  std::copy(record.trackCovarianceX.begin(), record.trackCovarianceX.end(), trackCovarianceX.begin());
+  std::copy(record.trackCovarianceY.begin(), record.trackCovarianceY.end(), trackCovarianceY.begin());
+  std::copy(record.trackChi2.begin(), record.trackChi2.end(), trackChi2.begin());
 
-  // Set the object track values into the arrays for writing to the root file
-  for (Int_t ntrack = 0; ntrack < numTracks; ntrack++) {
-    Track& track = event.getTrack(ntrack);
-    trackOriginX[ntrack] = track.getOriginX();
-    trackOriginY[ntrack] = track.getOriginY();
-    trackOriginErrX[ntrack] = track.getOriginErrX();
-    trackOriginErrY[ntrack] = track.getOriginErrY();
-    trackSlopeX[ntrack] = track.getSlopeX();
-    trackSlopeY[ntrack] = track.getSlopeY();
-    trackSlopeErrX[ntrack] = track.getSlopeErrX();
-    trackSlopeErrY[ntrack] = track.getSlopeErrY();
-    trackCovarianceX[ntrack] = track.getCovarianceX();
-    trackCovarianceY[ntrack] = track.getCovarianceY();
-    trackChi2[ntrack] = track.getChi2();
+  // Fill the hits and clusters trees one plane at a time
+  for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    const PlaneRecord& cols = record.planes[nplane];
+
+    numClusters = cols.clusterPixX.size();
+    reserveClusters(numClusters);
+    std::copy(cols.clusterPixX.begin(), cols.clusterPixX.end(), clusterPixX.begin());
+    std::copy(cols.clusterPixY.begin(), cols.clusterPixY.end(), clusterPixY.begin());
+    std::copy(cols.clusterPixErrX.begin(), cols.clusterPixErrX.end(), clusterPixErrX.begin());
+    std::copy(cols.clusterPixErrY.begin(), cols.clusterPixErrY.end(), clusterPixErrY.begin());
+    std::copy(cols.clusterPosX.begin(), cols.clusterPosX.end(), clusterPosX.begin());
+    std::copy(cols.clusterPosY.begin(), cols.clusterPosY.end(), clusterPosY.begin());
+    std::copy(cols.clusterPosZ.begin(), cols.clusterPosZ.end(), clusterPosZ.begin());
+    std::copy(cols.clusterPosErrX.begin(), cols.clusterPosErrX.end(), clusterPosErrX.begin());
+    std::copy(cols.clusterPosErrY.begin(), cols.clusterPosErrY.end(), clusterPosErrY.begin());
+    std::copy(cols.clusterPosErrZ.begin(), cols.clusterPosErrZ.end(), clusterPosErrZ.begin());
+    std::copy(cols.clusterTiming.begin(), cols.clusterTiming.end(), clusterTiming.begin());
+    std::copy(cols.clusterValue.begin(), cols.clusterValue.end(), clusterValue.begin());
+    std::copy(cols.clusterInTrack.begin(), cols.clusterInTrack.end(), clusterInTrack.begin());
+
+    numHits = cols.hitPixX.size();
+    reserveHits(numHits);
+    std::copy(cols.hitPixX.begin(), cols.hitPixX.end(), hitPixX.begin());
+    std::copy(cols.hitPixY.begin(), cols.hitPixY.end(), hitPixY.begin());
+    std::copy(cols.hitPosX.begin(), cols.hitPosX.end(), hitPosX.begin());
+    std::copy(cols.hitPosY.begin(), cols.hitPosY.end(), hitPosY.begin());
+    std::copy(cols.hitPosZ.begin(), cols.hitPosZ.end(), hitPosZ.begin());
+    std::copy(cols.hitValue.begin(), cols.hitValue.end(), hitValue.begin());
+    std::copy(cols.hitTiming.begin(), cols.hitTiming.end(), hitTiming.begin());
+    std::copy(cols.hitInCluster.begin(), cols.hitInCluster.end(), hitInCluster.begin());
+
+    fillPlaneTrees(nplane);
   }
 
+  fillEventTrees();
+}
+
+void StorageO::fillTrees(Event& event) {
+  m_file.cd();  // Ensure writing to the output file
+
+  // The branch arrays have the same columns as a record, fill them in place
+  copyEventInfo(event, *this);
+
+  // Make sure there is enough space allocated to store all the tracks
+  numTracks = event.getNumTracks();
+  reserveTracks(numTracks);
+  copyTracks(event, *this);
+
   // Fill the hits and clusters trees one plane at a time
   for (size_t nplane = 0; nplane < m_numPlanes; nplane++) {
+    checkPlane(nplane);
     Plane& plane = event.getPlane(nplane);
 
-    // There might not be any hit trees or cluster trees, so check first before
-    // comparing number of planes
-    if ((!m_hitsTrees.empty() && nplane >= m_hitsTrees.size()) ||
-        (!m_clustersTrees.empty() && nplane >= m_clustersTrees.size()))
-      throw std::runtime_error(
-          "StorageO::writeEvent: event has too many planes for the storage");
-
     numClusters = plane.getNumClusters();
-    if (numClusters > MAX_CLUSTERS)
-      throw std::runtime_error(
-          "StorageO::writeEvent: event exceeds MAX_CLUSTERS");
-
-    // Set the object cluster values into the arrays for writig into the root file
-    for (Int_t ncluster = 0; ncluster < numClusters; ncluster++) {
-      Cluster& cluster = plane.getCluster(ncluster);
-      clusterPixX[ncluster] = cluster.getPixX();
-      clusterPixY[ncluster] = cluster.getPixY();
-      clusterPixErrX[ncluster] = cluster.getPixErrX();
-      clusterPixErrY[ncluster] = cluster.getPixErrY();
-      clusterPosX[ncluster] = cluster.getPosX();
-      clusterPosY[ncluster] = cluster.getPosY();
-      clusterPosZ[ncluster] = cluster.getPosZ();
-      clusterPosErrX[ncluster] = cluster.getPosErrX();
-      clusterPosErrY[ncluster] = cluster.getPosErrY();
-      clusterPosErrZ[ncluster] = cluster.getPosErrZ();
-      clusterTiming[ncluster] = cluster.getTiming();
-      clusterValue[ncluster] = cluster.getValue();
-      clusterInTrack[ncluster] = cluster.fetchTrack() ? cluster.fetchTrack()->getIndex() : 0;
-    }
+    reserveClusters(numClusters);
+    copyClusters(plane, *this);
 
     numHits = plane.getNumHits();
-    if (numHits > MAX_HITS)
-      throw std::runtime_error(
-          "StorageO::writeEvent: event exceeds MAX_HITS");
-
-    for (Int_t nhit = 0; nhit < numHits; nhit++) {
-      Hit& hit = plane.getHit(nhit);
-      hitPixX[nhit] = hit.getPixX();
-      hitPixY[nhit] = hit.getPixY();
-      hitPosX[nhit] = hit.getPosX();
-      hitPosY[nhit] = hit.getPosY();
-      hitPosZ[nhit] = hit.getPosZ();
-      hitValue[nhit] = hit.getValue();
-      hitTiming[nhit] = hit.getTiming();
-      hitInCluster[nhit] = hit.fetchCluster() ? hit.fetchCluster()->getIndex(): 0;
-    }
+    reserveHits(numHits);
+    copyHits(plane, *this);
 
-    if (!m_hitsTrees.empty())
-      m_hitsTrees[nplane]->Fill();
-    if (!m_clustersTrees.empty())
-      m_clustersTrees[nplane]->Fill();
+    fillPlaneTrees(nplane);
   }
 
-  // Write the track and event info here so that if any errors occured they
-  // won't be desynchronized
-  if (m_tracksTree) m_tracksTree->Fill();
-  if (m_eventInfoTree) m_eventInfoTree->Fill();
+  fillEventTrees();
+}
+
+void StorageO::writeEvent(Event& event) {
+  // Without a writer thread, fill straight from the event without a copy
+  if (!m_writeThread.joinable()) {
+    fillTrees(event);
+    m_numEvents += 1;
+    return;
+  }
+
+  EventRecord* record = 0;
+  {
+    // Wait for the thread to give back a written record
+    std::unique_lock<std::mutex> lock(m_writeMutex);
+    while (m_free.empty() && m_writeError.empty())
+      m_writeCond.wait(lock);
+    if (!m_writeError.empty())
+      throw std::runtime_error("StorageO::writeEvent: " + m_writeError);
+    record = m_free.back();
+    m_free.pop_back();
+  }
+
+  // Copied without the lock, while the thread writes earlier records
+  try {
+    recordEvent(event, *record);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_free.push_back(record);
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_queue.push_back(record);
+  }
+  m_writeCond.notify_all();
 
+  // Counts the events queued, not only those already in the file
   m_numEvents += 1;
 }
 
+void StorageO::startWriter(size_t depth, unsigned int threads) {
+  stopWriter();
+  if (depth == 0) return;
+
+  // The trees are filled from the writer thread, while other files are read
+  // from the main thread
+  ROOT::EnableThreadSafety();
+#ifdef R__USE_IMT
+  if (threads > 0) ROOT::EnableImplicitMT(threads);
+#else
+  if (threads > 0)
+    std::cerr << "WARNING: StorageO: ROOT has no implicit multi-threading, "
+        << "baskets are compressed on the writer thread only" << std::endl;
+#endif
+
+  for (size_t i = 0; i < depth; i++) {
+    m_records.push_back(new EventRecord());
+    m_free.push_back(m_records.back());
+  }
+
+  m_writeStop = false;
+  m_writeError.clear();
+  m_writeThread = std::thread(&StorageO::writeLoop, this);
+}
+
+void StorageO::stopWriter() {
+  const std::string error = joinWriter();
+  if (!error.empty())
+    throw std::runtime_error("StorageO::stopWriter: " + error);
+}
+
+std::string StorageO::joinWriter() {
+  if (m_writeThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      m_writeStop = true;
+    }
+    m_writeCond.notify_all();
+    m_writeThread.join();
+  }
+
+  const std::string error = m_writeError;
+  m_writeError.clear();
+
+  for (size_t i = 0; i < m_records.size(); i++)
+    delete m_records[i];
+  m_records.clear();
+  m_free.clear();
+  m_queue.clear();
+
+  return error;
+}
+
+void StorageO::writeLoop() {
+  while (true) {
+    EventRecord* record = 0;
+    {
+      // Once stopped, the thread still writes out what is queued
+      std::unique_lock<std::mutex> lock(m_writeMutex);
+      while (m_queue.empty() && !m_writeStop)
+        m_writeCond.wait(lock);
+      if (m_queue.empty()) break;
+      record = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    try {
+      fillTrees(*record);
+    } catch (std::exception& e) {
+      // Reported to the next write, or when stopping
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      m_writeError = e.what();
+      m_writeCond.notify_all();
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      m_free.push_back(record);
+    }
+    m_writeCond.notify_all();
+  }
+}
+
 }
@@ -31,6 +31,26 @@ Cluster* Track::getMatchedCluster(unsigned int n) const
   return _matchedClusters.at(n);
 }
 
+void Track::clear()
+{
+  _originX = 0;
+  _originY = 0;
+  _originErrX = 0;
+  _originErrY = 0;
+  _slopeX = 0;
+  _slopeY = 0;
+  _slopeErrX = 0;
+  _slopeErrY = 0;
+  _covarianceX = 0;
+  _covarianceY = 0;
+  _chi2 = 0;
+  _numClusters = 0;
+  _clusters.clear();
+  _numMatchedClusters = 0;
+  _matchedClusters.clear();
+  _index = -1;
+}
+
 Track::Track() :
   _originX(0), _originY(0), _originErrX(0), _originErrY(0),
   _slopeX(0), _slopeY(0), _slopeErrX(0), _slopeErrY(0),
@@ -4,10 +4,12 @@
 
 #include "storage/cluster.h"
 #include "storage/track.h"
+#include "storage/event.h"
 
 namespace Storage {
 
 Track::Track() :
+    m_event(0),
     m_originX(0),
     m_originY(0),
     m_originErrX(0),
@@ -22,8 +24,12 @@ Track::Track() :
     m_index(-1) {}
 
 void Track::clear() {
-  m_clusters.clear();
-  m_matchedClusters.clear();
+  // The event resets its own tables, and sets them again if re-using the track
+  m_clusters = MemberRange();
+  m_matchedClusters = MemberRange();
+  m_event = 0;
+  m_ownClusters.clear();
+  m_ownMatched.clear();
   m_originX = 0;
   m_originY = 0;
   m_originErrX = 0;
@@ -38,38 +44,68 @@ void Track::clear() {
   m_index = -1;
 }
 
+void Track::reserveClusters(size_t n) {
+  if (m_event)
+    m_event->m_trackClusters.reserve(m_clusters, n);
+  else
+    m_ownClusters.reserve(n);
+}
+
 void Track::addCluster(Cluster& cluster) {
   cluster.setTrack(*this);
-  m_clusters.push_back(&cluster);
+  if (m_event)
+    m_event->m_trackClusters.add(m_clusters, cluster.getIndex());
+  else
+    m_ownClusters.push_back(&cluster);
 }
 
 void Track::setClusters(const std::vector<Cluster*>& clusters) {
-  m_clusters = clusters;
-  for (std::vector<Cluster*>::iterator it = m_clusters.begin();
-      it != m_clusters.end(); ++it)
-    (*it)->setTrack(*this);
+  // Start a new range, the old one is left as a gap in the array
+  m_clusters = MemberRange();
+  m_ownClusters.clear();
+  reserveClusters(clusters.size());
+  for (std::vector<Cluster*>::const_iterator it = clusters.begin();
+      it != clusters.end(); ++it)
+    addCluster(**it);
 }
 
 void Track::addMatchedCluster(Cluster& cluster) {
-  m_matchedClusters.push_back(&cluster);
+  if (cluster.m_event != m_event)
+    throw std::runtime_error(
+        "Track::addMatchedCluster: cluster and track in different events");
+  if (m_event)
+    m_event->m_matchedClusters.add(m_matchedClusters, cluster.getIndex());
+  else
+    m_ownMatched.push_back(&cluster);
 }
 
 void Track::setMatchedClusters(const std::vector<Cluster*>& clusters) {
-  m_matchedClusters = clusters;
+  m_matchedClusters = MemberRange();
+  m_ownMatched.clear();
+  if (m_event)
+    m_event->m_matchedClusters.reserve(m_matchedClusters, clusters.size());
+  else
+    m_ownMatched.reserve(clusters.size());
+  for (std::vector<Cluster*>::const_iterator it = clusters.begin();
+      it != clusters.end(); ++it)
+    addMatchedCluster(**it);
 }
 
 Cluster& Track::getCluster(size_t n) const {
   if (n >= getNumClusters())
     throw std::out_of_range(
         "Track::getCluster: requested cluster out of range");
-  return *m_clusters[n];
+  if (!m_event) return *m_ownClusters[n];
+  return m_event->m_clusterSlab[m_event->m_trackClusters.get(m_clusters, n)];
 }
 
 Cluster& Track::getMatchedCluster(size_t n) const { 
   if (n >= getNumMatchedClusters())
     throw std::out_of_range(
         "Track::getMatchedCluster: requested matched cluster out of range");
-  return *m_matchedClusters[n];
+  if (!m_event) return *m_ownMatched[n];
+  return m_event->m_clusterSlab[
+      m_event->m_matchedClusters.get(m_matchedClusters, n)];
 }
 
 }
@@ -40,6 +40,8 @@ private:
 protected:
   int _index;
 
+  void clear(); // Reset the values so a recycled track can be re-used
+
 public:
   Track(const Track& old);
   Track();
@@ -73,6 +75,7 @@ public:
   inline int getIndex() const { return _index; }
 
   friend class Event;
+  friend class StorageIO; // Recycles tracks
   friend class Processors::TrackMaker;
 };
 
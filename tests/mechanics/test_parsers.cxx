@@ -260,6 +260,60 @@ int test_alignment() {
   return 0;
 }
 
+int test_noiseMask() {
+  std::ofstream out("tmp.txt");
+  out << 
+    "device: dut\n"
+    "noise-mask tmp_mask.txt\n"
+    "\n"
+    "sensor:\n"
+    "chip small\n"
+    "off-z 0\n"
+    "\n"
+    "sensor:\n"
+    "chip small\n"
+    "off-z 1\n"
+    "\n"
+    "chip: small\n"
+    "rows 4\n"
+    "cols 6\n"
+    "\n" << std::flush;
+  out.close();
+
+  // Pixels as written by the noise scan: sensor, column, row
+  std::ofstream mask("tmp_mask.txt");
+  mask << 
+    "0, 5, 3\n"
+    "1, 0, 1\n"
+    "1, 2, 0\n" << std::flush;
+  mask.close();
+
+  Mechanics::Device* device = Mechanics::parseDevice("tmp.txt");
+
+  if (device->getSensor(0).m_noiseMask.count() != 1 ||
+      !device->getSensor(0).getPixelMask(3, 5) ||
+      device->getSensor(1).m_noiseMask.count() != 2 ||
+      !device->getSensor(1).getPixelMask(1, 0) ||
+      !device->getSensor(1).getPixelMask(0, 2) ||
+      device->getSensor(1).getPixelMask(2, 0)) {
+    std::cerr << "Device noise mask incorrect" << std::endl;
+    return -1;
+  }
+
+  // Only the active sensors' masks are handed on
+  device->maskSensor(0);
+  if (device->getNoiseMasks().size() != 1 ||
+      device->getNoiseMasks()[0].count() != 2) {
+    std::cerr << "Device noise masks incorrect" << std::endl;
+    return -1;
+  }
+
+  delete device;
+
+  gSystem->Exec("rm -f tmp.txt tmp_mask.txt");
+  return 0;
+}
+
 int main() {
   int retval = 0;
 
@@ -267,6 +321,7 @@ int main() {
     if ((retval = test_parsing()) != 0) return retval;
     if ((retval = test_errors()) != 0) return retval;
     if ((retval = test_alignment()) != 0) return retval;
+    if ((retval = test_noiseMask()) != 0) return retval;
   }
   
   catch (std::exception& e) {
@@ -1,10 +1,16 @@
 #include <iostream>
 #include <stdexcept>
 #include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
 
 #include "storage/event.h"
 #include "storage/cluster.h"
 #include "storage/hit.h"
+#include "storage/plane.h"
+#include "mechanics/device.h"
+#include "mechanics/sensor.h"
 #include "processors/clustering.h"
 
 bool approxEqual(double v1, double v2, double tol=1E-10) {
@@ -87,11 +93,240 @@ int test_clustering() {
   return 0;
 }
 
+/** Fill the same random hits in both events. Hit values are their index
+  * plus one, so that the clustered hits can be told apart. */
+void fillRandom(
+    Storage::Event& event1,
+    Storage::Event& event2,
+    std::mt19937& random,
+    int size,
+    int nhits) {
+  std::uniform_int_distribution<int> pix(0, size-1);
+  for (size_t iplane = 0; iplane < event1.getNumPlanes(); iplane++) {
+    for (int ihit = 0; ihit < nhits; ihit++) {
+      const int x = pix(random);
+      const int y = pix(random);
+      Storage::Hit& hit1 = event1.newHit(iplane);
+      Storage::Hit& hit2 = event2.newHit(iplane);
+      hit1.setPix(x, y);
+      hit2.setPix(x, y);
+      hit1.setValue(ihit+1);
+      hit2.setValue(ihit+1);
+    }
+  }
+}
+
+int test_clusteringSweep() {
+  std::mt19937 random(1);
+
+  // Sparse and dense planes, including duplicated pixels, with various
+  // cluster sizes and weighting
+  const int sizes[] = {200, 40, 10, 3};
+  const unsigned ranges[] = {0, 1, 2};
+
+  for (int isize = 0; isize < 4; isize++) {
+  for (int irange = 0; irange < 3; irange++) {
+  for (int itrial = 0; itrial < 5; itrial++) {
+    const size_t nplanes = 3;
+    Storage::Event event1(nplanes);
+    Storage::Event event2(nplanes);
+    fillRandom(event1, event2, random, sizes[isize], 10 + 40 * itrial);
+
+    Processors::Clustering scan;
+    Processors::Clustering sweep;
+    scan.m_maxRows = sweep.m_maxRows = ranges[irange];
+    scan.m_maxCols = sweep.m_maxCols = ranges[(irange+1)%3];
+    scan.m_weighted = sweep.m_weighted = (itrial % 2 == 1);
+    scan.m_algorithm = Processors::Clustering::SCAN;
+    sweep.m_algorithm = Processors::Clustering::SWEEP;
+    scan.execute(event1);
+    sweep.execute(event2);
+
+    if (event1.getNumClusters() != event2.getNumClusters()) {
+      std::cerr << "Processors::Clustering: sweep multiplicity failed"
+          << std::endl;
+      return -1;
+    }
+
+    for (size_t icluster = 0; icluster < event1.getNumClusters(); icluster++) {
+      const Storage::Cluster& cluster1 = event1.getCluster(icluster);
+      const Storage::Cluster& cluster2 = event2.getCluster(icluster);
+      // The same hits in the same order give exactly the same values
+      if (cluster1.getNumHits() != cluster2.getNumHits() ||
+          cluster1.getPixX() != cluster2.getPixX() ||
+          cluster1.getPixY() != cluster2.getPixY() ||
+          cluster1.getPixErrX() != cluster2.getPixErrX() ||
+          cluster1.getPixErrY() != cluster2.getPixErrY()) {
+        std::cerr << "Processors::Clustering: sweep cluster failed"
+            << std::endl;
+        return -1;
+      }
+      for (size_t ihit = 0; ihit < cluster1.getNumHits(); ihit++) {
+        if (cluster1.getHit(ihit).getValue() !=
+            cluster2.getHit(ihit).getValue()) {
+          std::cerr << "Processors::Clustering: sweep hits failed"
+              << std::endl;
+          return -1;
+        }
+      }
+    }
+  }
+  }
+  }
+
+  return 0;
+}
+
+int test_clusteringBitmap() {
+  std::mt19937 random(2);
+
+  const int sizes[] = {200, 40, 10, 3};
+  const unsigned ranges[] = {0, 1, 2};
+
+  for (int isize = 0; isize < 4; isize++) {
+  for (int irange = 0; irange < 3; irange++) {
+  for (int itrial = 0; itrial < 5; itrial++) {
+    const size_t nplanes = 3;
+    Mechanics::Device device(nplanes);
+    for (size_t iplane = 0; iplane < nplanes; iplane++) {
+      device.getSensor(iplane).m_ncols = sizes[isize];
+      device.getSensor(iplane).m_nrows = sizes[isize];
+    }
+
+    Storage::Event event1(nplanes);
+    Storage::Event event2(nplanes);
+    fillRandom(event1, event2, random, sizes[isize], 10 + 40 * itrial);
+    // A hit outside the sensor leaves its plane to the scan
+    Storage::Hit& outside1 = event1.newHit(nplanes-1);
+    Storage::Hit& outside2 = event2.newHit(nplanes-1);
+    outside1.setPix(sizes[isize], 0);
+    outside2.setPix(sizes[isize], 0);
+    outside1.setValue(1);
+    outside2.setValue(1);
+
+    Processors::Clustering scan;
+    Processors::Clustering bitmap(device);
+    scan.m_maxRows = bitmap.m_maxRows = ranges[irange];
+    scan.m_maxCols = bitmap.m_maxCols = ranges[(irange+1)%3];
+    scan.m_weighted = bitmap.m_weighted = (itrial % 2 == 1);
+    bitmap.m_denseOccupancy = 1E-6;
+    scan.execute(event1);
+    bitmap.execute(event2);
+
+    if (event1.getNumClusters() != event2.getNumClusters()) {
+      std::cerr << "Processors::Clustering: bitmap multiplicity failed"
+          << std::endl;
+      return -1;
+    }
+
+    for (size_t icluster = 0; icluster < event1.getNumClusters(); icluster++) {
+      const Storage::Cluster& cluster1 = event1.getCluster(icluster);
+      const Storage::Cluster& cluster2 = event2.getCluster(icluster);
+      // The hits are in another order, which only changes the rounding
+      if (cluster1.getNumHits() != cluster2.getNumHits() ||
+          !approxEqual(cluster1.getPixX(), cluster2.getPixX()) ||
+          !approxEqual(cluster1.getPixY(), cluster2.getPixY()) ||
+          !approxEqual(cluster1.getPixErrX(), cluster2.getPixErrX()) ||
+          !approxEqual(cluster1.getPixErrY(), cluster2.getPixErrY())) {
+        std::cerr << "Processors::Clustering: bitmap cluster failed"
+            << std::endl;
+        return -1;
+      }
+      std::vector<double> values1;
+      std::vector<double> values2;
+      for (size_t ihit = 0; ihit < cluster1.getNumHits(); ihit++) {
+        values1.push_back(cluster1.getHit(ihit).getValue());
+        values2.push_back(cluster2.getHit(ihit).getValue());
+      }
+      // Both start from the cluster's last hit
+      if (values1[0] != values2[0]) {
+        std::cerr << "Processors::Clustering: bitmap seed failed"
+            << std::endl;
+        return -1;
+      }
+      std::sort(values1.begin(), values1.end());
+      std::sort(values2.begin(), values2.end());
+      if (values1 != values2) {
+        std::cerr << "Processors::Clustering: bitmap hits failed"
+            << std::endl;
+        return -1;
+      }
+    }
+  }
+  }
+  }
+
+  return 0;
+}
+
+int test_clusteringThreads() {
+  std::mt19937 random(3);
+
+  const size_t nplanes = 6;
+  Mechanics::Device device(nplanes);
+  for (size_t iplane = 0; iplane < nplanes; iplane++) {
+    device.getSensor(iplane).m_ncols = 100;
+    device.getSensor(iplane).m_nrows = 50;
+  }
+
+  // The same objects are used for all events, to reuse the threads
+  Processors::Clustering serial(device);
+  Processors::Clustering threaded(device);
+  serial.m_algorithm = threaded.m_algorithm = Processors::Clustering::SWEEP;
+  serial.m_denseOccupancy = threaded.m_denseOccupancy = 0.05;
+  threaded.m_threads = 4;
+
+  for (int ievent = 0; ievent < 50; ievent++) {
+    Storage::Event event1(nplanes);
+    Storage::Event event2(nplanes);
+    // Sparse and dense events, so that some planes use the bitmap
+    fillRandom(event1, event2, random, 50, ievent % 2 ? 20 : 400);
+    serial.execute(event1);
+    threaded.execute(event2);
+
+    if (event1.getNumClusters() != event2.getNumClusters()) {
+      std::cerr << "Processors::Clustering: threaded multiplicity failed"
+          << std::endl;
+      return -1;
+    }
+
+    for (size_t icluster = 0; icluster < event1.getNumClusters(); icluster++) {
+      const Storage::Cluster& cluster1 = event1.getCluster(icluster);
+      const Storage::Cluster& cluster2 = event2.getCluster(icluster);
+      if (cluster1.getIndex() != cluster2.getIndex() ||
+          cluster1.fetchPlane()->getPlaneNum() !=
+          cluster2.fetchPlane()->getPlaneNum() ||
+          cluster1.getNumHits() != cluster2.getNumHits() ||
+          cluster1.getPixX() != cluster2.getPixX() ||
+          cluster1.getPixY() != cluster2.getPixY() ||
+          cluster1.getPixErrX() != cluster2.getPixErrX() ||
+          cluster1.getPixErrY() != cluster2.getPixErrY()) {
+        std::cerr << "Processors::Clustering: threaded cluster failed"
+            << std::endl;
+        return -1;
+      }
+      for (size_t ihit = 0; ihit < cluster1.getNumHits(); ihit++) {
+        if (cluster1.getHit(ihit).getValue() !=
+            cluster2.getHit(ihit).getValue()) {
+          std::cerr << "Processors::Clustering: threaded hits failed"
+              << std::endl;
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
 int main() {
   int retval = 0;
 
   try {
     if ((retval = test_clustering()) != 0) return retval;
+    if ((retval = test_clusteringSweep()) != 0) return retval;
+    if ((retval = test_clusteringBitmap()) != 0) return retval;
+    if ((retval = test_clusteringThreads()) != 0) return retval;
   }
   
   catch (std::exception& e) {
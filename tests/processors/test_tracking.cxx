@@ -15,8 +15,7 @@ bool approxEqual(double v1, double v2, double tol=1E-10) {
 }
 
 void newCluster(Storage::Event& event, size_t iplane, double posx, double posy=0) {
-  event.newCluster(iplane);
-  event.getPlane(iplane).getClusters().back()->setPos(posx, posy, iplane);
+  event.newCluster(iplane).setPos(posx, posy, iplane);
 }
 
 int test_association() {
@@ -221,11 +220,11 @@ int test_values() {
 
   // Setup a 3 cluster track with some slope, chi2 ...
   newCluster(event, 0, -0.10, -0.20);
-  event.getClusters().back()->setPosErr(.1, .2, 1);
+  event.getCluster(event.getNumClusters()-1).setPosErr(.1, .2, 1);
   newCluster(event, 1, +0.05, -0.05);
-  event.getClusters().back()->setPosErr(.2, .3, 1);
+  event.getCluster(event.getNumClusters()-1).setPosErr(.2, .3, 1);
   newCluster(event, 2, +0.10, +0.20);
-  event.getClusters().back()->setPosErr(.4, .5, 1);
+  event.getCluster(event.getNumClusters()-1).setPosErr(.4, .5, 1);
 
   Processors::Tracking tracking(nplanes);
   tracking.m_minClusters = 3;
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include <TSystem.h>
 
@@ -86,11 +87,147 @@ int test_event() {
   return 0;
 }
 
+int test_eventSlabs() {
+  Storage::Event event(2);
+
+  // Enough hits to outgrow the first block, references must stay valid
+  Storage::Hit& first = event.newHit(0);
+  first.setPix(1, 2);
+  for (int i = 1; i < 100; i++)
+    event.newHit(0).setPix(i, i);
+
+  if (&event.getHit(0) != &first || first.getPixX() != 1) {
+    std::cerr << "Storage::Event: hit moved when the slab grew" << std::endl;
+    return -1;
+  }
+
+  Storage::Span<Storage::Hit> hits;
+  if (!event.getPlaneHits(1, hits) || !hits.empty()) {
+    std::cerr << "Storage::Event: empty plane hits not contiguous" << std::endl;
+    return -1;
+  }
+
+  // Plane 0 now spans blocks, plane 1 alternates with plane 0
+  event.newHit(1);
+  event.newHit(0);
+  event.newHit(1);
+  if (event.getPlaneHits(1, hits)) {
+    std::cerr << "Storage::Event: interleaved plane hits contiguous" << std::endl;
+    return -1;
+  }
+
+  // Interleaved hits are still listed in order, and linked to their plane
+  const Storage::Plane& plane1 = event.getPlane(1);
+  if (plane1.getNumHits() != 2 ||
+      &plane1.getHit(0) != &event.getHit(100) ||
+      &plane1.getHit(1) != &event.getHit(102) ||
+      event.getHit(102).fetchPlane() != &plane1 ||
+      event.getPlane(0).getNumHits() != 101) {
+    std::cerr << "Storage::Event: interleaved plane hits failed" << std::endl;
+    return -1;
+  }
+
+  Storage::Cluster& cluster0 = event.newCluster(1);
+  Storage::Cluster& cluster1 = event.newCluster(1);
+  Storage::Span<Storage::Cluster> clusters;
+  if (!event.getPlaneClusters(1, clusters) ||
+      clusters.size() != 2 ||
+      &clusters[0] != &cluster0 ||
+      &clusters[1] != &cluster1 ||
+      cluster1.getIndex() != 1) {
+    std::cerr << "Storage::Event: getPlaneClusters failed" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+int test_eventMembership() {
+  Storage::Event event(1);
+
+  Storage::Cluster& cluster0 = event.newCluster(0);
+  Storage::Cluster& cluster1 = event.newCluster(0);
+  cluster1.reserveHits(2);
+
+  // Interleave the hits, so that cluster 0 must be moved as it grows
+  std::vector<Storage::Hit*> hits0;
+  std::vector<Storage::Hit*> hits1;
+  for (int i = 0; i < 10; i++) {
+    hits0.push_back(&event.newHit(0));
+    cluster0.addHit(*hits0.back());
+    hits1.push_back(&event.newHit(0));
+    cluster1.addHit(*hits1.back());
+  }
+
+  if (cluster0.getNumHits() != 10 || cluster1.getNumHits() != 10) {
+    std::cerr << "Storage::Event: cluster membership size failed" << std::endl;
+    return -1;
+  }
+
+  for (size_t i = 0; i < 10; i++) {
+    if (&cluster0.getHit(i) != hits0[i] || &cluster1.getHit(i) != hits1[i]) {
+      std::cerr << "Storage::Event: cluster membership order failed" << std::endl;
+      return -1;
+    }
+  }
+
+  Storage::Track& track0 = event.newTrack();
+  Storage::Track& track1 = event.newTrack();
+  track0.addCluster(cluster1);
+  track1.addCluster(cluster0);
+  track0.addMatchedCluster(cluster0);
+
+  if (track0.getNumClusters() != 1 ||
+      track1.getNumClusters() != 1 ||
+      &track0.getCluster(0) != &cluster1 ||
+      &track1.getCluster(0) != &cluster0 ||
+      track0.getNumMatchedClusters() != 1 ||
+      track1.getNumMatchedClusters() != 0 ||
+      &track0.getMatchedCluster(0) != &cluster0) {
+    std::cerr << "Storage::Event: track membership failed" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+int test_eventSlabsReused() {
+  Storage::StorageO store("tmp.root", 1);
+  Storage::Event& event = store.newEvent();
+
+  for (int i = 0; i < 100; i++)
+    event.newHit(0).setPix(i, i);
+
+  // Once cleared, the blocks are merged and the hits are in one array
+  store.newEvent();
+  for (int i = 0; i < 100; i++)
+    event.newHit(0).setPix(i, 2*i);
+
+  Storage::Span<Storage::Hit> hits;
+  if (!event.getPlaneHits(0, hits) || hits.size() != 100) {
+    std::cerr << "Storage::Event: reused hits not contiguous" << std::endl;
+    return -1;
+  }
+
+  for (int i = 0; i < 100; i++) {
+    if (&hits[i] != &event.getHit(i) || hits[i].getPixY() != 2*i) {
+      std::cerr << "Storage::Event: reused hits out of order" << std::endl;
+      return -1;
+    }
+  }
+
+  gSystem->Exec("rm -f tmp.root");
+  return 0;
+}
+
 int main() {
   int retval = 0;
 
   try {
     if ((retval = test_event()) != 0) return retval;
+    if ((retval = test_eventSlabs()) != 0) return retval;
+    if ((retval = test_eventSlabsReused()) != 0) return retval;
+    if ((retval = test_eventMembership()) != 0) return retval;
   }
   
   catch (std::exception& e) {
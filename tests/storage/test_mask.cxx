@@ -1,25 +1,179 @@
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+
+#include <TSystem.h>
 
 #include "storage/storageo.h"
 #include "storage/storagei.h"
 #include "storage/storageio.h"
+#include "storage/eventview.h"
 #include "storage/event.h"
-#include "storage/track.h"
 #include "storage/plane.h"
-#include "storage/cluster.h"
 #include "storage/hit.h"
+#include "storage/pixelmask.h"
+
+#define NPLANES 2
+#define NEVENTS 3
+#define NHITS 10
 
 int test_mask() {
+  // Odd sizes so that rows straddle the words
+  Storage::PixelMask mask(67, 13);
+
+  if (mask.count() != 0 || mask.get(0, 0)) {
+    std::cerr << "Storage::PixelMask: new mask not clear" << std::endl;
+    return -1;
+  }
+
+  mask.set(0, 0);
+  mask.set(66, 12);
+  mask.set(63, 0);
+  mask.set(64, 0);
+  mask.set(10, 5);
+  mask.set(10, 5, false);
+  // Outside the sensor, ignored
+  mask.set(67, 0);
+  mask.set(0, 13);
+
+  if (mask.count() != 4 ||
+      !mask.get(0, 0) ||
+      !mask.get(66, 12) ||
+      !mask.get(63, 0) ||
+      !mask.get(64, 0) ||
+      mask.get(10, 5) ||
+      mask.get(0, 1) ||
+      mask.get(67, 0)) {
+    std::cerr << "Storage::PixelMask: flags set incorrectly" << std::endl;
+    return -1;
+  }
+
+  mask.clear();
+  if (mask.count() != 0) {
+    std::cerr << "Storage::PixelMask: mask not cleared" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+int test_maskFilter() {
+  Storage::PixelMask mask(1152, 576);
+  for (unsigned col = 0; col < 1152; col += 7)
+    mask.set(col, col % 576);
+
+  // Hits over the sensor and outside of it, including negative coordinates
+  std::vector<Int_t> pixX;
+  std::vector<Int_t> pixY;
+  for (Int_t i = -5; i < 1200; i += 3) {
+    pixX.push_back(i);
+    pixY.push_back(i % 576);
+  }
+
+  std::vector<char> masked(pixX.size(), 2);
+  const size_t flagged =
+      mask.filter(&pixX[0], &pixY[0], pixX.size(), &masked[0]);
+
+  size_t expected = 0;
+  for (size_t i = 0; i < pixX.size(); i++) {
+    const bool isMasked = pixX[i] >= 0 && pixY[i] >= 0 &&
+        mask.get(pixX[i], pixY[i]);
+    if (masked[i] != isMasked) {
+      std::cerr << "Storage::PixelMask: filter disagrees with lookup" << std::endl;
+      return -1;
+    }
+    expected += isMasked;
+  }
+
+  if (flagged != expected || expected == 0) {
+    std::cerr << "Storage::PixelMask: wrong number of filtered hits" << std::endl;
+    return -1;
+  }
+
   return 0;
 }
 
+int test_maskStorage() {
+  // Hits along the diagonal of each plane
+  {
+    Storage::StorageO store("tmp_mask.root", NPLANES);
+    for (size_t n = 0; n < NEVENTS; n++) {
+      Storage::Event event(NPLANES);
+      for (size_t nplane = 0; nplane < NPLANES; nplane++)
+        for (size_t nhit = 0; nhit < NHITS; nhit++)
+          event.newHit(nplane).setPix(nhit, nhit);
+      store.writeEvent(event);
+    }
+  }
+
+  // Every other pixel of the diagonal is noisy, in the second plane only
+  std::vector<Storage::PixelMask> masks(NPLANES, Storage::PixelMask(NHITS, NHITS));
+  for (unsigned nhit = 0; nhit < NHITS; nhit += 2)
+    masks[1].set(nhit, nhit);
+
+  Storage::StorageI removing("tmp_mask.root");
+  removing.setNoiseMasks(masks);
+
+  Storage::StorageI flagging("tmp_mask.root");
+  flagging.setNoiseMasks(masks, Storage::StorageIO::PASSIVE);
+
+  for (Long64_t n = 0; n < NEVENTS; n++) {
+    Storage::Event& removed = removing.readEvent(n);
+    if (removed.getPlane(0).getNumHits() != NHITS ||
+        removed.getPlane(1).getNumHits() != NHITS/2) {
+      std::cerr << "Storage::StorageI: masked hits not removed" << std::endl;
+      return -1;
+    }
+    for (size_t nhit = 0; nhit < removed.getPlane(1).getNumHits(); nhit++) {
+      if (removed.getPlane(1).getHit(nhit).getPixX() % 2 != 1) {
+        std::cerr << "Storage::StorageI: wrong hits removed" << std::endl;
+        return -1;
+      }
+    }
+
+    Storage::Event& flagged = flagging.readEvent(n);
+    if (flagged.getPlane(1).getNumHits() != NHITS) {
+      std::cerr << "Storage::StorageI: passive mask removed hits" << std::endl;
+      return -1;
+    }
+    for (size_t nplane = 0; nplane < NPLANES; nplane++) {
+      for (size_t nhit = 0; nhit < NHITS; nhit++) {
+        const Storage::Hit& hit = flagged.getPlane(nplane).getHit(nhit);
+        const bool noisy = nplane == 1 && hit.getPixX() % 2 == 0;
+        if (hit.getMasked() != noisy) {
+          std::cerr << "Storage::StorageI: masked hits not flagged" << std::endl;
+          return -1;
+        }
+      }
+    }
+
+    // Views flag the hits in either mode
+    const Storage::EventView& view = removing.readView(n);
+    if (view.getPlane(1).numHits != NHITS ||
+        view.getPlane(1).hitMasked.size() != NHITS) {
+      std::cerr << "Storage::StorageI: view mask not filled" << std::endl;
+      return -1;
+    }
+    for (size_t nhit = 0; nhit < NHITS; nhit++) {
+      if ((bool)view.getPlane(1).hitMasked[nhit] !=
+          (view.getPlane(1).hitPixX[nhit] % 2 == 0)) {
+        std::cerr << "Storage::StorageI: view mask incorrect" << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  gSystem->Exec("rm -f tmp_mask.root");
+  return 0;
+}
 
 int main() {
   int retval = 0;
 
   try {
     if ((retval = test_mask()) != 0) return retval;
+    if ((retval = test_maskFilter()) != 0) return retval;
+    if ((retval = test_maskStorage()) != 0) return retval;
   }
   
   catch (std::exception& e) {
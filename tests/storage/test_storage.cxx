@@ -7,7 +7,9 @@
 
 #include "storage/storageo.h"
 #include "storage/storagei.h"
+#include "storage/storagechain.h"
 #include "storage/storageio.h"
+#include "storage/eventview.h"
 #include "storage/event.h"
 #include "storage/track.h"
 #include "storage/plane.h"
@@ -164,19 +166,19 @@ int test_storageio() {
   // event object is the same so our reference is still valid
   store.newEvent();
 
-  // Each call to newHit() should retrieve from the cahce until a the cache
-  // is empty
-  if (&event.newHit(0) != &hit2 || &event.newHit(0) != &hit) {
+  // Each call to newHit() should retrieve the kept objects in the order they
+  // were first made
+  if (&event.newHit(0) != &hit || &event.newHit(0) != &hit2) {
     std::cerr << "Storage::StorageIO: hits cache not working back" << std::endl;
     return -1;
   }
 
-  if (&event.newCluster(0) != &cluster2 || &event.newCluster(0) != &cluster) {
+  if (&event.newCluster(0) != &cluster || &event.newCluster(0) != &cluster2) {
     std::cerr << "Storage::StorageIO: clusters cache not working back" << std::endl;
     return -1;
   }
 
-  if (&event.newTrack() != &track2 || &event.newTrack() != &track) {
+  if (&event.newTrack() != &track || &event.newTrack() != &track2) {
     std::cerr << "Storage::StorageIO: tracks cache not working back" << std::endl;
     return -1;
   }
@@ -320,6 +322,176 @@ int test_storageioRead() {
   return 0;
 }
 
+int test_storageioPrefetch() {
+  Storage::StorageI store("tmp.root");
+
+  // Read ahead one event at a time, so that the ring is cycled through
+  store.startPrefetch(1, 0, store.getNumEvents());
+  for (Int_t n = 0; n < store.getNumEvents(); n++) {
+    Storage::Event& event = store.readEvent(n);
+    if (event.getTimeStamp() != (unsigned int)n ||
+        event.getNumHits() != 1 ||
+        !approxEqual(event.getHit(0).getPixX(), 1*n+1)) {
+      std::cerr << "Storage::StorageI: prefetched event incorrect" << std::endl;
+      return -1;
+    }
+  }
+
+  // Reading out of order falls back to reading in place
+  store.startPrefetch(4, 1, store.getNumEvents());
+  if (store.readEvent(1).getTimeStamp() != 1 ||
+      store.readEvent(0).getTimeStamp() != 0 ||
+      store.readEvent(1).getTimeStamp() != 1) {
+    std::cerr << "Storage::StorageI: out of order read incorrect" << std::endl;
+    return -1;
+  }
+  store.stopPrefetch();
+
+  return 0;
+}
+
+int test_storageioChain() {
+  // The same file twice makes a run of two segments
+  Storage::StorageChain store(
+      Storage::StorageChain::expandPaths("tmp.root,tmp.root"));
+
+  if (store.getNumSegments() != 2 ||
+      store.getNumEvents() != 2*NEVENTS ||
+      store.getSegmentOffset(1) != NEVENTS) {
+    std::cerr << "Storage::StorageChain: incorrect number of events" << std::endl;
+    return -1;
+  }
+
+  // Events are numbered across the segments, also when reading ahead
+  store.startPrefetch(2, 1, store.getNumEvents());
+  for (Int_t n = 1; n < store.getNumEvents(); n++) {
+    if (store.readEvent(n).getTimeStamp() != (unsigned int)(n%NEVENTS)) {
+      std::cerr << "Storage::StorageChain: event read back incorrect" << std::endl;
+      return -1;
+    }
+  }
+  store.stopPrefetch();
+
+  // And going back to the first segment
+  if (store.readEvent(0).getTimeStamp() != 0) {
+    std::cerr << "Storage::StorageChain: random access incorrect" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+int test_storageioFriend() {
+  {
+    Storage::StorageI input("tmp.root");
+    Storage::StorageO output(
+        "tmp_friend.root", input.getNumPlanes(), Storage::StorageIO::NONE,
+        0, 0, 0, 0, "tmp.root");
+
+    // Re-process the clusters, e.g. with another alignment
+    for (Int_t n = 0; n < input.getNumEvents(); n++) {
+      Storage::Event& event = input.readEvent(n);
+      Storage::Cluster& cluster = event.getCluster(0);
+      cluster.setPos(
+          cluster.getPosX()+10, cluster.getPosY(), cluster.getPosZ());
+      output.writeEvent(event);
+    }
+  }
+
+  // The hits and event information come from the original file
+  Storage::StorageI store("tmp_friend.root");
+
+  if (store.getNumEvents() != NEVENTS) {
+    std::cerr << "Storage::StorageI: incorrect number of friend events" << std::endl;
+    return -1;
+  }
+
+  for (Int_t n = 0; n < store.getNumEvents(); n++) {
+    Storage::Event& event = store.readEvent(n);
+
+    if (event.getTimeStamp() != (unsigned int)n ||
+        event.getNumHits() != 1 ||
+        event.getNumClusters() != 1 ||
+        event.getNumTracks() != 1) {
+      std::cerr << "Storage::StorageI: friend event read back incorrect" << std::endl;
+      return -1;
+    }
+
+    Storage::Hit& hit = event.getHit(0);
+    Storage::Cluster& cluster = event.getCluster(0);
+    if (hit.getPixX() != 1*n+1 ||
+        !approxEqual(cluster.getPosX(), .1*n+11)) {
+      std::cerr << "Storage::StorageI: friend objects read back incorrect" << std::endl;
+      return -1;
+    }
+  }
+
+  gSystem->Exec("rm -f tmp_friend.root");
+  return 0;
+}
+
+int test_storageioView() {
+  Storage::StorageI store("tmp.root");
+
+  // Read the views in reverse so that they don't just follow the file
+  for (Int_t n = store.getNumEvents()-1; n >= 0; n--) {
+    const Storage::EventView& view = store.readView(n);
+
+    if (view.timeStamp != (ULong64_t)n ||
+        view.frameNumber != (ULong64_t)n+1 ||
+        view.triggerOffset != n+2 ||
+        view.triggerInfo != n+3) {
+      std::cerr << "Storage::StorageI: view event info incorrect" << std::endl;
+      return -1;
+    }
+
+    if (view.getNumPlanes() != NPLANES || view.numTracks != 1) {
+      std::cerr << "Storage::StorageI: view has incorrect size" << std::endl;
+      return -1;
+    }
+
+    if (!approxEqual(view.trackOriginX[0], .1*n+1) ||
+        !approxEqual(view.trackSlopeY[0], .2*n+1) ||
+        !approxEqual(view.trackChi2[0], .1*n+1)) {
+      std::cerr << "Storage::StorageI: view tracks incorrect" << std::endl;
+      return -1;
+    }
+
+    const Storage::EventView::PlaneView& plane = view.getPlane(n%NPLANES);
+    if (plane.numClusters != 1 || plane.numHits != 1) {
+      std::cerr << "Storage::StorageI: view plane has incorrect size" << std::endl;
+      return -1;
+    }
+
+    if (!approxEqual(plane.clusterPixX[0], .1*n+1) ||
+        !approxEqual(plane.clusterPosZ[0], .3*n+1) ||
+        !approxEqual(plane.clusterPosErrY[0], .2*n+1) ||
+        plane.clusterInTrack[0] != 1) {
+      std::cerr << "Storage::StorageI: view clusters incorrect" << std::endl;
+      return -1;
+    }
+
+    if (plane.hitPixX[0] != 1*n+1 ||
+        plane.hitPixY[0] != 2*n+1 ||
+        !approxEqual(plane.hitPosY[0], .2*n+1) ||
+        plane.hitTiming[0] != 1*n+1 ||
+        plane.hitValue[0] != 2*n+1 ||
+        plane.hitInCluster[0] != 1 ||
+        !plane.hitMasked.empty()) {
+      std::cerr << "Storage::StorageI: view hits incorrect" << std::endl;
+      return -1;
+    }
+
+    // Events can still be read in between views
+    if (store.readEvent(n).getHit(0).getPixY() != 2*n+1) {
+      std::cerr << "Storage::StorageI: event after view incorrect" << std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 int test_storageioReadMasking() {
   {  // Hit masking
     Storage::StorageI store(
@@ -479,6 +651,145 @@ int test_storageioReadMasking() {
   return 0;
 }
 
+int test_storageioGrow() {
+  // Multiplicities well beyond the initial array sizes
+  const Int_t numHits = 4*INIT_HITS+1;
+  const Int_t numClusters = 4*INIT_CLUSTERS+1;
+  const Int_t numTracks = 4*INIT_TRACKS+1;
+
+  {
+    Storage::StorageO store("tmp_grow.root", 1);
+
+    // One small event, then one which needs the arrays to grow
+    for (Int_t n = 0; n < 2; n++) {
+      Storage::Event& event = store.newEvent();
+      const Int_t scale = n ? 1 : 0;
+      for (Int_t i = 0; i < 1+scale*(numHits-1); i++)
+        event.newHit(0).setPix(i, i+1);
+      for (Int_t i = 0; i < 1+scale*(numClusters-1); i++)
+        event.newCluster(0).setPix(i, i+1);
+      for (Int_t i = 0; i < 1+scale*(numTracks-1); i++)
+        event.newTrack().setChi2(i);
+      store.writeEvent(event);
+    }
+
+    if (store.getMaxHits() != numHits ||
+        store.getMaxClusters() != numClusters ||
+        store.getMaxTracks() != numTracks) {
+      std::cerr << "Storage::StorageO: wrong high-water marks" << std::endl;
+      return -1;
+    }
+  }
+
+  Storage::StorageI store("tmp_grow.root");
+
+  // Read the large event first, then the small one from the grown arrays
+  for (Int_t n = 1; n >= 0; n--) {
+    Storage::Event& event = store.readEvent(n);
+    const Int_t scale = n ? 1 : 0;
+
+    if (event.getNumHits() != (size_t)(1+scale*(numHits-1)) ||
+        event.getNumClusters() != (size_t)(1+scale*(numClusters-1)) ||
+        event.getNumTracks() != (size_t)(1+scale*(numTracks-1))) {
+      std::cerr << "Storage::StorageI: grown event sizes incorrect" << std::endl;
+      return -1;
+    }
+
+    const Int_t lastHit = event.getNumHits()-1;
+    const Int_t lastCluster = event.getNumClusters()-1;
+    const Int_t lastTrack = event.getNumTracks()-1;
+    if (event.getHit(lastHit).getPixX() != lastHit ||
+        event.getHit(lastHit).getPixY() != lastHit+1 ||
+        !approxEqual(event.getCluster(lastCluster).getPixX(), lastCluster) ||
+        !approxEqual(event.getCluster(lastCluster).getPixY(), lastCluster+1) ||
+        !approxEqual(event.getTrack(lastTrack).getChi2(), lastTrack)) {
+      std::cerr << "Storage::StorageI: grown event read back incorrect" << std::endl;
+      return -1;
+    }
+  }
+
+  if (store.getMaxHits() != numHits ||
+      store.getMaxClusters() != numClusters ||
+      store.getMaxTracks() != numTracks) {
+    std::cerr << "Storage::StorageI: wrong high-water marks" << std::endl;
+    return -1;
+  }
+
+  gSystem->Exec("rm -f tmp_grow.root");
+  return 0;
+}
+
+int test_storageioWriter() {
+  const Int_t numEvents = 16;
+
+  {
+    Storage::StorageO store("tmp_writer.root", NPLANES);
+    // Queue fewer events than are written, so that the loop has to wait
+    store.startWriter(2);
+
+    for (Int_t n = 0; n < numEvents; n++) {
+      Storage::Event& event = store.newEvent();
+      event.setTimeStamp(n);
+      for (Int_t i = 0; i <= n; i++)
+        event.newHit(0).setPix(n, i);
+      event.newTrack().setChi2(n);
+      store.writeEvent(event);
+    }
+
+    store.stopWriter();
+
+    if (store.getNumEvents() != numEvents ||
+        store.getMaxHits() != numEvents) {
+      std::cerr << "Storage::StorageO: queued events not written" << std::endl;
+      return -1;
+    }
+  }
+
+  // The events come back in order, each from its own copy
+  Storage::StorageI store("tmp_writer.root");
+  for (Int_t n = 0; n < store.getNumEvents(); n++) {
+    Storage::Event& event = store.readEvent(n);
+    if (event.getTimeStamp() != (unsigned int)n ||
+        event.getNumHits() != (size_t)n+1 ||
+        event.getHit(n).getPixX() != n ||
+        event.getHit(n).getPixY() != n ||
+        !approxEqual(event.getTrack(0).getChi2(), n)) {
+      std::cerr << "Storage::StorageO: queued event written incorrectly" << std::endl;
+      return -1;
+    }
+  }
+
+  gSystem->Exec("rm -f tmp_writer.root");
+  return 0;
+}
+
+int test_storageioSettings() {
+  Storage::StorageO::Settings settings;
+  Storage::StorageO::parseCompression("lz4:4", settings);
+  if (settings.compressionAlgorithm != 4 || settings.compressionLevel != 4) {
+    std::cerr << "Storage::StorageO: compression parsed incorrectly" << std::endl;
+    return -1;
+  }
+
+  // Without a level, the level is kept
+  Storage::StorageO::parseCompression("zlib", settings);
+  if (settings.compressionAlgorithm != 1 || settings.compressionLevel != 4) {
+    std::cerr << "Storage::StorageO: compression parsed incorrectly" << std::endl;
+    return -1;
+  }
+
+  const char* invalid[] = { "lz5", "lz4:", "lz4:10", "zstd:1x" };
+  for (size_t i = 0; i < sizeof(invalid)/sizeof(invalid[0]); i++) {
+    try {
+      Storage::StorageO::parseCompression(invalid[i], settings);
+      std::cerr << "Storage::StorageO: accepted compression " << invalid[i] << std::endl;
+      return -1;
+    } catch (std::runtime_error&) {}
+  }
+
+  return 0;
+}
+
 // TODO test masking on write
 
 int main() {
@@ -488,7 +799,14 @@ int main() {
     if ((retval = test_storageio()) != 0) return retval;
     if ((retval = test_storageioWrite()) != 0) return retval;
     if ((retval = test_storageioRead()) != 0) return retval;
+    if ((retval = test_storageioPrefetch()) != 0) return retval;
+    if ((retval = test_storageioChain()) != 0) return retval;
+    if ((retval = test_storageioFriend()) != 0) return retval;
+    if ((retval = test_storageioView()) != 0) return retval;
     if ((retval = test_storageioReadMasking()) != 0) return retval;
+    if ((retval = test_storageioGrow()) != 0) return retval;
+    if ((retval = test_storageioWriter()) != 0) return retval;
+    if ((retval = test_storageioSettings()) != 0) return retval;
   }
   
   catch (std::exception& e) {
@@ -0,0 +1,278 @@
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+#include <vector>
+
+#include <TSystem.h>
+
+#include "storage/storagemapped.h"
+#include "storage/storageio.h"
+#include "storage/storagei.h"
+#include "storage/storageo.h"
+#include "storage/eventview.h"
+#include "storage/event.h"
+#include "storage/track.h"
+#include "storage/plane.h"
+#include "storage/cluster.h"
+#include "storage/hit.h"
+
+#define NPLANES 3
+#define NEVENTS 20
+
+bool approxEqual(double v1, double v2, double tol=1E-10) {
+  return std::fabs(v1-v2) < tol;
+}
+
+int test_storagemappedWrite() {
+  Storage::StorageMappedO store("tmp.jmap", NPLANES);
+
+  for (size_t n = 0; n < NEVENTS; n++) {
+    Storage::Event event(NPLANES);
+    event.setTimeStamp(n);
+    event.setFrameNumber(n+1);
+    event.setTriggerOffset(n+2);
+    event.setTriggerInfo(n+3);
+    event.setInvalid(n%2);
+
+    Storage::Track& track = event.newTrack();
+    track.setOrigin(.1*n+1, .2*n+1);
+    track.setSlope(.3*n+1, .4*n+1);
+    track.setChi2(.5*n+1);
+
+    // Plane p has n%(p+2) clusters of 2 hits each, so that the event-wide
+    // cluster indices need to be offset for each plane
+    for (size_t nplane = 0; nplane < NPLANES; nplane++) {
+      for (size_t ncluster = 0; ncluster < n%(nplane+2); ncluster++) {
+        Storage::Cluster& cluster = event.newCluster(nplane);
+        cluster.setPix(ncluster+.5, nplane+.5);
+        cluster.setPos(.1*n, .2*ncluster, .3*nplane);
+        for (size_t nhit = 0; nhit < 2; nhit++) {
+          Storage::Hit& hit = event.newHit(nplane);
+          hit.setPix(ncluster, nhit);
+          hit.setValue(n);
+          cluster.addHit(hit);
+        }
+        if (ncluster == 0) track.addCluster(cluster);
+      }
+    }
+
+    store.writeEvent(event);
+  }
+
+  store.close();
+  return 0;
+}
+
+int test_storagemappedRead() {
+  Storage::StorageMapped store("tmp.jmap");
+
+  if (store.getNumEvents() != NEVENTS || store.getNumPlanes() != NPLANES) {
+    std::cerr << "Storage::StorageMapped: incorrect size" << std::endl;
+    return -1;
+  }
+
+  // Random access, reverse order
+  for (Long64_t n = NEVENTS-1; n >= 0; n--) {
+    Storage::Event& event = store.readEvent(n);
+
+    if (event.getTimeStamp() != (ULong64_t)n ||
+        event.getFrameNumber() != (ULong64_t)n+1 ||
+        event.getTriggerOffset() != n+2 ||
+        event.getTriggerInfo() != n+3 ||
+        event.getInvalid() != (bool)(n%2)) {
+      std::cerr << "Storage::StorageMapped: event info incorrect" << std::endl;
+      return -1;
+    }
+
+    if (event.getNumTracks() != 1 ||
+        !approxEqual(event.getTrack(0).getOriginY(), .2*n+1) ||
+        !approxEqual(event.getTrack(0).getSlopeX(), .3*n+1) ||
+        !approxEqual(event.getTrack(0).getChi2(), .5*n+1)) {
+      std::cerr << "Storage::StorageMapped: track incorrect" << std::endl;
+      return -1;
+    }
+
+    size_t nfirst = 0;  // clusters starting each plane's first cluster
+    for (size_t nplane = 0; nplane < NPLANES; nplane++) {
+      const Storage::Plane& plane = event.getPlane(nplane);
+      const size_t nclusters = n%(nplane+2);
+      if (plane.getNumClusters() != nclusters ||
+          plane.getNumHits() != 2*nclusters) {
+        std::cerr << "Storage::StorageMapped: plane size incorrect" << std::endl;
+        return -1;
+      }
+      if (nclusters) nfirst += 1;
+
+      for (size_t ncluster = 0; ncluster < nclusters; ncluster++) {
+        const Storage::Cluster& cluster = plane.getCluster(ncluster);
+        if (!approxEqual(cluster.getPixX(), ncluster+.5) ||
+            !approxEqual(cluster.getPosZ(), .3*nplane) ||
+            cluster.getNumHits() != 2 ||
+            cluster.getHit(1).getPixY() != 1 ||
+            cluster.getHit(0).getPixX() != (int)ncluster ||
+            (ncluster == 0) != (cluster.fetchTrack() != 0)) {
+          std::cerr << "Storage::StorageMapped: cluster incorrect" << std::endl;
+          return -1;
+        }
+      }
+    }
+
+    if (event.getTrack(0).getNumClusters() != nfirst) {
+      std::cerr << "Storage::StorageMapped: track clusters incorrect" << std::endl;
+      return -1;
+    }
+
+    // The view reads the same block
+    const Storage::EventView& view = store.readView(n);
+    if (view.timeStamp != (ULong64_t)n ||
+        !approxEqual(view.trackOriginX[0], .1*n+1) ||
+        view.getPlane(1).numClusters != (size_t)n%3 ||
+        (n%3 && !approxEqual(view.getPlane(1).clusterPixY[0], 1.5))) {
+      std::cerr << "Storage::StorageMapped: view incorrect" << std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int test_storagemappedMasking() {
+  // Mask the first plane and the tracks
+  std::vector<bool> planeMask(NPLANES, false);
+  planeMask[0] = true;
+  Storage::StorageMapped store(
+      "tmp.jmap",
+      Storage::StorageIO::TRACKS,
+      &planeMask);
+
+  if (store.getNumPlanes() != NPLANES-1) {
+    std::cerr << "Storage::StorageMapped: plane mask not applied" << std::endl;
+    return -1;
+  }
+
+  for (Long64_t n = 0; n < NEVENTS; n++) {
+    Storage::Event& event = store.readEvent(n);
+    if (event.getNumTracks() != 0) {
+      std::cerr << "Storage::StorageMapped: tracks mask not applied" << std::endl;
+      return -1;
+    }
+    // Hits still find their own clusters once the first plane is gone
+    for (size_t nplane = 0; nplane < NPLANES-1; nplane++) {
+      const Storage::Plane& plane = event.getPlane(nplane);
+      if (plane.getNumClusters() != n%(nplane+3)) {
+        std::cerr << "Storage::StorageMapped: masked plane size incorrect" << std::endl;
+        return -1;
+      }
+      for (size_t nhit = 0; nhit < plane.getNumHits(); nhit++)
+        if (plane.getHit(nhit).fetchCluster()->fetchPlane() !=
+            &event.getPlane(nplane)) {
+          std::cerr << "Storage::StorageMapped: masked associations incorrect" << std::endl;
+          return -1;
+        }
+    }
+  }
+
+  return 0;
+}
+
+/** Association columns of an event, copied out of its view */
+void copyLinks(
+    const Storage::EventView& view,
+    std::vector<Int_t>& hitInCluster,
+    std::vector<Int_t>& clusterInTrack) {
+  hitInCluster.clear();
+  clusterInTrack.clear();
+  for (size_t nplane = 0; nplane < view.getNumPlanes(); nplane++) {
+    const Storage::EventView::PlaneView& plane = view.getPlane(nplane);
+    for (size_t nhit = 0; nhit < plane.numHits; nhit++)
+      hitInCluster.push_back(plane.hitInCluster[nhit]);
+    for (size_t ncluster = 0; ncluster < plane.numClusters; ncluster++)
+      clusterInTrack.push_back(plane.clusterInTrack[ncluster]);
+  }
+}
+
+int test_storagemappedRoundTrip() {
+  // As from-mapped then to-mapped
+  {
+    Storage::StorageMapped input("tmp.jmap");
+    Storage::StorageO output("tmp_mapped.root", input.getNumPlanes());
+    for (Long64_t n = 0; n < input.getNumEvents(); n++)
+      output.writeEvent(input.readEvent(n));
+  }
+  {
+    Storage::StorageI input("tmp_mapped.root");
+    Storage::StorageMappedO output("tmp_back.jmap", input.getNumPlanes());
+    for (Long64_t n = 0; n < input.getNumEvents(); n++)
+      output.writeEvent(input.readEvent(n));
+    output.close();
+  }
+
+  Storage::StorageMapped mapped("tmp.jmap");
+  Storage::StorageI root("tmp_mapped.root");
+  Storage::StorageMapped back("tmp_back.jmap");
+
+  if (root.getNumEvents() != NEVENTS || back.getNumEvents() != NEVENTS) {
+    std::cerr << "Storage::StorageMapped: round trip size incorrect" << std::endl;
+    return -1;
+  }
+
+  // The formats store the associations the same way, so they go through
+  // both conversions unchanged
+  size_t nlinked = 0;
+  for (Long64_t n = 0; n < NEVENTS; n++) {
+    std::vector<Int_t> hitInCluster, clusterInTrack;
+    copyLinks(mapped.readView(n), hitInCluster, clusterInTrack);
+
+    std::vector<Int_t> rootHitInCluster, rootClusterInTrack;
+    copyLinks(root.readView(n), rootHitInCluster, rootClusterInTrack);
+
+    std::vector<Int_t> backHitInCluster, backClusterInTrack;
+    copyLinks(back.readView(n), backHitInCluster, backClusterInTrack);
+
+    if (rootHitInCluster != hitInCluster ||
+        rootClusterInTrack != clusterInTrack ||
+        backHitInCluster != hitInCluster ||
+        backClusterInTrack != clusterInTrack) {
+      std::cerr << "Storage::StorageMapped: round trip associations incorrect" << std::endl;
+      return -1;
+    }
+
+    // Every hit is in a cluster, and the first cluster of each plane in
+    // the track
+    for (size_t nhit = 0; nhit < hitInCluster.size(); nhit++)
+      if (hitInCluster[nhit] < 1) {
+        std::cerr << "Storage::StorageMapped: round trip lost a cluster" << std::endl;
+        return -1;
+      }
+    for (size_t ncluster = 0; ncluster < clusterInTrack.size(); ncluster++)
+      if (clusterInTrack[ncluster] == 1) nlinked += 1;
+  }
+
+  if (nlinked == 0) {
+    std::cerr << "Storage::StorageMapped: round trip lost the tracks" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+int main() {
+  int retval = 0;
+
+  try {
+    if ((retval = test_storagemappedWrite()) != 0) return retval;
+    if ((retval = test_storagemappedRead()) != 0) return retval;
+    if ((retval = test_storagemappedMasking()) != 0) return retval;
+    if ((retval = test_storagemappedRoundTrip()) != 0) return retval;
+  }
+
+  catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return -1;
+  }
+
+  // Remove file on success, otherwise keep it so it can be consulted
+  gSystem->Exec("rm -f tmp.jmap tmp_back.jmap tmp_mapped.root");
+
+  return 0;
+}